@@ -0,0 +1,568 @@
+//
+// Author: Lorenz Pullwitt <memorysurfer@lorenz-pullwitt.de>
+// Copyright 2016-2024
+//
+// This file is part of MemorySurfer.
+//
+// MemorySurfer is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, you can find it here:
+// https://www.gnu.org/licenses/old-licenses/gpl-2.0.html
+//
+
+// Offline benchmark of the scheduler and the IndexedMemoryFile: generates a synthetic .imsf through the XML import
+// (or reuses one generated before), then simulates days of learning on a copy of it, each a session of rating
+// requests (open, proceed, sync, ask the next card: the functions of S_PROCEED_SYNC_QA) up to a daily budget, and
+// reports their latency percentiles, chunk reads and allocations.
+// usage: msbench [-o file] [-k] [-t depth] [-f fan-out] [-c cards per deck] [-n new %] [-s suspended %]
+//                [-l weights of the strength levels 0,1,..] [-d days] [-b reviews per day] [-p pass %] [-r seed]
+// -k reuses the file when it exists, the runs are made on "<file>.run"
+
+#define main ms_main // the functions of the CGI are driven directly
+#include "../memorysurfer.c"
+#undef main
+
+#include <getopt.h>
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+static long bench_allocs; // linked with --wrap=malloc,--wrap=calloc,--wrap=realloc
+
+void *__wrap_malloc(size_t size)
+{
+  __atomic_fetch_add(&bench_allocs, 1, __ATOMIC_RELAXED);
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+  __atomic_fetch_add(&bench_allocs, 1, __ATOMIC_RELAXED);
+  return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+  __atomic_fetch_add(&bench_allocs, 1, __ATOMIC_RELAXED);
+  return __real_realloc(ptr, size);
+}
+
+static const time_t BENCH_EPOCH = 1699920000; // 2023-11-14 00:00 UTC: the time of the generated file, day 0 of the run
+
+struct BenchOpt {
+  const char *filename;
+  int8_t reuse;
+  int depth; // of the deck tree
+  int fan; // sub-decks of a deck
+  int card_n; // per deck
+  int new_pct;
+  int susp_pct;
+  int weight_l[21]; // of the strength levels
+  int weight_sum;
+  int day_n;
+  int budget; // ratings per day
+  int pass_pct;
+  unsigned seed;
+};
+
+struct BenchStat {
+  double *lat_l; // request, microseconds
+  double *ask_l; // ms_ask_card of the request
+  int32_t *gets_l;
+  long *allocs_l;
+  int n;
+  int refill_n; // requests which refilled the session queue
+};
+
+static double bench_usec(struct timespec *t0, struct timespec *t1)
+{
+  return (t1->tv_sec - t0->tv_sec) * 1e6 + (t1->tv_nsec - t0->tv_nsec) / 1e3;
+}
+
+// the level of the strength as the rating buttons of P_LEARN (gen_html) derive it, at most 19 to pass one up
+static int bench_level(int32_t strength)
+{
+  int lvl;
+  lvl = 0;
+  while (lvl < 19 && lvl_s[lvl] < strength) {
+    lvl++;
+  }
+  return lvl;
+}
+
+// the cards of a deck and its sub-decks, path_str is the name of the deck ("1.3.2")
+static int bench_gen_deck(FILE *stream, struct BenchOpt *bo, char *path_str, int depth, int *deck_np)
+{
+  int e;
+  int rv;
+  int i;
+  int lvl;
+  int state;
+  time_t card_time;
+  struct tm bd_time;
+  size_t len;
+  rv = fprintf(stream, "<deck><name>Deck %s</name>\n", path_str);
+  e = rv < 0;
+  for (i = 0; i < bo->card_n && e == 0; i++) {
+    rv = rand() % 100;
+    state = rv < bo->new_pct ? STATE_NEW : rv < bo->new_pct + bo->susp_pct ? STATE_SUSPENDED : STATE_SCHEDULED;
+    rv = rand() % bo->weight_sum;
+    for (lvl = 0; rv >= bo->weight_l[lvl]; lvl++) {
+      rv -= bo->weight_l[lvl];
+    }
+    card_time = BENCH_EPOCH - rand() % (2 * lvl_s[lvl]); // about half of the scheduled cards due
+    e = gmtime_r(&card_time, &bd_time) == NULL;
+    if (e == 0) {
+      rv = fprintf(stream, "<card><time>%04d-%02d-%02dT%02d:%02d:%02d</time><strength>%ld</strength><state>%d</state>"
+                           "<question>question %d of deck %s, term%d &amp; word%d</question><answer>answer %d</answer></card>\n",
+          bd_time.tm_year + 1900, bd_time.tm_mon + 1, bd_time.tm_mday, bd_time.tm_hour, bd_time.tm_min, bd_time.tm_sec,
+          (long)lvl_s[lvl], state, i, path_str, rand() % 1000, rand() % 100, i);
+      e = rv < 0;
+    }
+  }
+  (*deck_np)++;
+  len = strlen(path_str);
+  for (i = 0; i < bo->fan && depth < bo->depth && e == 0; i++) {
+    sprintf(path_str + len, len > 0 ? ".%d" : "%d", i + 1);
+    e = bench_gen_deck(stream, bo, path_str, depth + 1, deck_np);
+  }
+  path_str[len] = '\0';
+  if (e == 0) {
+    rv = fprintf(stream, "</deck>\n");
+    e = rv < 0;
+  }
+  return e;
+}
+
+// a collection like an XML export: a full tree of depth levels with fan-out sub-decks each
+static int bench_gen_xml(char **xml_dp, size_t *xml_np, struct BenchOpt *bo)
+{
+  int e;
+  FILE *stream;
+  char path_str[128];
+  int deck_n;
+  int rv;
+  int i;
+  stream = open_memstream(xml_dp, xml_np);
+  e = stream == NULL;
+  if (e == 0) {
+    rv = fprintf(stream, "<memorysurfer>\n");
+    e = rv < 0;
+    deck_n = 0;
+    for (i = 0; i < bo->fan && e == 0; i++) {
+      sprintf(path_str, "%d", i + 1);
+      e = bench_gen_deck(stream, bo, path_str, 1, &deck_n);
+    }
+    if (e == 0) {
+      rv = fprintf(stream, "</memorysurfer>\n");
+      e = rv < 0;
+    }
+    rv = fclose(stream);
+    if (e == 0) {
+      e = rv != 0;
+    }
+  }
+  return e;
+}
+
+// the steps of A_CREATE, A_UPLOAD_REPORT and A_SYNC, all decks checked for learning
+static int bench_generate(struct WebMemorySurfer *wms, char *xml_d, size_t xml_n)
+{
+  int e;
+  struct XML *xml;
+  int i;
+  int32_t data_size;
+  e = ms_create(&wms->ms, O_TRUNC);
+  if (e == 0) {
+    xml = calloc(1, sizeof(struct XML));
+    e = xml == NULL;
+    if (e == 0) {
+      xml->xml_buf = xml_d;
+      xml->xml_len = xml_n;
+      xml->xml_held = -1;
+      xml->prev_cat_i = -1;
+      xml_stage_init(xml);
+      wms->card_n = 0;
+      wms->deck_n = 0;
+      e = ms_clear_index(&wms->ms);
+      if (e == 0) {
+        e = parse_xml(xml, wms, TAG_ROOT, -1);
+        if (e == 0) {
+          e = xml_store(xml, &wms->ms);
+        }
+      }
+      for (i = 0; i < xml->cardlist_a; i++) {
+        free(xml->cardlist_l[i].card_l);
+      }
+      free(xml->cardlist_l);
+      xml_stage_free(xml);
+      free(xml);
+    }
+  }
+  if (e == 0) {
+    for (i = 0; i < wms->ms.deck_a; i++) {
+      wms->ms.cat_t[i].deck_on = wms->ms.cat_t[i].deck_slot_used;
+    }
+    data_size = sa_length(&wms->ms.deck_sa);
+    e = imf_put(&wms->ms.imf, SA_INDEX, wms->ms.deck_sa.sa_d, data_size);
+    if (e == 0) {
+      data_size = sizeof(struct Deck) * wms->ms.deck_a;
+      e = imf_put(&wms->ms.imf, C_INDEX, wms->ms.cat_t, data_size);
+      if (e == 0) {
+        e = ms_build_topology(&wms->ms);
+      }
+    }
+  }
+  if (e == 0) {
+    e = ms_sync(&wms->ms);
+  }
+  return e;
+}
+
+static int bench_copy(const char *src_filename, const char *dst_filename)
+{
+  int e;
+  int src_fd;
+  int dst_fd;
+  char *buf;
+  ssize_t nread;
+  ssize_t nwritten;
+  buf = malloc(1 << 20);
+  e = buf == NULL;
+  if (e == 0) {
+    src_fd = open(src_filename, O_RDONLY);
+    e = src_fd == -1;
+    if (e == 0) {
+      dst_fd = open(dst_filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      e = dst_fd == -1;
+      if (e == 0) {
+        do {
+          nread = read(src_fd, buf, 1 << 20);
+          e = nread < 0;
+          if (e == 0 && nread > 0) {
+            nwritten = write(dst_fd, buf, nread);
+            e = nwritten != nread;
+          }
+        } while (nread > 0 && e == 0);
+        if (close(dst_fd) != 0) {
+          e = 1;
+        }
+      }
+      close(src_fd);
+    }
+    free(buf);
+  }
+  return e;
+}
+
+// one request of S_PROCEED_SYNC_QA (A_OPEN, A_READ_PASSWD, A_LOAD_CARDLIST, A_PROCEED, A_SYNC, A_DETERMINE_CARD):
+// rates the card of *deck_ip and *card_ip at lvl (none for *deck_ip -1) and returns the next one in them, with its
+// strength (0 for a card not scheduled yet); *deck_ip is -1 when no card is eligible
+static int bench_request(const char *filename, time_t timestamp, int lvl, int *deck_ip, int *card_ip, int32_t *strength_p, struct BenchStat *bs)
+{
+  int e;
+  struct MemorySurfer ms;
+  struct Card *card_ptr;
+  struct timespec t_l[4];
+  long allocs;
+  int32_t gets;
+  int8_t refill;
+  allocs = bench_allocs;
+  e = clock_gettime(CLOCK_MONOTONIC, t_l + 0);
+  if (e == 0) {
+    e = ms_init(&ms);
+  }
+  if (e == 0) {
+    ms.timestamp = timestamp;
+    ms.imf_filename = strdup(filename);
+    e = ms.imf_filename == NULL;
+    if (e == 0) {
+      e = ms_open(&ms);
+      if (e == 0) {
+        e = ms_read_passwd(&ms);
+      }
+    }
+    if (e == 0 && *deck_ip >= 0) {
+      ms.deck_i = *deck_ip;
+      ms.card_i = *card_ip;
+      ms.lvl = lvl;
+      e = ms_load_card_list(&ms);
+      if (e == 0) {
+        e = ms.card_i < ms.card_a ? 0 : E_CARD_1;
+        if (e == 0) {
+          e = ms_proceed(&ms);
+          if (e == 0) {
+            e = ms_sync(&ms);
+          }
+        }
+      }
+    }
+    if (e == 0) {
+      e = clock_gettime(CLOCK_MONOTONIC, t_l + 1);
+    }
+    if (e == 0) {
+      e = ms_ask_card(&ms);
+      if (e == 0) {
+        card_ptr = ms.card_l + ms.card_i;
+        *deck_ip = ms.deck_i;
+        *card_ip = ms.card_i;
+        *strength_p = (card_ptr->card_state & 0x07) == STATE_SCHEDULED ? card_ptr->card_strength : 0;
+      } else if (e == -1) {
+        *deck_ip = -1;
+        e = 0;
+      }
+      if (e == 0) {
+        e = clock_gettime(CLOCK_MONOTONIC, t_l + 2);
+      }
+    }
+    refill = ms.sq_fill;
+    gets = ms.imf.stat_gets;
+    ms_free(&ms);
+  }
+  if (e == 0) {
+    e = clock_gettime(CLOCK_MONOTONIC, t_l + 3);
+    if (e == 0) {
+      bs->lat_l[bs->n] = bench_usec(t_l + 0, t_l + 3);
+      bs->ask_l[bs->n] = bench_usec(t_l + 1, t_l + 2);
+      bs->gets_l[bs->n] = gets;
+      bs->allocs_l[bs->n] = bench_allocs - allocs;
+      bs->refill_n += refill;
+      bs->n++;
+    }
+  }
+  return e;
+}
+
+static int dbl_cmp(const void *a, const void *b)
+{
+  double d;
+  d = *(const double *)a - *(const double *)b;
+  return d < 0 ? -1 : d > 0;
+}
+
+static void bench_print(const char *name, double *val_l, int n)
+{
+  qsort(val_l, n, sizeof(double), dbl_cmp);
+  printf("%-12s %10.1f %10.1f %10.1f %10.1f\n", name, val_l[(n - 1) * 50 / 100], val_l[(n - 1) * 90 / 100], val_l[(n - 1) * 99 / 100], val_l[n - 1]);
+}
+
+static int bench_weights(struct BenchOpt *bo, char *str)
+{
+  int e;
+  int i;
+  char *end;
+  long weight;
+  memset(bo->weight_l, 0, sizeof(bo->weight_l));
+  bo->weight_sum = 0;
+  e = 0;
+  i = 0;
+  do {
+    weight = strtol(str, &end, 10);
+    e = end == str || weight < 0 || weight > 1000 || (*end != ',' && *end != '\0') ? E_ARG_1 : 0;
+    if (e == 0) {
+      bo->weight_l[i++] = weight;
+      bo->weight_sum += weight;
+      str = end + (*end == ',');
+    }
+  } while (*end == ',' && i < 21 && e == 0);
+  if (e == 0) {
+    e = *end != '\0' || bo->weight_sum == 0 ? E_ARG_1 : 0;
+  }
+  return e;
+}
+
+int main(int argc, char *argv[])
+{
+  int e;
+  struct BenchOpt bo;
+  struct WebMemorySurfer *wms;
+  struct BenchStat bs;
+  char *xml_d;
+  size_t xml_n;
+  char *run_filename;
+  struct timespec t_l[2];
+  struct stat file_stat;
+  long allocs;
+  time_t timestamp;
+  int deck_i;
+  int card_i;
+  int32_t strength;
+  int lvl;
+  int req_a;
+  int day;
+  int rating_n;
+  int out_n;
+  int i;
+  int opt;
+  double *val_l;
+  bo.filename = "msbench.imsf";
+  bo.reuse = 0;
+  bo.depth = 2;
+  bo.fan = 8;
+  bo.card_n = 500;
+  bo.new_pct = 25;
+  bo.susp_pct = 5;
+  bo.day_n = 28;
+  bo.budget = 200;
+  bo.pass_pct = 80;
+  bo.seed = 1;
+  e = bench_weights(&bo, "1,1,1,1,1,1,1,1,1,1,1,1"); // 1m to 7D
+  while (e == 0 && (opt = getopt(argc, argv, "o:kt:f:c:n:s:l:d:b:p:r:")) != -1) {
+    switch (opt) {
+    case 'o':
+      bo.filename = optarg;
+      break;
+    case 'k':
+      bo.reuse = 1;
+      break;
+    case 't':
+      bo.depth = atoi(optarg);
+      break;
+    case 'f':
+      bo.fan = atoi(optarg);
+      break;
+    case 'c':
+      bo.card_n = atoi(optarg);
+      break;
+    case 'n':
+      bo.new_pct = atoi(optarg);
+      break;
+    case 's':
+      bo.susp_pct = atoi(optarg);
+      break;
+    case 'l':
+      e = bench_weights(&bo, optarg);
+      break;
+    case 'd':
+      bo.day_n = atoi(optarg);
+      break;
+    case 'b':
+      bo.budget = atoi(optarg);
+      break;
+    case 'p':
+      bo.pass_pct = atoi(optarg);
+      break;
+    case 'r':
+      bo.seed = atoi(optarg);
+      break;
+    default:
+      e = E_ARG_1;
+    }
+  }
+  if (e == 0) {
+    e = bo.depth <= 0 || bo.depth > 8 || bo.fan <= 0 || bo.card_n < 0 || bo.new_pct < 0 || bo.susp_pct < 0 || bo.new_pct + bo.susp_pct > 100
+        || bo.day_n <= 0 || bo.budget <= 0 || bo.pass_pct < 0 || bo.pass_pct > 100 || optind != argc ? E_ARG_2 : 0;
+  }
+  if (e == 0) {
+    srand(bo.seed);
+    xml_d = NULL;
+    xml_n = 0;
+    req_a = bo.day_n * (bo.budget + 1);
+    bs.lat_l = malloc(sizeof(double) * req_a);
+    bs.ask_l = malloc(sizeof(double) * req_a);
+    bs.gets_l = malloc(sizeof(int32_t) * req_a);
+    bs.allocs_l = malloc(sizeof(long) * req_a);
+    val_l = malloc(sizeof(double) * req_a);
+    wms = malloc(sizeof(struct WebMemorySurfer));
+    run_filename = malloc(strlen(bo.filename) + 5);
+    e = bs.lat_l == NULL || bs.ask_l == NULL || bs.gets_l == NULL || bs.allocs_l == NULL || val_l == NULL || wms == NULL || run_filename == NULL;
+    if (e == 0) {
+      sprintf(run_filename, "%s.run", bo.filename);
+      bs.n = 0;
+      bs.refill_n = 0;
+      if (bo.reuse == 1 && stat(bo.filename, &file_stat) == 0) {
+        printf("reuse: %s, %ld bytes\n", bo.filename, (long)file_stat.st_size);
+      } else {
+        e = wms_init(wms);
+        if (e == 0) {
+          wms->ms.timestamp = BENCH_EPOCH;
+          e = bench_gen_xml(&xml_d, &xml_n, &bo);
+          if (e == 0) {
+            wms->ms.imf_filename = strdup(bo.filename);
+            e = wms->ms.imf_filename == NULL;
+          }
+          if (e == 0) {
+            allocs = bench_allocs;
+            e = clock_gettime(CLOCK_MONOTONIC, t_l + 0);
+            if (e == 0) {
+              e = bench_generate(wms, xml_d, xml_n);
+              if (e == 0) {
+                e = clock_gettime(CLOCK_MONOTONIC, t_l + 1);
+              }
+            }
+            if (e == 0) {
+              e = stat(bo.filename, &file_stat);
+              if (e == 0) {
+                printf("generate: %d decks, %d cards, %ld bytes: %.1f ms, %ld allocations, %d chunk reads\n",
+                    wms->deck_n, wms->card_n, (long)file_stat.st_size, bench_usec(t_l + 0, t_l + 1) / 1e3,
+                    bench_allocs - allocs, wms->ms.imf.stat_gets);
+              }
+            }
+          }
+          wms_free(wms);
+        }
+        free(xml_d);
+      }
+      if (e == 0) {
+        e = bench_copy(bo.filename, run_filename);
+      }
+      rating_n = 0;
+      out_n = 0;
+      for (day = 0; day < bo.day_n && e == 0; day++) { // a session at 8:00, a rating every 5 to 60 seconds
+        timestamp = BENCH_EPOCH + day * 86400 + 8 * 3600;
+        deck_i = -1;
+        card_i = -1;
+        strength = 0;
+        e = bench_request(run_filename, timestamp, 0, &deck_i, &card_i, &strength, &bs);
+        for (i = 0; i < bo.budget && deck_i >= 0 && e == 0; i++) {
+          timestamp += 5 + rand() % 56;
+          lvl = rand() % 100 < bo.pass_pct ? bench_level(strength) + 1 : 0;
+          e = bench_request(run_filename, timestamp, lvl, &deck_i, &card_i, &strength, &bs);
+        }
+        rating_n += i;
+        if (deck_i < 0) {
+          out_n++;
+        }
+      }
+      if (e == 0) {
+        unlink(run_filename);
+        printf("days: %d, ratings: %d, days out of cards: %d, requests: %d, queue refills: %d\n", bo.day_n, rating_n, out_n, bs.n, bs.refill_n);
+        printf("%-12s %10s %10s %10s %10s\n", "", "p50", "p90", "p99", "max");
+        bench_print("request us", bs.lat_l, bs.n);
+        bench_print("ask us", bs.ask_l, bs.n);
+        for (i = 0; i < bs.n; i++) {
+          val_l[i] = bs.gets_l[i];
+        }
+        bench_print("chunk reads", val_l, bs.n);
+        for (i = 0; i < bs.n; i++) {
+          val_l[i] = bs.allocs_l[i];
+        }
+        bench_print("allocations", val_l, bs.n);
+      }
+    }
+    free(run_filename);
+    free(wms);
+    free(val_l);
+    free(bs.allocs_l);
+    free(bs.gets_l);
+    free(bs.ask_l);
+    free(bs.lat_l);
+  } else {
+    fprintf(stderr, "usage: msbench [-o file] [-k] [-t depth] [-f fan-out] [-c cards per deck] [-n new %%] [-s suspended %%]\n"
+                    "               [-l weights of the strength levels 0,1,..] [-d days] [-b reviews per day] [-p pass %%] [-r seed]\n");
+  }
+  if (e != 0) {
+    fprintf(stderr, "msbench: error %d (0x%08x)\n", e, e);
+  }
+  return e != 0;
+}
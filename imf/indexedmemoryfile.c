@@ -28,6 +28,7 @@
 #include <assert.h>
 #include <unistd.h>
 #include <stdlib.h> // abs
+#include <sys/uio.h> // writev
 
 enum Error { E_COPEN_1 = 0x048023b3, E_COPEN_2 = 0x048023b4, E_COPEN_3 = 0x048023b5, E_LARGE = 0x01ac7d3e, E_CARG = 0x001707d2, E_CFREE = 0x01a6806e };
 
@@ -43,6 +44,7 @@ void imf_init(struct IndexedMemoryFile *imf)
   imf->delete_end = 0;
   sw_init (&imf->sw);
   imf->stat_swap = -1;
+  imf->stat_gets = 0;
   imf->stats_gaps = -1;
   imf->stats_gaps_space = -1;
   imf->stats_gaps_str = NULL;
@@ -59,7 +61,8 @@ char imf_is_open(struct IndexedMemoryFile *imf)
   return (imf->chunk_count > 0) && (imf->filedesc != -1);
 }
 
-static int imf_read(struct IndexedMemoryFile *imf, void *data, int64_t position, int32_t data_size)
+// digest returns the verified SHA-1 of the data, if not NULL
+static int imf_read(struct IndexedMemoryFile *imf, void *data, int64_t position, int32_t data_size, uint8_t *digest)
 {
   int e;
   off_t off;
@@ -92,6 +95,10 @@ static int imf_read(struct IndexedMemoryFile *imf, void *data, int64_t position,
             if (e == 0)
             {
               e = memcmp (message_digest_data, message_digest, SHA1_HASH_SIZE);
+              if (e == 0 && digest != NULL)
+              {
+                memcpy (digest, message_digest, SHA1_HASH_SIZE);
+              }
             }
           }
         }
@@ -101,6 +108,40 @@ static int imf_read(struct IndexedMemoryFile *imf, void *data, int64_t position,
   return e;
 }
 
+// like imf_read, but without moving the file offset (pread), so several threads can read at once
+static int imf_pread(struct IndexedMemoryFile *imf, void *data, int64_t position, int32_t data_size)
+{
+  int e;
+  ssize_t ssize;
+  struct Sha1Context sha1;
+  uint8_t message_digest_data[SHA1_HASH_SIZE];
+  uint8_t message_digest[SHA1_HASH_SIZE];
+  ssize = pread (imf->filedesc, data, data_size, position);
+  e = ssize != data_size;
+  if (e == 0)
+  {
+    e = sha1_reset (&sha1);
+    if (e == 0)
+    {
+      e = sha1_input (&sha1, data, data_size);
+      if (e == 0)
+      {
+        e = sha1_result (&sha1, message_digest_data);
+        if (e == 0)
+        {
+          ssize = pread (imf->filedesc, message_digest, SHA1_HASH_SIZE, position + data_size);
+          e = ssize != SHA1_HASH_SIZE;
+          if (e == 0)
+          {
+            e = memcmp (message_digest_data, message_digest, SHA1_HASH_SIZE);
+          }
+        }
+      }
+    }
+  }
+  return e;
+}
+
 static int imf_write(struct IndexedMemoryFile *imf, const void *data, int64_t position, int32_t data_size)
 {
   int e;
@@ -138,7 +179,8 @@ static int imf_write(struct IndexedMemoryFile *imf, const void *data, int64_t po
   return e;
 }
 
-static int imf_alloc_chunks(struct IndexedMemoryFile *imf)
+// grows the chunk table by at least increase_min entries
+static int imf_alloc_chunks(struct IndexedMemoryFile *imf, int32_t increase_min)
 {
   int e;
   int i;
@@ -151,6 +193,9 @@ static int imf_alloc_chunks(struct IndexedMemoryFile *imf)
   if (increase > 128) {
     increase = 128;
   }
+  if (increase < increase_min) {
+    increase = increase_min;
+  }
   chunk_count = imf->chunk_count + increase;
   size = DATA_SIZE_MAX / sizeof(struct Chunk) + 2;
   assert(chunk_count < size);
@@ -332,7 +377,7 @@ int imf_open(struct IndexedMemoryFile *imf, const char *filename)
           e = chunks == NULL;
           if (e == 0) {
             imf->filedesc = filedesc;
-            e = imf_read(imf, chunks, 0, data_size);
+            e = imf_read(imf, chunks, 0, data_size, NULL);
             if (e == 0) {
               assert((chunks[1].chunk_size - SHA1_HASH_SIZE) % sizeof(struct Chunk) == 0);
               chunk_count = (chunks[1].chunk_size - SHA1_HASH_SIZE) / sizeof(struct Chunk) + 2;
@@ -341,7 +386,7 @@ int imf_open(struct IndexedMemoryFile *imf, const char *filename)
               e = chunks == NULL;
               if (e == 0) {
                 data_size = chunks[1].chunk_size - SHA1_HASH_SIZE;
-                e = imf_read(imf, chunks + 2, chunks[1].position, data_size);
+                e = imf_read(imf, chunks + 2, chunks[1].position, data_size, NULL);
                 if (e == 0) {
                   data_size = sizeof(int32_t) * chunk_count;
                   chunk_order = malloc(data_size);
@@ -388,7 +433,7 @@ int imf_seek_unused(struct IndexedMemoryFile *imf, int32_t *index)
   }
   assert(e == 0);
   if (i == imf->chunk_count - 1) {
-    e = imf_alloc_chunks(imf);
+    e = imf_alloc_chunks(imf, 1);
   }
   return e;
 }
@@ -408,10 +453,46 @@ int imf_get(struct IndexedMemoryFile *imf, int32_t index, void *data)
   int64_t position;
   data_size = imf_get_size (imf, index);
   position = imf->chunks[index].position;
-  e = imf_read(imf, data, position, data_size);
+  e = imf_read(imf, data, position, data_size, NULL);
+  imf->stat_gets++;
   return e;
 }
 
+// imf_get which also returns the (verified) SHA-1 of the chunk, as stored
+int imf_get_digest(struct IndexedMemoryFile *imf, int32_t index, void *data, uint8_t *digest)
+{
+  int e;
+  int32_t data_size;
+  int64_t position;
+  data_size = imf_get_size(imf, index);
+  position = imf->chunks[index].position;
+  e = imf_read(imf, data, position, data_size, digest);
+  imf->stat_gets++;
+  return e;
+}
+
+// the SHA-1 stored behind a chunk, read without the data (so not verified)
+int imf_peek_digest(struct IndexedMemoryFile *imf, int32_t index, uint8_t *digest)
+{
+  ssize_t ssize;
+  int32_t data_size;
+  int64_t position;
+  data_size = imf_get_size(imf, index);
+  position = imf->chunks[index].position + data_size;
+  ssize = pread(imf->filedesc, digest, SHA1_HASH_SIZE, position);
+  return ssize != SHA1_HASH_SIZE;
+}
+
+// imf_get for concurrent readers: the chunk table is only read and stat_gets is left to the caller
+int imf_pget(struct IndexedMemoryFile *imf, int32_t index, void *data)
+{
+  int32_t data_size;
+  int64_t position;
+  data_size = imf_get_size(imf, index);
+  position = imf->chunks[index].position;
+  return imf_pread(imf, data, position, data_size);
+}
+
 static int imf_prepare_free(struct IndexedMemoryFile *imf)
 {
   int e;
@@ -477,6 +558,94 @@ int imf_put(struct IndexedMemoryFile *imf, int32_t index, void *data, int32_t da
   return e;
 }
 
+enum { BULK_IOV = 512 }; // chunks per writev, two buffers (data and digest) each
+
+// puts n new chunks at once: unused indexes are taken in ascending order and returned in index_l, the data is
+// appended behind the last chunk in one sequential write and the chunk order is sorted once; digest_l holds the
+// SHA-1 of each chunk when the caller has computed them already (NULL: computed here)
+int imf_put_bulk(struct IndexedMemoryFile *imf, int32_t n, int32_t *index_l, void **data_l, const int32_t *size_l, const uint8_t *digest_l)
+{
+  int e;
+  int32_t i;
+  int32_t j;
+  int32_t k;
+  int32_t unused_n;
+  int64_t position;
+  int64_t end;
+  off_t cur_pos;
+  ssize_t ssize;
+  ssize_t expect;
+  struct iovec iov[BULK_IOV * 2];
+  uint8_t message_digest[BULK_IOV][SHA1_HASH_SIZE];
+  struct Sha1Context sha1;
+  e = 0;
+  for (i = 0; i < n && e == 0; i++) {
+    e = size_l[i] < 0 || size_l[i] > DATA_SIZE_MAX ? E_LARGE : 0;
+  }
+  if (e == 0 && n > 0) {
+    unused_n = 0;
+    for (i = 2; i < imf->chunk_count; i++) {
+      unused_n += imf->chunks[i].chunk_size == 0;
+    }
+    if (unused_n <= n) {
+      e = imf_alloc_chunks(imf, n - unused_n + 1); // imf_seek_unused keeps one unused at the end
+    }
+    if (e == 0) {
+      end = 0;
+      for (i = 0; i < imf->chunk_count; i++) {
+        if (imf->chunks[i].chunk_size > 0 && imf->chunks[i].position + imf->chunks[i].chunk_size > end) {
+          end = imf->chunks[i].position + imf->chunks[i].chunk_size;
+        }
+      }
+      cur_pos = lseek(imf->filedesc, end, SEEK_SET);
+      e = cur_pos == -1;
+      position = end;
+      i = 0;
+      j = 2;
+      while (i < n && e == 0) {
+        k = 0;
+        expect = 0;
+        while (k < BULK_IOV && i + k < n && e == 0) {
+          if (digest_l != NULL) {
+            iov[k * 2 + 1].iov_base = (void *)(digest_l + (i + k) * SHA1_HASH_SIZE);
+          } else {
+            e = sha1_reset(&sha1);
+            if (e == 0) {
+              e = sha1_input(&sha1, data_l[i + k], size_l[i + k]);
+            }
+            if (e == 0) {
+              e = sha1_result(&sha1, message_digest[k]);
+            }
+            iov[k * 2 + 1].iov_base = message_digest[k];
+          }
+          iov[k * 2].iov_base = data_l[i + k];
+          iov[k * 2].iov_len = size_l[i + k];
+          iov[k * 2 + 1].iov_len = SHA1_HASH_SIZE;
+          expect += size_l[i + k] + SHA1_HASH_SIZE;
+          k++;
+        }
+        if (e == 0) {
+          ssize = writev(imf->filedesc, iov, k * 2);
+          e = ssize != expect;
+        }
+        while (k > 0 && e == 0) {
+          while (imf->chunks[j].chunk_size != 0) {
+            j++;
+          }
+          assert(j < imf->chunk_count - 1);
+          imf->chunks[j].position = position;
+          imf->chunks[j].chunk_size = size_l[i] + SHA1_HASH_SIZE;
+          position += imf->chunks[j].chunk_size;
+          index_l[i++] = j;
+          k--;
+        }
+      }
+      imf_sort_order(imf);
+    }
+  }
+  return e;
+}
+
 int imf_sync(struct IndexedMemoryFile *imf)
 {
   int e;
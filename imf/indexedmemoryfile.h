@@ -49,6 +49,7 @@ struct IndexedMemoryFile
   int delete_end;
   struct Stopwatch sw;
   int stat_swap;
+  int stat_gets; // imf_get calls
   int stats_gaps;
   int stats_gaps_space;
   char *stats_gaps_str;
@@ -61,8 +62,12 @@ int imf_open (struct IndexedMemoryFile *imf, const char *filename);
 int imf_seek_unused (struct IndexedMemoryFile *imf, int32_t *index);
 int32_t imf_get_size (struct IndexedMemoryFile *imf, int32_t index);
 int imf_get (struct IndexedMemoryFile *imf, int32_t index, void *data);
+int imf_get_digest (struct IndexedMemoryFile *imf, int32_t index, void *data, uint8_t *digest);
+int imf_peek_digest (struct IndexedMemoryFile *imf, int32_t index, uint8_t *digest);
+int imf_pget (struct IndexedMemoryFile *imf, int32_t index, void *data);
 int imf_delete (struct IndexedMemoryFile *imf, int32_t index);
 int imf_put (struct IndexedMemoryFile *imf, int32_t index, void *data, int32_t data_size);
+int imf_put_bulk (struct IndexedMemoryFile *imf, int32_t n, int32_t *index_l, void **data_l, const int32_t *size_l, const uint8_t *digest_l);
 int imf_sync (struct IndexedMemoryFile *imf);
 int imf_close (struct IndexedMemoryFile *imf);
 int imf_get_length (struct IndexedMemoryFile *imf, int64_t *file_length);
@@ -42,18 +42,23 @@
 #include <unistd.h> // unlink
 #include <fcntl.h> // O_TRUNC / O_EXCL
 #include <errno.h>
+#include <stdlib.h> // qsort / bsearch
+#include <stdarg.h> // xg_printf
+#include <pthread.h> // search workers
+#include <zlib.h> // gzip export / upload
 
 static const int32_t MSF_VERSION = 0x010001ec;
 
-enum Error { E_OVERRN_1 = 0x7da6edc1, E_OVERRN_2 = 0x7da6edc2, E_OVERRN_3 = 0x7da6edc3, E_NEWLN_1 = 0x0495e6fd, E_NEWLN_2 = 0x0495e6fe, E_NEWLN_3 = 0x0495e6ff, E_UNESC = 0x012cf4b0, E_PXML = 0x0025968a, E_CRRPT = 0x0687f5d6, E_ASSRT_1 = 0x068e1507, E_HEX = 0x0002b106, E_POST = 0x003e3ed8, E_RPOFT = 0x115048c5, E_FIELD_1 = 0x0169002d, E_FIELD_2 = 0x0169002e, E_FIELD_3 = 0x0169002f, E_SCOPE_1 = 0x01c73201, E_SCOPE_2 = 0x01c73202, E_FIELD_4 = 0x01690030, E_FIELD_5 = 0x01690031, E_FIELD_6 = 0x01690032, E_FIELD_7 = 0x01690033, E_PARSE_1 = 0x01d087cf, E_HASH_1 = 0x001a255d, E_HASH_2 = 0x001a255e, E_PARSE_2 = 0x01d087d0, E_MISMA = 0x007a49be, E_SHA = 0x000025a8, E_PARSE_3 = 0x01d087d1, E_EXPOR_1 = 0x05e29399, E_EXPOR_2 = 0x05e2939a, E_EXPOR_3 = 0x05e2939b, E_GHTML_1 = 0x03f6667d, E_GHTML_2 = 0x03f6667e, E_GHTML_3 = 0x03f6667f, E_GHTML_4 = 0x03f66680, E_GHTML_5 = 0x03f66681, E_GHTML_6 = 0x03f66682, E_GENLRN_1 = 0x7d95d699, E_GENLRN_2 = 0x7d95d69a, E_GENLRN_3 = 0x7d95d69b, E_GENLRN_4 = 0x7d95d69c, E_GENLRN_5 = 0x7d95d69d, E_GENLRN_6 = 0x7d95d69e, E_GENLRN_7 = 0x7d95d69f, E_GENLRN_8 = 0x7d95d6a0, E_GENLRN_9 = 0x7d95d6a1, E_GHTML_7 = 0x03f66683, E_GHTML_8 = 0x03f66684, E_GHTML_9 = 0x03f66685, E_MALLOC_1 = 0x1e8e2971, E_MALLOC_2 = 0x1e8e2972, E_MALLOC_3 = 0x1e8e2973, E_ARG_1 = 0x0000da5d, E_ASSRT_2 = 0x0000da5d, E_DETECA = 0x099201b8, E_ARG_2 = 0x0000da5e, E_MALLOC_4 = 0x1e8e2974, E_MALLOC_5 = 0x1e8e2975, E_INIT = 0x003d20c0, E_CREATE = 0x311ccf88, E_ASSRT_3 = 0x068e1509, E_ASSRT_4 = 0x068e150a, E_CARD_1 = 0x000e0539, E_CARD_2 = 0x000e053a, E_CARD_3 = 0x000e053b, E_CARD_4 = 0x000e053c, E_DECK_1 = 0x00216467, E_DECK_2 = 0x00216468, E_DECK_3 = 0x00216469, E_DECK_4 = 0x0021646a, E_ASSRT_5 = 0x068e150b, E_UPLOAD_1 = 0x22b56c8f, E_MAX = 0x0002ad00, E_ARRANG_1 = 0x4052a587, E_MOVED = 0x0155e4ce, E_TOPOL = 0x03fbfe34, E_ARRANG_2 = 0x4052a588, E_CARD_5 = 0x000e053d, E_CARD_6 = 0x000e053e, E_CARD_7 = 0x000e053f, E_MCTR = 0x00384cd0, E_OVERFL_1 = 0x68bee46d, E_OVERFL_2 = 0x68bee46e, E_STATE = 0x01d1b8ba, E_SEND = 0x000d9828, E_LVL_1 = 0x00016d65, E_CARD_8 = 0x000e0540, E_CARD_9 = 0x000e0541 };
-enum Field { F_UNKNOWN, F_FILE_TITLE, F_UPLOAD, F_ARRANGE, F_DECK_NAME, F_STYLE_TXT, F_MOVED_CAT, F_SCOPE, F_SEARCH_TXT, F_MATCH_CASE, F_IS_HTML, F_IS_UNLOCKED, F_DECK, F_CARD, F_MOV_CARD, F_LVL, F_RANK, F_Q, F_A, F_REVEAL_POS, F_TODO_MAIN, F_MCTR, F_MTIME, F_PASSWORD, F_NEW_PASSWORD, F_TOKEN, F_EVENT, F_PAGE, F_MODE, F_TIMEOUT };
-enum Action { A_END, A_NONE, A_FILE, A_WARN_UPLOAD, A_CREATE, A_NEW, A_OPEN_DLG, A_FILELIST, A_OPEN, A_CHANGE_PASSWD, A_WRITE_PASSWD, A_READ_PASSWD, A_CHECK_PASSWORD, A_AUTH_PASSWD, A_AUTH_TOK, A_GEN_TOK, A_LOAD_CARDLIST, A_LOAD_CARDLIST_OLD, A_GET_CARD, A_CHECK_RESUME, A_DECK_PATH, A_SLASH, A_VOID, A_FILE_EXTENSION, A_GATHER, A_UPLOAD, A_UPLOAD_REPORT, A_EXPORT, A_ASK_REMOVE, A_REMOVE, A_ASK_ERASE, A_ERASE, A_CLOSE, A_START_DECKS, A_DECKS_CREATE, A_SELECT_DEST_DECK, A_SELECT_SEND_DECK, A_SELECT_PROCEED_SEND, A_SELECT_ARRANGE, A_ENTER_NAME, A_STYLE_GO, A_CREATE_DECK, A_RENAME_DECK, A_READ_STYLE, A_STYLE_APPLY, A_ASK_DELETE_DECK, A_DELETE_DECK, A_TOGGLE, A_MOVE_DECK, A_SELECT_EDIT_CAT, A_EDIT, A_UPDATE_QA, A_UPDATE_HTML, A_UPDATE_DECK_FLAGS, A_SYNC, A_SYNC_OLD, A_INSERT, A_APPEND, A_ASK_DELETE_CARD, A_DELETE_CARD, A_PREVIOUS, A_NEXT, A_SCHEDULE, A_SET, A_CARD_ARRANGE, A_MOVE_CARD, A_SEND_CARD, A_SELECT_LEARN_CAT, A_SELECT_SEARCH_CAT, A_PREFERENCES, A_ABOUT, A_APPLY, A_SEARCH, A_PREVIEW, A_RANK, A_DETERMINE_CARD, A_SHOW, A_REVEAL, A_PROCEED, A_ASK_SUSPEND, A_SUSPEND, A_ASK_RESUME, A_RESUME, A_CHECK_FILE, A_LOGIN, A_HISTOGRAM, A_TABLE, A_RETRIEVE_MTIME, A_MTIME_TEST, A_TEST_CARD, A_TEST_CAT_SELECTED, A_TEST_CAT_VALID, A_TEST_DECK, A_TEST_ARRANGE, A_TEST_NAME };
-enum Page { P_UNDEF = -1, P_START, P_FILE, P_PASSWORD, P_NEW, P_OPEN, P_UPLOAD, P_UPLOAD_REPORT, P_EXPORT, P_CAT_NAME, P_STYLE, P_SELECT_ARRANGE, P_SELECT_DEST_DECK, P_SELECT_DECK, P_EDIT, P_PREVIEW, P_SEARCH, P_PREFERENCES, P_ABOUT, P_LEARN, P_MSG, P_HISTOGRAM, P_TABLE };
-enum Block { B_END, B_START_HTML, B_FORM_URLENCODED, B_FORM_MULTIPART, B_OPEN_DIV, B_HIDDEN_CAT, B_HIDDEN_ARRANGE, B_HIDDEN_CAT_NAME, B_HIDDEN_SEARCH_TXT, B_HIDDEN_MOV_CARD, B_CLOSE_DIV, B_START, B_FILE, B_PASSWORD, B_NEW, B_OPEN, B_UPLOAD, B_UPLOAD_REPORT, B_EXPORT, B_DECK_NAME, B_STYLE, B_SELECT_ARRANGE, B_SELECT_DEST_DECK, B_SELECT_DECK, B_EDIT, B_PREVIEW, B_SEARCH, B_PREFERENCES, B_ABOUT, B_LEARN, B_MSG, B_HISTOGRAM, B_TABLE };
+enum Error { E_OVERRN_1 = 0x7da6edc1, E_OVERRN_2 = 0x7da6edc2, E_OVERRN_3 = 0x7da6edc3, E_NEWLN_1 = 0x0495e6fd, E_NEWLN_2 = 0x0495e6fe, E_NEWLN_3 = 0x0495e6ff, E_UNESC = 0x012cf4b0, E_PXML = 0x0025968a, E_CRRPT = 0x0687f5d6, E_ASSRT_1 = 0x068e1507, E_HEX = 0x0002b106, E_POST = 0x003e3ed8, E_RPOFT = 0x115048c5, E_FIELD_1 = 0x0169002d, E_FIELD_2 = 0x0169002e, E_FIELD_3 = 0x0169002f, E_SCOPE_1 = 0x01c73201, E_SCOPE_2 = 0x01c73202, E_FIELD_4 = 0x01690030, E_FIELD_5 = 0x01690031, E_FIELD_6 = 0x01690032, E_FIELD_7 = 0x01690033, E_PARSE_1 = 0x01d087cf, E_HASH_1 = 0x001a255d, E_HASH_2 = 0x001a255e, E_PARSE_2 = 0x01d087d0, E_MISMA = 0x007a49be, E_SHA = 0x000025a8, E_PARSE_3 = 0x01d087d1, E_EXPOR_1 = 0x05e29399, E_EXPOR_2 = 0x05e2939a, E_EXPOR_3 = 0x05e2939b, E_GHTML_1 = 0x03f6667d, E_GHTML_2 = 0x03f6667e, E_GHTML_3 = 0x03f6667f, E_GHTML_4 = 0x03f66680, E_GHTML_5 = 0x03f66681, E_GHTML_6 = 0x03f66682, E_GENLRN_1 = 0x7d95d699, E_GENLRN_2 = 0x7d95d69a, E_GENLRN_3 = 0x7d95d69b, E_GENLRN_4 = 0x7d95d69c, E_GENLRN_5 = 0x7d95d69d, E_GENLRN_6 = 0x7d95d69e, E_GENLRN_7 = 0x7d95d69f, E_GENLRN_8 = 0x7d95d6a0, E_GENLRN_9 = 0x7d95d6a1, E_GHTML_7 = 0x03f66683, E_GHTML_8 = 0x03f66684, E_GHTML_9 = 0x03f66685, E_MALLOC_1 = 0x1e8e2971, E_MALLOC_2 = 0x1e8e2972, E_MALLOC_3 = 0x1e8e2973, E_ARG_1 = 0x0000da5d, E_ASSRT_2 = 0x0000da5d, E_DETECA = 0x099201b8, E_ARG_2 = 0x0000da5e, E_MALLOC_4 = 0x1e8e2974, E_MALLOC_5 = 0x1e8e2975, E_INIT = 0x003d20c0, E_CREATE = 0x311ccf88, E_ASSRT_3 = 0x068e1509, E_ASSRT_4 = 0x068e150a, E_CARD_1 = 0x000e0539, E_CARD_2 = 0x000e053a, E_CARD_3 = 0x000e053b, E_CARD_4 = 0x000e053c, E_DECK_1 = 0x00216467, E_DECK_2 = 0x00216468, E_DECK_3 = 0x00216469, E_DECK_4 = 0x0021646a, E_ASSRT_5 = 0x068e150b, E_UPLOAD_1 = 0x22b56c8f, E_MAX = 0x0002ad00, E_ARRANG_1 = 0x4052a587, E_MOVED = 0x0155e4ce, E_TOPOL = 0x03fbfe34, E_ARRANG_2 = 0x4052a588, E_CARD_5 = 0x000e053d, E_CARD_6 = 0x000e053e, E_CARD_7 = 0x000e053f, E_MCTR = 0x00384cd0, E_OVERFL_1 = 0x68bee46d, E_OVERFL_2 = 0x68bee46e, E_STATE = 0x01d1b8ba, E_SEND = 0x000d9828, E_LVL_1 = 0x00016d65, E_CARD_8 = 0x000e0540, E_CARD_9 = 0x000e0541, E_BASE = 0x00112286, E_GZIP = 0x003129dc, E_UPLOAD_2 = 0x22b56c90, E_HIT = 0x00024356, E_PARSE_4 = 0x01d087d2, E_UPLOAD_3 = 0x22b56c91, E_PASSWD = 0x29ba2a74 };
+enum Field { F_UNKNOWN, F_FILE_TITLE, F_UPLOAD, F_ARRANGE, F_DECK_NAME, F_STYLE_TXT, F_MOVED_CAT, F_SCOPE, F_SEARCH_TXT, F_MATCH_CASE, F_IS_HTML, F_IS_UNLOCKED, F_DECK, F_CARD, F_MOV_CARD, F_LVL, F_RANK, F_Q, F_A, F_REVEAL_POS, F_TODO_MAIN, F_MCTR, F_MTIME, F_PASSWORD, F_NEW_PASSWORD, F_TOKEN, F_EVENT, F_PAGE, F_MODE, F_TIMEOUT, F_HIT, F_LIST_POS, F_SEARCH_MODE, F_SEARCH_DIST, F_HITS };
+enum Action { A_END, A_NONE, A_FILE, A_WARN_UPLOAD, A_CREATE, A_NEW, A_OPEN_DLG, A_FILELIST, A_OPEN, A_CHANGE_PASSWD, A_WRITE_PASSWD, A_READ_PASSWD, A_CHECK_PASSWORD, A_AUTH_PASSWD, A_AUTH_TOK, A_GEN_TOK, A_LOAD_CARDLIST, A_LOAD_CARDLIST_OLD, A_GET_CARD, A_CHECK_RESUME, A_DECK_PATH, A_SLASH, A_VOID, A_FILE_EXTENSION, A_GATHER, A_UPLOAD, A_UPLOAD_REPORT, A_EXPORT, A_ASK_BASE, A_MARK_BASE, A_ASK_REMOVE, A_REMOVE, A_ASK_ERASE, A_ERASE, A_CLOSE, A_START_DECKS, A_DECKS_CREATE, A_SELECT_DEST_DECK, A_SELECT_SEND_DECK, A_SELECT_PROCEED_SEND, A_SELECT_ARRANGE, A_ENTER_NAME, A_STYLE_GO, A_CREATE_DECK, A_RENAME_DECK, A_READ_STYLE, A_STYLE_APPLY, A_ASK_DELETE_DECK, A_DELETE_DECK, A_TOGGLE, A_MOVE_DECK, A_SELECT_EDIT_CAT, A_EDIT, A_UPDATE_QA, A_UPDATE_HTML, A_UPDATE_DECK_FLAGS, A_SYNC, A_SYNC_OLD, A_INSERT, A_APPEND, A_ASK_DELETE_CARD, A_DELETE_CARD, A_PREVIOUS, A_NEXT, A_SCHEDULE, A_SET, A_CARD_ARRANGE, A_MOVE_CARD, A_SEND_CARD, A_SELECT_LEARN_CAT, A_SELECT_SEARCH_CAT, A_PREFERENCES, A_ABOUT, A_APPLY, A_SEARCH, A_SEARCH_LIST, A_PREVIEW, A_RANK, A_DETERMINE_CARD, A_SHOW, A_REVEAL, A_PROCEED, A_ASK_SUSPEND, A_SUSPEND, A_ASK_RESUME, A_RESUME, A_CHECK_FILE, A_LOGIN, A_HISTOGRAM, A_TABLE, A_RETRIEVE_MTIME, A_MTIME_TEST, A_TEST_CARD, A_TEST_CAT_SELECTED, A_TEST_CAT_VALID, A_TEST_DECK, A_TEST_ARRANGE, A_TEST_NAME };
+enum Page { P_UNDEF = -1, P_START, P_FILE, P_PASSWORD, P_NEW, P_OPEN, P_UPLOAD, P_UPLOAD_REPORT, P_EXPORT, P_CAT_NAME, P_STYLE, P_SELECT_ARRANGE, P_SELECT_DEST_DECK, P_SELECT_DECK, P_EDIT, P_PREVIEW, P_SEARCH, P_PREFERENCES, P_ABOUT, P_LEARN, P_MSG, P_HISTOGRAM, P_TABLE, P_SEARCH_LIST };
+enum Block { B_END, B_START_HTML, B_FORM_URLENCODED, B_FORM_MULTIPART, B_OPEN_DIV, B_HIDDEN_CAT, B_HIDDEN_ARRANGE, B_HIDDEN_CAT_NAME, B_HIDDEN_SEARCH_TXT, B_HIDDEN_MOV_CARD, B_CLOSE_DIV, B_START, B_FILE, B_PASSWORD, B_NEW, B_OPEN, B_UPLOAD, B_UPLOAD_REPORT, B_EXPORT, B_DECK_NAME, B_STYLE, B_SELECT_ARRANGE, B_SELECT_DEST_DECK, B_SELECT_DECK, B_EDIT, B_PREVIEW, B_SEARCH, B_PREFERENCES, B_ABOUT, B_LEARN, B_MSG, B_HISTOGRAM, B_TABLE, B_SEARCH_LIST };
 enum Mode { M_NONE = -1, M_DEFAULT, M_MSG_START, M_MSG_UPLOAD, M_MSG_FILE, M_MSG_CARD, M_MSG_DECKS, M_MSG_SELECT_EDIT, M_MSG_SELECT_LEARN, M_MSG_SELECT_SEARCH, M_MSG_SUSPEND, M_MSG_RESUME, M_CHANGE_PASSWD, M_ASK, M_RATE, M_MSG_NO_CARD_ELIGIBLE, M_EDIT, M_LEARN, M_SEARCH, M_SEND, M_PROCEED_SEND, M_MOVE, M_CARD, M_MOVE_DECK, M_CREATE_DECK, M_START, M_END };
-enum Sequence { S_FILE, S_START_DECKS, S_DECKS_CREATE, S_SELECT_MOVE_ARRANGE, S_DECK_NAME, S_STYLE, S_SELECT_EDIT_DECK, S_SELECT_LEARN_DECK, S_SELECT_SEARCH_DECK, S_PREFERENCES, S_ABOUT, S_APPLY, S_NEW, S_FILELIST, S_WARN_UPLOAD, S_UPLOAD, S_LOGIN, S_ENTER, S_CHANGE, S_START, S_START_SYNC_RANK, S_UPLOAD_REPORT, S_EXPORT, S_ASK_REMOVE, S_REMOVE, S_ASK_ERASE, S_ERASE, S_CLOSE, S_NONE, S_CREATE, S_GO_LOGIN, S_GO_CHANGE, S_DECKS_RENAME, S_RENAME_DECK, S_STYLE_APPLY, S_SELECT_DEST_CAT, S_MOVE_DECK, S_CREATE_DECK, S_ASK_DELETE_DECK, S_DELETE_DECK, S_TOGGLE, S_EDIT, S_EDIT_SYNC_RANK, S_EDIT_SYNC, S_INSERT, S_APPEND, S_ASK_DELETE_CARD, S_DELETE_CARD, S_PREVIOUS, S_NEXT, S_SCHEDULE, S_SET, S_CARD_ARRANGE, S_MOVE_CARD, S_EDITING_SEND, S_SEND_CARD, S_PROCEED_SEND_CARD, S_SEARCH, S_SEARCH_SYNCED, S_SEARCH_SYNC_QA, S_SEARCH_SYNC_RANK, S_PREVIEW_SYNC, S_PREVIEW, S_QUESTION_SYNCED, S_QUESTION_SYNC_QA, S_LEARN, S_QUESTION, S_QUESTION_RANK, S_SHOW, S_REVEAL, S_PROCEED_SYNC_QA, S_SELECT_PROCEED_SEND, S_ASK_SUSPEND, S_SUSPEND, S_ASK_RESUME, S_RESUME, S_HISTOGRAM, S_HISTOGRAM_SYNC_QA, S_TABLE, S_TABLE_SYNC_QA, S_TABLE_REFRESH, S_END };
+enum Sequence { S_FILE, S_START_DECKS, S_DECKS_CREATE, S_SELECT_MOVE_ARRANGE, S_DECK_NAME, S_STYLE, S_SELECT_EDIT_DECK, S_SELECT_LEARN_DECK, S_SELECT_SEARCH_DECK, S_PREFERENCES, S_ABOUT, S_APPLY, S_NEW, S_FILELIST, S_WARN_UPLOAD, S_UPLOAD, S_UPDATE, S_MERGE, S_LOGIN, S_ENTER, S_CHANGE, S_START, S_START_SYNC_RANK, S_UPLOAD_REPORT, S_MERGE_REPORT, S_EXPORT, S_SNAPSHOT, S_DELTA, S_SHARE, S_ASK_BASE, S_MARK_BASE, S_ASK_REMOVE, S_REMOVE, S_ASK_ERASE, S_ERASE, S_CLOSE, S_NONE, S_CREATE, S_GO_LOGIN, S_GO_CHANGE, S_DECKS_RENAME, S_RENAME_DECK, S_STYLE_APPLY, S_SELECT_DEST_CAT, S_MOVE_DECK, S_CREATE_DECK, S_ASK_DELETE_DECK, S_DELETE_DECK, S_TOGGLE, S_EDIT, S_EDIT_SYNC_RANK, S_EDIT_SYNC, S_INSERT, S_APPEND, S_ASK_DELETE_CARD, S_DELETE_CARD, S_PREVIOUS, S_NEXT, S_SCHEDULE, S_SET, S_CARD_ARRANGE, S_MOVE_CARD, S_EDITING_SEND, S_SEND_CARD, S_PROCEED_SEND_CARD, S_SEARCH, S_SEARCH_SYNCED, S_SEARCH_SYNC_QA, S_SEARCH_SYNC_RANK, S_PREVIEW_SYNC, S_PREVIEW, S_QUESTION_SYNCED, S_QUESTION_SYNC_QA, S_LEARN, S_QUESTION, S_QUESTION_RANK, S_SHOW, S_REVEAL, S_PROCEED_SYNC_QA, S_SELECT_PROCEED_SEND, S_ASK_SUSPEND, S_SUSPEND, S_ASK_RESUME, S_RESUME, S_HISTOGRAM, S_HISTOGRAM_SYNC_QA, S_TABLE, S_TABLE_SYNC_QA, S_TABLE_REFRESH, S_SEARCH_LIST, S_END };
 enum Stage { T_NULL, T_URLENCODE_EQUALS, T_URLENCODE_AMP, T_BOUNDARY_INIT, T_CONTENT, T_NAME, T_NAME_QUOT, T_VALUE_START, T_VALUE_CRLFMINUSMINUS, T_FILENAME, T_FILENAME_QUOT, T_VALUE_XML, T_BOUNDARY_CHECK, T_EPILOGUE };
 enum Scope { C_UNDEF = -1, C_CURRENT, C_CHECKED, C_ALL };
+enum SearchMode { SM_UNDEF = -1, SM_LITERAL, SM_REGEX, SM_FUZZY };
 
 static enum Action action_seq[S_END+1][18] = {
   { A_GATHER, A_OPEN, A_READ_PASSWD, A_AUTH_TOK, A_GEN_TOK, A_FILELIST, A_FILE, A_END }, // S_FILE
@@ -72,13 +77,21 @@ static enum Action action_seq[S_END+1][18] = {
   { A_FILELIST, A_OPEN_DLG, A_END }, // S_FILELIST
   { A_SLASH, A_GATHER, A_OPEN, A_READ_PASSWD, A_AUTH_TOK, A_GEN_TOK, A_WARN_UPLOAD, A_END }, // S_WARN_UPLOAD
   { A_SLASH, A_GATHER, A_OPEN, A_READ_PASSWD, A_AUTH_TOK, A_GEN_TOK, A_ERASE, A_UPLOAD, A_END }, // S_UPLOAD
+  { A_SLASH, A_GATHER, A_OPEN, A_READ_PASSWD, A_AUTH_TOK, A_GEN_TOK, A_UPLOAD, A_END }, // S_UPDATE
+  { A_SLASH, A_GATHER, A_OPEN, A_READ_PASSWD, A_AUTH_TOK, A_GEN_TOK, A_TEST_DECK, A_UPLOAD, A_END }, // S_MERGE
   { A_GATHER, A_OPEN, A_READ_PASSWD, A_AUTH_PASSWD, A_GEN_TOK, A_NONE, A_END }, // S_LOGIN
   { A_SLASH, A_GATHER, A_OPEN, A_READ_PASSWD, A_CHECK_PASSWORD, A_CHANGE_PASSWD, A_WRITE_PASSWD, A_SYNC, A_GEN_TOK, A_NONE, A_END }, // S_ENTER
   { A_SLASH, A_GATHER, A_OPEN, A_READ_PASSWD, A_AUTH_PASSWD, A_CHANGE_PASSWD, A_WRITE_PASSWD, A_SYNC, A_GEN_TOK, A_NONE, A_END }, // S_CHANGE
   { A_SLASH, A_GATHER, A_OPEN, A_READ_PASSWD, A_AUTH_TOK, A_GEN_TOK, A_NONE, A_END }, // S_START
   { A_SLASH, A_GATHER, A_OPEN, A_READ_PASSWD, A_AUTH_TOK, A_GEN_TOK, A_RETRIEVE_MTIME, A_RANK, A_SYNC_OLD, A_NONE, A_END }, // S_START_SYNC_RANK
   { A_SLASH, A_GATHER, A_OPEN, A_READ_PASSWD, A_AUTH_TOK, A_GEN_TOK, A_RETRIEVE_MTIME, A_UPLOAD_REPORT, A_SYNC_OLD, A_END }, // S_UPLOAD_REPORT
+  { A_SLASH, A_GATHER, A_OPEN, A_READ_PASSWD, A_AUTH_TOK, A_GEN_TOK, A_RETRIEVE_MTIME, A_TEST_DECK, A_UPLOAD_REPORT, A_SYNC_OLD, A_END }, // S_MERGE_REPORT
   { A_SLASH, A_GATHER, A_OPEN, A_READ_PASSWD, A_AUTH_TOK, A_READ_STYLE, A_EXPORT, A_END }, // S_EXPORT
+  { A_SLASH, A_GATHER, A_OPEN, A_READ_PASSWD, A_AUTH_TOK, A_READ_STYLE, A_EXPORT, A_END }, // S_SNAPSHOT
+  { A_SLASH, A_GATHER, A_OPEN, A_READ_PASSWD, A_AUTH_TOK, A_READ_STYLE, A_EXPORT, A_END }, // S_DELTA
+  { A_SLASH, A_GATHER, A_OPEN, A_READ_PASSWD, A_AUTH_TOK, A_READ_STYLE, A_EXPORT, A_END }, // S_SHARE
+  { A_SLASH, A_GATHER, A_OPEN, A_READ_PASSWD, A_AUTH_TOK, A_GEN_TOK, A_RETRIEVE_MTIME, A_MTIME_TEST, A_ASK_BASE, A_END }, // S_ASK_BASE
+  { A_SLASH, A_GATHER, A_OPEN, A_READ_PASSWD, A_AUTH_TOK, A_GEN_TOK, A_RETRIEVE_MTIME, A_MTIME_TEST, A_MARK_BASE, A_FILE, A_END }, // S_MARK_BASE
   { A_SLASH, A_GATHER, A_OPEN, A_READ_PASSWD, A_AUTH_TOK, A_GEN_TOK, A_RETRIEVE_MTIME, A_MTIME_TEST, A_ASK_REMOVE, A_END }, // S_ASK_REMOVE
   { A_SLASH, A_GATHER, A_OPEN, A_READ_PASSWD, A_AUTH_TOK, A_REMOVE, A_FILELIST, A_CLOSE, A_END }, // S_REMOVE
   { A_SLASH, A_GATHER, A_OPEN, A_READ_PASSWD, A_AUTH_TOK, A_GEN_TOK, A_RETRIEVE_MTIME, A_MTIME_TEST, A_ASK_ERASE, A_END }, // S_ASK_ERASE
@@ -137,16 +150,17 @@ static enum Action action_seq[S_END+1][18] = {
   { A_SLASH, A_GATHER, A_OPEN, A_READ_PASSWD, A_AUTH_TOK, A_GEN_TOK, A_TEST_DECK, A_LOAD_CARDLIST, A_TABLE, A_END }, // S_TABLE
   { A_SLASH, A_GATHER, A_OPEN, A_READ_PASSWD, A_AUTH_TOK, A_GEN_TOK, A_RETRIEVE_MTIME, A_TEST_DECK, A_LOAD_CARDLIST, A_TEST_CARD, A_GET_CARD, A_UPDATE_QA, A_SYNC_OLD, A_TABLE, A_END }, // S_TABLE_SYNC_QA
   { A_SLASH, A_GATHER, A_OPEN, A_READ_PASSWD, A_AUTH_TOK, A_GEN_TOK, A_RETRIEVE_MTIME, A_LOAD_CARDLIST_OLD, A_RANK, A_TABLE, A_SYNC_OLD, A_END }, // S_TABLE_REFRESH
+  { A_SLASH, A_GATHER, A_OPEN, A_READ_PASSWD, A_AUTH_TOK, A_GEN_TOK, A_TEST_DECK, A_LOAD_CARDLIST, A_SEARCH_LIST, A_END }, // S_SEARCH_LIST
   { A_END } // S_END
 };
 
-static enum Block block_seq[P_TABLE+1][11] = {
+static enum Block block_seq[P_SEARCH_LIST+1][11] = {
   { B_START_HTML, B_FORM_URLENCODED, B_OPEN_DIV, B_HIDDEN_CAT, B_HIDDEN_ARRANGE, B_HIDDEN_CAT_NAME, B_HIDDEN_SEARCH_TXT, B_CLOSE_DIV, B_START, B_END }, // P_START
   { B_START_HTML, B_FORM_URLENCODED, B_OPEN_DIV, B_HIDDEN_CAT, B_HIDDEN_ARRANGE, B_HIDDEN_CAT_NAME, B_HIDDEN_SEARCH_TXT, B_CLOSE_DIV, B_FILE, B_END }, // P_FILE
   { B_START_HTML, B_FORM_URLENCODED, B_OPEN_DIV, B_HIDDEN_CAT, B_HIDDEN_ARRANGE, B_HIDDEN_CAT_NAME, B_HIDDEN_SEARCH_TXT, B_CLOSE_DIV, B_PASSWORD, B_END }, // P_PASSWORD
   { B_START_HTML, B_FORM_URLENCODED, B_OPEN_DIV, B_HIDDEN_CAT, B_HIDDEN_ARRANGE, B_HIDDEN_CAT_NAME, B_HIDDEN_SEARCH_TXT, B_CLOSE_DIV, B_NEW, B_END }, // P_NEW
   { B_START_HTML, B_FORM_URLENCODED, B_OPEN_DIV, B_HIDDEN_CAT, B_HIDDEN_ARRANGE, B_HIDDEN_CAT_NAME, B_HIDDEN_SEARCH_TXT, B_CLOSE_DIV, B_OPEN, B_END }, // P_OPEN
-  { B_START_HTML, B_FORM_MULTIPART, B_OPEN_DIV, B_CLOSE_DIV, B_UPLOAD, B_END }, // P_UPLOAD
+  { B_START_HTML, B_FORM_MULTIPART, B_OPEN_DIV, B_HIDDEN_CAT, B_CLOSE_DIV, B_UPLOAD, B_END }, // P_UPLOAD
   { B_START_HTML, B_FORM_URLENCODED, B_OPEN_DIV, B_HIDDEN_CAT, B_HIDDEN_ARRANGE, B_HIDDEN_CAT_NAME, B_HIDDEN_SEARCH_TXT, B_CLOSE_DIV, B_UPLOAD_REPORT, B_END }, // P_UPLOAD_REPORT
   { B_EXPORT, B_END }, // P_EXPORT
   { B_START_HTML, B_FORM_URLENCODED, B_OPEN_DIV, B_HIDDEN_CAT, B_HIDDEN_ARRANGE, B_HIDDEN_SEARCH_TXT, B_CLOSE_DIV, B_DECK_NAME, B_END }, // P_CAT_NAME
@@ -162,13 +176,21 @@ static enum Block block_seq[P_TABLE+1][11] = {
   { B_START_HTML, B_FORM_URLENCODED, B_OPEN_DIV, B_HIDDEN_CAT, B_HIDDEN_ARRANGE, B_HIDDEN_CAT_NAME, B_HIDDEN_SEARCH_TXT, B_CLOSE_DIV, B_LEARN, B_END }, // P_LEARN
   { B_START_HTML, B_FORM_URLENCODED, B_OPEN_DIV, B_HIDDEN_CAT, B_HIDDEN_ARRANGE, B_HIDDEN_CAT_NAME, B_HIDDEN_SEARCH_TXT, B_MSG, B_END }, // P_MSG
   { B_START_HTML, B_FORM_URLENCODED, B_OPEN_DIV, B_HIDDEN_CAT, B_HIDDEN_ARRANGE, B_HIDDEN_CAT_NAME, B_HIDDEN_SEARCH_TXT, B_CLOSE_DIV, B_HISTOGRAM, B_END }, // P_HISTOGRAM
-  { B_START_HTML, B_FORM_URLENCODED, B_OPEN_DIV, B_HIDDEN_CAT, B_HIDDEN_ARRANGE, B_HIDDEN_CAT_NAME, B_HIDDEN_SEARCH_TXT, B_CLOSE_DIV, B_TABLE, B_END } // P_TABLE
+  { B_START_HTML, B_FORM_URLENCODED, B_OPEN_DIV, B_HIDDEN_CAT, B_HIDDEN_ARRANGE, B_HIDDEN_CAT_NAME, B_HIDDEN_SEARCH_TXT, B_CLOSE_DIV, B_TABLE, B_END }, // P_TABLE
+  { B_START_HTML, B_FORM_URLENCODED, B_OPEN_DIV, B_HIDDEN_CAT, B_HIDDEN_ARRANGE, B_HIDDEN_CAT_NAME, B_HIDDEN_SEARCH_TXT, B_CLOSE_DIV, B_SEARCH_LIST, B_END } // P_SEARCH_LIST
 };
 
 static const char *DATA_PATH = "/var/www/memorysurfer";
 
 static const char *ARRANGE[] = { "Before", "Below", "Behind" };
 static const char *SCOPE[] = { "Current", "Checked", "All" };
+static const char *SEARCH_MODE[] = { "Text", "Regex", "Fuzzy" };
+
+enum { SI_BUCKETS = 256, SI_TERM_MAX = 64, SI_GRAM = 0x01, SI_PEND_MAX = 65536 }; // SI_PEND_MAX: bytes of pending postings folded into the buckets
+enum { SH_PAGE = 20, SH_CONTEXT = 40, SH_THREADS = 8, SH_WORK_MIN = 64 }; // hits per result page, snippet bytes around a match, search workers, cards per worker
+enum { XML_BLOCK = 65536, XML_STAGE = 1048576, XML_THREADS = 8, XML_WORK_MIN = 256 }; // upload buffer and hash step, staging block, digest workers, cards per batch
+enum { UPLOAD_MAX = 134217728 }; // bytes of a posted form, the uploaded file with it
+enum { INFLATE_MAX = UPLOAD_MAX * 4 }; // bytes a gzip upload may inflate to, the '\0' with them
 
 struct StringArray {
   int sa_c; // count
@@ -205,9 +227,97 @@ struct Password {
   int32_t style_sai; // string array index
   uint32_t mctr;
   int8_t rank;
+  int32_t dsum_i; // deck summary index
+  int32_t queue_i; // session queue index
+  int32_t sidx_i; // search index
+  int32_t base_i; // the base of the next delta (snapshot)
+};
+struct DeckSummary {
+  int64_t ds_due; // earliest card_time + card_strength of the scheduled cards
+  uint8_t ds_mask; // 1 << card state, for each state present in the deck
+  int32_t ds_day; // day (UTC) of ds_wheel0[0], the day the deck was summarized
+  int32_t ds_wheel0[32]; // scheduled cards by due day, overdue cards are counted in [0]
+  int32_t ds_wheel1[16]; // scheduled cards by 32 day span following ds_wheel0
+  int32_t ds_later; // scheduled cards due after ds_wheel1
+};
+struct QueueEntry {
+  int16_t qe_deck;
+  int32_t qe_card;
+  int32_t qe_nel; // cards_nel at the time the card is determined
+};
+struct SessionQueue {
+  uint32_t sq_mctr; // the queue is valid while it equals passwd.mctr
+  int64_t sq_due; // a further card gets eligible at this time which is picked before the queued ones, the queue is refilled then
+  int16_t sq_n; // -1 = invalid
+  struct QueueEntry sq_l[16]; // the head is the current card
+};
+struct SearchIndex {
+  uint32_t si_mctr; // the index is valid while it equals passwd.mctr
+  int32_t si_bucket[SI_BUCKETS]; // chunk of each term bucket, -1 = empty
+  uint8_t si_grams; // 1 = the buckets hold the trigrams too
+  int32_t si_vis_i; // chunk of the VisibleText map, -1 = none
+  uint8_t si_vis; // 1 = HTML cards are indexed by their visible text
+  uint8_t si_fold; // 1 = the terms and trigrams are folded beyond ASCII
+  int32_t si_pend_i; // chunk of the postings not yet folded into the buckets, -1 = none
+};
+struct VisibleText {
+  int32_t vt_qai; // card_qai of an HTML card
+  int32_t vt_vti; // chunk of its visible text (strings like the card's)
+};
+struct BaseHead {
+  uint8_t bh_id[SHA1_HASH_SIZE]; // of the state the base was taken of
+  int32_t bh_deck_a;
+  int32_t bh_card_n;
+};
+struct BaseDeck {
+  int32_t bd_ord; // ordinal of the first card
+  int32_t bd_n; // cards, -1 = unused slot
+  uint8_t bd_digest[SHA1_HASH_SIZE]; // of the card list
+};
+struct BaseCard {
+  int32_t bc_qai;
+  uint8_t bc_digest[SHA1_HASH_SIZE]; // of the Q/A
 };
 #pragma pack(pop)
 
+struct TermRecord {
+  char tr_term[SI_TERM_MAX + 1];
+  int32_t *tr_post; // card_qai, ascending
+  int32_t tr_n;
+  int32_t tr_a;
+};
+
+struct TermBucket {
+  struct TermRecord *tr_l; // sorted by term
+  int32_t tr_n;
+  int32_t tr_a;
+  int8_t tb_state; // -1 = not loaded, 0 = loaded, 1 = modified
+};
+
+struct TermSet {
+  char *ts_d; // folded copy of the text, the terms '\0' terminated, followed by the trigrams (SI_GRAM and 3 bytes)
+  char **ts_l; // sorted, unique
+  int ts_n;
+};
+
+struct DeckTopology {
+  int16_t dt_parent;
+  int16_t dt_prev; // previous sibling
+  int16_t dt_height; // 0 = leaf, -1 = unreachable
+  int16_t dt_depth;
+  int16_t dt_rank; // preorder
+  int16_t dt_size; // subtree, the deck included
+};
+
+struct QueueCandidate {
+  double qc_retent;
+  int64_t qc_time_diff;
+  int32_t qc_card;
+  int16_t qc_deck;
+  int16_t qc_height;
+  int8_t qc_class; // 0 = scheduled up to the rank strength, 1 = new, 2 = scheduled, 3 = suspended, 4 = scheduled but too strong, -1 = queued
+};
+
 struct MemorySurfer {
   struct IndexedMemoryFile imf;
   char *imf_filename;
@@ -216,6 +326,8 @@ struct MemorySurfer {
   struct Deck *cat_t; // tree
   int deck_a; // allocated
   int16_t n_first;
+  struct DeckTopology *topo_l; // deck_a entries, rebuilt after each tree mutation
+  int topo_h; // max height
   size_t deck_path_z;
   char *deck_path;
   int deck_i;
@@ -238,12 +350,31 @@ struct MemorySurfer {
   int8_t is_unlocked;
   int8_t search_dir;
   enum Scope scope;
+  enum SearchMode search_mode;
+  int search_dist; // edits allowed by SM_FUZZY, -1 = undefined
   int8_t can_resume;
   char *password;
   char *new_password;
   struct Password passwd;
   char *deck_flags;
   size_t deck_flags_n;
+  struct DeckSummary *dsum_l;
+  int dsum_a; // -1 = unknown (rebuilt at the next sync)
+  int8_t dsum_mod; // modified
+  struct SessionQueue sq;
+  int8_t sq_mod;
+  int8_t sq_fill; // 1 = filled by this request, at ms->timestamp
+  struct SearchIndex sidx;
+  int8_t sidx_state; // -1 = invalid (rebuilt by the next search), 0 = valid, 1 = modified
+  struct TermBucket *tb_l; // SI_BUCKETS entries, loaded on demand
+  struct VisibleText *vt_l; // loaded on demand
+  int vt_n; // -1 = not loaded
+  int vt_a;
+  int8_t vt_mod;
+  char *pend_d; // pending postings, in the order made: int32_t card_qai (~card_qai removes), uint8_t term length, term
+  int32_t pend_n; // -1 = not loaded
+  int32_t pend_a;
+  int8_t pend_mod;
 };
 
 static const int32_t SA_INDEX = 2; // StringArray
@@ -266,11 +397,65 @@ struct CardList {
 };
 
 struct XML {
-  char *p_lineptr; // parse
-  struct CardList *cardlist_l;
-  size_t n;
+  char *p_lineptr; // parse: the token scanned last, in xml_buf
+  struct CardList *cardlist_l; // kept for all decks until xml_store
+  int cardlist_a;
   int prev_cat_i;
-  FILE *xml_stream;
+  char *xml_buf; // the whole document, '\0' terminated, tokens are unescaped in place
+  size_t xml_len;
+  size_t xml_pos; // where the next token starts
+  int xml_held; // the byte at xml_pos, replaced by the '\0' which ends the token, -1 = none
+  char **stage_block_l; // the Q/A payloads of the parsed cards, in blocks which don't move while they are hashed
+  int stage_block_n;
+  char *stage_free; // in the last block
+  size_t stage_left;
+  void **stage_data_l; // the payload of each staged card
+  int32_t *stage_size_l;
+  uint8_t *stage_hash_d; // the SHA-1 of each staged payload, computed by the digest workers
+  uint8_t *stage_digest_d; // the SHA-1 each staged payload must have (snapshot), NULL for none
+  int32_t stage_c;
+  int32_t stage_ca;
+  int32_t stage_next; // the first staged card no worker has taken
+  int8_t stage_done; // nothing more is staged, the workers hash the rest and end
+  int stage_e; // of the workers
+  pthread_mutex_t stage_mutex; // the card arrays and stage_next, shared by the parser and the workers
+  pthread_cond_t stage_cond; // a batch is staged or staging is done
+  pthread_t stage_thread_l[XML_THREADS];
+  int stage_thread_n;
+  int stage_thread_a; // workers at most, one CPU parses
+  struct SnapBase *base; // the recorded base a delta applies to, NULL for a full snapshot
+  struct Deck *old_cat_t; // replaced by the delta
+  int old_deck_a;
+  int8_t *ref_l; // the cards of the base which the delta keeps
+  uint8_t snap_id[SHA1_HASH_SIZE]; // the state the snapshot was taken of
+  int8_t snap_idf; // 1 = snap_id is set, the imported state is recorded as the base of a delta
+  struct SnapBase *dup; // merge: the cards of the file, sorted by digest, which aren't stored again; NULL for none
+  int32_t dup_n; // the parsed cards skipped as they exist
+  int32_t fold_n; // the parsed decks folded into an existing one
+};
+
+enum SnapTag { SNAP_DECKS = 1, SNAP_NAMES, SNAP_STYLES, SNAP_CARDS, SNAP_QA, SNAP_END, SNAP_BASE };
+
+static const char SNAP_MAGIC[8] = { 'M', 'S', 'F', 'S', 'N', 'A', 'P', '1' };
+static const char DELTA_MAGIC[8] = { 'M', 'S', 'F', 'S', 'D', 'L', 'T', '1' };
+
+struct SnapBase {
+  char *sb_d; // the BaseHead, the BaseDeck of each deck slot, then the BaseCard of each card in snapshot order
+  int32_t sb_n;
+  struct BaseHead *sb_head;
+  struct BaseDeck *sb_deck_l;
+  struct BaseCard *sb_card_l;
+};
+
+struct BaseOrd {
+  int32_t bo_qai; // first, for qai_cmp
+  int32_t bo_ord;
+};
+
+struct SnapSection {
+  uint32_t ss_tag;
+  int32_t ss_arg; // the deck of SNAP_CARDS, the card of SNAP_QA
+  int32_t ss_size; // of the data which follows, then its SHA-1
 };
 
 struct IndentStr {
@@ -279,6 +464,92 @@ struct IndentStr {
   int indent_n;
 };
 
+struct MatchSpan {
+  int32_t span_off;
+  int32_t span_len;
+};
+
+struct SearchHit {
+  int64_t sh_pos; // chunk position, the cards are read in this order
+  int32_t sh_qai; // the chunk searched: the card or its visible text
+  int32_t sh_card_i;
+  int16_t sh_deck_i;
+  int16_t sh_rank; // preorder of the deck
+  int8_t sh_field; // 0 = question, 1 = answer, -1 = no match
+  int32_t sh_off; // of the match in the field
+  int32_t sh_len; // of the match
+  int8_t sh_dist; // edits (SM_FUZZY)
+  char *sh_path; // deck path, listed hits only
+  char *sh_text; // before, match and after ('\0' terminated each), listed hits only
+};
+
+enum { RX_POS_MAX = 64 };
+
+struct Regex {
+  uint64_t rx_class[256]; // the positions each byte can match
+  uint64_t rx_follow[RX_POS_MAX]; // the positions that can follow a position
+  uint64_t rx_next[8][256]; // union of the follow sets of the positions in one byte (k) of a state
+  uint64_t rx_prev[8][256]; // the same for the preceding positions (scanning backward)
+  uint64_t rx_first;
+  uint64_t rx_last;
+  int rx_n; // positions
+  int rx_w; // bytes of a state in use
+  int8_t rx_nullable; // matches the empty string
+  int8_t rx_bol; // ^
+  int8_t rx_eol; // $
+};
+
+enum { UC_VARIANTS = 4 };
+struct CaseRange {
+  uint16_t cr_lo;
+  uint16_t cr_hi;
+  int16_t cr_delta; // to the folded character
+  uint8_t cr_pairs; // 1 = only every second character from cr_lo folds (to the next one)
+};
+
+struct Glushkov {
+  uint64_t gl_first;
+  uint64_t gl_last;
+  int8_t gl_nullable;
+};
+
+struct RegexParse {
+  struct Regex *rp_rx;
+  const uint8_t *rp_s;
+  int rp_i;
+  int rp_end;
+  int rp_fold;
+  const char *rp_err;
+};
+
+enum { FZ_POS_MAX = 64, FZ_DIST_MAX = 3 };
+
+struct Fuzzy {
+  uint64_t fz_peq[2][128]; // the positions of each ASCII character in the pattern (0) and the reversed pattern (1)
+  uint32_t fz_cp[FZ_POS_MAX]; // the other characters of the pattern (UTF-8 bytes)
+  uint64_t fz_cp_peq[2][FZ_POS_MAX];
+  int fz_cp_n;
+  int fz_m; // characters of the pattern
+  int fz_k; // edits allowed
+  int fz_fold; // the characters of the text are folded (the pattern is folded already)
+};
+
+struct Matcher {
+  char *mt_txt; // the search text, lower case when folding
+  int mt_len;
+  int mt_fold;
+  struct Regex *mt_rx; // SM_REGEX
+  struct Fuzzy *mt_fz; // SM_FUZZY
+};
+
+struct SearchWork {
+  struct IndexedMemoryFile *imf;
+  const struct Matcher *mt;
+  struct SearchHit *hit_l; // a range of the position sorted candidates
+  int hit_n;
+  int e;
+};
+
 struct WebMemorySurfer {
   struct MemorySurfer ms;
   enum Sequence seq;
@@ -294,6 +565,7 @@ struct WebMemorySurfer {
   char **fl_v; // filelist vector
   int fl_c; // count
   struct StringArray qa_sa;
+  struct StringArray vis_sa; // the visible text of an HTML card searched
   int reveal_pos;
   int saved_reveal_pos;
   int sw_i;
@@ -306,20 +578,32 @@ struct WebMemorySurfer {
   size_t html_n;
   char *html_lp;
   char *found_str;
+  struct MatchSpan *span_l[2]; // all matches in the question (0) and the answer (1) of the card found
+  int span_n[2];
   uint32_t mctr;
   int32_t mtime[2];
   int hist_bucket[100]; // histogram
   int hist_max;
+  int fc_bucket[30]; // forecast, cards due per day
+  int fc_max;
   int lvl_bucket[2][21]; // 0 = total, 1 = eligible
   int count_bucket[4];
   int checked_decks;
   uint8_t tok_digest[SHA1_HASH_SIZE];
   char tok_str[41];
   struct IndentStr *inds;
-  char *temp_filename;
+  char *upload_d; // the uploaded XML, '\0' terminated
+  size_t upload_n;
+  uint8_t upload_digest[SHA1_HASH_SIZE]; // of upload_d, computed while it is received
   uint8_t *posted_message_digest;
   int card_n;
   int deck_n;
+  struct SearchHit *hit_l; // search results
+  int hit_n;
+  int list_pos; // first listed hit
+  int hit_posted; // hit_l was posted back by the list page, only the listed hits are matched again
+  int32_t hit_mctr; // of the file the posted hits were searched in
+  const char *search_err; // invalid search pattern
 };
 
 static int append_part(struct WebMemorySurfer *wms, struct Multi *mult)
@@ -598,25 +882,28 @@ static int xml_unescape(char *xml_str)
   int wp;
   char ch;
   assert(xml_str != NULL);
+  e = 0;
+  xml_str = strchr(xml_str, '&'); // nothing is moved before the first entity
   rp = 0;
   wp = 0;
-  e = 0;
-  do {
-    ch = xml_str[rp++];
-    if (ch == '&') {
-      if (strncmp(xml_str + rp, "amp;", 4) == 0) {
-        rp += 4;
-        ch = '&';
-      } else if (strncmp(xml_str + rp, "lt;", 3) == 0) {
-        rp += 3;
-        ch = '<';
-      } else {
-        ch = '\0';
-        e = E_UNESC; // illegal ampersand during unescape detected
+  if (xml_str != NULL) {
+    do {
+      ch = xml_str[rp++];
+      if (ch == '&') {
+        if (strncmp(xml_str + rp, "amp;", 4) == 0) {
+          rp += 4;
+          ch = '&';
+        } else if (strncmp(xml_str + rp, "lt;", 3) == 0) {
+          rp += 3;
+          ch = '<';
+        } else {
+          ch = '\0';
+          e = E_UNESC; // illegal ampersand during unescape detected
+        }
       }
-    }
-    xml_str[wp++] = ch;
-  } while (ch != '\0' && e == 0);
+      xml_str[wp++] = ch;
+    } while (ch != '\0' && e == 0);
+  }
   return e;
 }
 
@@ -628,493 +915,890 @@ enum CardState {
   STATE_HTML = 0x08
 };
 
-static ssize_t dummy_getdelim(char **lineptr, size_t *n, int delimiter, FILE *fp)
+// the next token of the document, up to and including the delimiter (or to the end), as a slice of xml_buf in
+// p_lineptr, '\0' terminated; returns its length, -1 at the end of the document
+static ssize_t xml_scan(struct XML *xml, int delimiter)
 {
-  ssize_t result;
-  size_t cur_len = 0;
+  size_t start;
+  size_t end;
+  char *found;
+  if (xml->xml_held >= 0) {
+    xml->xml_buf[xml->xml_pos] = xml->xml_held;
+    xml->xml_held = -1;
+  }
+  start = xml->xml_pos;
+  found = memchr(xml->xml_buf + start, delimiter, xml->xml_len - start);
+  end = found != NULL ? found + 1 - xml->xml_buf : xml->xml_len;
+  xml->p_lineptr = xml->xml_buf + start;
+  xml->xml_held = (uint8_t)xml->xml_buf[end];
+  xml->xml_buf[end] = '\0';
+  xml->xml_pos = end;
+  return end > start ? (ssize_t)(end - start) : -1;
+}
 
-  if (lineptr == NULL || n == NULL || fp == NULL)
-    {
-      errno = EINVAL;
-      return -1;
+static int ms_summarize(struct MemorySurfer *ms, int deck_i, struct Card *card_l, int card_a)
+{
+  int e;
+  int i;
+  int card_i;
+  size_t size;
+  int64_t due;
+  int64_t day;
+  enum CardState card_state;
+  struct DeckSummary *dsum_l;
+  struct DeckSummary *dsum_ptr;
+  e = 0;
+  if (ms->dsum_a >= 0) {
+    assert(deck_i >= 0 && deck_i < ms->deck_a);
+    if (ms->dsum_a < ms->deck_a) {
+      size = sizeof(struct DeckSummary) * ms->deck_a;
+      dsum_l = realloc(ms->dsum_l, size);
+      e = dsum_l == NULL;
+      if (e == 0) {
+        for (i = ms->dsum_a; i < ms->deck_a; i++) {
+          memset(dsum_l + i, 0, sizeof(struct DeckSummary));
+          dsum_l[i].ds_due = INT64_MAX;
+        }
+        ms->dsum_l = dsum_l;
+        ms->dsum_a = ms->deck_a;
+      }
+    }
+    if (e == 0) {
+      assert(ms->timestamp >= 0);
+      dsum_ptr = ms->dsum_l + deck_i;
+      memset(dsum_ptr, 0, sizeof(struct DeckSummary));
+      dsum_ptr->ds_due = INT64_MAX;
+      dsum_ptr->ds_day = ms->timestamp / 86400;
+      for (card_i = 0; card_i < card_a; card_i++) {
+        card_state = card_l[card_i].card_state & 0x07;
+        dsum_ptr->ds_mask |= 1 << card_state;
+        if (card_state == STATE_SCHEDULED) {
+          due = card_l[card_i].card_time + card_l[card_i].card_strength;
+          if (due < dsum_ptr->ds_due) {
+            dsum_ptr->ds_due = due;
+          }
+          day = due / 86400 - dsum_ptr->ds_day;
+          if (day < 32) {
+            dsum_ptr->ds_wheel0[day < 0 ? 0 : day]++;
+          } else if (day < 32 + 16 * 32) {
+            dsum_ptr->ds_wheel1[(day - 32) / 32]++;
+          } else {
+            dsum_ptr->ds_later++;
+          }
+        }
+      }
+      ms->dsum_mod = 1;
     }
+  }
+  return e;
+}
 
- // flockfile (fp);
+static const uint8_t lower_map[256] = {
+  0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+  0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f,
+  0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f,
+  0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0x3e, 0x3f,
+  0x40, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x6b, 0x6c, 0x6d, 0x6e, 0x6f, // A - O
+  0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x5b, 0x5c, 0x5d, 0x5e, 0x5f, // P - Z
+  0x60, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x6b, 0x6c, 0x6d, 0x6e, 0x6f,
+  0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x7b, 0x7c, 0x7d, 0x7e, 0x7f,
+  0x80, 0x81, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x8b, 0x8c, 0x8d, 0x8e, 0x8f,
+  0x90, 0x91, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0x9b, 0x9c, 0x9d, 0x9e, 0x9f,
+  0xa0, 0xa1, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xab, 0xac, 0xad, 0xae, 0xaf,
+  0xb0, 0xb1, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xbb, 0xbc, 0xbd, 0xbe, 0xbf,
+  0xc0, 0xc1, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xcb, 0xcc, 0xcd, 0xce, 0xcf,
+  0xd0, 0xd1, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xdb, 0xdc, 0xdd, 0xde, 0xdf,
+  0xe0, 0xe1, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xeb, 0xec, 0xed, 0xee, 0xef,
+  0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff };
 
-  if (*lineptr == NULL || *n == 0)
-    {
-      char *new_lineptr;
-      *n = 120;
-      new_lineptr = (char *) realloc (*lineptr, *n);
-      if (new_lineptr == NULL)
-        {
- //         alloc_failed ();
-          result = -1;
-          goto unlock_return;
-        }
-      *lineptr = new_lineptr;
+// simple case folding of the scripts with case, limited to mappings that keep the byte length of the UTF-8 sequence
+// (so text folds in place and a match has the length of the search text) and that don't fold into ASCII (U+0130,
+// U+017F and the Kelvin sign stay as they are, ASCII text is folded by bytes); sorted by cr_lo
+static const struct CaseRange CASE_RANGE[] = {
+  { 0x0041, 0x005a, 32, 0 }, { 0x00c0, 0x00d6, 32, 0 }, { 0x00d8, 0x00de, 32, 0 }, // Latin-1
+  { 0x0100, 0x012f, 1, 1 }, { 0x0132, 0x0137, 1, 1 }, { 0x0139, 0x0148, 1, 1 }, { 0x014a, 0x0177, 1, 1 },
+  { 0x0178, 0x0178, -121, 0 }, { 0x0179, 0x017e, 1, 1 }, // Latin Extended-A
+  { 0x01cd, 0x01dc, 1, 1 }, { 0x01de, 0x01ef, 1, 1 }, { 0x01f8, 0x021f, 1, 1 }, { 0x0222, 0x0233, 1, 1 }, // Latin Extended-B
+  { 0x0386, 0x0386, 38, 0 }, { 0x0388, 0x038a, 37, 0 }, { 0x038c, 0x038c, 64, 0 }, { 0x038e, 0x038f, 63, 0 },
+  { 0x0391, 0x03a1, 32, 0 }, { 0x03a3, 0x03ab, 32, 0 }, { 0x03c2, 0x03c2, 1, 0 }, { 0x03d8, 0x03ef, 1, 1 }, // Greek
+  { 0x0400, 0x040f, 80, 0 }, { 0x0410, 0x042f, 32, 0 }, { 0x0460, 0x0481, 1, 1 }, { 0x048a, 0x04bf, 1, 1 },
+  { 0x04c0, 0x04c0, 15, 0 }, { 0x04c1, 0x04ce, 1, 1 }, { 0x04d0, 0x052f, 1, 1 }, // Cyrillic
+  { 0x0531, 0x0556, 48, 0 }, // Armenian
+  { 0x10a0, 0x10c5, 7264, 0 }, // Georgian
+  { 0x1e00, 0x1e95, 1, 1 }, { 0x1ea0, 0x1eff, 1, 1 }, // Latin Extended Additional
+  { 0x2160, 0x216f, 16, 0 }, { 0x24b6, 0x24cf, 26, 0 }, { 0x2c00, 0x2c2f, 48, 0 }, { 0xff21, 0xff3a, 32, 0 } };
+
+static int utf8_lead_len(uint8_t ch)
+{
+  return ch >= 0xf0 ? 4 : ch >= 0xe0 ? 3 : ch >= 0xc0 ? 2 : 1;
+}
+
+// the code point of the UTF-8 character at s in *cp, returns its bytes; a byte which doesn't start a valid shortest
+// form sequence is taken alone as 0x80000000 | byte; reads no further than a '\0'
+static int utf8_decode(const char *s, uint32_t *cp)
+{
+  const uint8_t *b;
+  int n;
+  int i;
+  int is_valid;
+  b = (const uint8_t *)s;
+  n = utf8_lead_len(b[0]);
+  is_valid = b[0] < 0x80 || (b[0] >= 0xc2 && b[0] <= 0xf4);
+  *cp = b[0] & (0xff >> (n > 1 ? n + 1 : 1));
+  for (i = 1; i < n && is_valid != 0; i++) {
+    is_valid = (b[i] & 0xc0) == 0x80;
+    *cp = *cp << 6 | (b[i] & 0x3f);
+  }
+  if (is_valid == 0 || (n == 3 && (*cp < 0x800 || (*cp >= 0xd800 && *cp <= 0xdfff))) || (n == 4 && (*cp < 0x10000 || *cp > 0x10ffff))) {
+    n = 1;
+    *cp = 0x80000000 | b[0];
+  }
+  return n;
+}
+
+// writes the UTF-8 bytes of cp to s, returns their number
+static int utf8_encode(uint32_t cp, char *s)
+{
+  int n;
+  int i;
+  n = 0;
+  if (cp < 0x80) {
+    s[n++] = cp;
+  } else {
+    i = cp < 0x800 ? 1 : cp < 0x10000 ? 2 : 3;
+    s[n++] = (0xff00 >> (i + 1) & 0xff) | cp >> (6 * i);
+    while (i-- > 0) {
+      s[n++] = 0x80 | (cp >> (6 * i) & 0x3f);
     }
+  }
+  return n;
+}
 
-  for (;;)
-    {
-      int i;
+static uint32_t uc_fold(uint32_t cp)
+{
+  int lo;
+  int hi;
+  int mid;
+  const struct CaseRange *cr;
+  lo = 0;
+  hi = sizeof(CASE_RANGE) / sizeof(CASE_RANGE[0]);
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (cp > CASE_RANGE[mid].cr_hi) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo < (int)(sizeof(CASE_RANGE) / sizeof(CASE_RANGE[0]))) {
+    cr = CASE_RANGE + lo;
+    if (cp >= cr->cr_lo && (cr->cr_pairs == 0 || ((cp - cr->cr_lo) & 1) == 0)) {
+      cp += cr->cr_delta;
+    }
+  }
+  return cp;
+}
 
-      i = fgetc(fp);
-      if (i == EOF)
-        {
-          result = -1;
-          break;
-        }
+// the characters which fold like cp, the folded one first, returns their number (UC_VARIANTS at most)
+static int uc_variants(uint32_t cp, uint32_t *var_l)
+{
+  int n;
+  size_t i;
+  uint32_t c;
+  const struct CaseRange *cr;
+  var_l[0] = uc_fold(cp);
+  n = 1;
+  for (i = 0; i < sizeof(CASE_RANGE) / sizeof(CASE_RANGE[0]) && n < UC_VARIANTS; i++) {
+    cr = CASE_RANGE + i;
+    c = var_l[0] - cr->cr_delta;
+    if (c >= cr->cr_lo && c <= cr->cr_hi && (cr->cr_pairs == 0 || ((c - cr->cr_lo) & 1) == 0)) {
+      var_l[n++] = c;
+    }
+  }
+  return n;
+}
 
-      /* Make enough space for len+1 (for final NUL) bytes.  */
-      if (cur_len + 1 >= *n)
-        {
-          size_t needed_max =
-            SSIZE_MAX < SIZE_MAX ? (size_t) SSIZE_MAX + 1 : SIZE_MAX;
-          size_t needed = 2 * *n + 1;
-          char *new_lineptr;
-
-          if (needed_max < needed)
-            needed = needed_max;
-          if (cur_len + 1 >= needed)
-            {
-              result = -1;
-              errno = EOVERFLOW;
-              goto unlock_return;
-            }
+// the folded bytes of the character at s written to fold, returns their number (as many as it takes of s)
+static int utf8_fold_char(const char *s, char *fold)
+{
+  int n;
+  uint32_t cp;
+  uint32_t f;
+  if ((uint8_t)s[0] < 0x80) {
+    n = 1;
+    fold[0] = lower_map[(uint8_t)s[0]];
+  } else {
+    n = utf8_decode(s, &cp);
+    f = uc_fold(cp);
+    if (f != cp) {
+      utf8_encode(f, fold);
+    } else {
+      memcpy(fold, s, n);
+    }
+  }
+  return n;
+}
 
-          new_lineptr = (char *) realloc (*lineptr, needed);
-          if (new_lineptr == NULL)
-            {
- //             alloc_failed ();
-              result = -1;
-              goto unlock_return;
-            }
+// folds the n bytes of s in place (s[n] must not be a continuation byte, a '\0' say); 8 ASCII bytes at a time, when the
+// word holds no other: a byte from 'A' to 'Z' has bit 7 set after adding 0x3f but not after adding 0x25
+static void utf8_fold(char *s, size_t n)
+{
+  size_t i;
+  uint64_t word;
+  uint64_t upper;
+  uint32_t cp;
+  uint32_t f;
+  int len;
+  i = 0;
+  while (i < n) {
+    word = 0x8080808080808080ull;
+    if (i + sizeof(word) <= n) {
+      memcpy(&word, s + i, sizeof(word));
+    }
+    if ((word & 0x8080808080808080ull) == 0) {
+      upper = (word + 0x3f3f3f3f3f3f3f3full) & ~(word + 0x2525252525252525ull) & 0x8080808080808080ull;
+      word |= upper >> 2;
+      memcpy(s + i, &word, sizeof(word));
+      i += sizeof(word);
+    } else if ((uint8_t)s[i] < 0x80) {
+      s[i] = lower_map[(uint8_t)s[i]];
+      i++;
+    } else {
+      len = utf8_decode(s + i, &cp);
+      f = uc_fold(cp);
+      if (f != cp) {
+        utf8_encode(f, s + i);
+      }
+      i += len;
+    }
+  }
+}
+
+static size_t utf8_char_len(const char *s)
+{
+  uint32_t cp;
+  return s[0] != '\0' ? utf8_decode(s, &cp) : 0;
+}
+
+// the bytes of s before the first of the characters of reject (all of s without one)
+static int utf8_strcspn(const char *s, const char *reject, size_t *n)
+{
+  int e;
+  int i;
+  int len;
+  int found;
+  uint32_t cp;
+  uint32_t reject_cp;
+  e = s == NULL || reject == NULL || n == NULL;
+  if (e == 0) {
+    *n = 0;
+    found = 0;
+    while (s[*n] != '\0' && found == 0) {
+      len = utf8_decode(s + *n, &cp);
+      i = 0;
+      while (reject[i] != '\0' && found == 0) {
+        i += utf8_decode(reject + i, &reject_cp);
+        found = reject_cp == cp;
+      }
+      if (found == 0) {
+        *n += len;
+      }
+    }
+  }
+  return e;
+}
+
+static int si_is_term_char(uint8_t ch)
+{
+  return ch >= 0x80 || (ch >= '0' && ch <= '9') || (ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z');
+}
+
+static uint32_t si_hash(const char *term)
+{
+  uint32_t hash;
+  hash = 2166136261u; // FNV-1a
+  while (*term != '\0') {
+    hash = (hash ^ (uint8_t)*term++) * 16777619u;
+  }
+  return hash % SI_BUCKETS;
+}
+
+static int ts_cmp(const void *ls, const void *rs)
+{
+  return strcmp(*(char * const *)ls, *(char * const *)rs);
+}
 
-          *lineptr = new_lineptr;
-          *n = needed;
+// splits the text into folded terms (truncated to SI_TERM_MAX bytes), '\0' separates like any other non-term byte,
+// and into the folded trigrams of its strings
+static int ts_split(struct TermSet *ts, const char *str, int32_t len)
+{
+  int e;
+  int32_t i;
+  int32_t start;
+  int n;
+  int gram_n;
+  char *gram;
+  ts->ts_l = NULL;
+  ts->ts_n = 0;
+  ts->ts_d = malloc(len + 1 + len * 5);
+  e = ts->ts_d == NULL;
+  if (e == 0) {
+    memcpy(ts->ts_d, str, len);
+    ts->ts_d[len] = '\0';
+    utf8_fold(ts->ts_d, len);
+    gram = ts->ts_d + len + 1;
+    gram_n = 0;
+    for (i = 0; i + 2 < len; i++) {
+      if (ts->ts_d[i] != '\0' && ts->ts_d[i + 1] != '\0' && ts->ts_d[i + 2] != '\0') {
+        gram[0] = SI_GRAM;
+        memcpy(gram + 1, ts->ts_d + i, 3);
+        gram[4] = '\0';
+        gram += 5;
+        gram_n++;
+      }
+    }
+    n = gram_n;
+    start = -1;
+    for (i = 0; i < len; i++) {
+      if (si_is_term_char(ts->ts_d[i]) != 0) {
+        if (start < 0) {
+          start = i;
+          n++;
+        }
+        if (i - start >= SI_TERM_MAX) {
+          ts->ts_d[i] = '\0';
+        }
+      } else {
+        ts->ts_d[i] = '\0';
+        start = -1;
+      }
+    }
+    if (n > 0) {
+      ts->ts_l = malloc(sizeof(char *) * n);
+      e = ts->ts_l == NULL;
+      if (e == 0) {
+        for (i = 0; i < len; i++) {
+          if (ts->ts_d[i] != '\0' && (i == 0 || ts->ts_d[i - 1] == '\0')) {
+            ts->ts_l[ts->ts_n++] = ts->ts_d + i;
+          }
+        }
+        gram = ts->ts_d + len + 1;
+        for (i = 0; i < gram_n; i++) {
+          ts->ts_l[ts->ts_n++] = gram + i * 5;
+        }
+        assert(ts->ts_n == n);
+        qsort(ts->ts_l, n, sizeof(char *), ts_cmp);
+        ts->ts_n = 1;
+        for (i = 1; i < n; i++) {
+          if (strcmp(ts->ts_l[i], ts->ts_l[ts->ts_n - 1]) != 0) {
+            ts->ts_l[ts->ts_n++] = ts->ts_l[i];
+          }
         }
+      }
+    }
+  }
+  return e;
+}
 
-      (*lineptr)[cur_len] = i;
-      cur_len++;
+static void ts_free(struct TermSet *ts)
+{
+  free(ts->ts_l);
+  ts->ts_l = NULL;
+  ts->ts_n = 0;
+  free(ts->ts_d);
+  ts->ts_d = NULL;
+}
 
-      if (i == delimiter)
-        break;
+// returns the record of the term (*found = 1) or the position it is to be inserted at
+static int32_t tb_find(struct TermBucket *tb, const char *term, int *found)
+{
+  int32_t lo;
+  int32_t hi;
+  int32_t mid;
+  int cmp;
+  lo = 0;
+  hi = tb->tr_n;
+  *found = 0;
+  while (lo < hi && *found == 0) {
+    mid = (lo + hi) / 2;
+    cmp = strcmp(tb->tr_l[mid].tr_term, term);
+    if (cmp < 0) {
+      lo = mid + 1;
+    } else if (cmp > 0) {
+      hi = mid;
+    } else {
+      lo = mid;
+      *found = 1;
+    }
+  }
+  return lo;
+}
+
+// returns the position of the first posting not less than qai
+static int32_t tr_find(struct TermRecord *tr, int32_t qai)
+{
+  int32_t lo;
+  int32_t hi;
+  int32_t mid;
+  lo = 0;
+  hi = tr->tr_n;
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (tr->tr_post[mid] < qai) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
     }
-  (*lineptr)[cur_len] = '\0';
-  result = cur_len ? cur_len : result;
+  }
+  return lo;
+}
 
- unlock_return:
- // funlockfile (fp); /* doesn't set errno */
+static int tb_add(struct TermBucket *tb, const char *term, int32_t qai)
+{
+  int e;
+  int found;
+  int32_t tr_i;
+  int32_t post_i;
+  int32_t size;
+  struct TermRecord *tr_l;
+  struct TermRecord *tr;
+  int32_t *post_l;
+  e = 0;
+  assert(strlen(term) > 0 && strlen(term) <= SI_TERM_MAX);
+  tr_i = tb_find(tb, term, &found);
+  if (found == 0) {
+    if (tb->tr_n == tb->tr_a) {
+      size = tb->tr_a > 0 ? tb->tr_a * 2 : 16;
+      tr_l = realloc(tb->tr_l, sizeof(struct TermRecord) * size);
+      e = tr_l == NULL;
+      if (e == 0) {
+        tb->tr_l = tr_l;
+        tb->tr_a = size;
+      }
+    }
+    if (e == 0) {
+      memmove(tb->tr_l + tr_i + 1, tb->tr_l + tr_i, sizeof(struct TermRecord) * (tb->tr_n - tr_i));
+      tb->tr_n++;
+      tr = tb->tr_l + tr_i;
+      strcpy(tr->tr_term, term);
+      tr->tr_post = NULL;
+      tr->tr_n = 0;
+      tr->tr_a = 0;
+    }
+  }
+  if (e == 0) {
+    tr = tb->tr_l + tr_i;
+    post_i = tr->tr_n > 0 && tr->tr_post[tr->tr_n - 1] < qai ? tr->tr_n : tr_find(tr, qai); // appended while (re)building
+    if (post_i == tr->tr_n || tr->tr_post[post_i] != qai) {
+      if (tr->tr_n == tr->tr_a) {
+        size = tr->tr_a > 0 ? tr->tr_a * 2 : 4;
+        post_l = realloc(tr->tr_post, sizeof(int32_t) * size);
+        e = post_l == NULL;
+        if (e == 0) {
+          tr->tr_post = post_l;
+          tr->tr_a = size;
+        }
+      }
+      if (e == 0) {
+        memmove(tr->tr_post + post_i + 1, tr->tr_post + post_i, sizeof(int32_t) * (tr->tr_n - post_i));
+        tr->tr_post[post_i] = qai;
+        tr->tr_n++;
+        tb->tb_state = 1;
+      }
+    }
+  }
+  return e;
+}
 
-  return result;
+static void tb_remove(struct TermBucket *tb, const char *term, int32_t qai)
+{
+  int found;
+  int32_t tr_i;
+  int32_t post_i;
+  struct TermRecord *tr;
+  tr_i = tb_find(tb, term, &found);
+  if (found != 0) {
+    tr = tb->tr_l + tr_i;
+    post_i = tr_find(tr, qai);
+    if (post_i < tr->tr_n && tr->tr_post[post_i] == qai) {
+      tr->tr_n--;
+      memmove(tr->tr_post + post_i, tr->tr_post + post_i + 1, sizeof(int32_t) * (tr->tr_n - post_i));
+      if (tr->tr_n == 0) {
+        free(tr->tr_post);
+        tb->tr_n--;
+        memmove(tb->tr_l + tr_i, tb->tr_l + tr_i + 1, sizeof(struct TermRecord) * (tb->tr_n - tr_i));
+      }
+      tb->tb_state = 1;
+    }
+  }
 }
 
-static int parse_xml(struct XML *xml, struct WebMemorySurfer *wms, enum Tag tag, int parent_cat_i) {
+static void tb_clear(struct TermBucket *tb)
+{
+  int32_t tr_i;
+  for (tr_i = 0; tr_i < tb->tr_n; tr_i++) {
+    free(tb->tr_l[tr_i].tr_post);
+  }
+  tb->tr_n = 0;
+}
+
+// parses a stored bucket: records of uint8_t term length, term, int32_t n and n card_qai, sorted by term
+static int tb_load(struct TermBucket *tb, const char *data, int32_t data_size)
+{
   int e;
-  ssize_t nread;
-  int deck_i;
-  int card_i;
-  char *str;
+  int32_t pos;
   int len;
-  int i;
-  int deck_a;
-  size_t size;
-  struct tm bd_time; // broken-down
-  int a_n; // assignments
-  time_t simple_time;
-  int32_t index;
-  int32_t data_size;
-  char do_flag;
-  char slash_f; // flag
-  do_flag = 1;
-  deck_i = -1;
-  do {
-    nread = dummy_getdelim(&xml->p_lineptr, &xml->n, '<', xml->xml_stream);
-    e = nread <= 0;
+  int32_t post_n;
+  struct TermRecord *tr_l;
+  struct TermRecord *tr;
+  e = 0;
+  pos = 0;
+  while (pos < data_size && e == 0) {
+    len = (uint8_t)data[pos];
+    e = len == 0 || len > SI_TERM_MAX || pos + 1 + len + (int32_t)sizeof(int32_t) > data_size ? E_CRRPT : 0;
     if (e == 0) {
-      if (do_flag) {
-        do_flag = 0;
-        switch (tag) {
-        case TAG_ROOT:
-        case TAG_MEMORYSURFER:
-          break;
-        case TAG_DECK:
-          deck_i = 0;
-          while (deck_i < wms->ms.deck_a && wms->ms.cat_t[deck_i].deck_slot_used != 0)
-            deck_i++;
-          assert(deck_i <= INT16_MAX);
-          if (deck_i == wms->ms.deck_a) {
-            deck_a = wms->ms.deck_a + 7;
-            size = sizeof(struct Deck) * deck_a;
-            wms->ms.cat_t = realloc(wms->ms.cat_t, size);
-            e = wms->ms.cat_t == NULL;
-            if (e == 0) {
-              size = sizeof(struct CardList) * deck_a;
-              xml->cardlist_l = realloc(xml->cardlist_l, size);
-              e = xml->cardlist_l == NULL;
-            }
-            if (e == 0) {
-              for (i = wms->ms.deck_a; i < deck_a; i++) {
-                wms->ms.cat_t[i].deck_slot_used = 0;
-                xml->cardlist_l[i].card_l = NULL;
-                xml->cardlist_l[i].card_a = 0;
-              }
-              wms->ms.deck_a = deck_a;
-            }
-          }
-          if (e == 0) {
-            if (xml->prev_cat_i != -1) {
-              wms->ms.cat_t[xml->prev_cat_i].n_sibling = deck_i;
-            } else if (parent_cat_i != -1) {
-              wms->ms.cat_t[parent_cat_i].n_child = deck_i;
-            }
-            xml->prev_cat_i = -1;
-            if (e == 0) {
-              wms->ms.cat_t[deck_i].cat_cli = -1;
-              wms->ms.cat_t[deck_i].deck_x = 1;
-              wms->ms.cat_t[deck_i].n_sibling = -1;
-              wms->ms.cat_t[deck_i].n_child = -1;
-              wms->ms.cat_t[deck_i].deck_slot_used = 1;
-              wms->ms.cat_t[deck_i].deck_on = 0;
-            }
-          }
-          break;
-        case TAG_NAME:
-          str = xml->p_lineptr;
-          str[nread - 1] = '\0';
-          e = xml_unescape(str);
-          if (e == 0) {
-            e = sa_set(&wms->ms.deck_sa, parent_cat_i, str);
-          }
-          break;
-        case TAG_STYLE:
-          str = xml->p_lineptr;
-          str[nread - 1] = '\0';
-          e = xml_unescape(str);
-          if (e == 0) {
-            e = sa_set(&wms->ms.style_sa, parent_cat_i, str);
-          }
-          break;
-        case TAG_CARD:
-          assert(parent_cat_i >= 0 && xml->cardlist_l[parent_cat_i].card_a >= 0);
-          xml->cardlist_l[parent_cat_i].card_a++;
-          size = xml->cardlist_l[parent_cat_i].card_a * sizeof(struct Card);
-          xml->cardlist_l[parent_cat_i].card_l = realloc(xml->cardlist_l[parent_cat_i].card_l, size);
-          e = xml->cardlist_l[parent_cat_i].card_l == NULL;
+      memcpy(&post_n, data + pos + 1 + len, sizeof(int32_t));
+      e = post_n <= 0 || post_n > (data_size - pos - 1 - len) / (int32_t)sizeof(int32_t) - 1 ? E_CRRPT : 0;
+    }
+    if (e == 0 && tb->tr_n == tb->tr_a) {
+      tr_l = realloc(tb->tr_l, sizeof(struct TermRecord) * (tb->tr_a > 0 ? tb->tr_a * 2 : 16));
+      e = tr_l == NULL;
+      if (e == 0) {
+        tb->tr_l = tr_l;
+        tb->tr_a = tb->tr_a > 0 ? tb->tr_a * 2 : 16;
+      }
+    }
+    if (e == 0) {
+      tr = tb->tr_l + tb->tr_n;
+      memcpy(tr->tr_term, data + pos + 1, len);
+      tr->tr_term[len] = '\0';
+      e = tb->tr_n > 0 && strcmp(tr[-1].tr_term, tr->tr_term) >= 0 ? E_CRRPT : 0;
+      if (e == 0) {
+        tr->tr_post = malloc(sizeof(int32_t) * post_n);
+        e = tr->tr_post == NULL;
+        if (e == 0) {
+          memcpy(tr->tr_post, data + pos + 1 + len + sizeof(int32_t), sizeof(int32_t) * post_n);
+          tr->tr_n = post_n;
+          tr->tr_a = post_n;
+          tb->tr_n++;
+          pos += 1 + len + sizeof(int32_t) * (1 + post_n);
+        }
+      }
+    }
+  }
+  return e;
+}
+
+static int tb_store(struct TermBucket *tb, char **data_p, int32_t *data_size_p)
+{
+  int e;
+  int32_t tr_i;
+  int32_t pos;
+  int len;
+  struct TermRecord *tr;
+  char *data;
+  pos = 0;
+  for (tr_i = 0; tr_i < tb->tr_n; tr_i++) {
+    pos += 1 + strlen(tb->tr_l[tr_i].tr_term) + sizeof(int32_t) * (1 + tb->tr_l[tr_i].tr_n);
+  }
+  data = malloc(pos > 0 ? pos : 1);
+  e = data == NULL;
+  if (e == 0) {
+    *data_size_p = pos;
+    pos = 0;
+    for (tr_i = 0; tr_i < tb->tr_n; tr_i++) {
+      tr = tb->tr_l + tr_i;
+      len = strlen(tr->tr_term);
+      data[pos] = len;
+      memcpy(data + pos + 1, tr->tr_term, len);
+      memcpy(data + pos + 1 + len, &tr->tr_n, sizeof(int32_t));
+      memcpy(data + pos + 1 + len + sizeof(int32_t), tr->tr_post, sizeof(int32_t) * tr->tr_n);
+      pos += 1 + len + sizeof(int32_t) * (1 + tr->tr_n);
+    }
+    *data_p = data;
+  }
+  return e;
+}
+
+// the pending postings are loaded on demand
+static int ms_get_pend(struct MemorySurfer *ms)
+{
+  int e;
+  int32_t data_size;
+  char *pend_d;
+  e = 0;
+  if (ms->pend_n < 0) {
+    ms->pend_n = 0;
+    if (ms->sidx.si_pend_i >= 0) {
+      data_size = imf_get_size(&ms->imf, ms->sidx.si_pend_i);
+      e = data_size < 0;
+      if (e == 0 && data_size > 0) {
+        pend_d = realloc(ms->pend_d, data_size);
+        e = pend_d == NULL;
+        if (e == 0) {
+          ms->pend_d = pend_d;
+          ms->pend_a = data_size;
+          e = imf_get(&ms->imf, ms->sidx.si_pend_i, ms->pend_d);
           if (e == 0) {
-            card_i = xml->cardlist_l[parent_cat_i].card_a - 1;
-            xml->cardlist_l[parent_cat_i].card_l[card_i].card_time = 0;
-            xml->cardlist_l[parent_cat_i].card_l[card_i].card_strength = 60;
-            xml->cardlist_l[parent_cat_i].card_l[card_i].card_qai = -1;
-            xml->cardlist_l[parent_cat_i].card_l[card_i].card_state = STATE_NEW;
+            ms->pend_n = data_size;
           }
-          break;
-        case TAG_TIME:
-          memset(&bd_time, 0, sizeof(bd_time));
-          str = xml->p_lineptr;
-          str[nread - 1] = '\0';
-          a_n = sscanf(str, "%d-%d-%dT%d:%d:%d",
-              &bd_time.tm_year, &bd_time.tm_mon, &bd_time.tm_mday,
-              &bd_time.tm_hour, &bd_time.tm_min, &bd_time.tm_sec);
-          e = a_n != 6;
+        }
+      }
+    }
+  }
+  return e;
+}
+
+// reads the pending posting at *pos_p into term and *qai_p, *pos_p is advanced to the next one
+static int pend_next(struct MemorySurfer *ms, int32_t *pos_p, char *term, int32_t *qai_p)
+{
+  int e;
+  int32_t pos;
+  int len;
+  pos = *pos_p;
+  e = pos + (int32_t)sizeof(int32_t) + 1 > ms->pend_n ? E_CRRPT : 0;
+  if (e == 0) {
+    memcpy(qai_p, ms->pend_d + pos, sizeof(int32_t));
+    len = (uint8_t)ms->pend_d[pos + sizeof(int32_t)];
+    e = len == 0 || len > SI_TERM_MAX || pos + (int32_t)sizeof(int32_t) + 1 + len > ms->pend_n ? E_CRRPT : 0;
+    if (e == 0) {
+      memcpy(term, ms->pend_d + pos + sizeof(int32_t) + 1, len);
+      term[len] = '\0';
+      *pos_p = pos + sizeof(int32_t) + 1 + len;
+    }
+  }
+  return e;
+}
+
+// replays the pending postings of bucket b on the bucket as stored
+static int tb_replay(struct MemorySurfer *ms, int b, struct TermBucket *tb)
+{
+  int e;
+  int32_t pos;
+  int32_t qai;
+  char term[SI_TERM_MAX + 1];
+  e = ms_get_pend(ms);
+  pos = 0;
+  while (pos < ms->pend_n && e == 0) {
+    e = pend_next(ms, &pos, term, &qai);
+    if (e == 0 && si_hash(term) == b) {
+      if (qai >= 0) {
+        e = tb_add(tb, term, qai);
+      } else {
+        tb_remove(tb, term, ~qai);
+      }
+    }
+  }
+  return e;
+}
+
+static int ms_get_bucket(struct MemorySurfer *ms, int b, struct TermBucket **tb_p)
+{
+  int e;
+  int i;
+  int32_t data_size;
+  char *data;
+  struct TermBucket *tb;
+  e = 0;
+  if (ms->tb_l == NULL) {
+    ms->tb_l = malloc(sizeof(struct TermBucket) * SI_BUCKETS);
+    e = ms->tb_l == NULL;
+    if (e == 0) {
+      for (i = 0; i < SI_BUCKETS; i++) {
+        ms->tb_l[i].tr_l = NULL;
+        ms->tb_l[i].tr_n = 0;
+        ms->tb_l[i].tr_a = 0;
+        ms->tb_l[i].tb_state = -1;
+      }
+    }
+  }
+  if (e == 0) {
+    tb = ms->tb_l + b;
+    if (tb->tb_state < 0) {
+      if (ms->sidx.si_bucket[b] >= 0) {
+        data_size = imf_get_size(&ms->imf, ms->sidx.si_bucket[b]);
+        e = data_size < 0;
+        if (e == 0 && data_size > 0) {
+          data = malloc(data_size);
+          e = data == NULL;
           if (e == 0) {
-            bd_time.tm_mon -= 1;
-            bd_time.tm_year -= 1900;
-            simple_time = timegm(&bd_time);
-            e = simple_time == -1;
+            e = imf_get(&ms->imf, ms->sidx.si_bucket[b], data);
             if (e == 0) {
-              card_i = xml->cardlist_l[parent_cat_i].card_a - 1;
-              xml->cardlist_l[parent_cat_i].card_l[card_i].card_time = simple_time;
+              e = tb_load(tb, data, data_size);
             }
+            free(data);
           }
-          break;
-        case TAG_STRENGTH:
-          str = xml->p_lineptr;
-          str[nread - 1] = '\0';
-          card_i = xml->cardlist_l[parent_cat_i].card_a - 1;
-          a_n = sscanf(str, "%d", &xml->cardlist_l[parent_cat_i].card_l[card_i].card_strength);
-          e = a_n != 1;
-          break;
-        case TAG_STATE:
-          str = xml->p_lineptr;
-          i = str[0] - '0';
-          e = i > 3;
-          if (e == 0) {
-            card_i = xml->cardlist_l[parent_cat_i].card_a - 1;
-            xml->cardlist_l[parent_cat_i].card_l[card_i].card_state = (xml->cardlist_l[parent_cat_i].card_l[card_i].card_state & 0x08) | i;
-          }
-          break;
-        case TAG_TYPE:
-          str = xml->p_lineptr;
-          i = str[0] - '0';
-          e = i > 1;
-          if (e == 0) {
-            i <<= 3;
-            card_i = xml->cardlist_l[parent_cat_i].card_a - 1;
-            xml->cardlist_l[parent_cat_i].card_l[card_i].card_state = (xml->cardlist_l[parent_cat_i].card_l[card_i].card_state & 0x07) | i;
-          }
-          break;
-        case TAG_QUESTION:
-          str = xml->p_lineptr;
-          str[nread - 1] = '\0';
-          e = xml_unescape(str);
-          if (e == 0)
-            e = sa_set(&wms->ms.card_sa, 0, str);
-          break;
-        case TAG_ANSWER:
-          str = xml->p_lineptr;
-          str[nread - 1] = '\0';
-          e = xml_unescape(str);
-          if (e == 0)
-            e = sa_set(&wms->ms.card_sa, 1, str);
-          break;
         }
       }
       if (e == 0) {
-        nread = dummy_getdelim(&xml->p_lineptr, &xml->n, '>', xml->xml_stream);
-        e = nread <= 0;
-        if (e == 0) {
-          str = xml->p_lineptr;
-          len = nread - 1;
-          slash_f = str[0] == '/';
-          if (slash_f) {
-            str++;
-            len--;
+        e = tb_replay(ms, b, tb);
+      }
+      if (e == 0) {
+        tb->tb_state = 0; // the bucket with its pending postings
+      }
+    }
+    *tb_p = tb;
+  }
+  return e;
+}
+
+static const char *HTML_BLOCK[] = { "address", "article", "aside", "blockquote", "br", "dd", "div", "dl", "dt", "figcaption", "figure", "footer", "h1", "h2", "h3", "h4", "h5", "h6", "header", "hr", "li", "main", "nav", "ol", "p", "pre", "section", "table", "td", "th", "tr", "ul" };
+
+// the UTF-8 bytes of a character reference ("&amp;", "&#228;", "&#xe4;") at s[0] written to vis, returns the
+// bytes of s it takes or 0 if s[0] isn't one (never fewer than written)
+static int html_char_ref(const char *s, char *vis, int *vis_n)
+{
+  int n;
+  int i;
+  uint32_t cp;
+  char *end;
+  n = 0;
+  *vis_n = 0;
+  if (s[1] == '#') {
+    if (s[2] == 'x' || s[2] == 'X') {
+      cp = strtoul(s + 3, &end, 16);
+      i = s[3] != '\0' && strchr("0123456789abcdefABCDEF", s[3]) != NULL;
+    } else {
+      cp = strtoul(s + 2, &end, 10);
+      i = s[2] >= '0' && s[2] <= '9';
+    }
+    if (i != 0 && *end == ';' && end - s <= 10 && cp > 0 && cp <= 0x10ffff && (cp < 0xd800 || cp > 0xdfff)) {
+      n = end + 1 - s;
+      if (cp < 0x80) {
+        vis[(*vis_n)++] = cp;
+      } else {
+        i = cp < 0x800 ? 1 : cp < 0x10000 ? 2 : 3;
+        vis[(*vis_n)++] = (0xff00 >> (i + 1) & 0xff) | cp >> (6 * i);
+        while (i-- > 0) {
+          vis[(*vis_n)++] = 0x80 | (cp >> (6 * i) & 0x3f);
+        }
+      }
+    }
+  } else if (strncmp(s, "&amp;", 5) == 0) {
+    n = 5;
+    vis[(*vis_n)++] = '&';
+  } else if (strncmp(s, "&lt;", 4) == 0 || strncmp(s, "&gt;", 4) == 0) {
+    n = 4;
+    vis[(*vis_n)++] = s[1] == 'l' ? '<' : '>';
+  } else if (strncmp(s, "&quot;", 6) == 0 || strncmp(s, "&apos;", 6) == 0) {
+    n = 6;
+    vis[(*vis_n)++] = s[1] == 'q' ? '"' : '\'';
+  } else if (strncmp(s, "&nbsp;", 6) == 0) {
+    n = 6;
+    vis[(*vis_n)++] = ' ';
+  } else if (strncmp(s, "&shy;", 5) == 0) {
+    n = 5;
+  }
+  return n;
+}
+
+// the text a browser shows for an HTML string: tags are dropped (block level ones leave a line break), so are
+// comments and the content of script and style elements, character references are decoded;
+// vis takes as many bytes as html at most, returns the length of the visible text
+static int html_visible(const char *html, char *vis)
+{
+  int i;
+  int w;
+  int j;
+  int n;
+  int k;
+  int is_end;
+  char name[12];
+  const char *end;
+  i = 0;
+  w = 0;
+  while (html[i] != '\0') {
+    n = 0;
+    if (html[i] == '<') {
+      is_end = html[i + 1] == '/';
+      j = i + 1 + is_end;
+      while (n < sizeof(name) - 1 && ((html[j + n] >= 'a' && html[j + n] <= 'z') || (html[j + n] >= 'A' && html[j + n] <= 'Z') || (html[j + n] >= '0' && html[j + n] <= '9'))) {
+        name[n] = lower_map[(uint8_t)html[j + n]];
+        n++;
+      }
+      name[n] = '\0';
+      if (strncmp(html + i, "<!--", 4) == 0) {
+        end = strstr(html + i + 4, "-->");
+        i = end != NULL ? end + 3 - html : strlen(html);
+        n = 1;
+      } else if (n > 0 && (html[j] < '0' || html[j] > '9')) {
+        end = strchr(html + j + n, '>');
+        i = end != NULL ? end + 1 - html : strlen(html);
+        for (k = 0; k < sizeof(HTML_BLOCK) / sizeof(HTML_BLOCK[0]); k++) {
+          if (strcmp(name, HTML_BLOCK[k]) == 0 && w > 0 && vis[w - 1] != '\n') {
+            vis[w++] = '\n';
           }
-          switch (len) {
-          case 12:
-            e = memcmp(str, "memorysurfer", 12) != 0;
-            if (e == 0) {
-              if (slash_f == 0) {
-                e = tag != TAG_ROOT;
-                if (e == 0)
-                  e = parse_xml(xml, wms, TAG_MEMORYSURFER, parent_cat_i);
+        }
+        if (is_end == 0 && (strcmp(name, "script") == 0 || strcmp(name, "style") == 0)) {
+          do {
+            end = strstr(html + i, "</");
+            i = end != NULL ? end + 2 - html : strlen(html);
+            for (k = 0; k < n && end != NULL; k++) {
+              if (lower_map[(uint8_t)html[i + k]] != (uint8_t)name[k]) {
+                end = NULL;
               }
-              else
-                e = tag != TAG_MEMORYSURFER;
             }
-            break;
-          case 8:
-            if (memcmp(str, "strength", 8) == 0) {
-              if (slash_f == 0) {
-                e = tag != TAG_CARD;
-                if (e == 0) {
-                  e = parse_xml(xml, wms, TAG_STRENGTH, parent_cat_i);
-                }
-              } else {
-                e = tag != TAG_STRENGTH;
-              }
-            } else {
-              e = memcmp(str, "question", 8) != 0;
-              if (e == 0) {
-                if (slash_f == 0) {
-                  e = tag != TAG_CARD;
-                  if (e == 0)
-                    e = parse_xml(xml, wms, TAG_QUESTION, parent_cat_i);
-                } else
-                  e = tag != TAG_QUESTION;
-              }
-            }
-            break;
-          case 6:
-            e = memcmp(str, "answer", 6) != 0;
-            if (e == 0) {
-              if (slash_f == 0) {
-                e = tag != TAG_CARD;
-                if (e == 0) {
-                  e = parse_xml(xml, wms, TAG_ANSWER, parent_cat_i);
-                }
-              } else {
-                e = tag != TAG_ANSWER;
-              }
-            }
-            break;
-          case 5:
-            if (memcmp(str, "state", 5) == 0) {
-              if (slash_f == 0) {
-                e = tag != TAG_CARD;
-                if (e == 0) {
-                  e = parse_xml(xml, wms, TAG_STATE, parent_cat_i);
-                }
-              } else {
-                e = tag != TAG_STATE;
-              }
-            } else {
-              e = memcmp(str, "style", 5) != 0;
-              if (e == 0) {
-                if (slash_f == 0) {
-                  e = tag != TAG_DECK;
-                  if (e == 0) {
-                    e = parse_xml(xml, wms, TAG_STYLE, deck_i);
-                  }
-                } else {
-                  e = tag != TAG_STYLE;
-                }
-              }
-            }
-            break;
-          case 4:
-            if (memcmp(str, "card", 4) == 0) {
-              if (slash_f == 0) {
-                e = tag != TAG_DECK;
-                if (e == 0)
-                  e = parse_xml(xml, wms, TAG_CARD, deck_i);
-              } else {
-                e = tag != TAG_CARD;
-                if (e == 0) {
-                  e = imf_seek_unused(&wms->ms.imf, &index);
-                  if (e == 0) {
-                    data_size = sa_length(&wms->ms.card_sa);
-                    e = imf_put(&wms->ms.imf, index, wms->ms.card_sa.sa_d, data_size);
-                    if (e == 0) {
-                      card_i = xml->cardlist_l[parent_cat_i].card_a - 1;
-                      xml->cardlist_l[parent_cat_i].card_l[card_i].card_qai = index;
-                      wms->card_n++;
-                    }
-                  }
-                }
-              }
-            } else if (memcmp(str, "time", 4) == 0) {
-              if (slash_f == 0) {
-                e = tag != TAG_CARD;
-                if (e == 0) {
-                  e = parse_xml(xml, wms, TAG_TIME, parent_cat_i);
-                }
-              } else {
-                e = tag != TAG_TIME;
-              }
-            } else if (memcmp(str, "type", 4) == 0) {
-              if (slash_f == 0) {
-                e = tag != TAG_CARD;
-                if (e == 0) {
-                  e = parse_xml(xml, wms, TAG_TYPE, parent_cat_i);
-                }
-              } else {
-                e = tag != TAG_TYPE;
-              }
-            } else if (memcmp(str, "name", 4) == 0) {
-              if (slash_f == 0) {
-                e = tag != TAG_DECK;
-                if (e == 0)
-                  e = parse_xml(xml, wms, TAG_NAME, deck_i);
-              } else
-                e = tag != TAG_NAME;
-            } else {
-              e = memcmp(str, "deck", 4) != 0;
-              if (e == 0) {
-                if (slash_f == 0) {
-                  e = tag != TAG_MEMORYSURFER && tag != TAG_DECK;
-                  if (e == 0)
-                    e = parse_xml(xml, wms, TAG_DECK, deck_i);
-                } else {
-                  e = tag != TAG_DECK;
-                  if (e == 0) {
-                    assert(deck_i >= 0);
-                    e = imf_seek_unused(&wms->ms.imf, &index);
-                    if (e == 0) {
-                      assert(xml->cardlist_l[deck_i].card_a >= 0);
-                      data_size = xml->cardlist_l[deck_i].card_a * sizeof(struct Card);
-                      assert(xml->cardlist_l[deck_i].card_l != NULL || xml->cardlist_l[deck_i].card_a == 0);
-                      e = imf_put(&wms->ms.imf, index, xml->cardlist_l[deck_i].card_l, data_size);
-                      if (e == 0) {
-                        wms->ms.cat_t[deck_i].cat_cli = index;
-                        free(xml->cardlist_l[deck_i].card_l);
-                        xml->cardlist_l[deck_i].card_l = NULL;
-                        xml->cardlist_l[deck_i].card_a = 0;
-                        wms->deck_n++;
-                      }
-                    }
-                    xml->prev_cat_i = deck_i;
-                  }
-                }
-              }
-            }
-            break;
-          default:
-            e = E_PXML; // tag length undefined
-            break;
-          }
+          } while (end == NULL && html[i] != '\0');
+          end = strchr(html + i, '>');
+          i = end != NULL ? end + 1 - html : strlen(html);
         }
+      } else {
+        n = 0; // no tag
       }
-    } else if (tag == TAG_ROOT && parent_cat_i == -1) {
-      wms->msg_header = "No or Empty XML data";
-      wms->msg_btn_main = "OK";
-      wms->todo_main = S_WARN_UPLOAD;
-      wms->page = P_MSG;
+    } else if (html[i] == '&') {
+      n = html_char_ref(html + i, vis + w, &k);
+      i += n;
+      w += k;
     }
-  } while (slash_f == 0 && e == 0 && tag != TAG_ROOT);
-  return e;
+    if (n == 0) {
+      vis[w++] = html[i++];
+    }
+  }
+  vis[w] = '\0';
+  return w;
 }
 
-static int sa_load(struct StringArray *sa, struct IndexedMemoryFile *imf, int32_t index)
+// the visible text of the strings of a card (the same layout: '\0' terminated strings)
+static int sa_visible(const char *data, int32_t data_n, char **vis_d, int32_t *vis_n)
 {
   int e;
-  int32_t data_size;
-  int pos_c; // count
-  char *sa_d;
-  data_size = imf_get_size(imf, index);
-  e = 0;
-  if (sa->sa_n < data_size) {
-    sa_d = realloc(sa->sa_d, data_size);
-    e = sa_d == NULL;
-    if (e == 0) {
-      sa->sa_d = sa_d;
-      sa->sa_n = data_size;
-    }
-  }
+  int32_t rp;
+  int32_t wp;
+  char *vis;
+  vis = malloc(data_n + 1);
+  e = vis == NULL;
   if (e == 0) {
-    e = imf_get(imf, index, sa->sa_d);
-    if (e == 0) {
-      sa->sa_c = 0;
-      pos_c = 0;
-      while (pos_c < data_size) {
-        sa->sa_c += !sa->sa_d[pos_c++];
-      }
+    rp = 0;
+    wp = 0;
+    while (rp < data_n) {
+      wp += html_visible(data + rp, vis + wp) + 1;
+      rp += strlen(data + rp) + 1;
     }
+    *vis_d = vis;
+    *vis_n = wp;
   }
   return e;
 }
 
-static int ms_open(struct MemorySurfer *ms)
+// the map of the visible text chunks, sorted by card_qai, is loaded on demand
+static int ms_get_vis(struct MemorySurfer *ms)
 {
   int e;
-  int i;
   int32_t data_size;
-  int16_t n_prev;
-  e = ms->imf_filename == NULL || ms->cat_t != NULL || ms->deck_a != 0 || ms->n_first != -1 ? E_ASSRT_1 : 0;
-  if (e == 0) {
-    e = imf_open(&ms->imf, ms->imf_filename);
-    if (e == 0) {
-      e = sa_load(&ms->deck_sa, &ms->imf, SA_INDEX);
-      if (e == 0) {
-        data_size = imf_get_size(&ms->imf, C_INDEX);
-        assert(ms->cat_t == NULL);
-        if (data_size > 0) {
-          ms->cat_t = malloc(data_size);
-          e = ms->cat_t == NULL;
-        }
+  e = 0;
+  if (ms->vt_n < 0) {
+    ms->vt_n = 0;
+    if (ms->sidx.si_vis_i >= 0) {
+      data_size = imf_get_size(&ms->imf, ms->sidx.si_vis_i);
+      e = data_size < 0 || data_size % sizeof(struct VisibleText) != 0;
+      if (e == 0 && data_size > 0) {
+        ms->vt_l = realloc(ms->vt_l, data_size);
+        e = ms->vt_l == NULL;
         if (e == 0) {
-          assert(ms->deck_a == 0);
-          ms->deck_a = data_size / sizeof(struct Deck);
-          e = imf_get(&ms->imf, C_INDEX, ms->cat_t);
+          e = imf_get(&ms->imf, ms->sidx.si_vis_i, ms->vt_l);
           if (e == 0) {
-            do {
-              n_prev = -1;
-              for (i = 0; i < ms->deck_a && n_prev == -1; i++)
-                if (ms->cat_t[i].deck_slot_used != 0)
-                  if (ms->cat_t[i].n_sibling == ms->n_first || ms->cat_t[i].n_child == ms->n_first)
-                    n_prev = i;
-              if (n_prev != -1) {
-                e = n_prev == ms->n_first;
-                if (e == 0) {
-                  ms->n_first = n_prev;
-                } else {
-                  e = E_CRRPT; // decks hierarchy (is) corrupted
-                }
-              }
-            }
-            while (n_prev != -1 && e == 0);
+            ms->vt_n = data_size / sizeof(struct VisibleText);
+            ms->vt_a = ms->vt_n;
           }
         }
       }
@@ -1123,1407 +1807,1556 @@ static int ms_open(struct MemorySurfer *ms)
   return e;
 }
 
-static int scan_hex(uint8_t *data, char *str, size_t count)
+// the position of the map entry of qai, or where it goes
+static int vt_find(struct MemorySurfer *ms, int32_t qai, int *found)
+{
+  int lo;
+  int hi;
+  int mid;
+  lo = 0;
+  hi = ms->vt_n;
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (ms->vt_l[mid].vt_qai < qai) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  *found = lo < ms->vt_n && ms->vt_l[lo].vt_qai == qai;
+  return lo;
+}
+
+// the chunk that search reads for a card: its visible text when it has one
+static int ms_text_index(struct MemorySurfer *ms, int32_t qai, int is_html, int32_t *tai)
 {
   int e;
-  int i;
-  char ch;
-  int nibble[2];
+  int pos;
+  int found;
   e = 0;
-  while (count-- && e == 0) {
-    i = 2;
-    while (i--) {
-      ch = str[count * 2 + i];
-      if (ch >= 'a' && ch <= 'f') {
-        nibble[i] = ch - 'a' + 10;
-      } else if (ch >= '0' && ch <= '9') {
-        nibble[i] = ch - '0';
-      } else {
-        e = E_HEX;
+  *tai = qai;
+  if (is_html != 0 && ms->sidx_state >= 0) {
+    e = ms_get_vis(ms);
+    if (e == 0) {
+      pos = vt_find(ms, qai, &found);
+      if (found != 0) {
+        *tai = ms->vt_l[pos].vt_vti;
       }
     }
-    data[count] = nibble[0] << 4 | nibble[1];
   }
   return e;
 }
 
-struct Parse {
-  enum Field field;
-};
-
-static int determine_field(struct Multi *mult, struct Parse *parse)
+// stores the visible text of a card (vis_d == NULL drops it)
+static int ms_put_vis(struct MemorySurfer *ms, int32_t qai, char *vis_d, int32_t vis_n)
 {
   int e;
-  e = mult->post_fp <= 0;
+  int pos;
+  int found;
+  int32_t index;
+  e = ms_get_vis(ms);
   if (e == 0) {
-    switch (mult->post_fp) {
-    case 1:
-      if (memcmp(mult->post_lp, "q", 1) == 0) {
-        parse->field = F_Q;
-      } else {
-        e = memcmp(mult->post_lp, "a", 1) != 0;
+    pos = vt_find(ms, qai, &found);
+    if (vis_d != NULL) {
+      if (found == 0) {
+        e = imf_seek_unused(&ms->imf, &index);
+        if (e == 0 && ms->vt_n == ms->vt_a) {
+          ms->vt_a = ms->vt_a * 2 + 16;
+          ms->vt_l = realloc(ms->vt_l, sizeof(struct VisibleText) * ms->vt_a);
+          e = ms->vt_l == NULL;
+        }
         if (e == 0) {
-          parse->field = F_A;
+          memmove(ms->vt_l + pos + 1, ms->vt_l + pos, sizeof(struct VisibleText) * (ms->vt_n - pos));
+          ms->vt_l[pos].vt_qai = qai;
+          ms->vt_l[pos].vt_vti = index;
+          ms->vt_n++;
+          ms->vt_mod = 1;
         }
       }
-      break;
-    case 3:
-      e = memcmp(mult->post_lp, "lvl", 3) != 0;
       if (e == 0) {
-        parse->field = F_LVL;
+        e = imf_put(&ms->imf, ms->vt_l[pos].vt_vti, vis_d, vis_n);
       }
-      break;
-    case 4:
-      if (memcmp(mult->post_lp, "deck", 4) == 0) {
-        parse->field = F_DECK;
-      } else if (memcmp(mult->post_lp, "page", 4) == 0) {
-        parse->field = F_PAGE;
-      } else if (memcmp(mult->post_lp, "card", 4) == 0) {
-        parse->field = F_CARD;
-      } else if (memcmp(mult->post_lp, "mode", 4) == 0) {
-        parse->field = F_MODE;
-      } else if (memcmp(mult->post_lp, "mctr", 4) == 0) {
-        parse->field = F_MCTR;
-      } else {
-        e = memcmp(mult->post_lp, "rank", 4) != 0;
-        if (e == 0) {
-          parse->field = F_RANK;
-        }
+    } else if (found != 0) {
+      e = imf_delete(&ms->imf, ms->vt_l[pos].vt_vti);
+      if (e == 0) {
+        ms->vt_n--;
+        memmove(ms->vt_l + pos, ms->vt_l + pos + 1, sizeof(struct VisibleText) * (ms->vt_n - pos));
+        ms->vt_mod = 1;
       }
-      break;
-    case 5:
-      if (memcmp(mult->post_lp, "event", 5) == 0) {
-        parse->field = F_EVENT;
-      } else if (memcmp(mult->post_lp, "token", 5) == 0) {
-        parse->field = F_TOKEN;
-      } else if (memcmp(mult->post_lp, "scope", 5) == 0) {
-        parse->field = F_SCOPE;
-      } else {
-        e = memcmp(mult->post_lp, "mtime", 5) != 0;
+    }
+  }
+  return e;
+}
+
+// adds a posting (qai) or removes it (~qai): in the bucket when it is loaded, else it is recorded as pending so an
+// edit doesn't rewrite the buckets of all its trigrams (folded by ms_put_index once SI_PEND_MAX is exceeded)
+static int ms_post(struct MemorySurfer *ms, const char *term, int32_t qai)
+{
+  int e;
+  int b;
+  int len;
+  int32_t size;
+  char *pend_d;
+  e = 0;
+  b = si_hash(term);
+  if (ms->tb_l != NULL && ms->tb_l[b].tb_state >= 0) {
+    if (qai >= 0) {
+      e = tb_add(ms->tb_l + b, term, qai);
+    } else {
+      tb_remove(ms->tb_l + b, term, ~qai);
+    }
+  } else {
+    e = ms_get_pend(ms);
+    if (e == 0) {
+      len = strlen(term);
+      size = sizeof(int32_t) + 1 + len;
+      if (ms->pend_n + size > ms->pend_a) {
+        pend_d = realloc(ms->pend_d, ms->pend_a * 2 + size + 256);
+        e = pend_d == NULL;
         if (e == 0) {
-          parse->field = F_MTIME;
+          ms->pend_d = pend_d;
+          ms->pend_a = ms->pend_a * 2 + size + 256;
         }
       }
-      break;
-    case 6:
-      e = memcmp(mult->post_lp, "upload", 6) != 0;
       if (e == 0) {
-        parse->field = F_UPLOAD;
+        memcpy(ms->pend_d + ms->pend_n, &qai, sizeof(int32_t));
+        ms->pend_d[ms->pend_n + sizeof(int32_t)] = len;
+        memcpy(ms->pend_d + ms->pend_n + sizeof(int32_t) + 1, term, len);
+        ms->pend_n += size;
+        ms->pend_mod = 1;
       }
-      break;
-    case 7:
-      if (memcmp(mult->post_lp, "is-html", 7) == 0) {
-        parse->field = F_IS_HTML;
-      } else if (memcmp(mult->post_lp, "arrange", 7) == 0) {
-        parse->field = F_ARRANGE;
-      } else {
-        e = memcmp(mult->post_lp, "timeout", 7) != 0;
-        if (e == 0) {
-          parse->field = F_TIMEOUT;
-        }
-      }
-      break;
-    case 8:
-      if (memcmp(mult->post_lp, "mov-card", 8) == 0) {
-        parse->field = F_MOV_CARD;
-      } else if (memcmp(mult->post_lp, "mov-deck", 8) == 0) {
-        parse->field = F_MOVED_CAT;
-      } else {
-        e = memcmp(mult->post_lp, "password", 8) != 0;
-        if (e == 0) {
-          parse->field = F_PASSWORD;
+    }
+  }
+  return e;
+}
+
+// updates the postings of a card from the terms of its old to the terms of its new text (both may be empty), the
+// visible text of an HTML card is indexed instead of the markup and stored for search
+static int ms_index_card(struct MemorySurfer *ms, int32_t qai, const char *old_d, int32_t old_n, int old_html, const char *new_d, int32_t new_n, int new_html)
+{
+  int e;
+  int i;
+  int j;
+  int cmp;
+  struct TermSet ts[2];
+  char *vis_d[2];
+  int32_t vis_n[2];
+  e = 0;
+  vis_d[0] = NULL;
+  vis_d[1] = NULL;
+  if (ms->sidx_state >= 0) {
+    if (old_html != 0 && old_n > 0) {
+      e = sa_visible(old_d, old_n, vis_d + 0, vis_n + 0);
+      old_d = vis_d[0];
+      old_n = vis_n[0];
+    }
+    if (e == 0 && new_html != 0 && new_n > 0) {
+      e = sa_visible(new_d, new_n, vis_d + 1, vis_n + 1);
+      new_d = vis_d[1];
+      new_n = vis_n[1];
+    }
+    if (e == 0) {
+      e = ts_split(ts + 0, old_d, old_n);
+    }
+    if (e == 0) {
+      e = ts_split(ts + 1, new_d, new_n);
+      if (e == 0) {
+        i = 0;
+        j = 0;
+        while ((i < ts[0].ts_n || j < ts[1].ts_n) && e == 0) {
+          if (i == ts[0].ts_n) {
+            cmp = 1;
+          } else if (j == ts[1].ts_n) {
+            cmp = -1;
+          } else {
+            cmp = strcmp(ts[0].ts_l[i], ts[1].ts_l[j]);
+          }
+          if (cmp < 0) {
+            e = ms_post(ms, ts[0].ts_l[i], ~qai);
+            i++;
+          } else if (cmp > 0) {
+            e = ms_post(ms, ts[1].ts_l[j], qai);
+            j++;
+          } else {
+            i++;
+            j++;
+          }
         }
-      }
-      break;
-    case 9:
-      if (memcmp(mult->post_lp, "deck-name", 9) == 0) {
-        parse->field = F_DECK_NAME;
-      } else if (memcmp(mult->post_lp, "style-txt", 9) == 0) {
-        parse->field = F_STYLE_TXT;
-      } else {
-        e = memcmp(mult->post_lp, "todo_main", 9) != 0;
         if (e == 0) {
-          parse->field = F_TODO_MAIN;
+          ms->sidx_state = 1;
         }
+        ts_free(ts + 1);
       }
-      break;
-    case 10:
-      if (memcmp(mult->post_lp, "file-title", 10) == 0) {
-        parse->field = F_FILE_TITLE;
-      } else if (memcmp(mult->post_lp, "search-txt", 10) == 0) {
-        parse->field = F_SEARCH_TXT;
-      } else if (memcmp(mult->post_lp, "match-case", 10) == 0) {
-        parse->field = F_MATCH_CASE;
-      } else {
-        e = memcmp(mult->post_lp, "reveal-pos", 10) != 0;
+      ts_free(ts + 0);
+    }
+    if (e == 0 && (old_html != 0 || new_html != 0)) {
+      e = ms_put_vis(ms, qai, vis_d[1], vis_n[1]);
+    }
+    free(vis_d[0]);
+    free(vis_d[1]);
+  }
+  return e;
+}
+
+// adds (or removes, when the chunk is about to be deleted) the postings of a stored card
+static int ms_index_chunk(struct MemorySurfer *ms, int32_t qai, int add, int is_html)
+{
+  int e;
+  int32_t data_size;
+  char *data;
+  e = 0;
+  if (ms->sidx_state >= 0) {
+    data_size = imf_get_size(&ms->imf, qai);
+    e = data_size < 0;
+    if (e == 0 && data_size > 0) {
+      data = malloc(data_size);
+      e = data == NULL;
+      if (e == 0) {
+        e = imf_get(&ms->imf, qai, data);
         if (e == 0) {
-          parse->field = F_REVEAL_POS;
+          if (add != 0) {
+            e = ms_index_card(ms, qai, NULL, 0, 0, data, data_size, is_html);
+          } else {
+            e = ms_index_card(ms, qai, data, data_size, is_html, NULL, 0, 0);
+          }
         }
+        free(data);
       }
-      break;
-    case 11:
-      e = memcmp(mult->post_lp, "is-unlocked", 11) != 0;
-      if (e == 0)
-        parse->field = F_IS_UNLOCKED;
-      break;
-    case 12:
-      e = memcmp(mult->post_lp, "new-password", 12) != 0;
-      if (e == 0) {
-        parse->field = F_NEW_PASSWORD;
-      }
-      break;
-    default:
-      e = E_POST; // malformed form data
-      break;
     }
   }
   return e;
 }
 
-static int parse_field(struct WebMemorySurfer *wms, struct Multi *mult, struct Parse *parse)
+// drops all postings, the index is valid and empty afterwards
+static void ms_free_index(struct MemorySurfer *ms)
+{
+  int b;
+  if (ms->tb_l != NULL) {
+    for (b = 0; b < SI_BUCKETS; b++) {
+      tb_clear(ms->tb_l + b);
+      free(ms->tb_l[b].tr_l);
+    }
+    free(ms->tb_l);
+    ms->tb_l = NULL;
+  }
+  free(ms->vt_l);
+  ms->vt_l = NULL;
+  ms->vt_n = -1;
+  ms->vt_a = 0;
+  ms->vt_mod = 0;
+  free(ms->pend_d);
+  ms->pend_d = NULL;
+  ms->pend_n = -1;
+  ms->pend_a = 0;
+  ms->pend_mod = 0;
+  ms->sidx_state = -1;
+  for (b = 0; b < SI_BUCKETS; b++) {
+    ms->sidx.si_bucket[b] = -1;
+  }
+  ms->sidx.si_vis_i = -1;
+  ms->sidx.si_pend_i = -1;
+}
+
+static int ms_clear_index(struct MemorySurfer *ms)
 {
   int e;
-  int a_n; // assignments
-  int consumed_n;
-  int value;
-  size_t size;
-  int i;
+  int b;
+  struct TermBucket *tb;
   e = 0;
-  switch (parse->field) {
-  case F_FILE_TITLE:
-    e = wms->file_title_str != NULL ? E_RPOFT : 0; // repeated parse of file title
+  if (ms->sidx.si_pend_i >= 0) {
+    e = imf_delete(&ms->imf, ms->sidx.si_pend_i);
+    ms->sidx.si_pend_i = -1;
+  }
+  ms->pend_n = 0;
+  ms->pend_mod = 0;
+  for (b = 0; b < SI_BUCKETS && e == 0; b++) {
+    if (ms->sidx.si_bucket[b] >= 0) {
+      e = imf_delete(&ms->imf, ms->sidx.si_bucket[b]);
+      ms->sidx.si_bucket[b] = -1;
+    }
     if (e == 0) {
-      wms->file_title_str = malloc(mult->post_wp);
-      e = wms->file_title_str == NULL;
+      e = ms_get_bucket(ms, b, &tb);
       if (e == 0) {
-        assert(mult->post_lp[mult->post_fp] == '\0');
-        memcpy(wms->file_title_str, mult->post_lp, mult->post_wp);
-        e = percent2c(wms->file_title_str, mult->post_fp);
+        tb_clear(tb);
+        tb->tb_state = 0;
       }
     }
-    break;
-  case F_ARRANGE:
-    assert(wms->ms.arrange == -1);
-    a_n = sscanf(mult->post_lp, "%d", &wms->ms.arrange);
-    assert(wms->ms.arrange >= 0 && wms->ms.arrange <= 2);
-    e = a_n != 1;
-    break;
-  case F_DECK_NAME:
-    e = wms->ms.deck_name_str != NULL ? E_FIELD_1 : 0;
-    if (e == 0) {
-      wms->ms.deck_name_str = malloc(mult->post_wp);
-      e = wms->ms.deck_name_str == NULL ? E_FIELD_2 : 0;
-      if (e == 0) {
-        assert(mult->post_lp[mult->post_fp] == '\0');
-        memcpy(wms->ms.deck_name_str, mult->post_lp, mult->post_wp);
-        e = percent2c(wms->ms.deck_name_str, mult->post_fp) ? E_FIELD_3 : 0;
+  }
+  if (e == 0) {
+    e = ms_get_vis(ms);
+    for (b = 0; b < ms->vt_n && e == 0; b++) {
+      e = imf_delete(&ms->imf, ms->vt_l[b].vt_vti);
+    }
+    ms->vt_n = 0;
+    ms->vt_mod = 1;
+  }
+  if (e == 0) {
+    ms->sidx_state = 1;
+  }
+  return e;
+}
+
+static int ms_build_index(struct MemorySurfer *ms)
+{
+  int e;
+  int deck_i;
+  int card_i;
+  int32_t data_size;
+  struct Card *card_l;
+  e = ms_clear_index(ms);
+  card_l = NULL;
+  for (deck_i = 0; deck_i < ms->deck_a && e == 0; deck_i++) {
+    if (ms->cat_t[deck_i].deck_slot_used != 0) {
+      data_size = imf_get_size(&ms->imf, ms->cat_t[deck_i].cat_cli);
+      e = data_size < 0;
+      if (e == 0 && data_size > 0) {
+        card_l = realloc(card_l, data_size);
+        e = card_l == NULL;
+        if (e == 0) {
+          e = imf_get(&ms->imf, ms->cat_t[deck_i].cat_cli, card_l);
+          for (card_i = 0; card_i < data_size / sizeof(struct Card) && e == 0; card_i++) {
+            e = ms_index_chunk(ms, card_l[card_i].card_qai, 1, card_l[card_i].card_state & 0x08);
+          }
+        }
       }
     }
-    break;
-  case F_STYLE_TXT:
-    e = wms->ms.style_txt != NULL;
-    if (e == 0) {
-      wms->ms.style_txt = malloc(mult->post_wp);
-      e = wms->ms.style_txt == NULL;
-      if (e == 0) {
-        assert(mult->post_lp[mult->post_fp] == '\0');
-        memcpy(wms->ms.style_txt, mult->post_lp, mult->post_wp);
-        e = percent2c(wms->ms.style_txt, mult->post_fp);
+  }
+  free(card_l);
+  return e;
+}
+
+// hashes the staged cards in batches of XML_WORK_MIN while the parser stages more, the rest once staging is done
+static void *digest_staged(void *arg)
+{
+  struct XML *xml;
+  struct Sha1Context sha1;
+  void *data_l[XML_WORK_MIN];
+  int32_t size_l[XML_WORK_MIN];
+  uint8_t digest_l[SHA1_HASH_SIZE * XML_WORK_MIN];
+  int32_t k;
+  int32_t j;
+  int32_t n;
+  int e;
+  xml = arg;
+  pthread_mutex_lock(&xml->stage_mutex);
+  do {
+    while (xml->stage_done == 0 && xml->stage_c - xml->stage_next < XML_WORK_MIN) {
+      pthread_cond_wait(&xml->stage_cond, &xml->stage_mutex);
+    }
+    k = xml->stage_next;
+    n = xml->stage_c - k < XML_WORK_MIN ? xml->stage_c - k : XML_WORK_MIN;
+    if (n > 0) {
+      xml->stage_next += n;
+      memcpy(data_l, xml->stage_data_l + k, sizeof(void *) * n);
+      memcpy(size_l, xml->stage_size_l + k, sizeof(int32_t) * n);
+      pthread_mutex_unlock(&xml->stage_mutex);
+      e = 0;
+      for (j = 0; j < n && e == 0; j++) {
+        e = sha1_reset(&sha1);
+        if (e == 0) {
+          e = sha1_input(&sha1, data_l[j], size_l[j]);
+        }
+        if (e == 0) {
+          e = sha1_result(&sha1, digest_l + j * SHA1_HASH_SIZE);
+        }
+      }
+      pthread_mutex_lock(&xml->stage_mutex); // stage_hash_d may have been moved meanwhile
+      memcpy(xml->stage_hash_d + k * SHA1_HASH_SIZE, digest_l, SHA1_HASH_SIZE * n);
+      if (e != 0) {
+        xml->stage_e = e;
       }
     }
-    break;
-  case F_MOVED_CAT:
-    assert(wms->ms.mov_deck_i == -1);
-    a_n = sscanf(mult->post_lp, "%d", &wms->ms.mov_deck_i);
-    e = a_n != 1;
-    break;
-  case F_SCOPE:
-    e = wms->ms.scope != C_UNDEF ? E_SCOPE_1 : 0;
+  } while (n > 0);
+  pthread_mutex_unlock(&xml->stage_mutex);
+  return NULL;
+}
+
+static void xml_stage_init(struct XML *xml)
+{
+  long cpu_n;
+  xml->stage_block_l = NULL;
+  xml->stage_block_n = 0;
+  xml->stage_free = NULL;
+  xml->stage_left = 0;
+  xml->stage_data_l = NULL;
+  xml->stage_size_l = NULL;
+  xml->stage_hash_d = NULL;
+  xml->stage_digest_d = NULL;
+  xml->stage_c = 0;
+  xml->stage_ca = 0;
+  xml->stage_next = 0;
+  xml->stage_done = 0;
+  xml->stage_e = 0;
+  pthread_mutex_init(&xml->stage_mutex, NULL);
+  pthread_cond_init(&xml->stage_cond, NULL);
+  xml->stage_thread_n = 0;
+  cpu_n = sysconf(_SC_NPROCESSORS_ONLN);
+  xml->stage_thread_a = cpu_n - 1 < XML_THREADS ? cpu_n - 1 : XML_THREADS;
+}
+
+// ends staging: the parser hashes what is left along with the workers, which are joined
+static int xml_stage_end(struct XML *xml)
+{
+  int i;
+  pthread_mutex_lock(&xml->stage_mutex);
+  xml->stage_done = 1;
+  pthread_cond_broadcast(&xml->stage_cond);
+  pthread_mutex_unlock(&xml->stage_mutex);
+  digest_staged(xml);
+  for (i = 0; i < xml->stage_thread_n; i++) {
+    pthread_join(xml->stage_thread_l[i], NULL);
+  }
+  xml->stage_thread_n = 0;
+  return xml->stage_e;
+}
+
+static void xml_stage_free(struct XML *xml)
+{
+  int i;
+  pthread_mutex_lock(&xml->stage_mutex);
+  xml->stage_next = xml->stage_c; // not hashed when the import failed
+  pthread_mutex_unlock(&xml->stage_mutex);
+  xml_stage_end(xml);
+  for (i = 0; i < xml->stage_block_n; i++) {
+    free(xml->stage_block_l[i]);
+  }
+  free(xml->stage_block_l);
+  xml->stage_block_l = NULL;
+  xml->stage_block_n = 0;
+  free(xml->stage_data_l);
+  xml->stage_data_l = NULL;
+  free(xml->stage_size_l);
+  xml->stage_size_l = NULL;
+  free(xml->stage_hash_d);
+  xml->stage_hash_d = NULL;
+  free(xml->stage_digest_d);
+  xml->stage_digest_d = NULL;
+  pthread_cond_destroy(&xml->stage_cond);
+  pthread_mutex_destroy(&xml->stage_mutex);
+}
+
+// appends the payload of a parsed card to the staging area, with the digest it must have (or NULL); a worker is
+// started for each XML_WORK_MIN cards staged, up to stage_thread_a
+static int xml_stage(struct XML *xml, const char *data, int32_t data_size, const uint8_t *digest)
+{
+  int e;
+  size_t size;
+  int32_t stage_ca;
+  char **block_l;
+  void **data_l;
+  int32_t *size_l;
+  uint8_t *hash_d;
+  uint8_t *digest_d;
+  e = 0;
+  if (data_size > xml->stage_left) { // the parser alone uses the blocks
+    block_l = realloc(xml->stage_block_l, sizeof(char *) * (xml->stage_block_n + 1));
+    e = block_l == NULL;
     if (e == 0) {
-      a_n = sscanf(mult->post_lp, "%d%n", &wms->ms.scope, &consumed_n);
-      e = a_n != 1 || consumed_n != mult->post_fp || wms->ms.scope < C_CURRENT || wms->ms.scope > C_ALL ? E_SCOPE_2 : 0;
+      xml->stage_block_l = block_l;
+      size = data_size > XML_STAGE ? data_size : XML_STAGE;
+      xml->stage_free = malloc(size);
+      e = xml->stage_free == NULL;
+      xml->stage_left = e == 0 ? size : 0;
     }
-    break;
-  case F_SEARCH_TXT:
-    e = wms->ms.search_txt != NULL;
     if (e == 0) {
-      wms->ms.search_txt = malloc(mult->post_wp);
-      e = wms->ms.search_txt == NULL;
+      xml->stage_block_l[xml->stage_block_n++] = xml->stage_free;
+    }
+  }
+  if (e == 0) {
+    memcpy(xml->stage_free, data, data_size);
+    pthread_mutex_lock(&xml->stage_mutex);
+    if (xml->stage_c == xml->stage_ca) {
+      stage_ca = xml->stage_ca * 2 + 64;
+      data_l = realloc(xml->stage_data_l, sizeof(void *) * stage_ca);
+      e = data_l == NULL;
       if (e == 0) {
-        assert(mult->post_lp[mult->post_fp] == '\0');
-        memcpy(wms->ms.search_txt, mult->post_lp, mult->post_wp);
-        e = percent2c(wms->ms.search_txt, mult->post_fp);
+        xml->stage_data_l = data_l;
+        size_l = realloc(xml->stage_size_l, sizeof(int32_t) * stage_ca);
+        e = size_l == NULL;
       }
-    }
-    break;
-  case F_MATCH_CASE:
-    e = wms->ms.match_case != -1 || mult->post_fp != 2;
-    if (e == 0) {
-      e = memcmp(mult->post_lp, "on", 2) != 0;
       if (e == 0) {
-        wms->ms.match_case = 1;
+        xml->stage_size_l = size_l;
+        hash_d = realloc(xml->stage_hash_d, SHA1_HASH_SIZE * stage_ca);
+        e = hash_d == NULL;
       }
-    }
-    break;
-  case F_IS_HTML:
-    e = wms->ms.is_html != -1 || mult->post_fp != 2;
-    if (e == 0) {
-      e = memcmp(mult->post_lp, "on", 2) != 0;
       if (e == 0) {
-        wms->ms.is_html = 1;
+        xml->stage_hash_d = hash_d;
+        if (digest != NULL) {
+          digest_d = realloc(xml->stage_digest_d, SHA1_HASH_SIZE * stage_ca);
+          e = digest_d == NULL;
+          if (e == 0) {
+            xml->stage_digest_d = digest_d;
+          }
+        }
       }
-    }
-    break;
-  case F_IS_UNLOCKED:
-    e = wms->ms.is_unlocked != -1 || mult->post_fp != 2;
-    if (e == 0) {
-      e = memcmp(mult->post_lp, "on", 2) != 0;
       if (e == 0) {
-        wms->ms.is_unlocked = 1;
+        xml->stage_ca = stage_ca;
       }
     }
-    break;
-  case F_DECK:
-    a_n = sscanf(mult->post_lp, "%d%n", &value, &consumed_n);
-    size = DATA_SIZE_MAX / sizeof(struct Deck);
-    e = a_n != 1 || consumed_n != mult->post_fp || value < 0 || value >= size;
     if (e == 0) {
-      size = value + 1;
-      if (size > wms->ms.deck_flags_n) {
-        wms->ms.deck_flags = realloc(wms->ms.deck_flags, size);
-        e = wms->ms.deck_flags == NULL;
-        if (e == 0) {
-          for (i = wms->ms.deck_flags_n; i < size; i++) {
-            wms->ms.deck_flags[i] = 0;
-          }
-          wms->ms.deck_flags_n = size;
-        }
+      if (digest != NULL) {
+        memcpy(xml->stage_digest_d + SHA1_HASH_SIZE * xml->stage_c, digest, SHA1_HASH_SIZE);
       }
-      if (e == 0) {
-        wms->ms.deck_flags[value] = 1;
+      xml->stage_data_l[xml->stage_c] = xml->stage_free;
+      xml->stage_size_l[xml->stage_c++] = data_size;
+      if (xml->stage_c - xml->stage_next >= XML_WORK_MIN) {
+        pthread_cond_signal(&xml->stage_cond);
       }
     }
-    break;
-  case F_CARD:
-    assert(wms->ms.card_i == -1);
-    a_n = sscanf(mult->post_lp, "%d", &wms->ms.card_i);
-    e = a_n != 1;
-    break;
-  case F_MOV_CARD:
-    assert(wms->ms.mov_card_i == -1);
-    a_n = sscanf(mult->post_lp, "%d", &wms->ms.mov_card_i);
-    e = a_n != 1;
-    break;
-  case F_LVL:
-    assert(wms->ms.lvl == -1);
-    a_n = sscanf(mult->post_lp, "%d", &wms->ms.lvl);
-    e = a_n != 1;
-    if (e == 0) {
-      e = wms->ms.lvl < 0 || wms->ms.lvl >= 21;
-      if (e != 0) {
-        e = E_FIELD_4; // lvl assert (failed)
-      }
-    }
-    break;
-  case F_RANK:
-    e = wms->ms.rank != -1;
-    if (e == 0) {
-      a_n = sscanf(mult->post_lp, "%d%n", &wms->ms.rank, &consumed_n);
-      e = a_n != 1 || consumed_n != mult->post_fp || wms->ms.rank < 0 || wms->ms.rank > 20;
-    }
-    break;
-  case F_Q:
-    assert(mult->post_lp[mult->post_fp] == '\0');
-    e = percent2c(mult->post_lp, mult->post_fp);
-    if (e == 0) {
-      e = sa_set(&wms->qa_sa, 0, mult->post_lp);
-    }
-    break;
-  case F_A:
-    assert(mult->post_lp[mult->post_fp] == '\0');
-    e = percent2c(mult->post_lp, mult->post_fp);
-    if (e == 0) {
-      e = sa_set(&wms->qa_sa, 1, mult->post_lp);
-    }
-    break;
-  case F_REVEAL_POS:
-    e = wms->saved_reveal_pos != -1;
-    if (e == 0) {
-      a_n = sscanf(mult->post_lp, "%d", &wms->saved_reveal_pos);
-      e = a_n != 1 || wms->saved_reveal_pos < 0;
-    }
-    if (e == 1) {
-      e = E_FIELD_5; // reveal-pos assert (failed)
-      wms->saved_reveal_pos = -1;
-    }
-    break;
-  case F_TODO_MAIN:
-    assert(wms->todo_main == -1);
-    a_n = sscanf(mult->post_lp, "%d", &wms->todo_main);
-    e = a_n != 1;
-    assert(wms->todo_main >= S_FILE && wms->todo_main <= S_END);
-    break;
-  case F_MCTR:
-    a_n = sscanf(mult->post_lp, "%u%n", &wms->mctr, &consumed_n);
-    e = a_n != 1 || consumed_n != mult->post_fp;
-    break;
-  case F_MTIME:
-    e = mult->post_fp != 16;
-    if (e == 0) {
-      assert(wms->mtime[0] == -1 && wms->mtime[1] == -1);
-      a_n = sscanf(mult->post_lp, "%8x%8x%n", &wms->mtime[1], &wms->mtime[0], &consumed_n);
-      e = a_n != 2 || consumed_n != 16;
-      if (e == 0) {
-        assert(wms->mtime[0] >= 0 && wms->mtime[1] >= 0);
-      }
-    }
-    break;
-  case F_PASSWORD:
-    assert(wms->ms.password == NULL);
-    wms->ms.password = malloc(mult->post_wp);
-    e = wms->ms.password == NULL;
+    pthread_mutex_unlock(&xml->stage_mutex);
     if (e == 0) {
-      assert(mult->post_lp[mult->post_fp] == '\0');
-      memcpy(wms->ms.password, mult->post_lp, mult->post_wp);
-      e = percent2c(wms->ms.password, mult->post_fp);
+      xml->stage_free += data_size;
+      xml->stage_left -= data_size;
     }
-    break;
-  case F_NEW_PASSWORD:
-    assert(wms->ms.new_password == NULL);
-    wms->ms.new_password = malloc(mult->post_wp);
-    e = wms->ms.new_password == NULL;
-    if (e == 0) {
-      assert(mult->post_lp[mult->post_fp] == '\0');
-      memcpy(wms->ms.new_password, mult->post_lp, mult->post_wp);
-      e = percent2c(wms->ms.new_password, mult->post_fp);
+  }
+  if (e == 0 && xml->stage_thread_n < xml->stage_thread_a && xml->stage_c >= XML_WORK_MIN * (xml->stage_thread_n + 1)) {
+    if (pthread_create(xml->stage_thread_l + xml->stage_thread_n, NULL, digest_staged, xml) == 0) {
+      xml->stage_thread_n++;
+    } else {
+      xml->stage_thread_a = xml->stage_thread_n; // the rest is hashed by xml_stage_end
     }
-    break;
-  case F_TOKEN:
-    e = mult->post_fp != 40;
+  }
+  return e;
+}
+
+static int parse_xml(struct XML *xml, struct WebMemorySurfer *wms, enum Tag tag, int parent_cat_i) {
+  int e;
+  ssize_t nread;
+  int deck_i;
+  int card_i;
+  char *str;
+  int len;
+  int i;
+  int deck_a;
+  size_t size;
+  struct tm bd_time; // broken-down
+  int a_n; // assignments
+  time_t simple_time;
+  char do_flag;
+  char slash_f; // flag
+  do_flag = 1;
+  deck_i = -1;
+  do {
+    nread = xml_scan(xml, '<');
+    e = nread <= 0;
     if (e == 0) {
-      e = scan_hex(wms->tok_digest, mult->post_lp, SHA1_HASH_SIZE);
-    }
-    break;
-  case F_EVENT:
-    switch (mult->post_fp) {
-    case 3:
-      if (memcmp(mult->post_lp, "New", 3) == 0) {
-        wms->seq = S_NEW;
-      } else {
-        e = memcmp(mult->post_lp, "Set", 3) != 0;
-        if (e == 0) {
-          wms->seq = S_SET;
-        }
-      }
-      break;
-    case 4:
-      if (memcmp(mult->post_lp, "Show", 4) == 0) {
-        wms->seq = S_SHOW;
-      } else if (memcmp(mult->post_lp, "Stop", 4) == 0) {
-        if (wms->from_page == P_LEARN) {
-          wms->seq = S_SELECT_LEARN_DECK;
-        } else if (wms->from_page == P_SEARCH) {
-          wms->seq = S_SELECT_SEARCH_DECK;
-        } else if (wms->from_page == P_SELECT_ARRANGE) {
-          if (wms->saved_mode == M_CARD) {
-            wms->seq = S_EDIT;
-          } else {
-            if (wms->saved_mode == M_MOVE_DECK) {
-              wms->ms.deck_i = wms->ms.mov_deck_i;
-              wms->ms.mov_deck_i = -1;
-            } else {
-              e = wms->saved_mode != M_CREATE_DECK;
+      if (do_flag) {
+        do_flag = 0;
+        switch (tag) {
+        case TAG_ROOT:
+        case TAG_MEMORYSURFER:
+          deck_i = parent_cat_i; // the decks are arranged under it (merge)
+          break;
+        case TAG_DECK:
+          deck_i = 0;
+          while (deck_i < wms->ms.deck_a && wms->ms.cat_t[deck_i].deck_slot_used != 0)
+            deck_i++;
+          assert(deck_i <= INT16_MAX);
+          if (deck_i == wms->ms.deck_a) {
+            deck_a = wms->ms.deck_a + 7;
+            size = sizeof(struct Deck) * deck_a;
+            wms->ms.cat_t = realloc(wms->ms.cat_t, size);
+            e = wms->ms.cat_t == NULL;
+            if (e == 0) {
+              size = sizeof(struct CardList) * deck_a;
+              xml->cardlist_l = realloc(xml->cardlist_l, size);
+              e = xml->cardlist_l == NULL;
             }
             if (e == 0) {
-              wms->seq = S_START_DECKS;
+              for (i = wms->ms.deck_a; i < deck_a; i++) {
+                wms->ms.cat_t[i].deck_slot_used = 0;
+                xml->cardlist_l[i].card_l = NULL;
+                xml->cardlist_l[i].card_a = 0;
+              }
+              wms->ms.deck_a = deck_a;
+              xml->cardlist_a = deck_a;
             }
           }
-        } else if (wms->from_page == P_SELECT_DEST_DECK) {
-          if (wms->saved_mode == M_SEND) {
-            wms->ms.deck_i = wms->ms.mov_deck_i;
-            wms->ms.card_i = wms->ms.mov_card_i;
-            wms->seq = S_EDIT;
-          } else if (wms->saved_mode == M_PROCEED_SEND) {
-            wms->ms.deck_i = wms->ms.mov_deck_i;
-            wms->ms.card_i = wms->ms.mov_card_i;
-            wms->seq = S_QUESTION;
-          } else {
-            e = wms->saved_mode != M_MOVE;
+          if (e == 0) {
+            if (xml->prev_cat_i != -1) {
+              wms->ms.cat_t[xml->prev_cat_i].n_sibling = deck_i;
+            } else if (parent_cat_i != -1) {
+              wms->ms.cat_t[parent_cat_i].n_child = deck_i;
+            }
+            xml->prev_cat_i = -1;
             if (e == 0) {
-              wms->ms.deck_i = wms->ms.mov_deck_i;
-              wms->ms.mov_deck_i = -1;
-              wms->seq = S_START_DECKS;
+              wms->ms.cat_t[deck_i].cat_cli = -1;
+              wms->ms.cat_t[deck_i].deck_x = 1;
+              wms->ms.cat_t[deck_i].n_sibling = -1;
+              wms->ms.cat_t[deck_i].n_child = -1;
+              wms->ms.cat_t[deck_i].deck_slot_used = 1;
+              wms->ms.cat_t[deck_i].deck_on = 0;
             }
           }
-        } else if (wms->from_page == P_CAT_NAME) {
-          wms->seq = S_START_DECKS;
-        } else if (wms->from_page == P_STYLE) {
-          wms->seq = S_PREVIEW;
-        } else if (wms->from_page == P_NEW) {
-          wms->seq = S_CLOSE;
-        } else if (wms->from_page == P_UPLOAD) {
-           wms->seq = S_FILE;
-        } else if (wms->from_page == P_PASSWORD) {
-          if (wms->saved_mode == M_DEFAULT)
-            wms->seq = S_CLOSE;
-          else {
-            e = wms->saved_mode != M_CHANGE_PASSWD;
-            if (e == 0)
-              wms->seq = S_FILE;
-          }
-        } else {
-          e = wms->from_page != P_PREVIEW && wms->from_page != P_EDIT;
+          break;
+        case TAG_NAME:
+          str = xml->p_lineptr;
+          str[nread - 1] = '\0';
+          e = xml_unescape(str);
           if (e == 0) {
-            wms->seq = S_SELECT_EDIT_DECK;
+            e = sa_set(&wms->ms.deck_sa, parent_cat_i, str);
           }
-        }
-      } else if (memcmp(mult->post_lp, "Edit", 4) == 0) {
-        switch (wms->from_page) {
-        case P_START:
-          wms->seq = S_SELECT_EDIT_DECK;
-          break;
-        case P_SELECT_DECK:
-        case P_SEARCH:
-        case P_HISTOGRAM:
-          wms->seq = S_EDIT;
-          break;
-        case P_TABLE:
-          wms->seq = S_EDIT_SYNC_RANK;
-          break;
-        case P_LEARN:
-        case P_PREVIEW:
-          wms->seq = S_EDIT_SYNC;
           break;
-        default:
-          e = E_FIELD_6; // unknown from page
-        }
-      } else if (memcmp(mult->post_lp, "Next", 4) == 0) {
-        wms->seq = S_NEXT;
-      } else if (memcmp(mult->post_lp, "Open", 4) == 0) {
-        if (wms->from_page == P_OPEN) {
-          wms->seq = S_GO_LOGIN;
-        } else {
-          e = wms->from_page != P_FILE;
+        case TAG_STYLE:
+          str = xml->p_lineptr;
+          str[nread - 1] = '\0';
+          e = xml_unescape(str);
           if (e == 0) {
-            wms->seq = S_FILELIST;
+            e = sa_set(&wms->ms.style_sa, parent_cat_i, str);
           }
-        }
-      } else if (memcmp(mult->post_lp, "Move", 4) == 0) {
-        if (wms->from_page == P_SELECT_DECK) {
-          wms->seq = S_SELECT_DEST_CAT;
-        } else if (wms->from_page == P_SELECT_ARRANGE && wms->saved_mode == M_MOVE_DECK) {
-          wms->seq = S_MOVE_DECK;
-        } else if (wms->from_page == P_EDIT) {
-          wms->seq = S_CARD_ARRANGE;
-        } else {
-          e = wms->from_page != P_SELECT_ARRANGE || wms->saved_mode != M_CARD;
+          break;
+        case TAG_CARD:
+          assert(parent_cat_i >= 0 && xml->cardlist_l[parent_cat_i].card_a >= 0);
+          xml->cardlist_l[parent_cat_i].card_a++;
+          size = xml->cardlist_l[parent_cat_i].card_a * sizeof(struct Card);
+          xml->cardlist_l[parent_cat_i].card_l = realloc(xml->cardlist_l[parent_cat_i].card_l, size);
+          e = xml->cardlist_l[parent_cat_i].card_l == NULL;
           if (e == 0) {
-            wms->seq = S_MOVE_CARD;
+            card_i = xml->cardlist_l[parent_cat_i].card_a - 1;
+            xml->cardlist_l[parent_cat_i].card_l[card_i].card_time = 0;
+            xml->cardlist_l[parent_cat_i].card_l[card_i].card_strength = 60;
+            xml->cardlist_l[parent_cat_i].card_l[card_i].card_qai = -1;
+            xml->cardlist_l[parent_cat_i].card_l[card_i].card_state = STATE_NEW;
           }
-        }
-      } else if (memcmp(mult->post_lp, "Send", 4) == 0) {
-        if (wms->from_page == P_EDIT) {
-          wms->seq = S_EDITING_SEND;
-        } else {
-          e = wms->from_page != P_SELECT_DEST_DECK;
+          break;
+        case TAG_TIME:
+          memset(&bd_time, 0, sizeof(bd_time));
+          str = xml->p_lineptr;
+          str[nread - 1] = '\0';
+          a_n = sscanf(str, "%d-%d-%dT%d:%d:%d",
+              &bd_time.tm_year, &bd_time.tm_mon, &bd_time.tm_mday,
+              &bd_time.tm_hour, &bd_time.tm_min, &bd_time.tm_sec);
+          e = a_n != 6;
           if (e == 0) {
-            if (wms->saved_mode == M_SEND) {
-              wms->seq = S_SEND_CARD;
-            } else {
-              e = wms->saved_mode != M_PROCEED_SEND;
-              if (e == 0) {
-                wms->seq = S_PROCEED_SEND_CARD;
-              }
-            }
-          }
-        }
-      } else if (memcmp(mult->post_lp, "Done", 4) == 0) {
-        if (wms->from_page == P_TABLE)
-          wms->seq = S_START_SYNC_RANK;
-        else {
-          e = wms->from_page != P_HISTOGRAM;
-          if (e == 0)
-            wms->seq = S_START;
-        }
-      } else {
-        e = memcmp(mult->post_lp, "File", 4) != 0;
-        if (e == 0) {
-          wms->seq = S_FILE;
-        }
-      }
-      break;
-    case 5:
-      if (memcmp(mult->post_lp, "Learn", 5) == 0) {
-        if (wms->from_page == P_EDIT) {
-          wms->seq = S_QUESTION_SYNCED;
-        } else if (wms->from_page == P_START) {
-          wms->seq = S_SELECT_LEARN_DECK;
-        } else if (wms->from_page == P_TABLE) {
-          wms->seq = S_QUESTION_RANK;
-        } else if (wms->from_page == P_PREVIEW) {
-          wms->seq = S_QUESTION_SYNC_QA;
-        } else if (wms->from_page == P_SELECT_DECK) {
-          if (wms->saved_mode == M_LEARN) {
-            wms->seq = S_LEARN;
-          } else {
-            e = wms->saved_mode != M_EDIT && wms->saved_mode != M_SEARCH && wms->saved_mode != M_START;
+            bd_time.tm_mon -= 1;
+            bd_time.tm_year -= 1900;
+            simple_time = timegm(&bd_time);
+            e = simple_time == -1;
             if (e == 0) {
-              wms->seq = S_QUESTION;
+              card_i = xml->cardlist_l[parent_cat_i].card_a - 1;
+              xml->cardlist_l[parent_cat_i].card_l[card_i].card_time = simple_time;
             }
           }
-        } else {
-          e = wms->from_page != P_SEARCH && wms->from_page != P_HISTOGRAM;
+          break;
+        case TAG_STRENGTH:
+          str = xml->p_lineptr;
+          str[nread - 1] = '\0';
+          card_i = xml->cardlist_l[parent_cat_i].card_a - 1;
+          a_n = sscanf(str, "%d", &xml->cardlist_l[parent_cat_i].card_l[card_i].card_strength);
+          e = a_n != 1;
+          break;
+        case TAG_STATE:
+          str = xml->p_lineptr;
+          i = str[0] - '0';
+          e = i > 3;
           if (e == 0) {
-            wms->seq = S_QUESTION;
+            card_i = xml->cardlist_l[parent_cat_i].card_a - 1;
+            xml->cardlist_l[parent_cat_i].card_l[card_i].card_state = (xml->cardlist_l[parent_cat_i].card_l[card_i].card_state & 0x08) | i;
           }
-        }
-      } else if (memcmp(mult->post_lp, "Decks", 5) == 0) {
-        wms->seq = S_START_DECKS;
-      } else if (memcmp(mult->post_lp, "Table", 5) == 0) {
-        if (wms->from_page == P_LEARN) {
-          wms->seq = S_TABLE_SYNC_QA;
-        } else {
-          e = wms->from_page != P_MSG;
+          break;
+        case TAG_TYPE:
+          str = xml->p_lineptr;
+          i = str[0] - '0';
+          e = i > 1;
           if (e == 0) {
-            wms->seq = S_TABLE;
+            i <<= 3;
+            card_i = xml->cardlist_l[parent_cat_i].card_a - 1;
+            xml->cardlist_l[parent_cat_i].card_l[card_i].card_state = (xml->cardlist_l[parent_cat_i].card_l[card_i].card_state & 0x07) | i;
           }
+          break;
+        case TAG_QUESTION:
+          str = xml->p_lineptr;
+          str[nread - 1] = '\0';
+          e = xml_unescape(str);
+          if (e == 0)
+            e = sa_set(&wms->ms.card_sa, 0, str);
+          break;
+        case TAG_ANSWER:
+          str = xml->p_lineptr;
+          str[nread - 1] = '\0';
+          e = xml_unescape(str);
+          if (e == 0)
+            e = sa_set(&wms->ms.card_sa, 1, str);
+          break;
         }
-      } else if (memcmp(mult->post_lp, "Style", 5) == 0) {
-        wms->seq = S_STYLE;
-      } else if (memcmp(mult->post_lp, "Apply", 5) == 0) {
-        if (wms->from_page == P_PREFERENCES) {
-          wms->seq = S_APPLY;
-        } else {
-          e = wms->from_page != P_STYLE;
-          if (e == 0) {
-            wms->seq = S_STYLE_APPLY;
+      }
+      if (e == 0) {
+        nread = xml_scan(xml, '>');
+        e = nread <= 0;
+        if (e == 0) {
+          str = xml->p_lineptr;
+          len = nread - 1;
+          slash_f = str[0] == '/';
+          if (slash_f) {
+            str++;
+            len--;
           }
-        }
-      } else if (memcmp(mult->post_lp, "Enter", 5) == 0) {
-        wms->seq = S_ENTER;
-      } else if (memcmp(mult->post_lp, "Login", 5) == 0) {
-        wms->seq = S_LOGIN;
-      } else if (memcmp(mult->post_lp, "Erase", 5) == 0) {
-        if (wms->from_page == P_FILE) {
-          wms->seq = S_ASK_ERASE;
-        } else {
-          e = wms->from_page != P_MSG;
-          if (e == 0) {
-            if (wms->saved_mode == M_MSG_FILE) {
-              wms->seq = S_ERASE;
+          switch (len) {
+          case 12:
+            e = memcmp(str, "memorysurfer", 12) != 0;
+            if (e == 0) {
+              if (slash_f == 0) {
+                e = tag != TAG_ROOT;
+                if (e == 0)
+                  e = parse_xml(xml, wms, TAG_MEMORYSURFER, parent_cat_i);
+              }
+              else
+                e = tag != TAG_MEMORYSURFER;
+            }
+            break;
+          case 8:
+            if (memcmp(str, "strength", 8) == 0) {
+              if (slash_f == 0) {
+                e = tag != TAG_CARD;
+                if (e == 0) {
+                  e = parse_xml(xml, wms, TAG_STRENGTH, parent_cat_i);
+                }
+              } else {
+                e = tag != TAG_STRENGTH;
+              }
             } else {
-              e = wms->saved_mode != M_MSG_UPLOAD;
+              e = memcmp(str, "question", 8) != 0;
               if (e == 0) {
-                wms->seq = S_UPLOAD;
+                if (slash_f == 0) {
+                  e = tag != TAG_CARD;
+                  if (e == 0)
+                    e = parse_xml(xml, wms, TAG_QUESTION, parent_cat_i);
+                } else
+                  e = tag != TAG_QUESTION;
               }
             }
-          }
-        }
-      } else if (memcmp(mult->post_lp, "About", 5) == 0) {
-        wms->seq = S_ABOUT;
-      } else if (memcmp(mult->post_lp, "Close", 5) == 0) {
-        wms->seq = S_CLOSE;
-      } else {
-        e = memcmp(mult->post_lp, "Start", 5) != 0;
-        if (e == 0) {
-          wms->seq = S_NONE;
-        }
-      }
-      break;
-    case 6:
-      if (memcmp(mult->post_lp, "Reveal", 6) == 0) {
-        wms->seq = S_REVEAL;
-      } else if (memcmp(mult->post_lp, "Append", 6) == 0) {
-        wms->seq = S_APPEND;
-      } else if (memcmp(mult->post_lp, "Create", 6) == 0) {
-        if (wms->from_page == P_SELECT_DECK) {
-          wms->seq = S_DECKS_CREATE;
-        } else if (wms->from_page == P_NEW) {
-          wms->seq = S_CREATE;
-        } else {
-          e = wms->from_page != P_CAT_NAME;
-          if (e == 0) {
-            wms->seq = S_CREATE_DECK;
-          }
-        }
-      } else if (memcmp(mult->post_lp, "Cancel", 6) == 0) {
-        if (wms->from_page == P_SELECT_DECK || wms->from_page == P_PREFERENCES) {
-          wms->seq = S_START;
-        } else if (wms->from_page == P_FILE) {
-          if (wms->file_title_str != NULL) {
-            wms->seq = S_START;
-          } else {
-            wms->seq = S_NONE;
-          }
-        } else if (wms->from_page == P_MSG) {
-          if (wms->saved_mode == M_MSG_CARD) {
-            wms->seq = S_EDIT;
-          } else if (wms->saved_mode == M_MSG_DECKS) {
-            wms->seq = S_START_DECKS;
-          } else if (wms->saved_mode == M_MSG_SUSPEND || wms->saved_mode == M_MSG_RESUME) {
-            wms->seq = S_QUESTION;
-          } else if (wms->saved_mode == M_MSG_FILE) {
-            wms->seq = S_FILE;
-          } else {
-            e = wms->saved_mode != M_MSG_UPLOAD;
+            break;
+          case 6:
+            e = memcmp(str, "answer", 6) != 0;
             if (e == 0) {
-              wms->seq = S_FILE;
+              if (slash_f == 0) {
+                e = tag != TAG_CARD;
+                if (e == 0) {
+                  e = parse_xml(xml, wms, TAG_ANSWER, parent_cat_i);
+                }
+              } else {
+                e = tag != TAG_ANSWER;
+              }
             }
-          }
-        } else {
-          e = wms->from_page != P_OPEN;
-          if (e == 0) {
-            wms->seq = S_CLOSE;
-          }
-        }
-      } else if (memcmp(mult->post_lp, "Select", 6) == 0) {
-        if (wms->from_page == P_SELECT_DEST_DECK) {
-          wms->seq = S_SELECT_MOVE_ARRANGE;
-        } else {
-          e = wms->from_page != P_SELECT_ARRANGE || wms->saved_mode != M_CREATE_DECK;
-          if (e == 0) {
-            wms->seq = S_DECK_NAME;
-          }
-        }
-      } else if (memcmp(mult->post_lp, "Delete", 6) == 0) {
-        if (wms->from_page == P_MSG) {
-          if (wms->saved_mode == M_MSG_CARD) {
-            wms->seq = S_DELETE_CARD;
-          } else {
-            e = wms->saved_mode != M_MSG_DECKS;
-            wms->seq = S_DELETE_DECK;
-          }
-        } else if (wms->from_page == P_EDIT) {
-          wms->seq = S_ASK_DELETE_CARD;
-        } else {
-          e = wms->from_page != P_SELECT_DECK;
-          wms->seq = S_ASK_DELETE_DECK;
-        }
-      } else if (memcmp(mult->post_lp, "Rename", 6) == 0) {
-        if (wms->from_page == P_SELECT_DECK) {
-          wms->seq = S_DECKS_RENAME;
-        } else {
-          e = wms->from_page != P_CAT_NAME;
-          if (e == 0) {
-            wms->seq = S_RENAME_DECK;
-          }
-        }
-      } else if (memcmp(mult->post_lp, "Insert", 6) == 0) {
-        e = wms->from_page != P_EDIT;
-        if (e == 0) {
-          wms->seq = S_INSERT;
-        }
-      } else if (memcmp(mult->post_lp, "Export", 6) == 0) {
-        wms->seq = S_EXPORT;
-      } else if (memcmp(mult->post_lp, "Upload", 6) == 0) {
-        wms->seq = S_UPLOAD_REPORT;
-      } else if (memcmp(mult->post_lp, "Toggle", 6) == 0) {
-          e = wms->from_page != P_SELECT_DECK;
-          if (e == 0) {
-            wms->seq = S_TOGGLE;
-          }
-      } else if (memcmp(mult->post_lp, "Remove", 6) == 0) {
-        if (wms->from_page == P_FILE) {
-          wms->seq = S_ASK_REMOVE;
-        } else {
-          e = wms->from_page != P_MSG;
-          if (e == 0) {
-            e = wms->saved_mode != M_MSG_FILE;
-            if (e == 0) {
-              wms->seq = S_REMOVE;
-            }
-          }
-        }
-      } else if (memcmp(mult->post_lp, "Resume", 6) == 0) {
-        if (wms->from_page == P_LEARN) {
-          wms->seq = S_ASK_RESUME;
-        } else {
-          e = wms->from_page != P_MSG;
-          wms->seq = S_RESUME;
-        }
-      } else if (memcmp(mult->post_lp, "Search", 6) == 0) {
-        if (wms->from_page == P_EDIT) {
-          wms->seq = S_SEARCH_SYNCED;
-        } else if (wms->from_page == P_START) {
-          wms->seq = S_SELECT_SEARCH_DECK;
-        } else if (wms->from_page == P_LEARN || wms->from_page == P_PREVIEW) {
-          wms->seq = S_SEARCH_SYNC_QA;
-        } else if (wms->from_page == P_TABLE) {
-          wms->seq = S_SEARCH_SYNC_RANK;
-        } else {
-          e = wms->from_page != P_HISTOGRAM && wms->from_page != P_SELECT_DECK;
-          if (e == 0)
-            wms->seq = S_SEARCH;
-        }
-      } else if (memcmp(mult->post_lp, "Import", 6) == 0) {
-        wms->seq = S_WARN_UPLOAD;
-      } else {
-        e = memcmp(mult->post_lp, "Change", 6) != 0;
-        if (e == 0) {
-          wms->seq = S_CHANGE;
-        }
-      }
-      break;
-    case 7:
-      if (memcmp(mult->post_lp, "Proceed", 7) == 0) {
-        wms->seq = S_PROCEED_SYNC_QA;
-      } else if (memcmp(mult->post_lp, "Preview", 7) == 0) {
-        e = wms->from_page != P_EDIT;
-        if (e == 0) {
-          wms->seq = S_PREVIEW_SYNC;
-        }
-      } else if (memcmp(mult->post_lp, "Reverse", 7) == 0) {
-        wms->seq = S_SEARCH;
-        wms->ms.search_dir = -1;
-      } else if (memcmp(mult->post_lp, "Forward", 7) == 0) {
-        wms->seq = S_SEARCH;
-        wms->ms.search_dir = 1;
-      } else if (memcmp(mult->post_lp, "Suspend", 7) == 0) {
-        if (wms->from_page == P_LEARN) {
-          wms->seq = S_ASK_SUSPEND;
-        } else {
-          e = wms->from_page != P_MSG;
-          wms->seq = S_SUSPEND;
-        }
-      } else {
-        e = memcmp(mult->post_lp, "Refresh", 7) != 0;
-        if (e == 0) {
-          if (wms->from_page == P_HISTOGRAM) {
-            wms->seq = S_HISTOGRAM;
-          } else {
-            e = wms->from_page != P_TABLE;
-            if (e == 0)
-              wms->seq = S_TABLE_REFRESH;
-          }
-        }
-      }
-      break;
-    case 8:
-      if (memcmp(mult->post_lp, "Previous", 8) == 0) {
-        wms->seq = S_PREVIOUS;
-      } else if (memcmp(mult->post_lp, "Password", 8) == 0) {
-        wms->seq = S_GO_CHANGE;
-      } else {
-        e = memcmp(mult->post_lp, "Schedule", 8) != 0;
-        if (e == 0) {
-          wms->seq = S_SCHEDULE;
-        }
-      }
-      break;
-    case 11:
-      if (memcmp(mult->post_lp, "Preferences", 11) == 0) {
-        wms->seq = S_PREFERENCES;
-      } else {
-        e = memcmp(mult->post_lp, "ProceedSend", 11) != 0;
-        if (e == 0) {
-          wms->seq = S_SELECT_PROCEED_SEND;
-        }
-      }
-      break;
-    default:
-      if (strncmp(mult->post_lp, "Histogram", 9) == 0) {
-        e = wms->from_page != P_LEARN;
-        if (e == 0)
-          wms->seq = S_HISTOGRAM_SYNC_QA;
-      } else {
-        e = strncmp(mult->post_lp, "OK", 2) != 0;
-        if (e == 0) {
-          if (wms->from_page == P_ABOUT) {
-            if (wms->file_title_str != NULL) {
-              wms->seq = S_START;
+            break;
+          case 5:
+            if (memcmp(str, "state", 5) == 0) {
+              if (slash_f == 0) {
+                e = tag != TAG_CARD;
+                if (e == 0) {
+                  e = parse_xml(xml, wms, TAG_STATE, parent_cat_i);
+                }
+              } else {
+                e = tag != TAG_STATE;
+              }
             } else {
-              wms->seq = S_NONE;
+              e = memcmp(str, "style", 5) != 0;
+              if (e == 0) {
+                if (slash_f == 0) {
+                  e = tag != TAG_DECK;
+                  if (e == 0) {
+                    e = parse_xml(xml, wms, TAG_STYLE, deck_i);
+                  }
+                } else {
+                  e = tag != TAG_STYLE;
+                }
+              }
             }
-          } else if (wms->from_page == P_UPLOAD_REPORT) {
-            wms->seq = S_START;
-          } else {
-            e = wms->from_page != P_MSG;
-            if (e == 0) {
-              if (wms->saved_mode == M_NONE) {
-                e = wms->todo_main == -1;
+            break;
+          case 4:
+            if (memcmp(str, "card", 4) == 0) {
+              if (slash_f == 0) {
+                e = tag != TAG_DECK;
+                if (e == 0)
+                  e = parse_xml(xml, wms, TAG_CARD, deck_i);
+              } else {
+                e = tag != TAG_CARD;
                 if (e == 0) {
-                  wms->seq = wms->todo_main;
+                  e = xml_stage(xml, wms->ms.card_sa.sa_d, sa_length(&wms->ms.card_sa), NULL);
+                  if (e == 0) {
+                    card_i = xml->cardlist_l[parent_cat_i].card_a - 1;
+                    xml->cardlist_l[parent_cat_i].card_l[card_i].card_qai = xml->stage_c - 1; // replaced by the chunk in xml_store
+                    wms->card_n++;
+                  }
+                }
+              }
+            } else if (memcmp(str, "time", 4) == 0) {
+              if (slash_f == 0) {
+                e = tag != TAG_CARD;
+                if (e == 0) {
+                  e = parse_xml(xml, wms, TAG_TIME, parent_cat_i);
                 }
-              } else if (wms->saved_mode == M_MSG_START) {
-                wms->seq = S_START;
-              } else if (wms->saved_mode == M_MSG_CARD) {
-                wms->seq = S_EDIT;
-              } else if (wms->saved_mode == M_MSG_SELECT_EDIT) {
-                wms->seq = S_SELECT_EDIT_DECK;
-              } else if (wms->saved_mode == M_MSG_SELECT_LEARN || wms->saved_mode == M_MSG_NO_CARD_ELIGIBLE) {
-                wms->seq = S_SELECT_LEARN_DECK;
-              } else if (wms->saved_mode == M_MSG_SELECT_SEARCH) {
-                wms->seq = S_SELECT_SEARCH_DECK;
               } else {
-                e = wms->saved_mode != M_MSG_DECKS;
+                e = tag != TAG_TIME;
+              }
+            } else if (memcmp(str, "type", 4) == 0) {
+              if (slash_f == 0) {
+                e = tag != TAG_CARD;
                 if (e == 0) {
-                  wms->seq = S_START_DECKS;
+                  e = parse_xml(xml, wms, TAG_TYPE, parent_cat_i);
+                }
+              } else {
+                e = tag != TAG_TYPE;
+              }
+            } else if (memcmp(str, "name", 4) == 0) {
+              if (slash_f == 0) {
+                e = tag != TAG_DECK;
+                if (e == 0)
+                  e = parse_xml(xml, wms, TAG_NAME, deck_i);
+              } else
+                e = tag != TAG_NAME;
+            } else {
+              e = memcmp(str, "deck", 4) != 0;
+              if (e == 0) {
+                if (slash_f == 0) {
+                  e = tag != TAG_MEMORYSURFER && tag != TAG_DECK;
+                  if (e == 0)
+                    e = parse_xml(xml, wms, TAG_DECK, deck_i);
+                } else {
+                  e = tag != TAG_DECK;
+                  if (e == 0) {
+                    assert(deck_i >= 0);
+                    wms->deck_n++;
+                    xml->prev_cat_i = deck_i;
+                  }
                 }
               }
             }
+            break;
+          default:
+            e = E_PXML; // tag length undefined
+            break;
           }
         }
       }
-      break;
+    } else if (tag == TAG_ROOT) {
+      wms->msg_header = "No or Empty XML data";
+      wms->msg_btn_main = "OK";
+      wms->todo_main = S_WARN_UPLOAD;
+      wms->page = P_MSG;
+    }
+  } while (slash_f == 0 && e == 0 && tag != TAG_ROOT);
+  return e;
+}
+
+static int bc_cmp(const void *ls, const void *rs)
+{
+  return memcmp(((const struct BaseCard *)ls)->bc_digest, ((const struct BaseCard *)rs)->bc_digest, SHA1_HASH_SIZE);
+}
+
+// writes the parsed cards, then the card lists of the new decks, each set in one sequential imf_put_bulk, and
+// indexes the cards; the card lists hold staging ordinals until the chunks are known (or -2 - the chunk a delta
+// or a merge keeps). The digests of the cards are computed by the workers xml_stage started while the cards were
+// parsed, the single writer waits for them; a merge leaves out the cards whose digest is in xml->dup
+static int xml_store(struct XML *xml, struct MemorySurfer *ms)
+{
+  int e;
+  int deck_i;
+  int card_i;
+  int32_t deck_c;
+  int32_t k;
+  int32_t m; // cards stored
+  int32_t j;
+  int32_t n;
+  size_t size;
+  void **list_l;
+  int32_t *size_l;
+  int32_t *index_l;
+  int32_t *pos_l; // staging ordinal -> stored card, -1 = skipped
+  struct CardList *cl;
+  struct BaseCard bc;
+  e = xml_stage_end(xml);
+  n = xml->stage_c > xml->cardlist_a ? xml->stage_c : xml->cardlist_a;
+  size = sizeof(void *) * (n + 1);
+  list_l = malloc(size);
+  size = sizeof(int32_t) * (n + 1);
+  size_l = malloc(size);
+  index_l = malloc(size);
+  pos_l = malloc(size);
+  m = 0;
+  if (e == 0) {
+    e = list_l == NULL || size_l == NULL || index_l == NULL || pos_l == NULL;
+  }
+  if (e == 0) {
+    if (xml->stage_digest_d != NULL) {
+      e = memcmp(xml->stage_hash_d, xml->stage_digest_d, SHA1_HASH_SIZE * xml->stage_c) != 0 ? E_CRRPT : 0;
+    }
+    for (k = 0; k < xml->stage_c && e == 0; k++) { // compacted in place, m <= k
+      pos_l[k] = -1;
+      if (xml->dup != NULL) {
+        memcpy(bc.bc_digest, xml->stage_hash_d + k * SHA1_HASH_SIZE, SHA1_HASH_SIZE);
+      }
+      if (xml->dup == NULL || bsearch(&bc, xml->dup->sb_card_l, xml->dup->sb_head->bh_card_n, sizeof(struct BaseCard), bc_cmp) == NULL) {
+        xml->stage_data_l[m] = xml->stage_data_l[k];
+        xml->stage_size_l[m] = xml->stage_size_l[k];
+        memmove(xml->stage_hash_d + m * SHA1_HASH_SIZE, xml->stage_hash_d + k * SHA1_HASH_SIZE, SHA1_HASH_SIZE);
+        pos_l[k] = m++;
+      } else {
+        xml->dup_n++;
+      }
     }
-    break;
-  case F_PAGE:
-    assert(wms->from_page == P_UNDEF);
-    a_n = sscanf(mult->post_lp, "%d", &wms->from_page);
-    e = a_n != 1 || wms->from_page < P_START || wms->from_page > P_TABLE;
-    break;
-  case F_MODE:
-    assert(wms->saved_mode == M_NONE);
-    a_n = sscanf(mult->post_lp, "%d", &wms->saved_mode);
-    e = a_n != 1;
-    assert(wms->saved_mode >= M_DEFAULT && wms->saved_mode < M_END);
-    break;
-  case F_TIMEOUT:
-    e = wms->from_page != P_PREFERENCES;
     if (e == 0) {
-      assert(wms->timeout == -1);
-      a_n = sscanf(mult->post_lp, "%d", &wms->timeout);
-      e = a_n != 1;
-      if (e == 0)
-        assert(wms->timeout >= 0 && wms->timeout < 5);
+      e = imf_put_bulk(&ms->imf, m, index_l, xml->stage_data_l, xml->stage_size_l, xml->stage_hash_d);
+    }
+  }
+  deck_c = 0;
+  for (deck_i = 0; deck_i < xml->cardlist_a && e == 0; deck_i++) {
+    cl = xml->cardlist_l + deck_i;
+    if (ms->cat_t[deck_i].deck_slot_used != 0 && ms->cat_t[deck_i].cat_cli == -1) {
+      j = 0;
+      for (card_i = 0; card_i < cl->card_a && e == 0; card_i++) {
+        k = cl->card_l[card_i].card_qai;
+        if (k >= 0) {
+          assert(k < xml->stage_c);
+          k = pos_l[k];
+          if (k >= 0) {
+            cl->card_l[j] = cl->card_l[card_i];
+            cl->card_l[j].card_qai = index_l[k];
+            e = ms_index_card(ms, index_l[k], NULL, 0, 0, xml->stage_data_l[k], xml->stage_size_l[k], cl->card_l[j++].card_state & 0x08);
+          }
+        } else {
+          assert(k <= -2); // kept by a delta or a merge
+          cl->card_l[j] = cl->card_l[card_i];
+          cl->card_l[j++].card_qai = -2 - k;
+        }
+      }
+      cl->card_a = j;
+      if (e == 0) {
+        e = ms_summarize(ms, deck_i, cl->card_l, cl->card_a);
+      }
+      assert(cl->card_l != NULL || cl->card_a == 0);
+      list_l[deck_c] = cl->card_l;
+      size_l[deck_c++] = cl->card_a * sizeof(struct Card);
+    }
+  }
+  if (e == 0) {
+    e = imf_put_bulk(&ms->imf, deck_c, index_l, list_l, size_l, NULL);
+    deck_c = 0;
+    for (deck_i = 0; deck_i < xml->cardlist_a && e == 0; deck_i++) {
+      if (ms->cat_t[deck_i].deck_slot_used != 0 && ms->cat_t[deck_i].cat_cli == -1) {
+        ms->cat_t[deck_i].cat_cli = index_l[deck_c++];
+      }
     }
-    break;
-  default:
-    e = E_FIELD_7; // unknown Field value
-    break;
   }
+  free(list_l);
+  free(size_l);
+  free(index_l);
+  free(pos_l);
   return e;
 }
 
-static int parse_post(struct WebMemorySurfer *wms)
+// sets a string array from its data, as stored in a chunk
+static int sa_assign(struct StringArray *sa, const char *data, int32_t data_size)
 {
   int e;
-  int rv; // return value
-  char *str;
-  enum Stage stage;
-  size_t len;
-  size_t size;
-  struct Multi *mult;
-  char *boundary_str;
-  FILE *temp_stream;
-  int i;
-  int j;
-  int ch;
-  int tv; // test value
-  int post_tp;
-  struct Parse *parse;
-  boundary_str = NULL;
-  size = sizeof(struct Multi);
-  mult = malloc(size);
-  size = sizeof(struct Parse);
-  parse = malloc(size);
-  e = mult == NULL || parse == NULL;
+  int pos_c; // count
+  char *sa_d;
+  e = data_size > 0 && data[data_size - 1] != '\0' ? E_CRRPT : 0;
+  if (e == 0 && sa->sa_n < data_size) {
+    sa_d = realloc(sa->sa_d, data_size);
+    e = sa_d == NULL;
+    if (e == 0) {
+      sa->sa_d = sa_d;
+      sa->sa_n = data_size;
+    }
+  }
   if (e == 0) {
-    mult->post_lp = NULL;
-    mult->post_n = 0;
-    mult->delim_str[0] = "=";
-    mult->delim_str[1] = "--";
-    stage = T_NULL;
-    parse->field = F_UNKNOWN;
-    do {
-      e = multi_delim(mult);
-      if (mult->nread_del > 0 && e == 0) {
-        e = append_part(wms, mult);
+    memcpy(sa->sa_d, data, data_size);
+    sa->sa_c = 0;
+    pos_c = 0;
+    while (pos_c < data_size) {
+      sa->sa_c += !sa->sa_d[pos_c++];
+    }
+  }
+  return e;
+}
+
+// the upload: 0 = XML, 1 = snapshot, 2 = delta
+static int snap_kind(const char *data, size_t data_n)
+{
+  int kind;
+  kind = 0;
+  if (data_n >= sizeof(SNAP_MAGIC) && memcmp(data, SNAP_MAGIC, sizeof(SNAP_MAGIC)) == 0) {
+    kind = 1;
+  } else if (data_n >= sizeof(DELTA_MAGIC) && memcmp(data, DELTA_MAGIC, sizeof(DELTA_MAGIC)) == 0) {
+    kind = 2;
+  }
+  return kind;
+}
+
+// sets the pointers into the map of a base, E_CRRPT when the sizes don't add up
+static int base_assign(struct SnapBase *sb)
+{
+  int e;
+  int64_t size;
+  struct BaseHead *bh;
+  e = sb->sb_n < (int32_t)sizeof(struct BaseHead) ? E_CRRPT : 0;
+  if (e == 0) {
+    bh = (struct BaseHead *)sb->sb_d;
+    size = sizeof(struct BaseHead) + (int64_t)sizeof(struct BaseDeck) * bh->bh_deck_a + (int64_t)sizeof(struct BaseCard) * bh->bh_card_n;
+    e = bh->bh_deck_a < 0 || bh->bh_card_n < 0 || size != sb->sb_n ? E_CRRPT : 0;
+    if (e == 0) {
+      sb->sb_head = bh;
+      sb->sb_deck_l = (struct BaseDeck *)(sb->sb_d + sizeof(struct BaseHead));
+      sb->sb_card_l = (struct BaseCard *)(sb->sb_d + sizeof(struct BaseHead) + sizeof(struct BaseDeck) * bh->bh_deck_a);
+    }
+  }
+  return e;
+}
+
+static void base_free(struct SnapBase *sb)
+{
+  free(sb->sb_d);
+  sb->sb_d = NULL;
+  sb->sb_n = 0;
+}
+
+// the base of a delta: the digest of each card list and of the Q/A of each card, in snapshot order. The Q/A digests
+// are the stored ones, the Q/A aren't read. The id is the SHA-1 of the map
+static int ms_build_base(struct MemorySurfer *ms, struct SnapBase *sb)
+{
+  int e;
+  int deck_i;
+  int card_i;
+  int card_a;
+  int32_t card_n;
+  int32_t data_size;
+  int32_t list_n;
+  struct Card *card_l;
+  struct BaseDeck *bd;
+  struct BaseCard *bc;
+  struct Sha1Context sha1;
+  void *ptr;
+  card_n = 0;
+  for (deck_i = 0; deck_i < ms->deck_a; deck_i++) {
+    if (ms->cat_t[deck_i].deck_slot_used != 0) {
+      card_n += imf_get_size(&ms->imf, ms->cat_t[deck_i].cat_cli) / sizeof(struct Card);
+    }
+  }
+  sb->sb_n = sizeof(struct BaseHead) + sizeof(struct BaseDeck) * ms->deck_a + sizeof(struct BaseCard) * card_n;
+  sb->sb_d = malloc(sb->sb_n);
+  e = sb->sb_d == NULL;
+  card_l = NULL;
+  list_n = 0;
+  if (e == 0) {
+    sb->sb_head = (struct BaseHead *)sb->sb_d;
+    sb->sb_head->bh_deck_a = ms->deck_a;
+    sb->sb_head->bh_card_n = card_n;
+    e = base_assign(sb);
+    card_n = 0;
+    for (deck_i = 0; deck_i < ms->deck_a && e == 0; deck_i++) {
+      bd = sb->sb_deck_l + deck_i;
+      bd->bd_ord = card_n;
+      bd->bd_n = -1;
+      memset(bd->bd_digest, 0, SHA1_HASH_SIZE);
+      if (ms->cat_t[deck_i].deck_slot_used != 0) {
+        data_size = imf_get_size(&ms->imf, ms->cat_t[deck_i].cat_cli);
+        if (data_size > list_n) {
+          ptr = realloc(card_l, data_size);
+          e = ptr == NULL;
+          if (e == 0) {
+            card_l = ptr;
+            list_n = data_size;
+          }
+        }
+        if (e == 0) {
+          e = imf_get_digest(&ms->imf, ms->cat_t[deck_i].cat_cli, card_l, bd->bd_digest);
+        }
+        card_a = data_size / sizeof(struct Card);
+        bd->bd_n = card_a;
+        for (card_i = 0; card_i < card_a && e == 0; card_i++) {
+          bc = sb->sb_card_l + card_n++;
+          bc->bc_qai = card_l[card_i].card_qai;
+          e = imf_peek_digest(&ms->imf, bc->bc_qai, bc->bc_digest);
+        }
       }
+    }
+    if (e == 0) {
+      assert(card_n == sb->sb_head->bh_card_n);
+      e = sha1_reset(&sha1);
       if (e == 0) {
-        switch (stage) {
-        case T_NULL:
-          if (mult->nread_del > 0) {
-            if (mult->post_fp > 0 && mult->post_lp[mult->post_fp] == '=') {
-              stage = T_URLENCODE_EQUALS;
-            } else {
-              e = mult->post_fp != 0 || mult->nread_del != 2 || memcmp(mult->post_lp, "--", 2) != 0;
-              if (e == 0) {
-                stage = T_BOUNDARY_INIT;
-                mult->delim_str[0] = "\r\n";
-                mult->delim_str[1] = NULL;
-                break;
-              } else {
-                break;
-              }
-            }
-          } else {
-            break;
+        e = sha1_input(&sha1, (const uint8_t *)sb->sb_d + SHA1_HASH_SIZE, sb->sb_n - SHA1_HASH_SIZE);
+      }
+      if (e == 0) {
+        e = sha1_result(&sha1, sb->sb_head->bh_id);
+      }
+    }
+  }
+  free(card_l);
+  return e;
+}
+
+// the base recorded by the last snapshot (or delta), E_BASE for none
+static int ms_load_base(struct MemorySurfer *ms, struct SnapBase *sb)
+{
+  int e;
+  sb->sb_d = NULL;
+  sb->sb_n = 0;
+  e = ms->passwd.base_i < 0 ? E_BASE : 0;
+  if (e == 0) {
+    sb->sb_n = imf_get_size(&ms->imf, ms->passwd.base_i);
+    sb->sb_d = malloc(sb->sb_n + 1);
+    e = sb->sb_d == NULL;
+    if (e == 0) {
+      e = imf_get(&ms->imf, ms->passwd.base_i, sb->sb_d);
+      if (e == 0) {
+        e = base_assign(sb);
+      }
+    }
+  }
+  return e;
+}
+
+static int ms_store_base(struct MemorySurfer *ms, struct SnapBase *sb)
+{
+  int e;
+  e = 0;
+  if (ms->passwd.base_i < 0) {
+    e = imf_seek_unused(&ms->imf, &ms->passwd.base_i);
+  }
+  if (e == 0) {
+    e = imf_put(&ms->imf, ms->passwd.base_i, sb->sb_d, sb->sb_n);
+  }
+  return e;
+}
+
+// records the current state as the base of the next delta, once the snapshot (or delta) taken of it was saved. That
+// is no modification of the content: mctr isn't incremented and the mtime is restored, so open pages stay valid
+static int ms_mark_base(struct MemorySurfer *ms, struct SnapBase *sb)
+{
+  int e;
+  struct stat file_stat;
+  struct timespec times[2];
+  e = fstat(ms->imf.filedesc, &file_stat);
+  if (e == 0) {
+    e = ms_store_base(ms, sb);
+    if (e == 0) {
+      e = imf_put(&ms->imf, PW_INDEX, &ms->passwd, sizeof(struct Password));
+      if (e == 0) {
+        e = imf_sync(&ms->imf);
+        if (e == 0) {
+          times[0] = file_stat.st_atim;
+          times[1] = file_stat.st_mtim;
+          e = futimens(ms->imf.filedesc, times);
+        }
+      }
+    }
+  }
+  return e;
+}
+
+// the deck table of a snapshot must be one tree: each used slot linked at most once and only to used slots, all of
+// them reached from the one slot no link refers to; the links are range checked by the caller
+static int snap_check_decks(const struct Deck *cat_t, int deck_a)
+{
+  int e;
+  int deck_i;
+  int used_n;
+  int q_n;
+  int q_i;
+  int k;
+  int16_t link_i;
+  int8_t *ref_l;
+  int16_t *queue_l;
+  ref_l = calloc(deck_a, sizeof(int8_t));
+  queue_l = malloc(sizeof(int16_t) * deck_a);
+  e = ref_l == NULL || queue_l == NULL;
+  used_n = 0;
+  for (deck_i = 0; deck_i < deck_a && e == 0; deck_i++) {
+    if (cat_t[deck_i].deck_slot_used != 0) {
+      used_n++;
+      for (k = 0; k < 2 && e == 0; k++) {
+        link_i = k == 0 ? cat_t[deck_i].n_sibling : cat_t[deck_i].n_child;
+        if (link_i != -1) {
+          e = cat_t[link_i].deck_slot_used == 0 || ref_l[link_i] != 0 ? E_CRRPT : 0; // reached twice
+          ref_l[link_i] = 1;
+        }
+      }
+    }
+  }
+  q_n = 0;
+  for (deck_i = 0; deck_i < deck_a && e == 0; deck_i++) {
+    if (cat_t[deck_i].deck_slot_used != 0 && ref_l[deck_i] == 0) {
+      e = q_n != 0 ? E_CRRPT : 0; // a second root
+      queue_l[q_n++] = deck_i;
+    }
+  }
+  for (q_i = 0; q_i < q_n && e == 0; q_i++) {
+    deck_i = queue_l[q_i];
+    for (k = 0; k < 2; k++) {
+      link_i = k == 0 ? cat_t[deck_i].n_sibling : cat_t[deck_i].n_child;
+      if (link_i != -1) {
+        queue_l[q_n++] = link_i;
+      }
+    }
+  }
+  if (e == 0) {
+    e = q_n != used_n ? E_CRRPT : 0; // a cycle apart from the tree
+  }
+  free(ref_l);
+  free(queue_l);
+  return e;
+}
+
+// loads the uploaded snapshot into xml like parse_xml does: the deck table replaces the (empty) one, the card lists
+// hold staging ordinals and the Q/A are staged with the digests they must have, which xml_store checks. A delta
+// (xml->base set) replaces the deck table, the names and the styles as well, but only carries the card lists which
+// changed; there a card either refers to the Q/A of the base by its ordinal or is followed by its Q/A. The lists of
+// the other decks are kept. Cards waiting for their Q/A are -1, those keeping a chunk of the base -2 - the chunk
+static int snap_load(struct XML *xml, struct WebMemorySurfer *wms)
+{
+  int e;
+  int deck_i;
+  int card_i;
+  int deck_a;
+  int32_t ord;
+  int32_t k;
+  size_t pos;
+  size_t size;
+  const char *data;
+  const uint8_t *digest;
+  struct Deck *cat_t;
+  struct CardList *cl;
+  struct BaseDeck *bd;
+  struct SnapSection ss;
+  struct Sha1Context sha1;
+  uint8_t message_digest[SHA1_HASH_SIZE];
+  e = 0;
+  cl = NULL; // the deck whose Q/A follow
+  card_i = 0;
+  ss.ss_tag = 0;
+  pos = sizeof(SNAP_MAGIC);
+  while (ss.ss_tag != SNAP_END && e == 0) {
+    e = wms->upload_n - pos < sizeof(ss) ? E_CRRPT : 0;
+    if (e == 0) {
+      memcpy(&ss, wms->upload_d + pos, sizeof(ss));
+      pos += sizeof(ss);
+      e = ss.ss_size < 0 || wms->upload_n - pos < (size_t)ss.ss_size + SHA1_HASH_SIZE ? E_CRRPT : 0;
+    }
+    if (e == 0) {
+      data = wms->upload_d + pos;
+      digest = (const uint8_t *)data + ss.ss_size;
+      pos += ss.ss_size + SHA1_HASH_SIZE;
+      if (ss.ss_tag != SNAP_QA) { // the Q/A by the digest workers
+        e = sha1_reset(&sha1);
+        if (e == 0) {
+          e = sha1_input(&sha1, (const uint8_t *)data, ss.ss_size);
+        }
+        if (e == 0) {
+          e = sha1_result(&sha1, message_digest);
+        }
+        if (e == 0) {
+          e = memcmp(message_digest, digest, SHA1_HASH_SIZE) != 0 ? E_CRRPT : 0;
+        }
+      }
+    }
+    if (e == 0) {
+      switch (ss.ss_tag) {
+      case SNAP_BASE: // the id of the base (zero for a full snapshot), then of the state taken
+        e = xml->cardlist_l != NULL || xml->snap_idf != 0 || ss.ss_size != 2 * SHA1_HASH_SIZE ? E_CRRPT : 0;
+        if (e == 0 && xml->base != NULL) {
+          e = memcmp(data, xml->base->sb_head->bh_id, SHA1_HASH_SIZE) != 0 ? E_BASE : 0;
+        }
+        if (e == 0) {
+          memcpy(xml->snap_id, data + SHA1_HASH_SIZE, SHA1_HASH_SIZE);
+          xml->snap_idf = 1;
+        }
+        break;
+      case SNAP_DECKS:
+        deck_a = ss.ss_size / sizeof(struct Deck);
+        e = xml->cardlist_l != NULL || (xml->base != NULL && xml->snap_idf == 0) || deck_a == 0 || deck_a > INT16_MAX || ss.ss_size % sizeof(struct Deck) != 0 ? E_CRRPT : 0;
+        if (e == 0 && xml->base != NULL) {
+          size = sizeof(struct Deck) * (wms->ms.deck_a + 1);
+          xml->old_cat_t = malloc(size);
+          e = xml->old_cat_t == NULL;
+          if (e == 0) {
+            memcpy(xml->old_cat_t, wms->ms.cat_t, sizeof(struct Deck) * wms->ms.deck_a);
+            xml->old_deck_a = wms->ms.deck_a;
           }
-        case T_URLENCODE_EQUALS:
-          if (mult->post_fp >= 0)
-            str = mult->post_lp + mult->post_fp;
-          else if (parse->field != F_UNKNOWN)
-            str = "&";
-          else
-            str = NULL;
-          if (str != NULL) {
-            if (memcmp (str, "=", 1) == 0) {
-              assert(parse->field == F_UNKNOWN);
-              e = mult->post_fp < 0;
-              if (e == 0) {
-                e = determine_field(mult, parse);
-                if (e == 0) {
-                  stage = T_URLENCODE_AMP;
-                  mult->delim_str[0] = "&";
-                  mult->delim_str[1] = NULL;
-                }
+        }
+        if (e == 0) {
+          cat_t = realloc(wms->ms.cat_t, ss.ss_size);
+          e = cat_t == NULL;
+          if (e == 0) {
+            wms->ms.cat_t = cat_t;
+            xml->cardlist_l = malloc(sizeof(struct CardList) * deck_a);
+            e = xml->cardlist_l == NULL;
+          }
+          if (e == 0) {
+            memcpy(cat_t, data, ss.ss_size);
+            wms->ms.deck_a = deck_a;
+            xml->cardlist_a = deck_a;
+            for (deck_i = 0; deck_i < deck_a && e == 0; deck_i++) {
+              xml->cardlist_l[deck_i].card_l = NULL;
+              xml->cardlist_l[deck_i].card_a = 0;
+              if (cat_t[deck_i].deck_slot_used != 0) {
+                e = cat_t[deck_i].n_sibling < -1 || cat_t[deck_i].n_sibling >= deck_a || cat_t[deck_i].n_child < -1 || cat_t[deck_i].n_child >= deck_a ? E_CRRPT : 0;
+                cat_t[deck_i].cat_cli = -2; // no card list yet
+                wms->deck_n++;
               }
             }
+            if (e == 0) {
+              e = snap_check_decks(cat_t, deck_a);
+            }
           }
-          break;
-        case T_URLENCODE_AMP:
-          if (mult->post_fp >= 0)
-            str = mult->post_lp + mult->post_fp;
-          else if (parse->field != F_UNKNOWN)
-            str = "&";
-          else
-            str = NULL;
-          if (str != NULL) {
-            if (memcmp (str, "&", 1) == 0) {
-              e = strncmp(str, "&", 1) != 0;
-              if (e == 0) {
-                if (mult->post_fp < 0) {
-                  mult->post_fp = mult->post_wp;
-                  mult->post_wp++;
-                  e = mult->post_wp < 0 || mult->post_wp >= mult->post_n;
-                }
-                if (e == 0) {
-                  mult->post_lp[mult->post_fp] = '\0';
-                  e = parse_field(wms, mult, parse);
-                  if (e == 0) {
-                    parse->field = F_UNKNOWN;
-                    stage = T_URLENCODE_EQUALS;
-                    mult->delim_str[0] = "=";
-                    mult->delim_str[1] = NULL;
-                  }
-                }
-              }
-            }
-          }
-          break;
-        case T_BOUNDARY_INIT:
-          e = mult->post_fp < 0; // "\r\n"
-          if (e == 0) {
-            assert(boundary_str == NULL);
-            size = mult->nread_del - 1;
-            e = size <= 71 ? 0 : E_PARSE_1; // boundary exceeded
-            if (e == 0) {
-              boundary_str = malloc(size);
-              e = boundary_str == NULL;
-              if (e == 0) {
-                memcpy(boundary_str, mult->post_lp, mult->nread_del - 2);
-                boundary_str[mult->nread_del - 2] = '\0';
-                stage = T_CONTENT;
-                mult->delim_str[0] = "; ";
-                mult->delim_str[1] = NULL;
-              }
-            }
-          }
-          break;
-        case T_CONTENT:
-          e = mult->post_fp != 30; // "; "
-          if (e == 0) {
-            e = strncmp(mult->post_lp, "Content-Disposition: form-data", 30) != 0;
-            if (e == 0) {
-              stage = T_NAME;
-              mult->delim_str[0] = "=\"";
-            }
-          }
-          break;
-        case T_NAME:
-          e = mult->post_fp != 4; // "=\""
-          if (e == 0) {
-            e = strncmp(mult->post_lp, "name", 4) != 0;
-            if (e == 0) {
-              stage = T_NAME_QUOT;
-              mult->delim_str[0] = "\"";
-              mult->delim_str[1] = NULL;
-            }
-          }
-          break;
-        case T_NAME_QUOT:
-          e = mult->post_fp < 0; // "\""
-          if (e == 0) {
-            e = determine_field(mult, parse);
-            if (e == 0) {
-              if (parse->field != F_UPLOAD) {
-                stage = T_VALUE_START;
-                mult->delim_str[0] = "\r\n\r\n";
-                mult->delim_str[1] = NULL;
-              } else {
-                stage = T_FILENAME;
-                mult->delim_str[0] = "; filename=\"";
-                mult->delim_str[1] = NULL;
-              }
-            }
-          }
-          break;
-        case T_VALUE_START:
-          e = mult->post_fp != 0;
-          if (e == 0) {
-            stage = T_VALUE_CRLFMINUSMINUS;
-            mult->delim_str[0] = "\r\n--";
-            mult->delim_str[1] = NULL;
-          }
-          break;
-        case T_VALUE_CRLFMINUSMINUS:
-          e = mult->post_fp < 0;
-          if (e == 0) {
-            mult->post_lp[mult->post_fp] = '\0';
-            assert(mult->post_wp == mult->post_fp + 4);
-            mult->post_wp = mult->post_fp + 1;
-            e = parse_field(wms, mult, parse);
+        }
+        break;
+      case SNAP_NAMES:
+        e = sa_assign(&wms->ms.deck_sa, data, ss.ss_size);
+        break;
+      case SNAP_STYLES:
+        e = sa_assign(&wms->ms.style_sa, data, ss.ss_size);
+        break;
+      case SNAP_CARDS:
+        deck_i = ss.ss_arg;
+        e = (cl != NULL && card_i < cl->card_a) || deck_i < 0 || deck_i >= xml->cardlist_a || wms->ms.cat_t[deck_i].deck_slot_used == 0 || wms->ms.cat_t[deck_i].cat_cli != -2 || ss.ss_size % sizeof(struct Card) != 0 ? E_CRRPT : 0;
+        if (e == 0) {
+          wms->ms.cat_t[deck_i].cat_cli = -1;
+          cl = xml->cardlist_l + deck_i;
+          if (ss.ss_size > 0) {
+            cl->card_l = malloc(ss.ss_size);
+            e = cl->card_l == NULL;
             if (e == 0) {
-              stage = T_BOUNDARY_CHECK;
-              mult->delim_str[0] = "\r\n";
+              memcpy(cl->card_l, data, ss.ss_size);
+              cl->card_a = ss.ss_size / sizeof(struct Card);
             }
           }
-          break;
-        case T_FILENAME:
-          e = mult->post_fp != 0;
-          if (e == 0) {
-            stage = T_FILENAME_QUOT;
-            mult->delim_str[0] = "\"\r\n";
-            mult->delim_str[1] = NULL;
-          }
-          break;
-        case T_FILENAME_QUOT:
-          tv = mult->post_fp <= 4;
-          if (tv == 0) {
-            mult->post_lp[mult->post_fp] = '\0';
-            str = strrchr(mult->post_lp, '.');
-            i = str - mult->post_lp;
-            assert(i > 0 && mult->post_fp >= i);
-            len = mult->post_fp - i;
-            tv = str == NULL || len != 4 || strncmp(str, ".xml", 4) != 0;
-            if (tv == 0) {
-              str = strrchr(mult->post_lp, '#');
-              if (str != NULL && strncmp(str, "#sha1-", 6) == 0) {
-                j = str - mult->post_lp + 6;
-                assert(i >= j);
-                len = i - j;
-                size = SHA1_HASH_SIZE * 2;
-                e = len < size ? E_HASH_1 : 0;
-                if (e == 0) {
-                  e = wms->posted_message_digest != NULL ? E_HASH_2 : 0;
-                  if (e == 0) {
-                    wms->posted_message_digest = malloc(SHA1_HASH_SIZE);
-                    e = wms->posted_message_digest == NULL;
-                    if (e == 0) {
-                      e = scan_hex(wms->posted_message_digest, mult->post_lp + j, SHA1_HASH_SIZE);
-                    }
-                  }
-                }
+          for (card_i = 0; card_i < cl->card_a && e == 0; card_i++) {
+            k = -1;
+            ord = cl->card_l[card_i].card_qai;
+            if (xml->base != NULL && ord != -1) {
+              e = ord < 0 || ord >= xml->base->sb_head->bh_card_n || xml->ref_l[ord] != 0 ? E_CRRPT : 0;
+              if (e == 0) {
+                xml->ref_l[ord] = 1;
+                k = -2 - xml->base->sb_card_l[ord].bc_qai;
               }
             }
+            cl->card_l[card_i].card_qai = k;
           }
-          if (e == 0) {
-            stage = T_VALUE_XML;
-            mult->delim_str[0] = "\r\n\r\n";
-            mult->delim_str[1] = NULL;
+          card_i = 0;
+          while (card_i < cl->card_a && cl->card_l[card_i].card_qai != -1) {
+            card_i++;
           }
-          break;
-        case T_VALUE_XML:
-          e = mult->post_fp < 0 || parse->field != F_UPLOAD; // "\r\n\r\n"
+        }
+        break;
+      case SNAP_QA:
+        e = cl == NULL || ss.ss_arg != card_i || card_i >= cl->card_a ? E_CRRPT : 0;
+        if (e == 0) {
+          e = xml_stage(xml, data, ss.ss_size, digest);
           if (e == 0) {
-            e = mult->post_fp != 38 || strncmp(mult->post_lp, "Content-Type: application/octet-stream", 38) != 0;
-            if (e == 1) {
-              e = mult->post_fp != 22 || strncmp(mult->post_lp, "Content-Type: text/xml", 22) != 0;
-              if (e == 1) {
-                e = mult->post_fp != 29 || strncmp(mult->post_lp, "Content-Type: application/xml", 29) != 0;
-              }
+            cl->card_l[card_i++].card_qai = xml->stage_c - 1; // replaced by the chunk in xml_store
+            wms->card_n++;
+            while (card_i < cl->card_a && cl->card_l[card_i].card_qai != -1) {
+              card_i++;
             }
           }
-          if (e == 0) {
-            size = strlen(DATA_PATH) + 17; // + '/' + 9999999999 + . + temp + '\0'
-            assert(wms->temp_filename == NULL);
-            wms->temp_filename = malloc(size);
-            e = wms->temp_filename == NULL;
+        }
+        break;
+      case SNAP_END:
+        e = xml->cardlist_l == NULL || (cl != NULL && card_i < cl->card_a) ? E_CRRPT : 0;
+        for (deck_i = 0; deck_i < xml->cardlist_a && e == 0; deck_i++) {
+          if (wms->ms.cat_t[deck_i].deck_slot_used != 0 && wms->ms.cat_t[deck_i].cat_cli == -2) { // kept by the delta
+            e = xml->base == NULL || deck_i >= xml->old_deck_a || deck_i >= xml->base->sb_head->bh_deck_a || xml->old_cat_t[deck_i].deck_slot_used == 0 ? E_CRRPT : 0;
             if (e == 0) {
-              rv = snprintf(wms->temp_filename, size, "%s/%ld.temp", DATA_PATH, wms->ms.timestamp);
-              e = rv < 0 || rv >= size;
-              if (e == 0) {
-                temp_stream = fopen(wms->temp_filename, "w");
-                e = temp_stream == NULL;
-                if (e == 0) {
-                  len = strlen(boundary_str);
-                  assert(len > 0 && len <= 70);
-                  e = mult->post_n < 128; // \r\n--%s\r\n
-                  if (e == 0) {
-                    mult->post_wp = 0;
-                    tv = 0;
-                    while (e == 0 && tv == 0) {
-                      ch = fgetc(stdin);
-                      e = ch == EOF;
-                      if (e == 0) {
-                        mult->post_lp[mult->post_wp & 0x7f] = ch;
-                        post_tp = mult->post_wp - len - 5;
-                        mult->post_wp++;
-                        e = mult->post_wp < 0;
-                        if (e == 0 &&  post_tp >= 0) {
-                          if (mult->post_lp[post_tp & 0x7f] == '\r'
-                              && mult->post_lp[(post_tp+1) & 0x7f] == '\n'
-                              && mult->post_lp[(post_tp+2) & 0x7f] == '-'
-                              && mult->post_lp[(post_tp+3) & 0x7f] == '-') {
-                            i = 0;
-                            while (boundary_str[i] == mult->post_lp[(post_tp+4+i) & 0x7f] && i < len) {
-                              i++;
-                            }
-                            tv = i == len
-                                && mult->post_lp[(post_tp+4+len) & 0x7f] == '\r'
-                                && mult->post_lp[(post_tp+5+len) & 0x7f] == '\n';
-                          }
-                          if (tv == 0) {
-                            rv = fputc(mult->post_lp[post_tp & 0x7f], temp_stream);
-                            e = rv == EOF;
-                          }
-                        }
-                      }
-                    }
-                  }
-                  rv = fclose(temp_stream);
-                  if (e == 0) {
-                    e = rv != 0 ? E_PARSE_2 : 0;
-                  }
-                  temp_stream = NULL;
-                }
-              }
-            }
-          }
-          if (e == 0) {
-            stage = T_CONTENT;
-            mult->delim_str[0] = "; ";
-            mult->delim_str[1] = NULL;
-          }
-          break;
-        case T_BOUNDARY_CHECK:
-          assert(boundary_str != NULL);
-          len = strlen(boundary_str);
-          e = strncmp(mult->post_lp, boundary_str, len) != 0;
-          if (e == 0) {
-            if (mult->post_fp == len) {
-              stage = T_CONTENT;
-              mult->delim_str[0] = "; ";
-              mult->delim_str[1] = NULL;
-            } else if (mult->post_fp == len + 2) {
-              e = strncmp(mult->post_lp + mult->post_fp - 2, "--", 2) != 0;
-              if (e == 0) {
-                stage = T_EPILOGUE;
-                mult->delim_str[0] = NULL;
+              bd = xml->base->sb_deck_l + deck_i;
+              e = bd->bd_n < 0 ? E_CRRPT : 0;
+              for (ord = bd->bd_ord; ord < bd->bd_ord + bd->bd_n && e == 0; ord++) {
+                e = xml->ref_l[ord] != 0 ? E_CRRPT : 0;
+                xml->ref_l[ord] = 1;
               }
-            } else {
-              e = E_PARSE_3;
+              wms->ms.cat_t[deck_i].cat_cli = xml->old_cat_t[deck_i].cat_cli;
             }
           }
-          break;
-        case T_EPILOGUE:
-          break;
         }
+        break;
+      default:
+        e = E_CRRPT;
+        break;
       }
-    } while (mult->nread_del != -1 && e == 0);
-    free(boundary_str);
-    boundary_str = NULL;
-    free(parse);
-    parse = NULL;
-    free(mult->post_lp);
-    mult->post_lp = NULL;
-    mult->post_n = 0;
-    free(mult);
-    mult = NULL;
+    }
   }
   return e;
 }
 
-static char *sa_get(struct StringArray *sa, int16_t sa_i)
+// deletes the chunks of the base which a delta replaced: the card lists not kept and the Q/A no list refers to (a
+// merge: the card lists rewritten)
+static int snap_prune(struct XML *xml, struct MemorySurfer *ms)
 {
-  char *ret_str;
-  char ch;
-  int pos; // get
-  int i;
-  assert(sa != NULL && sa->sa_c >= 0);
-  ret_str = NULL;
-  if (sa_i >= 0 && sa_i < sa->sa_c) {
-    pos = 0;
-    for (i = 0; i != sa_i; i++) {
-      do {
-        ch = sa->sa_d[pos++];
-      } while (ch != '\0');
+  int e;
+  int deck_i;
+  int32_t ord;
+  e = 0;
+  for (deck_i = 0; deck_i < xml->old_deck_a && e == 0; deck_i++) {
+    if (xml->old_cat_t[deck_i].deck_slot_used != 0 && (deck_i >= ms->deck_a || ms->cat_t[deck_i].deck_slot_used == 0 || ms->cat_t[deck_i].cat_cli != xml->old_cat_t[deck_i].cat_cli)) {
+      e = imf_delete(&ms->imf, xml->old_cat_t[deck_i].cat_cli);
     }
-    assert(pos < sa->sa_n);
-    ret_str = sa->sa_d + pos;
   }
-  return ret_str;
+  for (ord = 0; xml->base != NULL && ord < xml->base->sb_head->bh_card_n && e == 0; ord++) {
+    if (xml->ref_l[ord] == 0) {
+      e = imf_delete(&ms->imf, xml->base->sb_card_l[ord].bc_qai);
+    }
+  }
+  return e;
 }
 
-enum { ESC_AMP = 1, ESC_LT = 2, ESC_QUOT = 4 };
-
-static int xml_escape(char **xml_str_ptr, size_t *xml_n_ptr, char *str_text, int escape_mask) {
+// shared != 0 reads with imf_pget (concurrent readers)
+static int sa_fetch(struct StringArray *sa, struct IndexedMemoryFile *imf, int32_t index, int shared)
+{
   int e;
-  char ch;
-  int src;
-  int dest;
-  e = xml_str_ptr == NULL || xml_n_ptr == NULL;
-  if (e == 0) {
-    if (str_text == NULL)
-      str_text = "";
-    src = 0;
-    dest = 0;
-    do
-    {
-      ch = str_text[src++];
-      while (((dest + 6) > *xml_n_ptr) && (e == 0)) {
-        *xml_n_ptr = (*xml_n_ptr << 1) | 1;
-        *xml_str_ptr = realloc (*xml_str_ptr, *xml_n_ptr);
-        e = *xml_str_ptr == NULL;
-      }
-      switch (ch) {
-      case '&':
-        if (escape_mask & ESC_AMP) {
-          (*xml_str_ptr)[dest++] = '&';
-          (*xml_str_ptr)[dest++] = 'a';
-          (*xml_str_ptr)[dest++] = 'm';
-          (*xml_str_ptr)[dest++] = 'p';
-          (*xml_str_ptr)[dest++] = ';';
-        }
-        else
-          (*xml_str_ptr)[dest++] = '&';
-        break;
-      case '<':
-        if (escape_mask & ESC_LT) {
-          (*xml_str_ptr)[dest++] = '&';
-          (*xml_str_ptr)[dest++] = 'l';
-          (*xml_str_ptr)[dest++] = 't';
-          (*xml_str_ptr)[dest++] = ';';
-        }
-        else
-          (*xml_str_ptr)[dest++] = '<';
-        break;
-      case '"':
-        if (escape_mask & ESC_QUOT) {
-          (*xml_str_ptr)[dest++] = '&';
-          (*xml_str_ptr)[dest++] = 'q';
-          (*xml_str_ptr)[dest++] = 'u';
-          (*xml_str_ptr)[dest++] = 'o';
-          (*xml_str_ptr)[dest++] = 't';
-          (*xml_str_ptr)[dest++] = ';';
-        }
-        else
-          (*xml_str_ptr)[dest++] = '"';
-        break;
-      default:
-        (*xml_str_ptr)[dest++] = ch;
-        break;
+  int32_t data_size;
+  int pos_c; // count
+  char *sa_d;
+  data_size = imf_get_size(imf, index);
+  e = 0;
+  if (sa->sa_n < data_size) {
+    sa_d = realloc(sa->sa_d, data_size);
+    e = sa_d == NULL;
+    if (e == 0) {
+      sa->sa_d = sa_d;
+      sa->sa_n = data_size;
+    }
+  }
+  if (e == 0) {
+    e = shared != 0 ? imf_pget(imf, index, sa->sa_d) : imf_get(imf, index, sa->sa_d);
+    if (e == 0) {
+      sa->sa_c = 0;
+      pos_c = 0;
+      while (pos_c < data_size) {
+        sa->sa_c += !sa->sa_d[pos_c++];
       }
-    } while ((ch != '\0') && (e == 0));
+    }
   }
   return e;
 }
 
-static int inds_set(struct IndentStr *inds, int indent_n, int change_flag)
+static int sa_load(struct StringArray *sa, struct IndexedMemoryFile *imf, int32_t index)
+{
+  return sa_fetch(sa, imf, index, 0);
+}
+
+static int ms_walk_topology(struct MemorySurfer *ms, int16_t deck_i, int16_t n_parent, int16_t depth, int16_t *rank, int *h_max)
 {
   int e;
-  char *str;
-  size_t size;
-  int i;
-  e = inds->indent_n == -1 && change_flag != 0;
-  if (e == 0) {
-    if (change_flag > 0) {
-      indent_n = inds->indent_n + indent_n;
-    } else if (change_flag < 0) {
-      indent_n = inds->indent_n - indent_n;
+  int16_t n_prev;
+  int h_child;
+  struct DeckTopology *dt_ptr;
+  e = 0;
+  n_prev = -1;
+  *h_max = 0;
+  while (deck_i != -1 && e == 0) {
+    e = deck_i < 0 || deck_i >= ms->deck_a || ms->cat_t[deck_i].deck_slot_used == 0 || *rank >= ms->deck_a ? E_CRRPT : 0;
+    if (e == 0) {
+      dt_ptr = ms->topo_l + deck_i;
+      dt_ptr->dt_parent = n_parent;
+      dt_ptr->dt_prev = n_prev;
+      dt_ptr->dt_depth = depth;
+      dt_ptr->dt_rank = (*rank)++;
+      dt_ptr->dt_height = 0;
+      if (ms->cat_t[deck_i].n_child != -1) {
+        e = ms_walk_topology(ms, ms->cat_t[deck_i].n_child, deck_i, depth + 1, rank, &h_child);
+        dt_ptr->dt_height = h_child + 1;
+      }
+      dt_ptr->dt_size = *rank - dt_ptr->dt_rank;
+      if (*h_max < dt_ptr->dt_height) {
+        *h_max = dt_ptr->dt_height;
+      }
+      n_prev = deck_i;
+      deck_i = ms->cat_t[deck_i].n_sibling;
     }
-    e = indent_n < 0;
+  }
+  return e;
+}
+
+// derives n_first and the topology of all decks in O(decks)
+static int ms_build_topology(struct MemorySurfer *ms)
+{
+  int e;
+  int i;
+  int16_t rank;
+  size_t size;
+  struct DeckTopology *topo_l;
+  e = 0;
+  ms->n_first = -1;
+  ms->topo_h = -1;
+  if (ms->deck_a > 0) {
+    size = sizeof(struct DeckTopology) * ms->deck_a;
+    topo_l = realloc(ms->topo_l, size);
+    e = topo_l == NULL;
     if (e == 0) {
-      if (indent_n >= inds->size) {
-        size = (indent_n / 32 + 1) * 32;
-        str = realloc(inds->str, size);
-        e = str == NULL;
+      ms->topo_l = topo_l;
+      for (i = 0; i < ms->deck_a; i++) {
+        topo_l[i].dt_parent = -1;
+        topo_l[i].dt_prev = -1;
+      }
+      for (i = 0; i < ms->deck_a && e == 0; i++) {
+        if (ms->cat_t[i].deck_slot_used != 0) {
+          e = ms->cat_t[i].n_sibling >= ms->deck_a || ms->cat_t[i].n_child >= ms->deck_a ? E_CRRPT : 0;
+          if (e == 0) {
+            if (ms->cat_t[i].n_sibling >= 0) {
+              topo_l[ms->cat_t[i].n_sibling].dt_prev = i;
+            }
+            if (ms->cat_t[i].n_child >= 0) {
+              topo_l[ms->cat_t[i].n_child].dt_parent = i;
+            }
+          }
+        }
+      }
+      for (i = 0; i < ms->deck_a && e == 0 && ms->n_first == -1; i++) {
+        if (ms->cat_t[i].deck_slot_used != 0 && (ms->cat_t[i].n_sibling == -1 || ms->cat_t[i].n_child == -1)) {
+          ms->n_first = i;
+        }
+      }
+      for (i = 0; ms->n_first != -1 && (topo_l[ms->n_first].dt_prev != -1 || topo_l[ms->n_first].dt_parent != -1) && e == 0; i++) {
+        e = i >= ms->deck_a ? E_CRRPT : 0; // decks hierarchy (is) corrupted
         if (e == 0) {
-          inds->str = str;
-          inds->size = size;
+          ms->n_first = topo_l[ms->n_first].dt_prev != -1 ? topo_l[ms->n_first].dt_prev : topo_l[ms->n_first].dt_parent;
         }
       }
       if (e == 0) {
-        if (inds->indent_n == -1) {
-          inds->indent_n = 0;
+        for (i = 0; i < ms->deck_a; i++) {
+          topo_l[i].dt_parent = -1;
+          topo_l[i].dt_prev = -1;
+          topo_l[i].dt_height = -1;
+          topo_l[i].dt_depth = -1;
+          topo_l[i].dt_rank = -1;
+          topo_l[i].dt_size = 0;
         }
-        if (inds->indent_n < indent_n) {
-          for (i = inds->indent_n; i < indent_n; i++)
-            inds->str[i] = '\t';
-          inds->str[i] = '\0';
+        rank = 0;
+        if (ms->n_first != -1) {
+          e = ms_walk_topology(ms, ms->n_first, -1, 0, &rank, &ms->topo_h);
         } else {
-          inds->str[indent_n] = '\0';
+          for (i = 0; i < ms->deck_a && e == 0; i++) {
+            e = ms->cat_t[i].deck_slot_used != 0 ? E_CRRPT : 0; // decks hierarchy (is) corrupted
+          }
         }
-        inds->indent_n = indent_n;
       }
     }
   }
   return e;
 }
 
-enum Hierarchy { H_CHILD, H_SIBLING };
-enum SelType { Y_RADIO, Y_CHECKBOX };
-
-static int gen_html_deck(int16_t n_create, enum Hierarchy hierarchy, struct WebMemorySurfer *wms, enum SelType sel_type)
+static int ms_open(struct MemorySurfer *ms)
 {
   int e;
-  int rv;
-  char *str;
-  e = 0;
-  assert(sel_type == Y_RADIO || sel_type == Y_CHECKBOX);
-  if (n_create >= 0) {
-    if (hierarchy == H_CHILD) {
-      rv = printf("%s<ul class=\"msf\">\n", wms->inds->str);
-      e = rv < 0;
-    }
+  int32_t data_size;
+  e = ms->imf_filename == NULL || ms->cat_t != NULL || ms->deck_a != 0 || ms->n_first != -1 ? E_ASSRT_1 : 0;
+  if (e == 0) {
+    e = imf_open(&ms->imf, ms->imf_filename);
     if (e == 0) {
-      str = sa_get(&wms->ms.deck_sa, n_create);
-      e = str == NULL;
+      e = sa_load(&ms->deck_sa, &ms->imf, SA_INDEX);
       if (e == 0) {
-        e = xml_escape(&wms->html_lp, &wms->html_n, str, ESC_AMP | ESC_LT);
+        data_size = imf_get_size(&ms->imf, C_INDEX);
+        assert(ms->cat_t == NULL);
+        if (data_size > 0) {
+          ms->cat_t = malloc(data_size);
+          e = ms->cat_t == NULL;
+        }
         if (e == 0) {
-          assert(sel_type == Y_CHECKBOX ? wms->ms.mov_deck_i == -1 : 1);
-          if (sel_type == Y_RADIO) {
-            str = n_create == wms->ms.deck_i ? " checked autofocus" : "";
-          } else {
-            str = wms->ms.cat_t[n_create].deck_on == 1 ? " checked" : "";
-          }
-          rv = printf("%s\t<li><details%s><summary><label class=\"msf-td\"><input type=\"%s\" name=\"deck\" value=\"%d\"%s%s>%s</label></summary>%s\n",
-              wms->inds->str,
-              wms->ms.cat_t[n_create].deck_x != 0 ? " open" : "",
-              sel_type == Y_RADIO ? "radio" : "checkbox",
-              n_create,
-              str,
-              n_create == wms->ms.mov_deck_i ? " disabled" : "",
-              wms->html_lp,
-              wms->ms.cat_t[n_create].n_child == -1 ? "</details></li>" : "");
-          e = rv < 0;
+          assert(ms->deck_a == 0);
+          ms->deck_a = data_size / sizeof(struct Deck);
+          e = imf_get(&ms->imf, C_INDEX, ms->cat_t);
           if (e == 0) {
-            if (wms->ms.cat_t[n_create].n_child != -1) {
-              e = inds_set(wms->inds, 2, 1);
-              if (e == 0) {
-                e = gen_html_deck(wms->ms.cat_t[n_create].n_child, H_CHILD, wms, sel_type);
-                if (e == 0) {
-                  e = inds_set(wms->inds, 2, -1);
-                }
-              }
-              if (e == 0) {
-                rv = printf("%s\t</details></li>\n", wms->inds->str);
-                e = rv < 0;
-              }
-            }
-            if (e == 0) {
-              if (wms->ms.cat_t[n_create].n_sibling != -1) {
-                e = gen_html_deck(wms->ms.cat_t[n_create].n_sibling, H_SIBLING, wms, sel_type);
-              }
-              if (e == 0) {
-                if (hierarchy == H_CHILD) {
-                  rv = printf("%s</ul>\n", wms->inds->str);
-                  e = rv < 0;
-                }
-              }
-            }
+            e = ms_build_topology(ms);
           }
         }
       }
@@ -2532,2147 +3365,6589 @@ static int gen_html_deck(int16_t n_create, enum Hierarchy hierarchy, struct WebM
   return e;
 }
 
-enum
+static int scan_hex(uint8_t *data, char *str, size_t count)
 {
-  SECONDS_MINUTE = 60,
-  SECONDS_HOUR = SECONDS_MINUTE * 60,
-  SECONDS_DAY = SECONDS_HOUR * 24,
-  SECONDS_MONTH = SECONDS_DAY * 30,
-  SECONDS_YEAR = SECONDS_DAY * 365
-};
+  int e;
+  int i;
+  char ch;
+  int nibble[2];
+  e = 0;
+  while (count-- && e == 0) {
+    i = 2;
+    while (i--) {
+      ch = str[count * 2 + i];
+      if (ch >= 'a' && ch <= 'f') {
+        nibble[i] = ch - 'a' + 10;
+      } else if (ch >= '0' && ch <= '9') {
+        nibble[i] = ch - '0';
+      } else {
+        e = E_HEX;
+      }
+    }
+    data[count] = nibble[0] << 4 | nibble[1];
+  }
+  return e;
+}
 
-static void set_time_str(char *time_diff_str, time_t time_set)
+// parses a posted hit "-deck.card.field.off.len.dist", *end_p is set past it
+static int scan_hit(char *str, char **end_p, struct SearchHit *hit)
 {
-  int n_stored;
-  char *str_cursor;
-  int n_years;
-  int n_month;
-  int n_days;
-  int n_hours;
-  int n_minutes;
-  int n_seconds;
-  int valid_c; // count
-  char *space_str;
-  str_cursor = time_diff_str;
-  valid_c = 0;
-  n_years = time_set / SECONDS_YEAR;
-  if (n_years) {
-    valid_c = 48;
-    time_set -= SECONDS_YEAR * n_years;
-  }
-  n_month = time_set / SECONDS_MONTH;
-  if (n_month) {
-    if (valid_c == 0) valid_c = 24;
-    time_set -= SECONDS_MONTH * n_month;
-  }
-  n_days = time_set / SECONDS_DAY;
-  if (n_days) {
-    if (valid_c == 0) valid_c = 12;
-    time_set -= SECONDS_DAY * n_days;
-  }
-  n_hours = time_set / SECONDS_HOUR;
-  if (n_hours) {
-    if (valid_c == 0) valid_c = 6;
-    time_set -= SECONDS_HOUR * n_hours;
-  }
-  n_minutes = time_set / SECONDS_MINUTE;
-  if (n_minutes) {
-    if (valid_c == 0) valid_c = 3;
-    time_set -= SECONDS_MINUTE * n_minutes;
-  }
-  n_seconds = time_set;
-  if (valid_c == 0) valid_c = 1;
-  time_set -= n_seconds;
-  if (valid_c & 32) {
-    n_stored = sprintf(str_cursor, "%dY", n_years);
-    str_cursor += n_stored;
-  }
-  if ((valid_c & 16) && n_month != 0) {
-    space_str = valid_c & 32 ? " " : "";
-    n_stored = sprintf(str_cursor, "%s%dM", space_str, n_month);
-    str_cursor += n_stored;
-  }
-  if ((valid_c & 8) && n_days != 0) {
-    space_str = valid_c & 16 ? " " : "";
-    n_stored = sprintf(str_cursor, "%s%dD", space_str, n_days);
-    str_cursor += n_stored;
-  }
-  if ((valid_c & 4) && n_hours != 0) {
-    space_str = valid_c & 8 ? " " : "";
-    n_stored = sprintf(str_cursor, "%s%dh", space_str, n_hours);
-    str_cursor += n_stored;
+  int e;
+  int i;
+  long val_l[6];
+  char *end;
+  e = 0;
+  end = str;
+  for (i = 0; i < 6 && e == 0; i++) {
+    e = *end != (i == 0 ? '-' : '.') ? E_HIT : 0;
+    if (e == 0) {
+      str = end + 1;
+      val_l[i] = strtol(str, &end, 10);
+      e = end == str || val_l[i] < 0 || val_l[i] > INT32_MAX ? E_HIT : 0;
+    }
   }
-  if ((valid_c & 2) && n_minutes != 0) {
-    space_str = valid_c & 4 ? " " : "";
-    n_stored = sprintf(str_cursor, "%s%dm", space_str, n_minutes);
-    str_cursor += n_stored;
+  if (e == 0) {
+    e = val_l[0] > INT16_MAX || val_l[2] > 1 || val_l[5] > INT8_MAX ? E_HIT : 0;
   }
-  if (valid_c & 1) {
-    space_str = valid_c & 2 ? " " : "";
-    if (n_seconds != 0 || (valid_c & 2) == 0)
-      n_stored = sprintf(str_cursor, "%s%ds", space_str, n_seconds);
+  if (e == 0) {
+    hit->sh_pos = 0;
+    hit->sh_qai = -1; // resolved when listed
+    hit->sh_deck_i = val_l[0];
+    hit->sh_card_i = val_l[1];
+    hit->sh_rank = 0;
+    hit->sh_field = val_l[2];
+    hit->sh_off = val_l[3];
+    hit->sh_len = val_l[4];
+    hit->sh_dist = val_l[5];
+    hit->sh_path = NULL;
+    hit->sh_text = NULL;
+    *end_p = end;
   }
+  return e;
 }
 
-struct XmlGenerator {
-  FILE *w_stream; // write
-  char *w_lineptr;
-  size_t w_n;
+struct Parse {
+  enum Field field;
 };
 
-static void sa_init(struct StringArray *sa)
-{
-  sa->sa_c = 0;
-  sa->sa_d = NULL;
-  sa->sa_n = 0;
-  assert(sizeof(char) == 1);
-}
-
-static void sa_free(struct StringArray *sa)
-{
-  sa->sa_c = 0;
-  free(sa->sa_d);
-  sa->sa_d = NULL;
-  sa->sa_n = 0;
-}
-
-static int gen_xml_category(int16_t deck_i, struct XmlGenerator *xg, struct MemorySurfer *ms, struct IndentStr *inds)
+static int determine_field(struct Multi *mult, struct Parse *parse)
 {
   int e;
-  int rv;
-  struct Deck *cat_ptr;
-  char *str;
-  int32_t data_size;
-  struct Card *card_l;
-  int card_a;
-  int card_i;
-  struct Card *card_ptr;
-  struct StringArray card_sa;
-  struct tm bd_time; // broken-down
-  time_t card_time;
-  char time_str[20]; // 1971-01-01T00:00:00
-  char strength_str[16];
-  char state_ch;
-  char *q_str;
-  char *a_str;
-  rv = fprintf(xg->w_stream, "\n%s<deck>", inds->str);
-  e = rv < 0;
+  e = mult->post_fp <= 0;
   if (e == 0) {
-    e = inds_set(inds, 1, 1);
-    if (e == 0) {
-      cat_ptr = ms->cat_t + deck_i;
-      str = sa_get(&ms->deck_sa, deck_i);
-      e = str == NULL;
+    switch (mult->post_fp) {
+    case 1:
+      if (memcmp(mult->post_lp, "q", 1) == 0) {
+        parse->field = F_Q;
+      } else {
+        e = memcmp(mult->post_lp, "a", 1) != 0;
+        if (e == 0) {
+          parse->field = F_A;
+        }
+      }
+      break;
+    case 3:
+      if (memcmp(mult->post_lp, "hit", 3) == 0) {
+        parse->field = F_HIT;
+      } else {
+        e = memcmp(mult->post_lp, "lvl", 3) != 0;
+        if (e == 0) {
+          parse->field = F_LVL;
+        }
+      }
+      break;
+    case 4:
+      if (memcmp(mult->post_lp, "deck", 4) == 0) {
+        parse->field = F_DECK;
+      } else if (memcmp(mult->post_lp, "page", 4) == 0) {
+        parse->field = F_PAGE;
+      } else if (memcmp(mult->post_lp, "card", 4) == 0) {
+        parse->field = F_CARD;
+      } else if (memcmp(mult->post_lp, "mode", 4) == 0) {
+        parse->field = F_MODE;
+      } else if (memcmp(mult->post_lp, "mctr", 4) == 0) {
+        parse->field = F_MCTR;
+      } else if (memcmp(mult->post_lp, "hits", 4) == 0) {
+        parse->field = F_HITS;
+      } else {
+        e = memcmp(mult->post_lp, "rank", 4) != 0;
+        if (e == 0) {
+          parse->field = F_RANK;
+        }
+      }
+      break;
+    case 5:
+      if (memcmp(mult->post_lp, "event", 5) == 0) {
+        parse->field = F_EVENT;
+      } else if (memcmp(mult->post_lp, "token", 5) == 0) {
+        parse->field = F_TOKEN;
+      } else if (memcmp(mult->post_lp, "scope", 5) == 0) {
+        parse->field = F_SCOPE;
+      } else {
+        e = memcmp(mult->post_lp, "mtime", 5) != 0;
+        if (e == 0) {
+          parse->field = F_MTIME;
+        }
+      }
+      break;
+    case 6:
+      e = memcmp(mult->post_lp, "upload", 6) != 0;
       if (e == 0) {
-        e = xml_escape(&xg->w_lineptr, &xg->w_n, str, ESC_AMP | ESC_LT);
+        parse->field = F_UPLOAD;
+      }
+      break;
+    case 7:
+      if (memcmp(mult->post_lp, "is-html", 7) == 0) {
+        parse->field = F_IS_HTML;
+      } else if (memcmp(mult->post_lp, "arrange", 7) == 0) {
+        parse->field = F_ARRANGE;
+      } else {
+        e = memcmp(mult->post_lp, "timeout", 7) != 0;
         if (e == 0) {
-          rv = fprintf(xg->w_stream, "\n%s<name>%s</name>", inds->str, xg->w_lineptr);
-          e = rv < 0;
-          if (e == 0) {
-            str = sa_get(&ms->style_sa, deck_i);
-            if (str != NULL && str[0] != '\0') {
-              e = xml_escape(&xg->w_lineptr, &xg->w_n, str, ESC_AMP | ESC_LT);
-              if (e == 0) {
-                rv = fprintf(xg->w_stream, "\n%s<style>%s</style>", inds->str, xg->w_lineptr);
-                e = rv < 0;
-              }
-            }
-          }
-          if (e == 0) {
-            data_size = imf_get_size(&ms->imf, cat_ptr->cat_cli);
-            card_l = malloc(data_size);
-            e = card_l == NULL;
-            if (e == 0) {
-              e = imf_get(&ms->imf, cat_ptr->cat_cli, card_l);
-              if (e == 0) {
-                sa_init(&card_sa);
-                card_a = data_size / sizeof(struct Card);
-                card_i = 0;
-                while ((card_i < card_a) && (e == 0))
-                {
-                  card_ptr = card_l + card_i;
-                  e = sa_load(&card_sa, &ms->imf, card_ptr->card_qai);
-                  if (e == 0) {
-                    rv = fprintf(xg->w_stream, "\n%s<card>", inds->str);
-                    e = rv < 0;
-                    if (e == 0) {
-                      memset(&bd_time, 0, sizeof (bd_time));
-                      assert((card_ptr->card_time < INT32_MAX) || (sizeof(card_time) == 8));
-                      card_time = card_ptr->card_time;
-                      e = gmtime_r(&card_time, &bd_time) == NULL;
-                      if (e == 0) {
-                        bd_time.tm_mon += 1;
-                        bd_time.tm_year += 1900;
-                        rv = snprintf(time_str, sizeof(time_str), "%4d-%02d-%02dT%02d:%02d:%02d",
-                            bd_time.tm_year, bd_time.tm_mon, bd_time.tm_mday,
-                            bd_time.tm_hour, bd_time.tm_min, bd_time.tm_sec);
-                        e = rv != 19;
-                        if (e == 0) {
-                          rv = fprintf(xg->w_stream, "\n\t%s<time>%s</time>", inds->str, time_str);
-                          e = rv < 0;
-                          if (e == 0) {
-                            rv = snprintf(strength_str, sizeof(strength_str), "%d", card_ptr->card_strength);
-                            e = rv < 0 || rv >= sizeof(strength_str);
-                            if (e == 0) {
-                              state_ch = '0' + (card_ptr->card_state & 0x07);
-                              rv = fprintf(xg->w_stream, "\n\t%s<strength>%s</strength>", inds->str, strength_str);
-                              e = rv < 0;
-                              if (e == 0) {
-                                rv = fprintf(xg->w_stream, "\n\t%s<state>%c</state>", inds->str, state_ch);
-                                e = rv < 0;
-                              }
-                              if (e == 0 && card_ptr->card_state & 0x08) {
-                                rv = fprintf(xg->w_stream, "\n\t%s<type>1</type>", inds->str);
-                                e = rv < 0;
-                              }
-                              if (e == 0) {
-                                q_str = sa_get(&card_sa, 0);
-                                e = q_str == NULL;
-                                if (e == 0) {
-                                  e = xml_escape(&xg->w_lineptr, &xg->w_n, q_str, ESC_AMP | ESC_LT);
-                                  if (e == 0) {
-                                    rv = fprintf(xg->w_stream, "\n\t%s<question>%s</question>", inds->str, xg->w_lineptr);
-                                    e = rv < 0;
-                                    if (e == 0) {
-                                      a_str = sa_get(&card_sa, 1);
-                                      e = a_str == NULL;
-                                      if (e == 0) {
-                                        e = xml_escape(&xg->w_lineptr, &xg->w_n, a_str, ESC_AMP | ESC_LT);
-                                        if (e == 0) {
-                                          rv = fprintf(xg->w_stream, "\n\t%s<answer>%s</answer></card>", inds->str, xg->w_lineptr);
-                                          e = rv < 0;
-                                          if (e == 0) {
-                                            card_i++;
-                                          }
-                                        }
-                                      }
-                                    }
-                                  }
-                                }
-                              }
-                            }
-                          }
-                        }
-                      }
-                    }
-                  }
-                }
-                sa_free(&card_sa);
-                if (e == 0) {
-                  if (ms->cat_t[deck_i].n_child != -1) {
-                    e = gen_xml_category(ms->cat_t[deck_i].n_child, xg, ms, inds);
-                  }
-                  if (e == 0) {
-                    e = fputs("</deck>", xg->w_stream) <= 0;
-                    if (e == 0) {
-                      e = inds_set(inds, 1, -1);
-                      if (e == 0) {
-                        if (ms->cat_t[deck_i].n_sibling != -1) {
-                          e = gen_xml_category(ms->cat_t[deck_i].n_sibling, xg, ms, inds);
-                        }
-                      }
-                    }
-                  }
-                }
-              }
-              free(card_l);
-            }
-          }
+          parse->field = F_TIMEOUT;
+        }
+      }
+      break;
+    case 8:
+      if (memcmp(mult->post_lp, "mov-card", 8) == 0) {
+        parse->field = F_MOV_CARD;
+      } else if (memcmp(mult->post_lp, "list-pos", 8) == 0) {
+        parse->field = F_LIST_POS;
+      } else if (memcmp(mult->post_lp, "mov-deck", 8) == 0) {
+        parse->field = F_MOVED_CAT;
+      } else {
+        e = memcmp(mult->post_lp, "password", 8) != 0;
+        if (e == 0) {
+          parse->field = F_PASSWORD;
+        }
+      }
+      break;
+    case 9:
+      if (memcmp(mult->post_lp, "deck-name", 9) == 0) {
+        parse->field = F_DECK_NAME;
+      } else if (memcmp(mult->post_lp, "style-txt", 9) == 0) {
+        parse->field = F_STYLE_TXT;
+      } else {
+        e = memcmp(mult->post_lp, "todo_main", 9) != 0;
+        if (e == 0) {
+          parse->field = F_TODO_MAIN;
+        }
+      }
+      break;
+    case 10:
+      if (memcmp(mult->post_lp, "file-title", 10) == 0) {
+        parse->field = F_FILE_TITLE;
+      } else if (memcmp(mult->post_lp, "search-txt", 10) == 0) {
+        parse->field = F_SEARCH_TXT;
+      } else if (memcmp(mult->post_lp, "match-case", 10) == 0) {
+        parse->field = F_MATCH_CASE;
+      } else {
+        e = memcmp(mult->post_lp, "reveal-pos", 10) != 0;
+        if (e == 0) {
+          parse->field = F_REVEAL_POS;
         }
       }
+      break;
+    case 11:
+      if (memcmp(mult->post_lp, "search-mode", 11) == 0) {
+        parse->field = F_SEARCH_MODE;
+      } else if (memcmp(mult->post_lp, "search-dist", 11) == 0) {
+        parse->field = F_SEARCH_DIST;
+      } else {
+        e = memcmp(mult->post_lp, "is-unlocked", 11) != 0;
+        if (e == 0)
+          parse->field = F_IS_UNLOCKED;
+      }
+      break;
+    case 12:
+      e = memcmp(mult->post_lp, "new-password", 12) != 0;
+      if (e == 0) {
+        parse->field = F_NEW_PASSWORD;
+      }
+      break;
+    default:
+      e = E_POST; // malformed form data
+      break;
     }
   }
   return e;
 }
 
-static const struct Timeout timeouts[5] = {
-  { 60, 10 }, // 10m
-  { 60, 60 }, // 1h
-  { 60, 360 }, // 6h
-  { 120, 360 }, //12h
-  { 240, 360 } // 24h
-};
-
-static time_t lvl_s[21] = { // level strength
-  60, // 1m (0)
-  120, // 2m (1)
-  300, // 5m (2)
-  900, // 15m (3)
-  1800, // 30m (4)
-  3600, // 1h (5)
-  14400, // 4h (6)
-  43200, // 12h (7)
-  86400, // 1D (8)
-  172800, // 2D (9)
-  345600, // 4D (10)
-  604800, // 7D (11)
-  1209600, // 14D (12)
-  2592000, // 1M (13)
-  7776000,  // 3M (14)
-  15552000, // 6M (15)
-  31536000, // 1Y (16)
-  63072000, // 2Y (17)
-  157680000, // 5Y (18)
-  315360000, // 10Y (19)
-  630720000 // 20Y (20)
-};
-
-static void print_hex(char *str, uint8_t *data, size_t count)
-{
-  int i;
-  int nibble[2];
-  char ch;
-  str[count * 2] = '\0';
-  while (count--) {
-    nibble[1] = data[count] & 0xf;
-    nibble[0] = data[count] >> 4;
-    i = 2;
-    while (i--) {
-      ch = nibble[i];
-      if (ch >= 10) {
-        ch += 'a' - 10;
-      } else {
-        ch += '0';
-      }
-      str[count * 2 + i] = ch;
-    }
-  }
-}
-
-static int gen_html(struct WebMemorySurfer *wms)
+static int parse_field(struct WebMemorySurfer *wms, struct Multi *mult, struct Parse *parse)
 {
   int e;
-  int rv;
+  int a_n; // assignments
+  int consumed_n;
+  int value;
+  size_t size;
   int i;
-  int j;
-  int k;
-  int lvl; // level
-  int lvl_sel; // select
-  char *q_str;
-  char *a_str;
-  time_t time_diff;
-  char time_diff_str[32];
-  int x;
-  int y;
+  long val;
   char *str;
-  const char *dis_str; // disabled
-  const char *attr_str; // attribute
-  const char *header_str;
-  const char *notice_str;
-  const char *submit_str;
-  char *text_str;
-  char *ext_str;
-  char *dup_str;
-  char title_str[64];
-  FILE *temp_stream;
-  char *temp_filename;
-  char digest_str[41];
-  struct XmlGenerator xg;
-  struct Sha1Context sha1;
-  uint8_t message_digest[SHA1_HASH_SIZE];
-  char *sw_info_str;
-  char mtime_str[17];
-  struct stat file_stat;
-  int n;
-  int dx; // delta
-  int dy;
-  int vby; // viewbox
-  static const char *TIMEOUTS[] = { "10 m", "1 h", "6 h", "12 h", "24 h" };
-  size_t size;
-  size_t len;
-  enum Block bl;
-  static const char *state_str[] = { "Alarm", "Scheduled", "New", "Suspended" };
-  static const char *event_str[] = { "Edit", "Learn", "Search" };
-  char el_str[5]; // "100%"
-  int bl_i; // block index
-  enum SelType sel_type;
+  int hit_a;
+  struct SearchHit *hit_ptr;
   e = 0;
-  mtime_str[0] = '\0';
-  if (wms->ms.imf_filename != NULL) {
-    size = sizeof(struct stat);
-    memset(&file_stat, 0, size);
-    e = stat(wms->ms.imf_filename, &file_stat);
+  switch (parse->field) {
+  case F_FILE_TITLE:
+    e = wms->file_title_str != NULL ? E_RPOFT : 0; // repeated parse of file title
     if (e == 0) {
-      assert(file_stat.st_mtim.tv_sec >= 0 && file_stat.st_mtim.tv_nsec >= 0);
-      size = sizeof(mtime_str);
-      rv = snprintf(mtime_str, size, "%08x%08x", (uint32_t) file_stat.st_mtim.tv_sec, (uint32_t) file_stat.st_mtim.tv_nsec);
-      e = rv != 16;
+      wms->file_title_str = malloc(mult->post_wp);
+      e = wms->file_title_str == NULL;
+      if (e == 0) {
+        assert(mult->post_lp[mult->post_fp] == '\0');
+        memcpy(wms->file_title_str, mult->post_lp, mult->post_wp);
+        e = percent2c(wms->file_title_str, mult->post_fp);
+      }
     }
-  }
-  if (e == 0) {
-    size = sizeof(title_str);
-    rv = snprintf(title_str, size, "MemorySurfer - Welcome");
-    e = rv < 0 || rv >= size;
-    if (wms->file_title_str != NULL && e == 0) {
-      e = xml_escape(&wms->html_lp, &wms->html_n, wms->file_title_str, ESC_AMP | ESC_LT);
+    break;
+  case F_ARRANGE:
+    assert(wms->ms.arrange == -1);
+    a_n = sscanf(mult->post_lp, "%d", &wms->ms.arrange);
+    assert(wms->ms.arrange >= 0 && wms->ms.arrange <= 2);
+    e = a_n != 1;
+    break;
+  case F_DECK_NAME:
+    e = wms->ms.deck_name_str != NULL ? E_FIELD_1 : 0;
+    if (e == 0) {
+      wms->ms.deck_name_str = malloc(mult->post_wp);
+      e = wms->ms.deck_name_str == NULL ? E_FIELD_2 : 0;
       if (e == 0) {
-        rv = snprintf(title_str, size, "MemorySurfer – %s", wms->html_lp);
-        e = rv < 0;
+        assert(mult->post_lp[mult->post_fp] == '\0');
+        memcpy(wms->ms.deck_name_str, mult->post_lp, mult->post_wp);
+        e = percent2c(wms->ms.deck_name_str, mult->post_fp) ? E_FIELD_3 : 0;
       }
     }
-  }
-  if (e == 0) {
-    e = sw_stop(wms->sw_i, &wms->ms.imf.sw);
-    if (e == 0)
-      e = sw_info(&sw_info_str, &wms->ms.imf.sw);
-  }
-  assert(wms->tok_str[0] == '\0' || wms->tok_str[40] == '\0');
-  if (e == 0) {
-    bl_i = 0;
-    while ((bl = block_seq[wms->page][bl_i++]) != B_END && e == 0) {
-      switch (bl) {
-      case B_START_HTML:
-        rv = printf("Content-Type: text/html; charset=utf-8\r\n\r\n"
-                    "<!DOCTYPE html>\n"
-                    "<html lang=\"en\">\n"
-                    "\t<head>\n"
-                    "\t\t<meta charset=\"utf-8\">\n"
-                    "\t\t<title>%s</title>\n"
-                    "\t\t<meta name=\"viewport\" content=\"width=device-width\">\n"
-                    "\t\t<meta name=\"description\" content=\"Open source software to efficiently memorize flashcards.\">\n"
-                    "\t\t<link rel=\"shortcut icon\" href=\"/favicon.ico\">\n"
-                    "\t\t<link rel=\"stylesheet\" type=\"text/css\" href=\"/ms.css\">\n",
-            title_str);
-        e = rv < 0;
-        if ((wms->page == P_PREVIEW || wms->page == P_LEARN) && e == 0) {
-          rv = printf("\t\t<script src=\"/ms.js\" defer></script>\n");
-          e = rv < 0;
-        }
-        if (e == 0 && (wms->page == P_LEARN || wms->page == P_PREVIEW)) {
-          assert(wms->ms.passwd.style_sai < 0 || wms->ms.style_sa.sa_n > 0);
-          str = sa_get(&wms->ms.style_sa, wms->ms.deck_i);
-          if (str != NULL && str[0] != '\0') {
-            rv = printf("\t\t<style>%s</style>\n", str);
-            e = rv < 0;
-          }
-        }
+    break;
+  case F_STYLE_TXT:
+    e = wms->ms.style_txt != NULL;
+    if (e == 0) {
+      wms->ms.style_txt = malloc(mult->post_wp);
+      e = wms->ms.style_txt == NULL;
+      if (e == 0) {
+        assert(mult->post_lp[mult->post_fp] == '\0');
+        memcpy(wms->ms.style_txt, mult->post_lp, mult->post_wp);
+        e = percent2c(wms->ms.style_txt, mult->post_fp);
+      }
+    }
+    break;
+  case F_MOVED_CAT:
+    assert(wms->ms.mov_deck_i == -1);
+    a_n = sscanf(mult->post_lp, "%d", &wms->ms.mov_deck_i);
+    e = a_n != 1;
+    break;
+  case F_SCOPE:
+    e = wms->ms.scope != C_UNDEF ? E_SCOPE_1 : 0;
+    if (e == 0) {
+      a_n = sscanf(mult->post_lp, "%d%n", &wms->ms.scope, &consumed_n);
+      e = a_n != 1 || consumed_n != mult->post_fp || wms->ms.scope < C_CURRENT || wms->ms.scope > C_ALL ? E_SCOPE_2 : 0;
+    }
+    break;
+  case F_SEARCH_MODE:
+    e = wms->ms.search_mode != SM_UNDEF;
+    if (e == 0) {
+      a_n = sscanf(mult->post_lp, "%d%n", &wms->ms.search_mode, &consumed_n);
+      e = a_n != 1 || consumed_n != mult->post_fp || wms->ms.search_mode < SM_LITERAL || wms->ms.search_mode > SM_FUZZY;
+    }
+    break;
+  case F_SEARCH_DIST:
+    e = wms->ms.search_dist != -1;
+    if (e == 0) {
+      a_n = sscanf(mult->post_lp, "%d%n", &wms->ms.search_dist, &consumed_n);
+      e = a_n != 1 || consumed_n != mult->post_fp || wms->ms.search_dist < 1 || wms->ms.search_dist > FZ_DIST_MAX;
+    }
+    break;
+  case F_SEARCH_TXT:
+    e = wms->ms.search_txt != NULL;
+    if (e == 0) {
+      wms->ms.search_txt = malloc(mult->post_wp);
+      e = wms->ms.search_txt == NULL;
+      if (e == 0) {
+        assert(mult->post_lp[mult->post_fp] == '\0');
+        memcpy(wms->ms.search_txt, mult->post_lp, mult->post_wp);
+        e = percent2c(wms->ms.search_txt, mult->post_fp);
+      }
+    }
+    break;
+  case F_MATCH_CASE:
+    e = wms->ms.match_case != -1 || mult->post_fp != 2;
+    if (e == 0) {
+      e = memcmp(mult->post_lp, "on", 2) != 0;
+      if (e == 0) {
+        wms->ms.match_case = 1;
+      }
+    }
+    break;
+  case F_IS_HTML:
+    e = wms->ms.is_html != -1 || mult->post_fp != 2;
+    if (e == 0) {
+      e = memcmp(mult->post_lp, "on", 2) != 0;
+      if (e == 0) {
+        wms->ms.is_html = 1;
+      }
+    }
+    break;
+  case F_IS_UNLOCKED:
+    e = wms->ms.is_unlocked != -1 || mult->post_fp != 2;
+    if (e == 0) {
+      e = memcmp(mult->post_lp, "on", 2) != 0;
+      if (e == 0) {
+        wms->ms.is_unlocked = 1;
+      }
+    }
+    break;
+  case F_DECK:
+    a_n = sscanf(mult->post_lp, "%d%n", &value, &consumed_n);
+    size = DATA_SIZE_MAX / sizeof(struct Deck);
+    e = a_n != 1 || consumed_n != mult->post_fp || value < 0 || value >= size;
+    if (e == 0) {
+      size = value + 1;
+      if (size > wms->ms.deck_flags_n) {
+        wms->ms.deck_flags = realloc(wms->ms.deck_flags, size);
+        e = wms->ms.deck_flags == NULL;
         if (e == 0) {
-          rv = printf("\t\t<link rel=\"license\" href=\"https://www.gnu.org/licenses/old-licenses/gpl-2.0.html\">\n"
-                      "\t</head>\n"
-                      "\t<body id=\"msf\">\n");
-          e = rv < 0;
+          for (i = wms->ms.deck_flags_n; i < size; i++) {
+            wms->ms.deck_flags[i] = 0;
+          }
+          wms->ms.deck_flags_n = size;
         }
-        break;
-      case B_FORM_URLENCODED:
-        rv = printf("\t\t<form enctype=\"application/x-www-form-urlencoded\" method=\"post\" action=\"memorysurfer.cgi\">\n");
-        e = rv < 0;
-        break;
-      case B_FORM_MULTIPART:
-        rv = printf("\t\t<form enctype=\"multipart/form-data\" method=\"post\" action=\"memorysurfer.cgi\">\n");
-        e = rv < 0;
-        break;
-      case B_OPEN_DIV:
-        rv = printf("\t\t\t<div>\n"
-                    "\t\t\t\t<input type=\"hidden\" name=\"page\" value=\"%d\">\n",
-            wms->page);
-        e = rv < 0;
-        if (e == 0 && wms->mode >= M_DEFAULT && wms->mode < M_END) {
-          rv = printf("\t\t\t\t<input type=\"hidden\" name=\"mode\" value=\"%d\">\n", wms->mode);
-          e = rv < 0;
-        }
-        if (e == 0 && wms->file_title_str != NULL) {
-          e = xml_escape(&wms->html_lp, &wms->html_n, wms->file_title_str, ESC_AMP | ESC_QUOT);
+      }
+      if (e == 0) {
+        wms->ms.deck_flags[value] = 1;
+      }
+    }
+    break;
+  case F_CARD:
+    assert(wms->ms.card_i == -1);
+    a_n = sscanf(mult->post_lp, "%d", &wms->ms.card_i);
+    e = a_n != 1;
+    break;
+  case F_HIT: // "deck.card", overrides the position the list was requested at
+    a_n = sscanf(mult->post_lp, "%d.%d%n", &wms->ms.deck_i, &wms->ms.card_i, &consumed_n);
+    e = a_n != 2 || consumed_n != mult->post_fp || wms->ms.deck_i < 0 || wms->ms.card_i < 0;
+    break;
+  case F_HITS: // "mctr" then the hits, see scan_hit
+    e = wms->hit_posted != 0 ? E_HIT : 0;
+    if (e == 0) {
+      val = strtol(mult->post_lp, &str, 10);
+      e = str == mult->post_lp || val < 0 || val > INT32_MAX ? E_HIT : 0;
+      wms->hit_mctr = val;
+      hit_a = 0;
+      while (e == 0 && str < mult->post_lp + mult->post_fp) {
+        if (wms->hit_n == hit_a) {
+          hit_a = hit_a * 2 + 64;
+          hit_ptr = realloc(wms->hit_l, sizeof(struct SearchHit) * hit_a);
+          e = hit_ptr == NULL;
           if (e == 0) {
-            rv = printf("\t\t\t\t<input type=\"hidden\" name=\"file-title\" value=\"%s\">\n", wms->html_lp);
-            e = rv < 0;
+            wms->hit_l = hit_ptr;
           }
         }
-        if (e == 0 && strlen(wms->tok_str) == 40) {
-          rv = printf("\t\t\t\t<input type=\"hidden\" name=\"token\" value=\"%s\">\n", wms->tok_str);
-          e = rv < 0;
-        }
-        if (e == 0 && wms->ms.card_i >= 0 && ((wms->page == P_SELECT_ARRANGE && wms->mode == M_CARD) || (wms->page == P_SELECT_DEST_DECK && wms->mode == M_SEND) || (wms->page == P_SELECT_DEST_DECK && wms->mode == M_PROCEED_SEND) || wms->page == P_EDIT || wms->page == P_PREVIEW || wms->page == P_SEARCH || wms->page == P_LEARN || wms->page == P_MSG || wms->page == P_HISTOGRAM || wms->page == P_TABLE || wms->page == P_STYLE)) {
-          rv = printf("\t\t\t\t<input type=\"hidden\" name=\"card\" value=\"%d\">\n", wms->ms.card_i);
-          e = rv < 0;
-        }
         if (e == 0) {
-          rv = printf("\t\t\t\t<input type=\"hidden\" name=\"mctr\" value=\"%u\">\n", wms->ms.passwd.mctr);
-          e = rv < 0;
-        }
-        if (e == 0 && strlen(mtime_str) == 16) {
-          rv = printf("\t\t\t\t<input type=\"hidden\" name=\"mtime\" value=\"%s\">\n", mtime_str);
-          e = rv < 0;
-        }
-        if (e == 0 && wms->reveal_pos >= 0) {
-          rv = printf("\t\t\t\t<input type=\"hidden\" name=\"reveal-pos\" value=\"%d\">\n", wms->reveal_pos);
-          e = rv < 0;
-        }
-        if (e == 0 && wms->ms.match_case > 0 && wms->page != P_SEARCH) {
-          rv = printf("\t\t\t\t<input type=\"hidden\" name=\"match-case\" value=\"on\">\n");
-          e = rv < 0;
+          e = scan_hit(str, &str, wms->hit_l + wms->hit_n);
+          if (e == 0) {
+            wms->hit_n++;
+          }
         }
-        if (e == 0 && wms->ms.scope >= C_CURRENT && wms->page != P_SEARCH) {
-          rv = printf("\t\t\t\t<input type=\"hidden\" name=\"scope\" value=\"%d\">\n", wms->ms.scope);
-          e = rv < 0;
+      }
+      if (e == 0) {
+        e = str != mult->post_lp + mult->post_fp ? E_HIT : 0;
+      }
+      wms->hit_posted = 1;
+    }
+    break;
+  case F_LIST_POS:
+    assert(wms->list_pos == -1);
+    a_n = sscanf(mult->post_lp, "%d%n", &wms->list_pos, &consumed_n);
+    e = a_n != 1 || consumed_n != mult->post_fp || wms->list_pos < 0;
+    break;
+  case F_MOV_CARD:
+    assert(wms->ms.mov_card_i == -1);
+    a_n = sscanf(mult->post_lp, "%d", &wms->ms.mov_card_i);
+    e = a_n != 1;
+    break;
+  case F_LVL:
+    assert(wms->ms.lvl == -1);
+    a_n = sscanf(mult->post_lp, "%d", &wms->ms.lvl);
+    e = a_n != 1;
+    if (e == 0) {
+      e = wms->ms.lvl < 0 || wms->ms.lvl >= 21;
+      if (e != 0) {
+        e = E_FIELD_4; // lvl assert (failed)
+      }
+    }
+    break;
+  case F_RANK:
+    e = wms->ms.rank != -1;
+    if (e == 0) {
+      a_n = sscanf(mult->post_lp, "%d%n", &wms->ms.rank, &consumed_n);
+      e = a_n != 1 || consumed_n != mult->post_fp || wms->ms.rank < 0 || wms->ms.rank > 20;
+    }
+    break;
+  case F_Q:
+    assert(mult->post_lp[mult->post_fp] == '\0');
+    e = percent2c(mult->post_lp, mult->post_fp);
+    if (e == 0) {
+      e = sa_set(&wms->qa_sa, 0, mult->post_lp);
+    }
+    break;
+  case F_A:
+    assert(mult->post_lp[mult->post_fp] == '\0');
+    e = percent2c(mult->post_lp, mult->post_fp);
+    if (e == 0) {
+      e = sa_set(&wms->qa_sa, 1, mult->post_lp);
+    }
+    break;
+  case F_REVEAL_POS:
+    e = wms->saved_reveal_pos != -1;
+    if (e == 0) {
+      a_n = sscanf(mult->post_lp, "%d", &wms->saved_reveal_pos);
+      e = a_n != 1 || wms->saved_reveal_pos < 0;
+    }
+    if (e == 1) {
+      e = E_FIELD_5; // reveal-pos assert (failed)
+      wms->saved_reveal_pos = -1;
+    }
+    break;
+  case F_TODO_MAIN:
+    assert(wms->todo_main == -1);
+    a_n = sscanf(mult->post_lp, "%d", &wms->todo_main);
+    e = a_n != 1;
+    assert(wms->todo_main >= S_FILE && wms->todo_main <= S_END);
+    break;
+  case F_MCTR:
+    a_n = sscanf(mult->post_lp, "%u%n", &wms->mctr, &consumed_n);
+    e = a_n != 1 || consumed_n != mult->post_fp;
+    break;
+  case F_MTIME:
+    e = mult->post_fp != 16;
+    if (e == 0) {
+      assert(wms->mtime[0] == -1 && wms->mtime[1] == -1);
+      a_n = sscanf(mult->post_lp, "%8x%8x%n", &wms->mtime[1], &wms->mtime[0], &consumed_n);
+      e = a_n != 2 || consumed_n != 16;
+      if (e == 0) {
+        assert(wms->mtime[0] >= 0 && wms->mtime[1] >= 0);
+      }
+    }
+    break;
+  case F_PASSWORD:
+    assert(wms->ms.password == NULL);
+    wms->ms.password = malloc(mult->post_wp);
+    e = wms->ms.password == NULL;
+    if (e == 0) {
+      assert(mult->post_lp[mult->post_fp] == '\0');
+      memcpy(wms->ms.password, mult->post_lp, mult->post_wp);
+      e = percent2c(wms->ms.password, mult->post_fp);
+    }
+    break;
+  case F_NEW_PASSWORD:
+    assert(wms->ms.new_password == NULL);
+    wms->ms.new_password = malloc(mult->post_wp);
+    e = wms->ms.new_password == NULL;
+    if (e == 0) {
+      assert(mult->post_lp[mult->post_fp] == '\0');
+      memcpy(wms->ms.new_password, mult->post_lp, mult->post_wp);
+      e = percent2c(wms->ms.new_password, mult->post_fp);
+    }
+    break;
+  case F_TOKEN:
+    e = mult->post_fp != 40;
+    if (e == 0) {
+      e = scan_hex(wms->tok_digest, mult->post_lp, SHA1_HASH_SIZE);
+    }
+    break;
+  case F_EVENT:
+    switch (mult->post_fp) {
+    case 3:
+      if (memcmp(mult->post_lp, "New", 3) == 0) {
+        wms->seq = S_NEW;
+      } else {
+        e = memcmp(mult->post_lp, "Set", 3) != 0;
+        if (e == 0) {
+          wms->seq = S_SET;
         }
-        if (e == 0 && wms->ms.mov_deck_i >= 0 && (wms->page == P_SELECT_DEST_DECK || (wms->page == P_SELECT_ARRANGE && wms->mode == M_MOVE_DECK))) {
-          rv = printf("\t\t\t\t<input type=\"hidden\" name=\"mov-deck\" value=\"%d\">\n", wms->ms.mov_deck_i);
-          e = rv < 0;
+      }
+      break;
+    case 4:
+      if (memcmp(mult->post_lp, "Show", 4) == 0) {
+        wms->seq = S_SHOW;
+      } else if (memcmp(mult->post_lp, "Base", 4) == 0) {
+        e = wms->from_page != P_FILE;
+        if (e == 0) {
+          wms->seq = S_ASK_BASE;
         }
-        break;
-      case B_HIDDEN_CAT:
-        if (wms->ms.deck_i >= 0) {
-          rv = printf("\t\t\t\t<input type=\"hidden\" name=\"deck\" value=\"%d\">\n", wms->ms.deck_i);
-          e = rv < 0;
+      } else if (memcmp(mult->post_lp, "Mark", 4) == 0) {
+        e = wms->from_page != P_MSG || wms->saved_mode != M_MSG_FILE;
+        if (e == 0) {
+          wms->seq = S_MARK_BASE;
         }
-        break;
-      case B_HIDDEN_ARRANGE:
-        if (wms->ms.arrange >= 0) {
-          rv = printf("\t\t\t\t<input type=\"hidden\" name=\"arrange\" value=\"%d\">\n", wms->ms.arrange);
-          e = rv < 0;
+      } else if (memcmp(mult->post_lp, "List", 4) == 0) {
+        e = wms->from_page != P_SEARCH && wms->from_page != P_SEARCH_LIST;
+        if (e == 0) {
+          wms->seq = S_SEARCH_LIST;
         }
-        break;
-      case B_HIDDEN_CAT_NAME:
-        if (wms->ms.deck_name_str != NULL) {
-          e = xml_escape(&wms->html_lp, &wms->html_n, wms->ms.deck_name_str, ESC_AMP | ESC_QUOT);
-          if (e == 0) {
-            rv = printf("\t\t\t\t<input type=\"hidden\" name=\"deck-name\" value=\"%s\">\n", wms->html_lp);
-            e = rv < 0;
+      } else if (memcmp(mult->post_lp, "Stop", 4) == 0) {
+        if (wms->from_page == P_LEARN) {
+          wms->seq = S_SELECT_LEARN_DECK;
+        } else if (wms->from_page == P_SEARCH || wms->from_page == P_SEARCH_LIST) {
+          wms->seq = S_SELECT_SEARCH_DECK;
+        } else if (wms->from_page == P_SELECT_ARRANGE) {
+          if (wms->saved_mode == M_CARD) {
+            wms->seq = S_EDIT;
+          } else {
+            if (wms->saved_mode == M_MOVE_DECK) {
+              wms->ms.deck_i = wms->ms.mov_deck_i;
+              wms->ms.mov_deck_i = -1;
+            } else {
+              e = wms->saved_mode != M_CREATE_DECK;
+            }
+            if (e == 0) {
+              wms->seq = S_START_DECKS;
+            }
           }
-        }
-        break;
-      case B_HIDDEN_SEARCH_TXT:
-        if (wms->ms.search_txt != NULL && strlen(wms->ms.search_txt) > 0) {
-          e = xml_escape(&wms->html_lp, &wms->html_n, wms->ms.search_txt, ESC_AMP | ESC_QUOT);
+        } else if (wms->from_page == P_SELECT_DEST_DECK) {
+          if (wms->saved_mode == M_SEND) {
+            wms->ms.deck_i = wms->ms.mov_deck_i;
+            wms->ms.card_i = wms->ms.mov_card_i;
+            wms->seq = S_EDIT;
+          } else if (wms->saved_mode == M_PROCEED_SEND) {
+            wms->ms.deck_i = wms->ms.mov_deck_i;
+            wms->ms.card_i = wms->ms.mov_card_i;
+            wms->seq = S_QUESTION;
+          } else {
+            e = wms->saved_mode != M_MOVE;
+            if (e == 0) {
+              wms->ms.deck_i = wms->ms.mov_deck_i;
+              wms->ms.mov_deck_i = -1;
+              wms->seq = S_START_DECKS;
+            }
+          }
+        } else if (wms->from_page == P_CAT_NAME) {
+          wms->seq = S_START_DECKS;
+        } else if (wms->from_page == P_STYLE) {
+          wms->seq = S_PREVIEW;
+        } else if (wms->from_page == P_NEW) {
+          wms->seq = S_CLOSE;
+        } else if (wms->from_page == P_UPLOAD) {
+           wms->seq = S_FILE;
+        } else if (wms->from_page == P_PASSWORD) {
+          if (wms->saved_mode == M_DEFAULT)
+            wms->seq = S_CLOSE;
+          else {
+            e = wms->saved_mode != M_CHANGE_PASSWD;
+            if (e == 0)
+              wms->seq = S_FILE;
+          }
+        } else {
+          e = wms->from_page != P_PREVIEW && wms->from_page != P_EDIT;
           if (e == 0) {
-            rv = printf("\t\t\t\t<input type=\"hidden\" name=\"search-txt\" value=\"%s\">\n", wms->html_lp);
-            e = rv < 0;
+            wms->seq = S_SELECT_EDIT_DECK;
           }
         }
-        break;
-      case B_HIDDEN_MOV_CARD:
-        if (wms->ms.mov_card_i >= 0) {
-          rv = printf("\t\t\t\t<input type=\"hidden\" name=\"mov-card\" value=\"%d\">\n", wms->ms.mov_card_i);
-          e = rv < 0;
-        }
-        break;
-      case B_CLOSE_DIV:
-        if ((wms->page == P_PREVIEW || (wms->page == P_LEARN && wms->mode == M_RATE)) && e == 0) {
-          rv = printf("\t\t\t\t<input type=\"hidden\" name=\"q\" value=\"\">\n"
-                      "\t\t\t\t<input type=\"hidden\" name=\"a\" value=\"\">\n");
-          e = rv < 0;
+      } else if (memcmp(mult->post_lp, "Edit", 4) == 0) {
+        switch (wms->from_page) {
+        case P_START:
+          wms->seq = S_SELECT_EDIT_DECK;
+          break;
+        case P_SELECT_DECK:
+        case P_SEARCH:
+        case P_SEARCH_LIST:
+        case P_HISTOGRAM:
+          wms->seq = S_EDIT;
+          break;
+        case P_TABLE:
+          wms->seq = S_EDIT_SYNC_RANK;
+          break;
+        case P_LEARN:
+        case P_PREVIEW:
+          wms->seq = S_EDIT_SYNC;
+          break;
+        default:
+          e = E_FIELD_6; // unknown from page
         }
-        if (e == 0) {
-          rv = printf("\t\t\t</div>\n");
-          e = rv < 0;
+      } else if (memcmp(mult->post_lp, "Next", 4) == 0) {
+        if (wms->from_page == P_SEARCH_LIST) {
+          wms->seq = S_SEARCH_LIST;
+          wms->ms.search_dir = 1;
+        } else {
+          wms->seq = S_NEXT;
         }
-        break;
-      case B_START:
-        dis_str = wms->file_title_str != NULL ? "" : " disabled";
-        attr_str = wms->ms.n_first != -1 ? "" : " disabled";
-        rv = printf("\t\t\t<h1 class=\"msf\">Start</h1>\n"
-                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"File\">File</button></div>\n"
-                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Decks\"%s>Decks</button></div>\n"
-                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Edit\"%s>Edit</button></div>\n"
-                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Learn\"%s>Learn</button></div>\n"
-                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Search\"%s>Search</button></div>\n"
-                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Preferences\"%s>Preferences</button></div>\n"
-                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"About\">About</button></div>\n"
-                    "\t\t</form>\n"
-                    "\t\t<code class=\"msf\">%s</code>\n"
-                    "\t</body>\n"
-                    "</html>\n",
-            dis_str,
-            attr_str,
-            attr_str,
-            attr_str,
-            dis_str,
-            sw_info_str);
-        e = rv < 0;
-        break;
-      case B_FILE:
-        if (wms->file_title_str != NULL) {
-          dis_str = "";
+      } else if (memcmp(mult->post_lp, "Open", 4) == 0) {
+        if (wms->from_page == P_OPEN) {
+          wms->seq = S_GO_LOGIN;
         } else {
-          dis_str = " disabled";
+          e = wms->from_page != P_FILE;
+          if (e == 0) {
+            wms->seq = S_FILELIST;
+          }
         }
-        rv = printf("\t\t\t<h1 class=\"msf\">File</h1>\n"
-                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"New\"%s>New</button></div>\n"
-                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Open\"%s>Open</button></div>\n"
-                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Password\"%s>Password</button></div>\n"
-                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Import\"%s>Import</button></div>\n"
-                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Export\"%s>Export</button></div>\n"
-                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Remove\"%s>Remove</button></div>\n"
-                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Erase\"%s>Erase</button></div>\n"
-                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Close\"%s>Close</button></div>\n"
-                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Cancel\">Cancel</button></div>\n"
-                    "\t\t</form>\n"
-                    "\t\t<code class=\"msf\" >%s</code>\n"
-                    "\t</body>\n"
-                    "</html>\n",
-            wms->file_title_str == NULL ? "" : " disabled",
-            wms->file_title_str == NULL && wms->fl_c > 0 ? "" : " disabled",
-            dis_str,
-            dis_str,
-            wms->file_title_str != NULL && wms->ms.n_first != -1 ? "" : " disabled",
-            dis_str,
-            wms->file_title_str != NULL && wms->ms.n_first != -1 ? "" : " disabled",
-            dis_str,
-            sw_info_str);
-        e = rv < 0;
-        break;
-      case B_PASSWORD:
-        assert(wms->ms.passwd.pw_flag >= 0);
-        header_str = NULL;
-        notice_str = NULL;
-        x = 0;
-        y = 0;
-        if (wms->ms.passwd.pw_flag > 0) {
-          x = 1;
-          if (wms->mode != M_CHANGE_PASSWD) {
-            header_str = "Enter the password to login";
-            submit_str = "Login";
-          } else {
-            assert(wms->seq == S_GO_CHANGE);
-            header_str = "Change password";
-            notice_str = "Enter the current password";
-            submit_str = "Change";
-            y = 1;
+      } else if (memcmp(mult->post_lp, "Move", 4) == 0) {
+        if (wms->from_page == P_SELECT_DECK) {
+          wms->seq = S_SELECT_DEST_CAT;
+        } else if (wms->from_page == P_SELECT_ARRANGE && wms->saved_mode == M_MOVE_DECK) {
+          wms->seq = S_MOVE_DECK;
+        } else if (wms->from_page == P_EDIT) {
+          wms->seq = S_CARD_ARRANGE;
+        } else {
+          e = wms->from_page != P_SELECT_ARRANGE || wms->saved_mode != M_CARD;
+          if (e == 0) {
+            wms->seq = S_MOVE_CARD;
           }
+        }
+      } else if (memcmp(mult->post_lp, "Send", 4) == 0) {
+        if (wms->from_page == P_EDIT) {
+          wms->seq = S_EDITING_SEND;
         } else {
-          assert(wms->ms.passwd.pw_flag == 0);
-          header_str = "Define password";
-          notice_str = "Define a (initial) password (for this file) (may be empty)";
-          submit_str = "Enter";
-          y = 1;
+          e = wms->from_page != P_SELECT_DEST_DECK;
+          if (e == 0) {
+            if (wms->saved_mode == M_SEND) {
+              wms->seq = S_SEND_CARD;
+            } else {
+              e = wms->saved_mode != M_PROCEED_SEND;
+              if (e == 0) {
+                wms->seq = S_PROCEED_SEND_CARD;
+              }
+            }
+          }
         }
-        assert(wms->mode != M_NONE && header_str != NULL);
-        printf("\t\t\t<h1 class=\"msf\">%s</h1>\n", header_str);
-        if (notice_str != NULL) printf("\t\t\t<p class=\"msf\">%s</p>\n", notice_str);
-        if (x != 0) printf("\t\t\t<div class=\"msf-btns\"><input type=\"text\" name=\"password\" value=\"\" size=25></div>\n");
-        if (wms->mode == M_CHANGE_PASSWD && e == 0) {
-          rv = printf("\t\t\t<p class=\"msf\">Enter a new password</p>\n");
-          e = rv < 0;
+      } else if (memcmp(mult->post_lp, "Done", 4) == 0) {
+        if (wms->from_page == P_TABLE)
+          wms->seq = S_START_SYNC_RANK;
+        else {
+          e = wms->from_page != P_HISTOGRAM;
+          if (e == 0)
+            wms->seq = S_START;
         }
-        if (y != 0) printf("\t\t\t<div class=\"msf-btns\"><input type=\"text\" name=\"new-password\" value=\"\" size=25></div>\n");
+      } else {
+        e = memcmp(mult->post_lp, "File", 4) != 0;
         if (e == 0) {
-          rv = printf("\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"%s\">%s</button>\n"
-                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Stop\">Stop</button></div>\n"
-                      "\t\t</form>\n"
-                      "\t</body>\n"
-                      "</html>\n",
-              submit_str,
-              submit_str);
-          e = rv < 0;
+          wms->seq = S_FILE;
         }
-        break;
-      case B_NEW:
-        assert(wms->seq == S_NEW);
-        size = 14; // 'new-9999.imsf\0'
-        str = malloc(size);
-        e = str == NULL;
-        if (e == 0) {
-          i = 0;
-          do {
-            if (i > 0) {
-              rv = snprintf(str, size, "new-%d.imsf", i);
-            } else
-              rv = snprintf(str, size, "new.imsf");
-            e = rv < 0 || rv >= size;
+      }
+      break;
+    case 5:
+      if (memcmp(mult->post_lp, "Learn", 5) == 0) {
+        if (wms->from_page == P_EDIT) {
+          wms->seq = S_QUESTION_SYNCED;
+        } else if (wms->from_page == P_START) {
+          wms->seq = S_SELECT_LEARN_DECK;
+        } else if (wms->from_page == P_TABLE) {
+          wms->seq = S_QUESTION_RANK;
+        } else if (wms->from_page == P_PREVIEW) {
+          wms->seq = S_QUESTION_SYNC_QA;
+        } else if (wms->from_page == P_SELECT_DECK) {
+          if (wms->saved_mode == M_LEARN) {
+            wms->seq = S_LEARN;
+          } else {
+            e = wms->saved_mode != M_EDIT && wms->saved_mode != M_SEARCH && wms->saved_mode != M_START;
             if (e == 0) {
-              x = 0;
-              for (j = 0; x == 0 && j < wms->fl_c; j++)
-                x = strcmp(wms->fl_v[j], str) == 0;
-              i++;
-              e = i > 9999;
+              wms->seq = S_QUESTION;
             }
-          } while (e == 0 && x == 1);
+          }
+        } else {
+          e = wms->from_page != P_SEARCH && wms->from_page != P_SEARCH_LIST && wms->from_page != P_HISTOGRAM;
           if (e == 0) {
-            ext_str = rindex(str, '.');
-            assert(ext_str != NULL);
-            *ext_str = '\0';
-            rv = printf("\t\t\t<h1 class=\"msf\">Create a New file</h1>\n"
-                        "\t\t\t<div class=\"msf-btns\"><input type=\"text\" name=\"file-title\" value=\"%s\" size=25>.imsf</div>\n"
-                        "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Create\">Create</button>\n"
-                        "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Stop\">Stop</button></div>\n"
-                        "\t\t</form>\n"
-                        "\t\t<code class=\"msf\">%s</code>\n"
-                        "\t</body>\n"
-                        "</html>\n",
-                str,
-                sw_info_str);
-            e = rv < 0;
+            wms->seq = S_QUESTION;
           }
-          free(str);
         }
-        break;
-      case B_OPEN:
-        rv = printf("\t\t\t<h1 class=\"msf\">Open file</h1>\n"
-                    "\t\t\t<ul class=\"msf\">\n");
-        e = rv < 0;
-        for (i = 0; e == 0 && i < wms->fl_c; i++) {
-          e = xml_escape(&wms->html_lp, &wms->html_n, wms->fl_v[i], ESC_AMP | ESC_QUOT);
+      } else if (memcmp(mult->post_lp, "Decks", 5) == 0) {
+        wms->seq = S_START_DECKS;
+      } else if (memcmp(mult->post_lp, "Table", 5) == 0) {
+        if (wms->from_page == P_LEARN) {
+          wms->seq = S_TABLE_SYNC_QA;
+        } else {
+          e = wms->from_page != P_MSG;
           if (e == 0) {
-            rv = printf("\t\t\t\t<li><label class=\"msf-td\"><input type=\"radio\" name=\"file-title\" value=\"%s\">", wms->html_lp);
-            e = rv < 0;
-            if (e == 0) {
-              e = xml_escape(&wms->html_lp, &wms->html_n, wms->fl_v[i], ESC_AMP | ESC_LT);
-              rv = printf("%s</label></li>\n", wms->html_lp);
-              e = rv < 0;
-            }
+            wms->seq = S_TABLE;
           }
         }
-        rv = printf("\t\t\t</ul>\n"
-                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Open\"%s>Open</button>\n"
-                    "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Cancel\">Cancel</button></div>\n"
-                    "\t\t</form>\n"
-                    "\t\t<code class=\"msf\">%s</code>\n"
-                    "\t</body>\n"
-                    "</html>\n",
-            wms->fl_c > 0 ? "" : " disabled",
-            sw_info_str);
-        e = rv < 0;
-        break;
-      case B_UPLOAD:
-        assert(wms->file_title_str != NULL && strlen(wms->tok_str) == 40);
-        rv = printf("\t\t\t<h1 class=\"msf\">Upload</h1>\n"
-                    "\t\t\t<p class=\"msf\">Choose a (previously exported .XML) File to upload (which will be used for the Import)</p>\n"
-                    "\t\t\t<div class=\"msf-btns\"><input type=\"file\" name=\"upload\"></div>\n"
-                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Upload\">Upload</button>\n"
-                    "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Stop\">Stop</button></div>\n"
-                    "\t\t</form>\n"
-                    "\t</body>\n"
-                    "</html>\n");
-        e = rv < 0;
-        break;
-      case B_UPLOAD_REPORT:
-        rv = printf("\t\t\t<h1 class=\"msf\">XML File imported</h1>\n"
-                    "\t\t\t<p class=\"msf\">%d card(s) in %d deck(s) imported</p>\n",
-            wms->card_n,
-            wms->deck_n);
-        e = rv < 0;
-        if (e == 0) {
-          if (wms->posted_message_digest != NULL) {
-            print_hex(digest_str, wms->posted_message_digest, SHA1_HASH_SIZE);
-            rv = printf("\t\t\t<p class=\"msf\">sha1 = %s</p>\n", digest_str);
-            e = rv < 0;
-          }
+      } else if (memcmp(mult->post_lp, "Style", 5) == 0) {
+        wms->seq = S_STYLE;
+      } else if (memcmp(mult->post_lp, "Apply", 5) == 0) {
+        if (wms->from_page == P_PREFERENCES) {
+          wms->seq = S_APPLY;
+        } else {
+          e = wms->from_page != P_STYLE;
           if (e == 0) {
-            rv = printf("\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"OK\">OK</button></div>\n"
-                        "\t\t</form>\n"
-                        "\t\t<code class=\"msf\">%s; chunks=%d, swaps=%d, avg=%d</code>\n"
-                        "\t</body>\n"
-                        "</html>\n",
-                sw_info_str,
-                wms->ms.imf.chunk_count,
-                wms->ms.imf.stat_swap,
-                wms->ms.imf.stat_swap / wms->ms.imf.chunk_count);
-            e = rv < 0;
+            wms->seq = S_STYLE_APPLY;
           }
         }
-        break;
-      case B_EXPORT:
-        size = strlen(DATA_PATH) + 17; // + '/' + 9999999999 + . + temp + '\0'
-        temp_filename = malloc(size);
-        e = temp_filename == NULL;
-        if (e == 0) {
-          rv = snprintf(temp_filename, size, "%s/%ld.temp", DATA_PATH, wms->ms.timestamp);
-          e = rv < 0 || rv >= size;
+      } else if (memcmp(mult->post_lp, "Enter", 5) == 0) {
+        wms->seq = S_ENTER;
+      } else if (memcmp(mult->post_lp, "Login", 5) == 0) {
+        wms->seq = S_LOGIN;
+      } else if (memcmp(mult->post_lp, "Erase", 5) == 0) {
+        if (wms->from_page == P_FILE) {
+          wms->seq = S_ASK_ERASE;
+        } else {
+          e = wms->from_page != P_MSG;
           if (e == 0) {
-            temp_stream = fopen(temp_filename, "w");
-            e = temp_stream == NULL;
-            if (e == 0) {
-              xg.w_stream = temp_stream; // stdout
-              rv = fputs("<memorysurfer>", xg.w_stream);
-              e = rv == EOF;
-              if (e == 0) {
-                e = inds_set(wms->inds, 1, 0);
-                if (e == 0) {
-                  xg.w_lineptr = NULL;
-                  xg.w_n = 0;
-                  if (wms->ms.n_first != -1) {
-                    e = gen_xml_category(wms->ms.n_first, &xg, &wms->ms, wms->inds);
-                  }
-                  if (e == 0) {
-                    rv = fputs("</memorysurfer>", xg.w_stream);
-                    e = rv == EOF;
-                  }
-                  free(xg.w_lineptr);
-                }
-              }
-              rv = fclose(temp_stream);
-              if (e == 0) {
-                e = rv != 0 ? E_EXPOR_1 : 0;
-              }
-            }
-            if (e == 0) {
-              e = sha1_reset(&sha1);
-              if (e == 0) {
-                temp_stream = fopen(temp_filename, "r");
-                e = temp_stream == NULL;
-                if (e == 0) {
-                  do {
-                    len = fread(wms->html_lp, 1, wms->html_n, temp_stream);
-                    e = len == 0 && ferror(temp_stream) != 0;
-                    if (len > 0 && e == 0) {
-                      e = sha1_input(&sha1, (uint8_t*)wms->html_lp, len);
-                    }
-                  } while (feof(temp_stream) == 0 && e == 0);
-                  if (e == 0) {
-                    e = sha1_result(&sha1, message_digest);
-                  }
-                  rv = fclose(temp_stream);
-                  if (e == 0) {
-                    e = rv != 0 ? E_EXPOR_2 : 0;
-                  }
-                }
-              }
-            }
-            if (e == 0) {
-              temp_stream = fopen(temp_filename, "r");
-              e = temp_stream == NULL;
+            if (wms->saved_mode == M_MSG_FILE) {
+              wms->seq = S_ERASE;
+            } else {
+              e = wms->saved_mode != M_MSG_UPLOAD;
               if (e == 0) {
-                e = wms->file_title_str == NULL;
-                if (e == 0) {
-                  dup_str = strdup(wms->file_title_str);
-                  e = dup_str == NULL;
-                  if (e == 0) {
-                    len = strlen(dup_str);
-                    e = len <= 5;
-                    if (e == 0) {
-                      ext_str = strrchr(dup_str, '.');
-                      e = ext_str == NULL || ext_str - dup_str != len - 5 || strcmp(ext_str, ".imsf") != 0;
-                      if (e == 0) {
-                        *ext_str = '\0';
-                        print_hex(digest_str, message_digest, SHA1_HASH_SIZE);
-                        rv = printf("Content-Disposition: attachment; filename=\"%s#sha1-%s.xml\"\r\n"
-                                    "Content-Type: application/xml; charset=utf-8\r\n\r\n",
-                            dup_str, digest_str);
-                        e = rv < 0;
-                        if (e == 0) {
-                          do {
-                            len = fread(wms->html_lp, 1, wms->html_n, temp_stream);
-                            e = len == 0 && ferror(temp_stream) != 0;
-                            if (len > 0 && e == 0) {
-                              size = fwrite(wms->html_lp, 1, len, stdout);
-                              e = size != len;
-                            }
-                          } while (feof(temp_stream) == 0 && e == 0);
-                        }
-                      }
-                    }
-                    free(dup_str);
-                  }
-                }
-                rv = fclose(temp_stream);
-                if (e == 0) {
-                  e = rv != 0 ? E_EXPOR_3 : 0;
-                }
+                wms->seq = S_UPLOAD;
               }
             }
           }
-          free(temp_filename);
         }
-        break;
-      case B_SELECT_ARRANGE:
-        assert(wms->file_title_str != NULL && strlen(wms->tok_str) == 40);
-        if (wms->seq == S_DECKS_CREATE) {
-          submit_str = "Select";
-          text_str = "the deck to create";
-        } else if (wms->seq == S_SELECT_MOVE_ARRANGE) {
-          assert(wms->ms.mov_deck_i >= 0);
-          submit_str = "Move";
-          text_str = "the deck to move";
+      } else if (memcmp(mult->post_lp, "About", 5) == 0) {
+        wms->seq = S_ABOUT;
+      } else if (memcmp(mult->post_lp, "Close", 5) == 0) {
+        wms->seq = S_CLOSE;
+      } else if (memcmp(mult->post_lp, "Delta", 5) == 0) {
+        wms->seq = S_DELTA;
+      } else if (memcmp(mult->post_lp, "Share", 5) == 0) {
+        wms->seq = S_SHARE;
+      } else if (memcmp(mult->post_lp, "Merge", 5) == 0) {
+        if (wms->from_page == P_SELECT_DECK) {
+          wms->seq = S_MERGE;
         } else {
-          assert(wms->seq == S_CARD_ARRANGE);
-          submit_str = "Move";
-          text_str = "the card to move";
+          e = wms->from_page != P_UPLOAD;
+          if (e == 0) {
+            wms->seq = S_MERGE_REPORT;
+          }
         }
-        rv = printf("\t\t\t<h1 class=\"msf\">Select how to arrange %s</h1>\n"
-                    "\t\t\t<div class=\"msf-btns\">\n",
-            text_str);
-        e = rv < 0;
+      } else {
+        e = memcmp(mult->post_lp, "Start", 5) != 0;
         if (e == 0) {
-          for (i = 0; i < 3 && e == 0; i++)
-            if (wms->mode != M_CARD || i != 1) {
-              rv = printf("\t\t\t\t<label class=\"msf-div\"><input type=\"radio\" name=\"arrange\" value=\"%d\"%s>%s</label>\n",
-                  i,
-                  i == wms->ms.arrange ? " checked" : "",
-                  ARRANGE[i]);
-              e = rv < 0;
+          wms->seq = S_NONE;
+        }
+      }
+      break;
+    case 6:
+      if (memcmp(mult->post_lp, "Reveal", 6) == 0) {
+        wms->seq = S_REVEAL;
+      } else if (memcmp(mult->post_lp, "Append", 6) == 0) {
+        wms->seq = S_APPEND;
+      } else if (memcmp(mult->post_lp, "Create", 6) == 0) {
+        if (wms->from_page == P_SELECT_DECK) {
+          wms->seq = S_DECKS_CREATE;
+        } else if (wms->from_page == P_NEW) {
+          wms->seq = S_CREATE;
+        } else {
+          e = wms->from_page != P_CAT_NAME;
+          if (e == 0) {
+            wms->seq = S_CREATE_DECK;
+          }
+        }
+      } else if (memcmp(mult->post_lp, "Cancel", 6) == 0) {
+        if (wms->from_page == P_SELECT_DECK || wms->from_page == P_PREFERENCES) {
+          wms->seq = S_START;
+        } else if (wms->from_page == P_FILE) {
+          if (wms->file_title_str != NULL) {
+            wms->seq = S_START;
+          } else {
+            wms->seq = S_NONE;
+          }
+        } else if (wms->from_page == P_MSG) {
+          if (wms->saved_mode == M_MSG_CARD) {
+            wms->seq = S_EDIT;
+          } else if (wms->saved_mode == M_MSG_DECKS) {
+            wms->seq = S_START_DECKS;
+          } else if (wms->saved_mode == M_MSG_SUSPEND || wms->saved_mode == M_MSG_RESUME) {
+            wms->seq = S_QUESTION;
+          } else if (wms->saved_mode == M_MSG_FILE) {
+            wms->seq = S_FILE;
+          } else {
+            e = wms->saved_mode != M_MSG_UPLOAD;
+            if (e == 0) {
+              wms->seq = S_FILE;
             }
+          }
+        } else {
+          e = wms->from_page != P_OPEN;
           if (e == 0) {
-            rv = printf("\t\t\t</div>\n"
-                        "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"%s\">%s</button>\n"
-                        "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Stop\">Stop</button></div>\n"
-                        "\t\t</form>\n"
-                        "\t\t<code class=\"msf\">%s</code>\n"
-                        "\t</body>\n"
-                        "</html>\n",
-                submit_str,
-                submit_str,
-                sw_info_str);
-            e = rv < 0;
+            wms->seq = S_CLOSE;
           }
         }
-        break;
-      case B_DECK_NAME:
-        assert(wms->file_title_str != NULL && strlen(wms->tok_str) == 40);
-        if (wms->seq == S_DECK_NAME || wms->seq == S_DECKS_CREATE) {
-          header_str = "Enter the name of the deck to create.";
-          text_str = wms->ms.deck_name_str != NULL ? wms->ms.deck_name_str : "";
-          submit_str = "Create";
+      } else if (memcmp(mult->post_lp, "Select", 6) == 0) {
+        if (wms->from_page == P_SELECT_DEST_DECK) {
+          wms->seq = S_SELECT_MOVE_ARRANGE;
         } else {
-          assert(wms->seq == S_DECKS_RENAME && wms->ms.deck_i >= 0 && wms->ms.deck_i < wms->ms.deck_a);
-          header_str = "Enter the name to rename the deck to.";
-          text_str = sa_get(&wms->ms.deck_sa, wms->ms.deck_i);
-          e = text_str == NULL;
-          submit_str = "Rename";
+          e = wms->from_page != P_SELECT_ARRANGE || wms->saved_mode != M_CREATE_DECK;
+          if (e == 0) {
+            wms->seq = S_DECK_NAME;
+          }
         }
-        if (e == 0) {
-          e = xml_escape(&wms->html_lp, &wms->html_n, text_str, ESC_AMP | ESC_QUOT);
+      } else if (memcmp(mult->post_lp, "Delete", 6) == 0) {
+        if (wms->from_page == P_MSG) {
+          if (wms->saved_mode == M_MSG_CARD) {
+            wms->seq = S_DELETE_CARD;
+          } else {
+            e = wms->saved_mode != M_MSG_DECKS;
+            wms->seq = S_DELETE_DECK;
+          }
+        } else if (wms->from_page == P_EDIT) {
+          wms->seq = S_ASK_DELETE_CARD;
+        } else {
+          e = wms->from_page != P_SELECT_DECK;
+          wms->seq = S_ASK_DELETE_DECK;
+        }
+      } else if (memcmp(mult->post_lp, "Rename", 6) == 0) {
+        if (wms->from_page == P_SELECT_DECK) {
+          wms->seq = S_DECKS_RENAME;
+        } else {
+          e = wms->from_page != P_CAT_NAME;
           if (e == 0) {
-            rv = printf("\t\t\t<h1 class=\"msf\">%s</h1>\n"
-                        "\t\t\t<div class=\"msf-btns\"><input type=\"text\" name=\"deck-name\" value=\"%s\" size=25 placeholder=\"Enter deck name here...\"></div>\n"
-                        "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"%s\">%s</button>\n"
-                        "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Stop\">Stop</button></div>\n"
-                        "\t\t</form>\n"
-                        "\t\t<code class=\"msf\">%s</code>\n"
-                        "\t</body>\n"
-                        "</html>\n",
-                header_str,
-                wms->html_lp,
-                submit_str,
-                submit_str,
-                sw_info_str);
-            e = rv < 0;
+            wms->seq = S_RENAME_DECK;
           }
         }
-        break;
-      case B_STYLE:
-        str = sa_get(&wms->ms.style_sa, wms->ms.deck_i);
-        e = xml_escape(&wms->html_lp, &wms->html_n, str, ESC_AMP | ESC_LT);
+      } else if (memcmp(mult->post_lp, "Insert", 6) == 0) {
+        e = wms->from_page != P_EDIT;
         if (e == 0) {
-          rv = printf("\t\t\t<h1 class=\"msf\">Style</h1>\n"
-                      "\t\t\t<p class=\"msf\">Define the (inline) &lt;style&gt; for this deck (and it's cards).</p>\n"
-                      "\t\t\t<div class=\"msf-txtarea\"><textarea class=\"msf\" name=\"style-txt\" rows=\"10\" placeholder=\"div.qa-txt { font-family: serif; }\ndiv.qa-html { background-color: #ffe; }\ndiv#a-html { text-align: center; }\ndiv#q-txt { color: #888; }\n/* ... */\">%s</textarea></div>\n"
-                      "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Apply\">Apply</button>\n"
-                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Stop\">Stop</button></div>\n"
-                      "\t\t</form>\n"
-                      "\t\t<code class=\"msf\">%s</code>\n"
-                      "\t</body>\n"
-                      "</html>\n",
-              wms->html_lp,
-              sw_info_str);
-          e = rv < 0;
+          wms->seq = S_INSERT;
         }
-        break;
-      case B_SELECT_DEST_DECK:
-        assert(wms->file_title_str != NULL && strlen(wms->tok_str) == 40);
-        assert(wms->seq == S_EDITING_SEND || wms->seq == S_SELECT_DEST_CAT || wms->seq == S_SELECT_PROCEED_SEND);
-        assert(wms->ms.mov_deck_i >= 0);
-        switch (wms->mode) {
-        case M_SEND:
-          header_str = "Sending";
-          notice_str = "to move the card to";
-          submit_str = "Send";
-          break;
-        case M_PROCEED_SEND:
-          header_str = "Proceed &amp; Send";
-          notice_str = "to move the rated card to";
-          submit_str = "Send";
-          break;
-        case M_MOVE:
-          header_str = "Moving";
-          notice_str = "where to move";
-          submit_str = "Select";
-          break;
-        default:
-          e = E_GHTML_1; // unexpected mode B_SELECT_DEST_DECK
-          break;
-        }
-        if (e == 0) {
-          assert(strlen(mtime_str) == 16);
-          rv = printf("\t\t\t<h1 class=\"msf\">%s</h1>\n", header_str);
-          e = rv < 0;
+      } else if (memcmp(mult->post_lp, "Export", 6) == 0) {
+        wms->seq = S_EXPORT;
+      } else if (memcmp(mult->post_lp, "Upload", 6) == 0) {
+        wms->seq = S_UPLOAD_REPORT;
+      } else if (memcmp(mult->post_lp, "Toggle", 6) == 0) {
+          e = wms->from_page != P_SELECT_DECK;
           if (e == 0) {
-            rv = printf("\t\t\t<p class=\"msf\">Select the deck %s</p>\n", notice_str);
-            e = rv < 0;
+            wms->seq = S_TOGGLE;
           }
+      } else if (memcmp(mult->post_lp, "Remove", 6) == 0) {
+        if (wms->from_page == P_FILE) {
+          wms->seq = S_ASK_REMOVE;
+        } else {
+          e = wms->from_page != P_MSG;
           if (e == 0) {
-            e = inds_set(wms->inds, 3, 0);
+            e = wms->saved_mode != M_MSG_FILE;
             if (e == 0) {
-              e = gen_html_deck(wms->ms.n_first, H_CHILD, wms, Y_RADIO);
-              if (e == 0) {
-                rv = printf("\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"%s\">%s</button>\n"
-                            "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Stop\">Stop</button></div>\n"
-                            "\t\t</form>\n"
-                            "\t\t<code class=\"msf\">%s</code>\n"
-                            "\t</body>\n"
-                            "</html>\n",
-                    submit_str,
-                    submit_str,
-                    sw_info_str);
-                e = rv < 0;
-              }
+              wms->seq = S_REMOVE;
             }
           }
         }
-        break;
-      case B_SELECT_DECK:
-        sel_type = Y_RADIO;
-        e = wms->file_title_str == NULL || strlen(wms->tok_str) != 40;
+      } else if (memcmp(mult->post_lp, "Resume", 6) == 0) {
+        if (wms->from_page == P_LEARN) {
+          wms->seq = S_ASK_RESUME;
+        } else {
+          e = wms->from_page != P_MSG;
+          wms->seq = S_RESUME;
+        }
+      } else if (memcmp(mult->post_lp, "Search", 6) == 0) {
+        if (wms->from_page == P_EDIT) {
+          wms->seq = S_SEARCH_SYNCED;
+        } else if (wms->from_page == P_START) {
+          wms->seq = S_SELECT_SEARCH_DECK;
+        } else if (wms->from_page == P_LEARN || wms->from_page == P_PREVIEW) {
+          wms->seq = S_SEARCH_SYNC_QA;
+        } else if (wms->from_page == P_TABLE) {
+          wms->seq = S_SEARCH_SYNC_RANK;
+        } else {
+          e = wms->from_page != P_HISTOGRAM && wms->from_page != P_SELECT_DECK && wms->from_page != P_SEARCH_LIST;
+          if (e == 0)
+            wms->seq = S_SEARCH;
+        }
+      } else if (memcmp(mult->post_lp, "Import", 6) == 0) {
+        wms->seq = S_WARN_UPLOAD;
+      } else if (memcmp(mult->post_lp, "Update", 6) == 0) {
+        wms->seq = S_UPDATE;
+      } else {
+        e = memcmp(mult->post_lp, "Change", 6) != 0;
         if (e == 0) {
-          j = 0;
-          switch (wms->mode) {
-          case M_EDIT:
-            header_str = "Select a category to edit";
-            break;
-          case M_LEARN:
-            header_str = "Select a category to learn";
-            j = 1;
-            sel_type = Y_CHECKBOX;
-            break;
-          case M_SEARCH:
-            header_str = "Select a category to search";
-            j = 2;
-            break;
-          case M_START:
-            header_str = "Select a deck (if possible) and / or a action";
-            break;
-          default:
-            e = E_GHTML_2; // unexpected mode B_SELECT_DECK
-            break;
+          wms->seq = S_CHANGE;
+        }
+      }
+      break;
+    case 7:
+      if (memcmp(mult->post_lp, "Proceed", 7) == 0) {
+        wms->seq = S_PROCEED_SYNC_QA;
+      } else if (memcmp(mult->post_lp, "Preview", 7) == 0) {
+        e = wms->from_page != P_EDIT;
+        if (e == 0) {
+          wms->seq = S_PREVIEW_SYNC;
+        }
+      } else if (memcmp(mult->post_lp, "Reverse", 7) == 0) {
+        wms->seq = S_SEARCH;
+        wms->ms.search_dir = -1;
+      } else if (memcmp(mult->post_lp, "Forward", 7) == 0) {
+        wms->seq = S_SEARCH;
+        wms->ms.search_dir = 1;
+      } else if (memcmp(mult->post_lp, "Suspend", 7) == 0) {
+        if (wms->from_page == P_LEARN) {
+          wms->seq = S_ASK_SUSPEND;
+        } else {
+          e = wms->from_page != P_MSG;
+          wms->seq = S_SUSPEND;
+        }
+      } else {
+        e = memcmp(mult->post_lp, "Refresh", 7) != 0;
+        if (e == 0) {
+          if (wms->from_page == P_HISTOGRAM) {
+            wms->seq = S_HISTOGRAM;
+          } else {
+            e = wms->from_page != P_TABLE;
+            if (e == 0)
+              wms->seq = S_TABLE_REFRESH;
           }
-          if (e == 0) {
-            rv = printf("\t\t\t<h1 class=\"msf\">%s</h1>\n", header_str);
-            e = rv < 0;
+        }
+      }
+      break;
+    case 8:
+      if (memcmp(mult->post_lp, "Previous", 8) == 0) {
+        if (wms->from_page == P_SEARCH_LIST) {
+          wms->seq = S_SEARCH_LIST;
+          wms->ms.search_dir = -1;
+        } else {
+          wms->seq = S_PREVIOUS;
+        }
+      } else if (memcmp(mult->post_lp, "Password", 8) == 0) {
+        wms->seq = S_GO_CHANGE;
+      } else if (memcmp(mult->post_lp, "Snapshot", 8) == 0) {
+        wms->seq = S_SNAPSHOT;
+      } else {
+        e = memcmp(mult->post_lp, "Schedule", 8) != 0;
+        if (e == 0) {
+          wms->seq = S_SCHEDULE;
+        }
+      }
+      break;
+    case 11:
+      if (memcmp(mult->post_lp, "Preferences", 11) == 0) {
+        wms->seq = S_PREFERENCES;
+      } else {
+        e = memcmp(mult->post_lp, "ProceedSend", 11) != 0;
+        if (e == 0) {
+          wms->seq = S_SELECT_PROCEED_SEND;
+        }
+      }
+      break;
+    default:
+      if (strncmp(mult->post_lp, "Histogram", 9) == 0) {
+        e = wms->from_page != P_LEARN;
+        if (e == 0)
+          wms->seq = S_HISTOGRAM_SYNC_QA;
+      } else {
+        e = strncmp(mult->post_lp, "OK", 2) != 0;
+        if (e == 0) {
+          if (wms->from_page == P_ABOUT) {
+            if (wms->file_title_str != NULL) {
+              wms->seq = S_START;
+            } else {
+              wms->seq = S_NONE;
+            }
+          } else if (wms->from_page == P_UPLOAD_REPORT) {
+            wms->seq = S_START;
+          } else {
+            e = wms->from_page != P_MSG;
             if (e == 0) {
-              dis_str = wms->ms.n_first >= 0 ? "" : " disabled";
-              if (wms->mode == M_START) {
-                rv = printf("\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Create\">Create</button>\n"
-                            "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Rename\"%s>Rename</button>\n"
-                            "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Move\"%s>Move</button>\n"
-                            "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Delete\"%s>Delete</button>\n"
-                            "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Toggle\"%s>Toggle</button></div>\n",
-                    dis_str,
-                    dis_str,
-                    dis_str,
-                    dis_str);
-                e = rv < 0;
-              }
-              if (e == 0) {
-                e = inds_set(wms->inds, 3, 0);
+              if (wms->saved_mode == M_NONE) {
+                e = wms->todo_main == -1;
                 if (e == 0) {
-                  e = gen_html_deck(wms->ms.n_first, H_CHILD, wms, sel_type);
-                }
-              }
-              if (e == 0) {
-                rv = printf("\t\t\t<div class=\"msf-btns\">");
-                e = rv < 0;
-                for (i = 0; i < 3 && e == 0; i++) {
-                  k = (i + j) % 3;
-                  rv = printf("%s<button class=\"msf\" type=\"submit\" name=\"event\" value=\"%s\"%s>%s</button>\n",
-                      i > 0 ? "\t\t\t\t" : "",
-                      event_str[k],
-                      dis_str,
-                      event_str[k]);
-                  e = rv < 0;
+                  wms->seq = wms->todo_main;
                 }
+              } else if (wms->saved_mode == M_MSG_START) {
+                wms->seq = S_START;
+              } else if (wms->saved_mode == M_MSG_CARD) {
+                wms->seq = S_EDIT;
+              } else if (wms->saved_mode == M_MSG_SELECT_EDIT) {
+                wms->seq = S_SELECT_EDIT_DECK;
+              } else if (wms->saved_mode == M_MSG_SELECT_LEARN || wms->saved_mode == M_MSG_NO_CARD_ELIGIBLE) {
+                wms->seq = S_SELECT_LEARN_DECK;
+              } else if (wms->saved_mode == M_MSG_SELECT_SEARCH) {
+                wms->seq = S_SELECT_SEARCH_DECK;
+              } else {
+                e = wms->saved_mode != M_MSG_DECKS;
                 if (e == 0) {
-                  rv = printf("\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Cancel\">Cancel</button></div>\n"
-                              "\t\t</form>\n"
-                              "\t\t<code class=\"msf\">%s</code>\n"
-                              "\t</body>\n"
-                              "</html>\n",
-                      sw_info_str);
-                  e = rv < 0;
+                  wms->seq = S_START_DECKS;
                 }
               }
             }
           }
         }
-        break;
-      case B_EDIT:
-        q_str = sa_get(&wms->ms.card_sa, 0);
-        a_str = sa_get(&wms->ms.card_sa, 1);
-        e = xml_escape(&wms->html_lp, &wms->html_n, q_str, ESC_AMP | ESC_LT);
-        if (e == 0) {
-          n = 0;
-          assert(wms->ms.deck_a > 0);
-          for (i = 0; i < wms->ms.deck_a && n < 2; i++) {
-            n += wms->ms.cat_t[i].deck_slot_used != 0;
-          }
-          assert(strlen(mtime_str) == 16 && wms->file_title_str != NULL && strlen(wms->tok_str) == 40);
-          rv = printf("\t\t\t<h1 class=\"msf\">Editing</h1>\n"
-                      "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Insert\"%s>Insert</button>\n"
-                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Append\">Append</button>\n"
-                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Delete\"%s>Delete</button>\n"
-                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Previous\"%s>Previous</button>\n"
-                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Next\"%s>Next</button></div>\n"
-                      "\t\t\t<div class=\"msf-txtarea\"><textarea class=\"msf\" name=\"q\" rows=\"10\"%s%s>%s</textarea></div>\n"
-                      "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Schedule\"%s>Schedule</button>\n"
-                      "\t\t\t\t<span class=\"msf-space\"></span>\n"
-                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Set\"%s>Set</button>\n"
-                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Move\"%s>Move</button>\n"
-                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Send\"%s>Send</button></div>\n",
-              wms->ms.card_a > 0 ? "" : " disabled",
-              wms->ms.card_a > 0 ? "" : " disabled",
-              wms->ms.card_a > 0 && wms->ms.card_i > 0 ? "" : " disabled",
-              wms->ms.card_a > 0 && wms->ms.card_i + 1 < wms->ms.card_a ? "" : " disabled",
-              q_str != NULL && q_str[0] == '\0' ? " placeholder=\"Type question here...\"" : "",
-              q_str != NULL ? "" : " disabled",
-              wms->html_lp,
-              wms->ms.card_i >= 0 && wms->ms.card_a > 0 && wms->ms.card_i < wms->ms.card_a && (wms->ms.card_l[wms->ms.card_i].card_state & 0x07) >= STATE_NEW ? "" : " disabled",
-              wms->ms.card_i != wms->ms.mov_card_i ? "" : " disabled",
-              wms->ms.mov_card_i != -1 && wms->ms.card_i != wms->ms.mov_card_i ? "" : " disabled",
-              wms->ms.card_i != -1 && n > 1 ? "" : " disabled");
-          e = rv < 0;
-          if (e == 0) {
-            e = xml_escape(&wms->html_lp, &wms->html_n, a_str, ESC_AMP | ESC_LT);
-            if (e == 0) {
-              rv = printf("\t\t\t<div class=\"msf-txtarea\"><textarea class=\"msf\" name=\"a\" rows=\"10\"%s%s>%s</textarea></div>\n"
-                          "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Learn\"%s>Learn</button>\n"
-                          "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Search\"%s>Search</button>\n"
-                          "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Preview\"%s>Preview</button>\n"
-                          "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Stop\">Stop</button>\n"
-                          "\t\t\t\t<label class=\"msf-div\"><input type=\"checkbox\" name=\"is-html\"%s>HTML</label></div>\n",
-                  a_str != NULL && a_str[0] == '\0' ? " placeholder=\"Type answer here...\"" : "",
-                  a_str != NULL ? "" : " disabled",
-                  wms->html_lp,
-                  wms->ms.card_a > 0 ? "" : " disabled",
-                  wms->ms.card_a > 0 ? "" : " disabled",
-                  wms->ms.card_a > 0 ? "" : " disabled",
-                  wms->ms.card_i >= 0 && wms->ms.card_a > 0 && wms->ms.card_i < wms->ms.card_a && (wms->ms.card_l[wms->ms.card_i].card_state & 0x08) != 0 ? " checked" : "");
-              e = rv < 0;
-              if (e == 0) {
-                imf_info_swaps(&wms->ms.imf);
-                rv = printf("\t\t</form>\n"
-                            "\t\t<code class=\"msf\">%s; chunks=%d, swaps=%d, avg=%d</code>\n"
-                            "\t</body>\n"
-                            "</html>\n",
-                    sw_info_str,
-                    wms->ms.imf.chunk_count,
-                    wms->ms.imf.stat_swap,
-                    wms->ms.imf.stat_swap / wms->ms.imf.chunk_count);
-                e = rv < 0;
-              }
-            }
-          }
-        }
-        break;
-      case B_PREVIEW:
-        q_str = sa_get(&wms->ms.card_sa, 0);
-        a_str = sa_get(&wms->ms.card_sa, 1);
-        e = q_str == NULL || a_str == NULL || strlen(mtime_str) != 16 || wms->file_title_str == NULL || strlen(wms->tok_str) != 40;
+      }
+      break;
+    }
+    break;
+  case F_PAGE:
+    assert(wms->from_page == P_UNDEF);
+    a_n = sscanf(mult->post_lp, "%d", &wms->from_page);
+    e = a_n != 1 || wms->from_page < P_START || wms->from_page > P_SEARCH_LIST;
+    break;
+  case F_MODE:
+    assert(wms->saved_mode == M_NONE);
+    a_n = sscanf(mult->post_lp, "%d", &wms->saved_mode);
+    e = a_n != 1;
+    assert(wms->saved_mode >= M_DEFAULT && wms->saved_mode < M_END);
+    break;
+  case F_TIMEOUT:
+    e = wms->from_page != P_PREFERENCES;
+    if (e == 0) {
+      assert(wms->timeout == -1);
+      a_n = sscanf(mult->post_lp, "%d", &wms->timeout);
+      e = a_n != 1;
+      if (e == 0)
+        assert(wms->timeout >= 0 && wms->timeout < 5);
+    }
+    break;
+  default:
+    e = E_FIELD_7; // unknown Field value
+    break;
+  }
+  return e;
+}
+
+struct Receive {
+  struct Sha1Context rc_sha1; // of the (inflated) upload
+  z_stream rc_z;
+  int rc_gz; // -1 undecided, 0 plain, 1 inflating (gzip), 2 at the end of the gzip stream
+  size_t rc_a; // allocated for upload_d
+  size_t rc_n; // received, at most UPLOAD_MAX
+};
+
+static int upload_grow(struct WebMemorySurfer *wms, struct Receive *rc, size_t size)
+{
+  int e;
+  size_t a;
+  char *upload_d;
+  e = 0;
+  if (size > rc->rc_a) {
+    a = rc->rc_a > 0 ? rc->rc_a : XML_BLOCK;
+    while (a < size)
+      a *= 2;
+    upload_d = realloc(wms->upload_d, a);
+    e = upload_d == NULL;
+    if (e == 0) {
+      wms->upload_d = upload_d;
+      rc->rc_a = a;
+    }
+  }
+  return e;
+}
+
+// appends received bytes to upload_d and its digest, inflated when the upload starts with the gzip magic
+static int upload_put(struct WebMemorySurfer *wms, struct Receive *rc, uint8_t *data, size_t n)
+{
+  int e;
+  int rv;
+  int tv;
+  size_t len;
+  rc->rc_n += n;
+  e = rc->rc_n > UPLOAD_MAX ? E_UPLOAD_3 : 0;
+  if (e == 0 && rc->rc_gz == -1) {
+    rc->rc_gz = n >= 2 && data[0] == 0x1f && data[1] == 0x8b;
+    if (rc->rc_gz == 1) {
+      rc->rc_z.zalloc = Z_NULL;
+      rc->rc_z.zfree = Z_NULL;
+      rc->rc_z.opaque = Z_NULL;
+      rc->rc_z.next_in = Z_NULL;
+      rc->rc_z.avail_in = 0;
+      rv = inflateInit2(&rc->rc_z, 15 + 16); // gzip header
+      if (rv != Z_OK) {
+        rc->rc_gz = 0;
+        e = E_GZIP;
+      }
+    }
+  }
+  if (e == 0) {
+    if (rc->rc_gz == 0) {
+      e = upload_grow(wms, rc, wms->upload_n + n + 1);
+      if (e == 0) {
+        memcpy(wms->upload_d + wms->upload_n, data, n);
+        e = sha1_input(&rc->rc_sha1, data, n);
+        wms->upload_n += n;
+      }
+    } else {
+      e = rc->rc_gz == 2 && n > 0 ? E_GZIP : 0; // trailing data
+      rc->rc_z.next_in = data;
+      rc->rc_z.avail_in = n;
+      tv = rc->rc_gz == 1 && n > 0;
+      while (e == 0 && tv != 0) {
+        e = wms->upload_n + 1 >= INFLATE_MAX ? E_GZIP : 0; // a gzip bomb
         if (e == 0) {
-          e = xml_escape(&wms->html_lp, &wms->html_n, q_str, (wms->ms.card_l[wms->ms.card_i].card_state & 0x08) != 0 ? 0 : ESC_AMP | ESC_LT);
-          if (e == 0) {
-            rv = printf("\t\t\t<h1 class=\"msf\">Preview</h1>\n"
-                        "\t\t\t<div class=\"msf-btns msf-anchor\"><input id=\"msf-unlock\" type=\"checkbox\" name=\"is-unlocked\"%s>\n"
-                        "\t\t\t<label class=\"msf-div\" for=\"msf-unlock\">Unlock</label>\n"
-                        "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Style\">Style</button>\n"
-                        "\t\t\t\t<button id=\"msf-surround\" class=\"msf\" type=\"button\" disabled>Surround</button>\n"
-                        "\t\t\t\t<button id=\"msf-unformat-btn\" class=\"msf\" type=\"button\" disabled>Unformat</button>\n"
-                        "\t\t\t\t<button id=\"msf-br\" class=\"msf\" type=\"button\" disabled>&lt;br&gt;</button>\n"
-                        "\t\t\t\t<div id=\"msf-inl-dlg\" class=\"msf-dlg\">\n"
-                        "\t\t\t\t\t<h1 class=\"msf\">Surround Node</h1>\n"
-                        "\t\t\t\t\t<select id=\"msf-format-inline\">\n"
-                        "\t\t\t\t\t\t<option value=\"DIV\">&lt;div&gt;</option>\n"
-                        "\t\t\t\t\t\t<option value=\"P\">&lt;p&gt;</option>\n"
-                        "\t\t\t\t\t\t<option value=\"PRE\">&lt;pre&gt;</option>\n"
-                        "\t\t\t\t\t\t<option value=\"BLOCKQUOTE\">&lt;blockquote&gt;</option>\n"
-                        "\t\t\t\t\t\t<option value=\"SPAN\">&lt;span&gt;</option>\n"
-                        "\t\t\t\t\t\t<option value=\"CODE\">&lt;code&gt;</option>\n"
-                        "\t\t\t\t\t\t<option value=\"EM\">&lt;em&gt;</option>\n"
-                        "\t\t\t\t\t\t<option value=\"MARK\">&lt;mark&gt;</option>\n"
-                        "\t\t\t\t\t\t<option value=\"STRONG\">&lt;strong&gt;</option>\n"
-                        "\t\t\t\t\t\t<option value=\"CITE\">&lt;cite&gt;</option>\n"
-                        "\t\t\t\t\t\t<option value=\"I\">&lt;i&gt;</option>\n"
-                        "\t\t\t\t\t\t<option value=\"B\">&lt;b&gt;</option>\n"
-                        "\t\t\t\t\t\t<option value=\"U\">&lt;u&gt;</option>\n"
-                        "\t\t\t\t\t</select>\n"
-                        "\t\t\t\t\t<div class=\"msf-btns\"><button id=\"msf-inl-apply\" class=\"msf\" type=\"button\">Apply</button>\n"
-                        "\t\t\t\t\t\t<button id=\"msf-inl-cancel\" class=\"msf\" type=\"button\">Cancel</button></div>\n"
-                        "\t\t\t\t</div>\n"
-                        "\t\t\t</div>\n"
-                        "\t\t\t<div id=\"%s\" class=\"%s\">%s</div>\n",
-                wms->ms.card_i >= 0 && wms->ms.card_a > 0 && wms->ms.card_i < wms->ms.card_a && (wms->ms.card_l[wms->ms.card_i].card_state & 0x08) != 0 ? "" : " disabled",
-                (wms->ms.card_l[wms->ms.card_i].card_state & 0x08) != 0 ? "q-html" : "q-txt",
-                (wms->ms.card_l[wms->ms.card_i].card_state & 0x08) != 0 ? "qa-html" : "qa-txt",
-                wms->html_lp);
-            e = rv < 0;
-          }
+          e = upload_grow(wms, rc, wms->upload_n + 2);
         }
         if (e == 0) {
-          e = xml_escape(&wms->html_lp, &wms->html_n, a_str, (wms->ms.card_l[wms->ms.card_i].card_state & 0x08) != 0 ? 0 : ESC_AMP | ESC_LT);
+          len = rc->rc_a < INFLATE_MAX ? rc->rc_a : INFLATE_MAX;
+          rc->rc_z.next_out = (Bytef *)wms->upload_d + wms->upload_n;
+          rc->rc_z.avail_out = len - wms->upload_n - 1; // '\0'
+          rv = inflate(&rc->rc_z, Z_NO_FLUSH);
+          e = rv != Z_OK && rv != Z_STREAM_END ? E_GZIP : 0;
           if (e == 0) {
-            rv = printf("\t\t\t<div id=\"%s\" class=\"%s\">%s</div>\n",
-                (wms->ms.card_l[wms->ms.card_i].card_state & 0x08) != 0 ? "a-html" : "a-txt",
-                (wms->ms.card_l[wms->ms.card_i].card_state & 0x08) != 0 ? "qa-html" : "qa-txt",
-                wms->html_lp);
-            e = rv < 0;
+            len = (char *)rc->rc_z.next_out - wms->upload_d - wms->upload_n;
+            e = sha1_input(&rc->rc_sha1, (uint8_t *)wms->upload_d + wms->upload_n, len);
+            wms->upload_n += len;
+            tv = rv == Z_OK && (rc->rc_z.avail_in > 0 || rc->rc_z.avail_out == 0);
+            if (rv == Z_STREAM_END) {
+              rc->rc_gz = 2;
+              e = rc->rc_z.avail_in > 0 ? E_GZIP : 0;
+            }
           }
         }
-        if (e == 0) {
-          rv = printf("\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Edit\">Edit</button>\n"
-                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Learn\">Learn</button>\n"
-                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Search\">Search</button>\n"
-                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Stop\">Stop</button></div>\n");
-          e = rv < 0;
-        }
-        if (e == 0) {
-          rv = printf("\t\t</form>\n"
-                      "\t\t<code class=\"msf\">%s; neli: %d</code>\n"
-                      "\t</body>\n"
-                      "</html>\n",
-              sw_info_str,
-              wms->ms.cards_nel);
-          e = rv < 0 ? E_GHTML_3 : 0;
-        }
-        break;
-      case B_SEARCH:
-        e = xml_escape(&wms->html_lp, &wms->html_n, wms->ms.search_txt, ESC_AMP | ESC_QUOT);
-        if (e == 0) {
-          assert(wms->file_title_str != NULL && strlen(wms->tok_str) == 40);
-          assert(wms->ms.match_case == -1 || wms->ms.match_case == 1);
-          rv = printf("\t\t\t<h1 class=\"msf\">Searching</h1>\n"
-                      "\t\t\t<div class=\"msf-btns\"><input class=\"msf\" type=\"text\" name=\"search-txt\" value=\"%s\" size=25>\n"
-                      "\t\t\t\t<label class=\"msf-div\"><input type=\"checkbox\" name=\"match-case\"%s>Match&nbsp;Case</label></div>\n",
-              wms->html_lp,
-              wms->ms.match_case > 0 ? " checked" : "");
-          e = rv < 0;
-          if (e == 0) {
-            q_str = sa_get(&wms->ms.card_sa, 0);
-            a_str = sa_get(&wms->ms.card_sa, 1);
-            e = xml_escape(&wms->html_lp, &wms->html_n, q_str, ESC_AMP | ESC_LT);
-            if (e == 0) {
-              rv = printf("\t\t\t<div class=\"msf-txtarea\"><textarea class=\"msf\" rows=\"10\"%s>%s</textarea></div>\n"
-                          "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Reverse\"%s>Reverse</button>\n"
-                          "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Forward\"%s>Forward</button>\n"
-                          "\t\t\t\t<span class=\"msf-space\"></span>\n",
-                  wms->found_str != NULL ? " readonly" : " disabled",
-                  wms->html_lp,
-                  wms->ms.card_a > 0 || wms->ms.scope == C_ALL ? "" : " disabled",
-                  wms->ms.card_a > 0 || wms->ms.scope == C_ALL ? "" : " disabled");
-              e = rv < 0;
-              j = wms->ms.scope >= C_CURRENT && wms->ms.scope <= C_ALL ? wms->ms.scope : 0;
-              for (i = C_CURRENT; i <= C_ALL && e == 0; i++) {
-                if (i != C_CHECKED) {
-                  rv = printf("\t\t\t\t<input id=\"msf-scope-%d\" type=\"radio\" name=\"scope\" value=\"%d\"%s%s>\n"
-                              "\t\t\t\t<label class=\"msf-div\" for=\"msf-scope-%d\">%s</label>\n",
-                      i, i,
-                      i == j ? " checked" : "",
-                      i == 1 ? " disabled" : "",
-                      i, SCOPE[i]);
-                  e = rv < 0;
-                }
-              }
+      }
+    }
+  }
+  return e;
+}
+
+static int parse_post(struct WebMemorySurfer *wms)
+{
+  int e;
+  int rv; // return value
+  char *str;
+  enum Stage stage;
+  size_t len;
+  size_t size;
+  struct Multi *mult;
+  char *boundary_str;
+  char delim_str[80]; // \r\n--%s\r\n
+  uint8_t *recv_d; // received, but possibly part of the delimiter
+  size_t recv_n;
+  struct Receive rc;
+  int i;
+  int j;
+  int ch;
+  int tv; // test value
+  struct Parse *parse;
+  boundary_str = NULL;
+  mult = NULL;
+  parse = NULL;
+  str = getenv("CONTENT_LENGTH");
+  e = str != NULL && strtoull(str, NULL, 10) > UPLOAD_MAX ? E_PARSE_4 : 0; // refused before anything is buffered
+  if (e == 0) {
+    size = sizeof(struct Multi);
+    mult = malloc(size);
+    size = sizeof(struct Parse);
+    parse = malloc(size);
+    e = mult == NULL || parse == NULL;
+  }
+  if (e == 0) {
+    mult->post_lp = NULL;
+    mult->post_n = 0;
+    mult->delim_str[0] = "=";
+    mult->delim_str[1] = "--";
+    stage = T_NULL;
+    parse->field = F_UNKNOWN;
+    do {
+      e = multi_delim(mult);
+      if (mult->nread_del > 0 && e == 0) {
+        e = append_part(wms, mult);
+      }
+      if (e == 0) {
+        switch (stage) {
+        case T_NULL:
+          if (mult->nread_del > 0) {
+            if (mult->post_fp > 0 && mult->post_lp[mult->post_fp] == '=') {
+              stage = T_URLENCODE_EQUALS;
+            } else {
+              e = mult->post_fp != 0 || mult->nread_del != 2 || memcmp(mult->post_lp, "--", 2) != 0;
               if (e == 0) {
-                e = xml_escape(&wms->html_lp, &wms->html_n, a_str, ESC_AMP | ESC_LT);
-                if (e == 0) {
-                  rv = printf("\t\t\t</div>\n"
-                              "\t\t\t<div class=\"msf-txtarea\"><textarea class=\"msf\" rows=\"10\"%s>%s</textarea></div>\n"
-                              "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Edit\">Edit</button>\n"
-                              "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Learn\"%s>Learn</button>\n"
-                              "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Stop\">Stop</button></div>\n"
-                              "\t\t</form>\n"
-                              "\t\t<code class=\"msf\">%s</code>\n"
-                              "\t</body>\n"
-                              "</html>\n",
-                      wms->found_str != NULL ? " readonly" : " disabled",
-                      wms->html_lp,
-                      wms->ms.card_a > 0 ? "" : " disabled",
-                      sw_info_str);
-                  e = rv < 0;
-                }
+                stage = T_BOUNDARY_INIT;
+                mult->delim_str[0] = "\r\n";
+                mult->delim_str[1] = NULL;
+                break;
+              } else {
+                break;
               }
             }
+          } else {
+            break;
           }
-        }
-        break;
-      case B_PREFERENCES:
-        assert(wms->file_title_str != NULL && strlen(wms->tok_str) == 40);
-        rv = printf("\t\t\t<h1 class=\"msf\">Preferences</h1>\n"
-                    "\t\t\t<p class=\"msf\">Timeout</p>\n"
-                    "\t\t\t<div>\n");
-        e = rv < 0;
-        if (e == 0) {
-          j = -1;
-          for (i = 0; i < 5 && j == -1; i++) {
-            if (timeouts[i].to_sec * timeouts[i].to_count >= wms->ms.passwd.timeout.to_count * wms->ms.passwd.timeout.to_sec) {
-              j = i;
+        case T_URLENCODE_EQUALS:
+          if (mult->post_fp >= 0)
+            str = mult->post_lp + mult->post_fp;
+          else if (parse->field != F_UNKNOWN)
+            str = "&";
+          else
+            str = NULL;
+          if (str != NULL) {
+            if (memcmp (str, "=", 1) == 0) {
+              assert(parse->field == F_UNKNOWN);
+              e = mult->post_fp < 0;
+              if (e == 0) {
+                e = determine_field(mult, parse);
+                if (e == 0) {
+                  stage = T_URLENCODE_AMP;
+                  mult->delim_str[0] = "&";
+                  mult->delim_str[1] = NULL;
+                }
+              }
             }
           }
-          if (j == -1) {
-            j = 1;
+          break;
+        case T_URLENCODE_AMP:
+          if (mult->post_fp >= 0)
+            str = mult->post_lp + mult->post_fp;
+          else if (parse->field != F_UNKNOWN)
+            str = "&";
+          else
+            str = NULL;
+          if (str != NULL) {
+            if (memcmp (str, "&", 1) == 0) {
+              e = strncmp(str, "&", 1) != 0;
+              if (e == 0) {
+                if (mult->post_fp < 0) {
+                  mult->post_fp = mult->post_wp;
+                  mult->post_wp++;
+                  e = mult->post_wp < 0 || mult->post_wp >= mult->post_n;
+                }
+                if (e == 0) {
+                  mult->post_lp[mult->post_fp] = '\0';
+                  e = parse_field(wms, mult, parse);
+                  if (e == 0) {
+                    parse->field = F_UNKNOWN;
+                    stage = T_URLENCODE_EQUALS;
+                    mult->delim_str[0] = "=";
+                    mult->delim_str[1] = NULL;
+                  }
+                }
+              }
+            }
           }
-          for (i = 0; i < 5 && e == 0; i++) {
-            attr_str = i == j ? " checked" : "";
-            rv = printf("\t\t\t\t<label class=\"msf-td\"><input type=\"radio\" name=\"timeout\" value=\"%d\"%s>%s</label>\n",
-                i,
-                attr_str,
-                TIMEOUTS[i]);
-            e = rv < 0;
+          break;
+        case T_BOUNDARY_INIT:
+          e = mult->post_fp < 0; // "\r\n"
+          if (e == 0) {
+            assert(boundary_str == NULL);
+            size = mult->nread_del - 1;
+            e = size <= 71 ? 0 : E_PARSE_1; // boundary exceeded
+            if (e == 0) {
+              boundary_str = malloc(size);
+              e = boundary_str == NULL;
+              if (e == 0) {
+                memcpy(boundary_str, mult->post_lp, mult->nread_del - 2);
+                boundary_str[mult->nread_del - 2] = '\0';
+                stage = T_CONTENT;
+                mult->delim_str[0] = "; ";
+                mult->delim_str[1] = NULL;
+              }
+            }
           }
+          break;
+        case T_CONTENT:
+          e = mult->post_fp != 30; // "; "
           if (e == 0) {
-            rv = printf("\t\t\t</div>\n"
-                        "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Apply\">Apply</button>\n"
-                        "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Cancel\">Cancel</button></div>\n"
-                        "\t\t</form>\n"
-                        "\t\t<code class=\"msf\">%s</code>\n"
-                        "\t</body>\n"
-                        "</html>\n",
-                sw_info_str);
-            e = rv < 0;
+            e = strncmp(mult->post_lp, "Content-Disposition: form-data", 30) != 0;
+            if (e == 0) {
+              stage = T_NAME;
+              mult->delim_str[0] = "=\"";
+            }
           }
-        }
-        break;
-      case B_ABOUT:
-        rv = printf("\t\t\t<h1 class=\"msf\">About <a href=\"https://www.lorenz-pullwitt.de/MemorySurfer/\">MemorySurfer</a> v%08x</h1>\n"
-                    "\t\t\t<p class=\"msf\">Author: Lorenz Pullwitt</p>\n"
-                    "\t\t\t<p class=\"msf\">Copyright 2016-2024</p>\n"
-                    "\t\t\t<p class=\"msf\">Send bugs and suggestions to\n"
-                    "<a href=\"mailto:memorysurfer@lorenz-pullwitt.de\">memorysurfer@lorenz-pullwitt.de</a></p>\n"
-                    "\t\t\t<cite class=\"msf\">MemorySurfer is free software; you can redistribute it and/or\n"
-                    "modify it under the terms of the GNU\302\240General\302\240Public\302\240License\n"
-                    "as published by the Free\302\240Software\302\240Foundation; either version 2\n"
-                    "of the License, or (at your option) any later version.</cite>\n"
-                    "\t\t\t<cite class=\"msf\">This program is distributed in the hope that it will be useful,\n"
-                    "but WITHOUT ANY WARRANTY; without even the implied warranty of\n"
-                    "MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the\n"
-                    "<a href=\"https://www.gnu.org/licenses/\">GNU\302\240General\302\240Public\302\240License</a> for more details.</cite>\n"
-                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"OK\">OK</button></div>\n"
-                    "\t\t</form>\n"
-                    "\t\t<code class=\"msf\">%s, PATH_MAX=%u</code>\n"
-                    "\t</body>\n"
-                    "</html>\n",
-            MSF_VERSION,
-            sw_info_str,
-            PATH_MAX);
-        e = rv < 0;
-        break;
-      case B_LEARN:
-        q_str = sa_get(&wms->ms.card_sa, 0);
-        a_str = sa_get(&wms->ms.card_sa, 1);
-        e = q_str == NULL || a_str == NULL || strlen(mtime_str) != 16 || wms->file_title_str == NULL || strlen(wms->tok_str) != 40 || wms->ms.deck_path == NULL ? E_GHTML_4 : 0;
-        if (e == 0) {
-          if (wms->mode == M_ASK) {
-            header_str = "Asking";
-          } else {
-            e = wms->mode != M_RATE ? E_GHTML_5 : 0;
+          break;
+        case T_NAME:
+          e = mult->post_fp != 4; // "=\""
+          if (e == 0) {
+            e = strncmp(mult->post_lp, "name", 4) != 0;
             if (e == 0) {
-              header_str = "Rating";
+              stage = T_NAME_QUOT;
+              mult->delim_str[0] = "\"";
+              mult->delim_str[1] = NULL;
             }
           }
+          break;
+        case T_NAME_QUOT:
+          e = mult->post_fp < 0; // "\""
           if (e == 0) {
-            rv = printf("\t\t\t<h1 class=\"msf\">%s</h1>\n"
-                        "\t\t\t<div class=\"msf-btns msf-anchor\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Proceed\"%s>Proceed</button>\n"
-                        "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Show\"%s>Show</button>\n"
-                        "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Reveal\"%s>Reveal</button>\n"
-                        "\t\t\t\t<span class=\"msf-space\"></span>\n"
-                        "\t\t\t\t<input id=\"msf-unlock\" type=\"checkbox\" name=\"is-unlocked\"%s>\n"
-                        "\t\t\t\t<label class=\"msf-div\" for=\"msf-unlock\">Unlock</label>\n"
-                        "\t\t\t\t<button id=\"msf-menu\" class=\"msf\" type=\"button\">☰</button>\n"
-                        "\t\t\t\t<div id=\"msf-data\" class=\"msf-dlg\">\n"
-                        "\t\t\t\t\t<h1 class=\"msf\">Data Views</h1>\n"
-                        "\t\t\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Histogram\">Histogram</button>\n"
-                        "\t\t\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Table\">Table</button>\n"
-                        "\t\t\t\t\t\t<span class=\"msf-space\"></span>\n"
-                        "\t\t\t\t\t\t<input id=\"msf-tools-cbox\" type=\"checkbox\"%s>\n"
-                        "\t\t\t\t\t\t<label class=\"msf-div\" for=\"msf-tools-cbox\">Tools</label></div>\n"
-                        "\t\t\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"ProceedSend\" style=\"max-width:min-content;\"%s>Proceed&amp;Send</button>\n"
-                        "\t\t\t\t\t\t<span class=\"msf-space\"></span>\n"
-                        "\t\t\t\t\t\t<button id=\"msf-data-close\" class=\"msf\" type=\"button\">Close</button></div>\n"
-                        "\t\t\t\t</div>\n"
-                        "\t\t\t</div>\n"
-                        "\t\t\t<div id=\"msf-tools\" class=\"msf-btns msf-anchor\" style=\"display: none;\"><button id=\"msf-surround\" class=\"msf\" type=\"button\" disabled>Surround</button>\n"
-                        "\t\t\t\t<button id=\"msf-unformat-btn\" class=\"msf\" type=\"button\" disabled>Unformat</button>\n"
-                        "\t\t\t\t<button id=\"msf-br\" class=\"msf\" type=\"button\" disabled>&lt;br&gt;</button>\n"
-                        "\t\t\t\t<div id=\"msf-inl-dlg\" class=\"msf-dlg\">\n"
-                        "\t\t\t\t\t<h1 class=\"msf\">Surround Node</h1>\n"
-                        "\t\t\t\t\t<select id=\"msf-format-inline\">\n"
-                        "\t\t\t\t\t\t<option value=\"DIV\">&lt;div&gt;</option>\n"
-                        "\t\t\t\t\t\t<option value=\"P\">&lt;p&gt;</option>\n"
-                        "\t\t\t\t\t\t<option value=\"PRE\">&lt;pre&gt;</option>\n"
-                        "\t\t\t\t\t\t<option value=\"BLOCKQUOTE\">&lt;blockquote&gt;</option>\n"
-                        "\t\t\t\t\t\t<option value=\"SPAN\">&lt;span&gt;</option>\n"
-                        "\t\t\t\t\t\t<option value=\"CODE\">&lt;code&gt;</option>\n"
-                        "\t\t\t\t\t\t<option value=\"EM\">&lt;em&gt;</option>\n"
-                        "\t\t\t\t\t\t<option value=\"MARK\">&lt;mark&gt;</option>\n"
-                        "\t\t\t\t\t\t<option value=\"STRONG\">&lt;strong&gt;</option>\n"
-                        "\t\t\t\t\t\t<option value=\"CITE\">&lt;cite&gt;</option>\n"
-                        "\t\t\t\t\t\t<option value=\"I\">&lt;i&gt;</option>\n"
-                        "\t\t\t\t\t\t<option value=\"B\">&lt;b&gt;</option>\n"
-                        "\t\t\t\t\t\t<option value=\"U\">&lt;u&gt;</option>\n"
-                        "\t\t\t\t\t</select>\n"
-                        "\t\t\t\t\t<div class=\"msf-btns\"><button id=\"msf-inl-apply\" class=\"msf\" type=\"button\">Apply</button>\n"
-                        "\t\t\t\t\t\t<button id=\"msf-inl-cancel\" class=\"msf\" type=\"button\">Cancel</button></div>\n"
-                        "\t\t\t\t</div>\n"
-                        "\t\t\t</div>\n",
-                header_str,
-                wms->mode != M_RATE ? " disabled" : "",
-                wms->mode != M_ASK ? " disabled" : "",
-                wms->mode != M_ASK ? " disabled" : "",
-                wms->ms.card_i >= 0 && wms->ms.card_a > 0 && wms->ms.card_i < wms->ms.card_a && (wms->ms.card_l[wms->ms.card_i].card_state & 0x08) != 0 && wms->mode == M_RATE ? "" : " disabled",
-                wms->mode != M_RATE ? " disabled" : "",
-                wms->mode != M_RATE ? " disabled" : "");
-            e = rv < 0 ? E_GHTML_6 : 0;
+            e = determine_field(mult, parse);
+            if (e == 0) {
+              if (parse->field != F_UPLOAD) {
+                stage = T_VALUE_START;
+                mult->delim_str[0] = "\r\n\r\n";
+                mult->delim_str[1] = NULL;
+              } else {
+                stage = T_FILENAME;
+                mult->delim_str[0] = "; filename=\"";
+                mult->delim_str[1] = NULL;
+              }
+            }
+          }
+          break;
+        case T_VALUE_START:
+          e = mult->post_fp != 0;
+          if (e == 0) {
+            stage = T_VALUE_CRLFMINUSMINUS;
+            mult->delim_str[0] = "\r\n--";
+            mult->delim_str[1] = NULL;
           }
+          break;
+        case T_VALUE_CRLFMINUSMINUS:
+          e = mult->post_fp < 0;
           if (e == 0) {
-            e = xml_escape(&wms->html_lp, &wms->html_n, q_str, (wms->ms.card_l[wms->ms.card_i].card_state & 0x08) != 0 ? 0 : ESC_AMP | ESC_LT) ? E_GENLRN_1 : 0;
+            mult->post_lp[mult->post_fp] = '\0';
+            assert(mult->post_wp == mult->post_fp + 4);
+            mult->post_wp = mult->post_fp + 1;
+            e = parse_field(wms, mult, parse);
             if (e == 0) {
-              rv = printf("\t\t\t<div id=\"%s\" class=\"%s\">%s</div>\n"
-                          "\t\t\t<table>\n",
-                  (wms->ms.card_l[wms->ms.card_i].card_state & 0x08) != 0 ? "q-html" : "q-txt",
-                  (wms->ms.card_l[wms->ms.card_i].card_state & 0x08) != 0 ? "qa-html" : "qa-txt",
-                  wms->html_lp);
-              e = rv < 0 ? E_GENLRN_2 : 0;
+              stage = T_BOUNDARY_CHECK;
+              mult->delim_str[0] = "\r\n";
+            }
+          }
+          break;
+        case T_FILENAME:
+          e = mult->post_fp != 0;
+          if (e == 0) {
+            stage = T_FILENAME_QUOT;
+            mult->delim_str[0] = "\"\r\n";
+            mult->delim_str[1] = NULL;
+          }
+          break;
+        case T_FILENAME_QUOT:
+          tv = mult->post_fp <= 4;
+          if (tv == 0) {
+            mult->post_lp[mult->post_fp] = '\0';
+            str = strrchr(mult->post_lp, '.');
+            len = mult->post_fp; // the end of the extension
+            if (str != NULL && strcmp(str, ".gz") == 0) { // compressed (upload_put)
+              len = str - mult->post_lp;
+              mult->post_lp[len] = '\0';
+              str = strrchr(mult->post_lp, '.');
+            }
+            tv = str == NULL;
+            if (tv == 0) {
+              i = str - mult->post_lp;
+              assert(i > 0 && len >= i);
+              len -= i;
+              tv = (len != 4 || strncmp(str, ".xml", 4) != 0) && (len != 5 || strncmp(str, ".msfs", 5) != 0);
+            }
+            if (tv == 0) {
+              str = strrchr(mult->post_lp, '#');
+              if (str != NULL && strncmp(str, "#sha1-", 6) == 0) {
+                j = str - mult->post_lp + 6;
+                assert(i >= j);
+                len = i - j;
+                size = SHA1_HASH_SIZE * 2;
+                e = len < size ? E_HASH_1 : 0;
+                if (e == 0) {
+                  e = wms->posted_message_digest != NULL ? E_HASH_2 : 0;
+                  if (e == 0) {
+                    wms->posted_message_digest = malloc(SHA1_HASH_SIZE);
+                    e = wms->posted_message_digest == NULL;
+                    if (e == 0) {
+                      e = scan_hex(wms->posted_message_digest, mult->post_lp + j, SHA1_HASH_SIZE);
+                    }
+                  }
+                }
+              }
+            }
+          }
+          if (e == 0) {
+            stage = T_VALUE_XML;
+            mult->delim_str[0] = "\r\n\r\n";
+            mult->delim_str[1] = NULL;
+          }
+          break;
+        case T_VALUE_XML:
+          e = mult->post_fp < 0 || parse->field != F_UPLOAD; // "\r\n\r\n"
+          if (e == 0) {
+            e = mult->post_fp != 38 || strncmp(mult->post_lp, "Content-Type: application/octet-stream", 38) != 0;
+            if (e == 1) {
+              e = mult->post_fp != 22 || strncmp(mult->post_lp, "Content-Type: text/xml", 22) != 0;
+              if (e == 1) {
+                e = mult->post_fp != 29 || strncmp(mult->post_lp, "Content-Type: application/xml", 29) != 0;
+                if (e == 1) {
+                  e = mult->post_fp != 30 || strncmp(mult->post_lp, "Content-Type: application/gzip", 30) != 0;
+                  if (e == 1) {
+                    e = mult->post_fp != 32 || strncmp(mult->post_lp, "Content-Type: application/x-gzip", 32) != 0;
+                  }
+                }
+              }
+            }
+          }
+          if (e == 0) {
+            len = strlen(boundary_str);
+            assert(len > 0 && len <= 70);
+            rv = snprintf(delim_str, sizeof(delim_str), "\r\n--%s\r\n", boundary_str);
+            e = rv < 0 || rv >= sizeof(delim_str);
+            if (e == 0) {
+              e = wms->upload_d != NULL ? E_PARSE_2 : sha1_reset(&rc.rc_sha1);
+            }
+            if (e == 0) {
+              size = rv + XML_BLOCK;
+              recv_d = malloc(size);
+              e = recv_d == NULL;
+              if (e == 0) {
+                rc.rc_gz = -1;
+                rc.rc_a = 0;
+                rc.rc_n = 0;
+                recv_n = 0;
+                tv = 0;
+                while (e == 0 && tv == 0) {
+                  ch = fgetc(stdin);
+                  e = ch == EOF;
+                  if (e == 0) {
+                    recv_d[recv_n++] = ch;
+                    if (ch == '\n' && recv_n >= rv) {
+                      tv = memcmp(recv_d + recv_n - rv, delim_str, rv) == 0;
+                    }
+                    if (tv == 0 && recv_n == size) {
+                      e = upload_put(wms, &rc, recv_d, XML_BLOCK); // what cannot be part of the delimiter
+                      memmove(recv_d, recv_d + XML_BLOCK, rv);
+                      recv_n = rv;
+                    }
+                  }
+                }
+                if (e == 0) {
+                  e = upload_put(wms, &rc, recv_d, recv_n - rv);
+                  if (e == 0) {
+                    e = rc.rc_gz == 1 ? E_GZIP : upload_grow(wms, &rc, wms->upload_n + 1); // truncated gzip stream
+                  }
+                  if (e == 0) {
+                    wms->upload_d[wms->upload_n] = '\0';
+                    e = sha1_result(&rc.rc_sha1, wms->upload_digest);
+                  }
+                }
+                if (rc.rc_gz > 0) {
+                  inflateEnd(&rc.rc_z);
+                }
+                free(recv_d);
+              }
+            }
+          }
+          if (e == 0) {
+            stage = T_CONTENT;
+            mult->delim_str[0] = "; ";
+            mult->delim_str[1] = NULL;
+          }
+          break;
+        case T_BOUNDARY_CHECK:
+          assert(boundary_str != NULL);
+          len = strlen(boundary_str);
+          e = strncmp(mult->post_lp, boundary_str, len) != 0;
+          if (e == 0) {
+            if (mult->post_fp == len) {
+              stage = T_CONTENT;
+              mult->delim_str[0] = "; ";
+              mult->delim_str[1] = NULL;
+            } else if (mult->post_fp == len + 2) {
+              e = strncmp(mult->post_lp + mult->post_fp - 2, "--", 2) != 0;
+              if (e == 0) {
+                stage = T_EPILOGUE;
+                mult->delim_str[0] = NULL;
+              }
+            } else {
+              e = E_PARSE_3;
+            }
+          }
+          break;
+        case T_EPILOGUE:
+          break;
+        }
+      }
+    } while (mult->nread_del != -1 && e == 0);
+    free(boundary_str);
+    boundary_str = NULL;
+    free(parse);
+    parse = NULL;
+    free(mult->post_lp);
+    mult->post_lp = NULL;
+    mult->post_n = 0;
+    free(mult);
+    mult = NULL;
+  }
+  return e;
+}
+
+static char *sa_get(struct StringArray *sa, int16_t sa_i)
+{
+  char *ret_str;
+  char ch;
+  int pos; // get
+  int i;
+  assert(sa != NULL && sa->sa_c >= 0);
+  ret_str = NULL;
+  if (sa_i >= 0 && sa_i < sa->sa_c) {
+    pos = 0;
+    for (i = 0; i != sa_i; i++) {
+      do {
+        ch = sa->sa_d[pos++];
+      } while (ch != '\0');
+    }
+    assert(pos < sa->sa_n);
+    ret_str = sa->sa_d + pos;
+  }
+  return ret_str;
+}
+
+// folds each new deck under parent_i into an earlier sibling of the same name: its cards are appended to the card
+// list of that deck (an existing list is loaded and rewritten, its cards kept) and its children to the children of
+// that deck, then its slot is freed. The decks which existed before the merge stay where they are
+static int merge_fold(struct XML *xml, struct MemorySurfer *ms, int16_t parent_i)
+{
+  int e;
+  int16_t deck_i;
+  int16_t prev_i;
+  int16_t peer_i;
+  int16_t child_i;
+  int32_t data_size;
+  int card_i;
+  size_t size;
+  char *name_str;
+  char *str;
+  struct CardList *dst;
+  struct CardList *src;
+  struct Card *card_l;
+  e = 0;
+  prev_i = -1;
+  deck_i = ms->cat_t[parent_i].n_child;
+  while (deck_i != -1 && e == 0) {
+    peer_i = -1;
+    if (deck_i >= xml->old_deck_a || xml->old_cat_t[deck_i].deck_slot_used == 0) {
+      name_str = sa_get(&ms->deck_sa, deck_i);
+      e = name_str == NULL;
+      peer_i = ms->cat_t[parent_i].n_child;
+      str = sa_get(&ms->deck_sa, peer_i);
+      while (e == 0 && peer_i != deck_i && (str == NULL || strcmp(str, name_str) != 0)) {
+        peer_i = ms->cat_t[peer_i].n_sibling;
+        str = sa_get(&ms->deck_sa, peer_i);
+      }
+      if (peer_i == deck_i) {
+        peer_i = -1;
+      }
+    }
+    if (e == 0 && peer_i != -1) {
+      assert(prev_i != -1);
+      dst = xml->cardlist_l + peer_i;
+      if (ms->cat_t[peer_i].cat_cli != -1) {
+        data_size = imf_get_size(&ms->imf, ms->cat_t[peer_i].cat_cli);
+        e = data_size < 0;
+        if (e == 0 && data_size > 0) {
+          dst->card_l = malloc(data_size);
+          e = dst->card_l == NULL;
+          if (e == 0) {
+            e = imf_get(&ms->imf, ms->cat_t[peer_i].cat_cli, dst->card_l);
+          }
+          if (e == 0) {
+            dst->card_a = data_size / sizeof(struct Card);
+            for (card_i = 0; card_i < dst->card_a; card_i++) {
+              dst->card_l[card_i].card_qai = -2 - dst->card_l[card_i].card_qai; // kept
+            }
+          }
+        }
+        if (e == 0) {
+          ms->cat_t[peer_i].cat_cli = -1; // written by xml_store, the old list is deleted by snap_prune
+        }
+      }
+      src = xml->cardlist_l + deck_i;
+      if (e == 0 && src->card_a > 0) {
+        size = sizeof(struct Card) * (dst->card_a + src->card_a);
+        card_l = realloc(dst->card_l, size);
+        e = card_l == NULL;
+        if (e == 0) {
+          memcpy(card_l + dst->card_a, src->card_l, sizeof(struct Card) * src->card_a);
+          dst->card_l = card_l;
+          dst->card_a += src->card_a;
+        }
+      }
+      if (e == 0) {
+        if (ms->cat_t[deck_i].n_child != -1) {
+          child_i = ms->cat_t[peer_i].n_child;
+          if (child_i == -1) {
+            ms->cat_t[peer_i].n_child = ms->cat_t[deck_i].n_child;
+          } else {
+            while (ms->cat_t[child_i].n_sibling != -1) {
+              child_i = ms->cat_t[child_i].n_sibling;
+            }
+            ms->cat_t[child_i].n_sibling = ms->cat_t[deck_i].n_child;
+          }
+        }
+        ms->cat_t[prev_i].n_sibling = ms->cat_t[deck_i].n_sibling;
+        ms->cat_t[deck_i].deck_slot_used = 0;
+        xml->fold_n++;
+        free(src->card_l);
+        src->card_l = NULL;
+        src->card_a = 0;
+        deck_i = ms->cat_t[prev_i].n_sibling;
+      }
+    } else {
+      prev_i = deck_i;
+      deck_i = ms->cat_t[deck_i].n_sibling;
+    }
+  }
+  deck_i = ms->cat_t[parent_i].n_child;
+  while (deck_i != -1 && e == 0) {
+    e = merge_fold(xml, ms, deck_i);
+    deck_i = ms->cat_t[deck_i].n_sibling;
+  }
+  return e;
+}
+
+enum { ESC_AMP = 1, ESC_LT = 2, ESC_QUOT = 4 };
+
+// escapes the text for XML / HTML: *esc_ptr is the text itself when there is nothing to escape (no copy), else the
+// buffer, which is sized in one pass before the copy. The runs of plain bytes are found with strcspn (vectorized by
+// the C library) and copied whole
+static int xml_escape(char **xml_str_ptr, size_t *xml_n_ptr, char *str_text, int escape_mask, char **esc_ptr) {
+  int e;
+  int i;
+  char set_str[4];
+  char *ent_str;
+  size_t ent_n;
+  size_t n;
+  size_t src;
+  size_t dest;
+  size_t size;
+  e = xml_str_ptr == NULL || xml_n_ptr == NULL || esc_ptr == NULL;
+  if (e == 0) {
+    if (str_text == NULL)
+      str_text = "";
+    i = 0;
+    if (escape_mask & ESC_AMP)
+      set_str[i++] = '&';
+    if (escape_mask & ESC_LT)
+      set_str[i++] = '<';
+    if (escape_mask & ESC_QUOT)
+      set_str[i++] = '"';
+    set_str[i] = '\0';
+    src = strcspn(str_text, set_str);
+    if (str_text[src] == '\0') {
+      *esc_ptr = str_text;
+    } else {
+      size = src + 1;
+      while (str_text[src] != '\0') {
+        size += str_text[src] == '&' ? 5 : str_text[src] == '<' ? 4 : 6; // &amp; &lt; &quot;
+        src++;
+        n = strcspn(str_text + src, set_str);
+        size += n;
+        src += n;
+      }
+      if (size > *xml_n_ptr) {
+        *xml_str_ptr = realloc(*xml_str_ptr, size);
+        e = *xml_str_ptr == NULL;
+        if (e == 0) {
+          *xml_n_ptr = size;
+        }
+      }
+      if (e == 0) {
+        src = 0;
+        dest = 0;
+        do {
+          n = strcspn(str_text + src, set_str);
+          memcpy(*xml_str_ptr + dest, str_text + src, n);
+          src += n;
+          dest += n;
+          if (str_text[src] != '\0') {
+            switch (str_text[src++]) {
+            case '&':
+              ent_str = "&amp;";
+              break;
+            case '<':
+              ent_str = "&lt;";
+              break;
+            default:
+              ent_str = "&quot;";
+              break;
+            }
+            ent_n = strlen(ent_str);
+            memcpy(*xml_str_ptr + dest, ent_str, ent_n);
+            dest += ent_n;
+          }
+        } while (str_text[src] != '\0');
+        assert(dest < size);
+        (*xml_str_ptr)[dest] = '\0';
+        *esc_ptr = *xml_str_ptr;
+      }
+    }
+  }
+  return e;
+}
+
+// prints the text escaped for element content (ESC_AMP | ESC_LT) with the (sorted) spans in <mark>, in one pass
+// without a copy: runs of plain bytes are written as they are
+static int print_marked(const char *str, const struct MatchSpan *span_l, int span_n)
+{
+  int e;
+  int rv;
+  int s;
+  int is_open;
+  int32_t i;
+  int32_t stop;
+  size_t n;
+  if (str == NULL) {
+    str = "";
+  }
+  e = 0;
+  i = 0;
+  s = 0;
+  is_open = 0;
+  while (e == 0 && (str[i] != '\0' || is_open != 0)) {
+    while (is_open == 0 && s < span_n && span_l[s].span_len == 0) {
+      s++;
+    }
+    stop = s < span_n ? span_l[s].span_off + (is_open != 0 ? span_l[s].span_len : 0) : INT32_MAX;
+    if (i == stop) {
+      rv = printf(is_open != 0 ? "</mark>" : "<mark>");
+      e = rv < 0;
+      s += is_open;
+      is_open = !is_open;
+    } else if (str[i] == '&' || str[i] == '<') {
+      rv = printf(str[i] == '&' ? "&amp;" : "&lt;");
+      e = rv < 0;
+      i++;
+    } else {
+      n = strcspn(str + i, "&<");
+      if (n > (size_t)(stop - i)) {
+        n = stop - i;
+      }
+      e = fwrite(str + i, 1, n, stdout) != n;
+      i += n;
+    }
+  }
+  return e;
+}
+
+// a field of the card on the search page: with the matches marked once one is found, else in a disabled text area
+static int print_search_field(const char *str, const struct MatchSpan *span_l, int span_n, int is_found)
+{
+  int e;
+  int rv;
+  rv = printf(is_found != 0 ? "\t\t\t<div class=\"msf-txtarea\"><div class=\"qa-txt\">" : "\t\t\t<div class=\"msf-txtarea\"><textarea class=\"msf\" rows=\"10\" disabled>");
+  e = rv < 0;
+  if (e == 0) {
+    e = print_marked(str, span_l, span_n);
+    if (e == 0) {
+      rv = printf(is_found != 0 ? "</div></div>\n" : "</textarea></div>\n");
+      e = rv < 0;
+    }
+  }
+  return e;
+}
+
+static int inds_set(struct IndentStr *inds, int indent_n, int change_flag)
+{
+  int e;
+  char *str;
+  size_t size;
+  int i;
+  e = inds->indent_n == -1 && change_flag != 0;
+  if (e == 0) {
+    if (change_flag > 0) {
+      indent_n = inds->indent_n + indent_n;
+    } else if (change_flag < 0) {
+      indent_n = inds->indent_n - indent_n;
+    }
+    e = indent_n < 0;
+    if (e == 0) {
+      if (indent_n >= inds->size) {
+        size = (indent_n / 32 + 1) * 32;
+        str = realloc(inds->str, size);
+        e = str == NULL;
+        if (e == 0) {
+          inds->str = str;
+          inds->size = size;
+        }
+      }
+      if (e == 0) {
+        if (inds->indent_n == -1) {
+          inds->indent_n = 0;
+        }
+        if (inds->indent_n < indent_n) {
+          for (i = inds->indent_n; i < indent_n; i++)
+            inds->str[i] = '\t';
+          inds->str[i] = '\0';
+        } else {
+          inds->str[indent_n] = '\0';
+        }
+        inds->indent_n = indent_n;
+      }
+    }
+  }
+  return e;
+}
+
+enum Hierarchy { H_CHILD, H_SIBLING };
+enum SelType { Y_RADIO, Y_CHECKBOX };
+
+static int gen_html_deck(int16_t n_create, enum Hierarchy hierarchy, struct WebMemorySurfer *wms, enum SelType sel_type)
+{
+  int e;
+  int rv;
+  char *str;
+  char *esc_str;
+  e = 0;
+  assert(sel_type == Y_RADIO || sel_type == Y_CHECKBOX);
+  if (n_create >= 0) {
+    if (hierarchy == H_CHILD) {
+      rv = printf("%s<ul class=\"msf\">\n", wms->inds->str);
+      e = rv < 0;
+    }
+    if (e == 0) {
+      str = sa_get(&wms->ms.deck_sa, n_create);
+      e = str == NULL;
+      if (e == 0) {
+        e = xml_escape(&wms->html_lp, &wms->html_n, str, ESC_AMP | ESC_LT, &esc_str);
+        if (e == 0) {
+          assert(sel_type == Y_CHECKBOX ? wms->ms.mov_deck_i == -1 : 1);
+          if (sel_type == Y_RADIO) {
+            str = n_create == wms->ms.deck_i ? " checked autofocus" : "";
+          } else {
+            str = wms->ms.cat_t[n_create].deck_on == 1 ? " checked" : "";
+          }
+          rv = printf("%s\t<li><details%s><summary><label class=\"msf-td\"><input type=\"%s\" name=\"deck\" value=\"%d\"%s%s>%s</label></summary>%s\n",
+              wms->inds->str,
+              wms->ms.cat_t[n_create].deck_x != 0 ? " open" : "",
+              sel_type == Y_RADIO ? "radio" : "checkbox",
+              n_create,
+              str,
+              n_create == wms->ms.mov_deck_i ? " disabled" : "",
+              esc_str,
+              wms->ms.cat_t[n_create].n_child == -1 ? "</details></li>" : "");
+          e = rv < 0;
+          if (e == 0) {
+            if (wms->ms.cat_t[n_create].n_child != -1) {
+              e = inds_set(wms->inds, 2, 1);
+              if (e == 0) {
+                e = gen_html_deck(wms->ms.cat_t[n_create].n_child, H_CHILD, wms, sel_type);
+                if (e == 0) {
+                  e = inds_set(wms->inds, 2, -1);
+                }
+              }
+              if (e == 0) {
+                rv = printf("%s\t</details></li>\n", wms->inds->str);
+                e = rv < 0;
+              }
+            }
+            if (e == 0) {
+              if (wms->ms.cat_t[n_create].n_sibling != -1) {
+                e = gen_html_deck(wms->ms.cat_t[n_create].n_sibling, H_SIBLING, wms, sel_type);
+              }
+              if (e == 0) {
+                if (hierarchy == H_CHILD) {
+                  rv = printf("%s</ul>\n", wms->inds->str);
+                  e = rv < 0;
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  return e;
+}
+
+enum
+{
+  SECONDS_MINUTE = 60,
+  SECONDS_HOUR = SECONDS_MINUTE * 60,
+  SECONDS_DAY = SECONDS_HOUR * 24,
+  SECONDS_MONTH = SECONDS_DAY * 30,
+  SECONDS_YEAR = SECONDS_DAY * 365
+};
+
+static void set_time_str(char *time_diff_str, time_t time_set)
+{
+  int n_stored;
+  char *str_cursor;
+  int n_years;
+  int n_month;
+  int n_days;
+  int n_hours;
+  int n_minutes;
+  int n_seconds;
+  int valid_c; // count
+  char *space_str;
+  str_cursor = time_diff_str;
+  valid_c = 0;
+  n_years = time_set / SECONDS_YEAR;
+  if (n_years) {
+    valid_c = 48;
+    time_set -= SECONDS_YEAR * n_years;
+  }
+  n_month = time_set / SECONDS_MONTH;
+  if (n_month) {
+    if (valid_c == 0) valid_c = 24;
+    time_set -= SECONDS_MONTH * n_month;
+  }
+  n_days = time_set / SECONDS_DAY;
+  if (n_days) {
+    if (valid_c == 0) valid_c = 12;
+    time_set -= SECONDS_DAY * n_days;
+  }
+  n_hours = time_set / SECONDS_HOUR;
+  if (n_hours) {
+    if (valid_c == 0) valid_c = 6;
+    time_set -= SECONDS_HOUR * n_hours;
+  }
+  n_minutes = time_set / SECONDS_MINUTE;
+  if (n_minutes) {
+    if (valid_c == 0) valid_c = 3;
+    time_set -= SECONDS_MINUTE * n_minutes;
+  }
+  n_seconds = time_set;
+  if (valid_c == 0) valid_c = 1;
+  time_set -= n_seconds;
+  if (valid_c & 32) {
+    n_stored = sprintf(str_cursor, "%dY", n_years);
+    str_cursor += n_stored;
+  }
+  if ((valid_c & 16) && n_month != 0) {
+    space_str = valid_c & 32 ? " " : "";
+    n_stored = sprintf(str_cursor, "%s%dM", space_str, n_month);
+    str_cursor += n_stored;
+  }
+  if ((valid_c & 8) && n_days != 0) {
+    space_str = valid_c & 16 ? " " : "";
+    n_stored = sprintf(str_cursor, "%s%dD", space_str, n_days);
+    str_cursor += n_stored;
+  }
+  if ((valid_c & 4) && n_hours != 0) {
+    space_str = valid_c & 8 ? " " : "";
+    n_stored = sprintf(str_cursor, "%s%dh", space_str, n_hours);
+    str_cursor += n_stored;
+  }
+  if ((valid_c & 2) && n_minutes != 0) {
+    space_str = valid_c & 4 ? " " : "";
+    n_stored = sprintf(str_cursor, "%s%dm", space_str, n_minutes);
+    str_cursor += n_stored;
+  }
+  if (valid_c & 1) {
+    space_str = valid_c & 2 ? " " : "";
+    if (n_seconds != 0 || (valid_c & 2) == 0)
+      n_stored = sprintf(str_cursor, "%s%ds", space_str, n_seconds);
+  }
+}
+
+struct XmlGenerator {
+  FILE *w_stream; // write, NULL to take the digest only
+  struct Sha1Context *w_sha1; // digest of the output, NULL for none
+  char *w_lineptr;
+  size_t w_n;
+  char *w_fmt; // formatted output (xg_printf)
+  size_t w_fmt_n;
+  z_stream *w_z; // gzip the stream, NULL to write it plain
+  uint8_t *w_zbuf;
+};
+
+static void sa_init(struct StringArray *sa)
+{
+  sa->sa_c = 0;
+  sa->sa_d = NULL;
+  sa->sa_n = 0;
+  assert(sizeof(char) == 1);
+}
+
+static void sa_free(struct StringArray *sa)
+{
+  sa->sa_c = 0;
+  free(sa->sa_d);
+  sa->sa_d = NULL;
+  sa->sa_n = 0;
+}
+
+// whether the client accepts the gzip Content-Encoding (and not with q=0)
+static int accept_gzip(const char *str)
+{
+  int tv;
+  size_t len;
+  const char *q_str;
+  tv = 0;
+  while (str != NULL && tv == 0 && *str != '\0') {
+    str += strspn(str, " \t,");
+    len = strcspn(str, " \t,;");
+    tv = (len == 4 && strncasecmp(str, "gzip", 4) == 0) || (len == 6 && strncasecmp(str, "x-gzip", 6) == 0);
+    str += len;
+    len = strcspn(str, ",");
+    if (tv != 0) {
+      q_str = strchr(str, '=');
+      if (q_str != NULL && q_str - str < len) {
+        tv = strtod(q_str + 1, NULL) > 0;
+      }
+    }
+    str += len;
+  }
+  return tv;
+}
+
+static int xg_gzip(struct XmlGenerator *xg)
+{
+  int e;
+  int rv;
+  xg->w_z = malloc(sizeof(z_stream));
+  xg->w_zbuf = malloc(XML_BLOCK);
+  e = xg->w_z == NULL || xg->w_zbuf == NULL;
+  if (e == 0) {
+    xg->w_z->zalloc = Z_NULL;
+    xg->w_z->zfree = Z_NULL;
+    xg->w_z->opaque = Z_NULL;
+    rv = deflateInit2(xg->w_z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY); // gzip header
+    e = rv != Z_OK ? E_GZIP : 0;
+  }
+  if (e != 0) {
+    free(xg->w_z);
+    xg->w_z = NULL;
+  }
+  return e;
+}
+
+// compresses to the stream, Z_FINISH writes the end of the gzip stream
+static int xg_deflate(struct XmlGenerator *xg, const char *str, size_t len, int flush)
+{
+  int e;
+  int rv;
+  size_t n;
+  e = 0;
+  xg->w_z->next_in = (Bytef *)str;
+  xg->w_z->avail_in = len;
+  do {
+    xg->w_z->next_out = xg->w_zbuf;
+    xg->w_z->avail_out = XML_BLOCK;
+    rv = deflate(xg->w_z, flush);
+    e = rv == Z_STREAM_ERROR ? E_GZIP : 0;
+    if (e == 0) {
+      n = XML_BLOCK - xg->w_z->avail_out;
+      e = fwrite(xg->w_zbuf, 1, n, xg->w_stream) != n;
+    }
+  } while (e == 0 && xg->w_z->avail_out == 0);
+  return e;
+}
+
+static int xg_write(struct XmlGenerator *xg, const char *str, size_t len)
+{
+  int e;
+  e = 0;
+  if (xg->w_sha1 != NULL) {
+    e = sha1_input(xg->w_sha1, (const uint8_t *)str, len);
+  }
+  if (e == 0 && xg->w_stream != NULL) {
+    if (xg->w_z != NULL) {
+      e = xg_deflate(xg, str, len, Z_NO_FLUSH);
+    } else {
+      e = fwrite(str, 1, len, xg->w_stream) != len;
+    }
+  }
+  return e;
+}
+
+// like fprintf, to the stream and/or the digest of the generator
+static int xg_printf(struct XmlGenerator *xg, const char *format, ...)
+{
+  int rv;
+  size_t size;
+  char *str;
+  va_list ap;
+  va_start(ap, format);
+  rv = vsnprintf(xg->w_fmt, xg->w_fmt_n, format, ap);
+  va_end(ap);
+  if (rv >= 0 && rv >= xg->w_fmt_n) {
+    size = rv + 1;
+    str = realloc(xg->w_fmt, size);
+    rv = -1;
+    if (str != NULL) {
+      xg->w_fmt = str;
+      xg->w_fmt_n = size;
+      va_start(ap, format);
+      rv = vsnprintf(xg->w_fmt, xg->w_fmt_n, format, ap);
+      va_end(ap);
+    }
+  }
+  if (rv >= 0 && xg_write(xg, xg->w_fmt, rv) != 0) {
+    rv = -1;
+  }
+  return rv;
+}
+
+// siblings != 0 continues with the next sibling, 0 generates the deck with its subtree only
+static int gen_xml_category(int16_t deck_i, struct XmlGenerator *xg, struct MemorySurfer *ms, struct IndentStr *inds, int siblings)
+{
+  int e;
+  int rv;
+  struct Deck *cat_ptr;
+  char *str;
+  char *esc_str;
+  int32_t data_size;
+  struct Card *card_l;
+  int card_a;
+  int card_i;
+  struct Card *card_ptr;
+  struct StringArray card_sa;
+  struct tm bd_time; // broken-down
+  time_t card_time;
+  char time_str[20]; // 1971-01-01T00:00:00
+  char strength_str[16];
+  char state_ch;
+  char *q_str;
+  char *a_str;
+  rv = xg_printf(xg, "\n%s<deck>", inds->str);
+  e = rv < 0;
+  if (e == 0) {
+    e = inds_set(inds, 1, 1);
+    if (e == 0) {
+      cat_ptr = ms->cat_t + deck_i;
+      str = sa_get(&ms->deck_sa, deck_i);
+      e = str == NULL;
+      if (e == 0) {
+        e = xml_escape(&xg->w_lineptr, &xg->w_n, str, ESC_AMP | ESC_LT, &esc_str);
+        if (e == 0) {
+          rv = xg_printf(xg, "\n%s<name>%s</name>", inds->str, esc_str);
+          e = rv < 0;
+          if (e == 0) {
+            str = sa_get(&ms->style_sa, deck_i);
+            if (str != NULL && str[0] != '\0') {
+              e = xml_escape(&xg->w_lineptr, &xg->w_n, str, ESC_AMP | ESC_LT, &esc_str);
+              if (e == 0) {
+                rv = xg_printf(xg, "\n%s<style>%s</style>", inds->str, esc_str);
+                e = rv < 0;
+              }
+            }
+          }
+          if (e == 0) {
+            data_size = imf_get_size(&ms->imf, cat_ptr->cat_cli);
+            card_l = malloc(data_size);
+            e = card_l == NULL;
+            if (e == 0) {
+              e = imf_get(&ms->imf, cat_ptr->cat_cli, card_l);
+              if (e == 0) {
+                sa_init(&card_sa);
+                card_a = data_size / sizeof(struct Card);
+                card_i = 0;
+                while ((card_i < card_a) && (e == 0))
+                {
+                  card_ptr = card_l + card_i;
+                  e = sa_load(&card_sa, &ms->imf, card_ptr->card_qai);
+                  if (e == 0) {
+                    rv = xg_printf(xg, "\n%s<card>", inds->str);
+                    e = rv < 0;
+                    if (e == 0) {
+                      memset(&bd_time, 0, sizeof (bd_time));
+                      assert((card_ptr->card_time < INT32_MAX) || (sizeof(card_time) == 8));
+                      card_time = card_ptr->card_time;
+                      e = gmtime_r(&card_time, &bd_time) == NULL;
+                      if (e == 0) {
+                        bd_time.tm_mon += 1;
+                        bd_time.tm_year += 1900;
+                        rv = snprintf(time_str, sizeof(time_str), "%4d-%02d-%02dT%02d:%02d:%02d",
+                            bd_time.tm_year, bd_time.tm_mon, bd_time.tm_mday,
+                            bd_time.tm_hour, bd_time.tm_min, bd_time.tm_sec);
+                        e = rv != 19;
+                        if (e == 0) {
+                          rv = xg_printf(xg, "\n\t%s<time>%s</time>", inds->str, time_str);
+                          e = rv < 0;
+                          if (e == 0) {
+                            rv = snprintf(strength_str, sizeof(strength_str), "%d", card_ptr->card_strength);
+                            e = rv < 0 || rv >= sizeof(strength_str);
+                            if (e == 0) {
+                              state_ch = '0' + (card_ptr->card_state & 0x07);
+                              rv = xg_printf(xg, "\n\t%s<strength>%s</strength>", inds->str, strength_str);
+                              e = rv < 0;
+                              if (e == 0) {
+                                rv = xg_printf(xg, "\n\t%s<state>%c</state>", inds->str, state_ch);
+                                e = rv < 0;
+                              }
+                              if (e == 0 && card_ptr->card_state & 0x08) {
+                                rv = xg_printf(xg, "\n\t%s<type>1</type>", inds->str);
+                                e = rv < 0;
+                              }
+                              if (e == 0) {
+                                q_str = sa_get(&card_sa, 0);
+                                e = q_str == NULL;
+                                if (e == 0) {
+                                  e = xml_escape(&xg->w_lineptr, &xg->w_n, q_str, ESC_AMP | ESC_LT, &esc_str);
+                                  if (e == 0) {
+                                    rv = xg_printf(xg, "\n\t%s<question>%s</question>", inds->str, esc_str);
+                                    e = rv < 0;
+                                    if (e == 0) {
+                                      a_str = sa_get(&card_sa, 1);
+                                      e = a_str == NULL;
+                                      if (e == 0) {
+                                        e = xml_escape(&xg->w_lineptr, &xg->w_n, a_str, ESC_AMP | ESC_LT, &esc_str);
+                                        if (e == 0) {
+                                          rv = xg_printf(xg, "\n\t%s<answer>%s</answer></card>", inds->str, esc_str);
+                                          e = rv < 0;
+                                          if (e == 0) {
+                                            card_i++;
+                                          }
+                                        }
+                                      }
+                                    }
+                                  }
+                                }
+                              }
+                            }
+                          }
+                        }
+                      }
+                    }
+                  }
+                }
+                sa_free(&card_sa);
+                if (e == 0) {
+                  if (ms->cat_t[deck_i].n_child != -1) {
+                    e = gen_xml_category(ms->cat_t[deck_i].n_child, xg, ms, inds, 1);
+                  }
+                  if (e == 0) {
+                    e = xg_write(xg, "</deck>", 7);
+                    if (e == 0) {
+                      e = inds_set(inds, 1, -1);
+                      if (e == 0) {
+                        if (siblings != 0 && ms->cat_t[deck_i].n_sibling != -1) {
+                          e = gen_xml_category(ms->cat_t[deck_i].n_sibling, xg, ms, inds, 1);
+                        }
+                      }
+                    }
+                  }
+                }
+              }
+              free(card_l);
+            }
+          }
+        }
+      }
+    }
+  }
+  return e;
+}
+
+// the checked decks of the chain from deck_i, each with its subtree; the decks above them are left out
+static int gen_xml_checked(int16_t deck_i, struct XmlGenerator *xg, struct MemorySurfer *ms, struct IndentStr *inds)
+{
+  int e;
+  e = 0;
+  while (deck_i != -1 && e == 0) {
+    if (ms->cat_t[deck_i].deck_on != 0) {
+      e = gen_xml_category(deck_i, xg, ms, inds, 0);
+    } else if (ms->cat_t[deck_i].n_child != -1) {
+      e = gen_xml_checked(ms->cat_t[deck_i].n_child, xg, ms, inds);
+    }
+    deck_i = ms->cat_t[deck_i].n_sibling;
+  }
+  return e;
+}
+
+// the file as XML, the deck tree from n_first (checked != 0: the checked decks only)
+static int gen_xml(struct XmlGenerator *xg, struct MemorySurfer *ms, struct IndentStr *inds, int checked)
+{
+  int e;
+  e = xg_write(xg, "<memorysurfer>", 14);
+  if (e == 0) {
+    e = inds_set(inds, 1, 0);
+    if (e == 0 && ms->n_first != -1) {
+      if (checked != 0) {
+        e = gen_xml_checked(ms->n_first, xg, ms, inds);
+      } else {
+        e = gen_xml_category(ms->n_first, xg, ms, inds, 1);
+      }
+    }
+    if (e == 0) {
+      e = xg_write(xg, "</memorysurfer>", 15);
+    }
+  }
+  return e;
+}
+
+// one section of a snapshot; digest is the SHA-1 of the data, computed here when NULL
+static int snap_put(struct XmlGenerator *xg, enum SnapTag tag, int32_t arg, const void *data, int32_t data_size, const uint8_t *digest)
+{
+  int e;
+  struct SnapSection ss;
+  struct Sha1Context sha1;
+  uint8_t message_digest[SHA1_HASH_SIZE];
+  e = 0;
+  if (digest == NULL) {
+    e = sha1_reset(&sha1);
+    if (e == 0) {
+      e = sha1_input(&sha1, data, data_size);
+    }
+    if (e == 0) {
+      e = sha1_result(&sha1, message_digest);
+    }
+    digest = message_digest;
+  }
+  if (e == 0) {
+    ss.ss_tag = tag;
+    ss.ss_arg = arg;
+    ss.ss_size = data_size;
+    e = xg_write(xg, (const char *)&ss, sizeof(ss));
+    if (e == 0) {
+      e = xg_write(xg, data, data_size);
+    }
+    if (e == 0) {
+      e = xg_write(xg, (const char *)digest, SHA1_HASH_SIZE);
+    }
+  }
+  return e;
+}
+
+static int bo_cmp(const void *ls, const void *rs)
+{
+  return ((const struct BaseOrd *)ls)->bo_qai < ((const struct BaseOrd *)rs)->bo_qai ? -1 : ((const struct BaseOrd *)ls)->bo_qai > ((const struct BaseOrd *)rs)->bo_qai;
+}
+
+// the file as a binary snapshot: the ids of the base and of the state taken (cur), the deck table, the deck names and
+// the styles, then the card list of each deck followed by the Q/A of its cards, these streamed from their chunks with
+// the digests stored there. With a base (a delta) the decks whose list and Q/A are unchanged are left out, and in the
+// other lists a card whose Q/A is in the base (unchanged) is its ordinal there instead of being followed by its Q/A
+static int gen_snapshot(struct XmlGenerator *xg, struct MemorySurfer *ms, struct SnapBase *base, struct SnapBase *cur)
+{
+  int e;
+  int deck_i;
+  int card_i;
+  int card_a;
+  int32_t data_size;
+  int32_t card_n;
+  int32_t data_n;
+  int32_t ord;
+  int32_t qai;
+  struct Card *card_l;
+  struct BaseOrd *ord_l; // the cards of the base by chunk
+  struct BaseOrd *bo;
+  struct BaseDeck *bd;
+  struct BaseDeck *base_bd;
+  struct BaseCard *bc;
+  char *data;
+  void *ptr;
+  const uint8_t *list_digest;
+  uint8_t digest[SHA1_HASH_SIZE];
+  uint8_t id_d[2 * SHA1_HASH_SIZE];
+  card_l = NULL;
+  card_n = 0;
+  data = NULL;
+  data_n = 0;
+  ord_l = NULL;
+  e = 0;
+  memset(id_d, 0, SHA1_HASH_SIZE);
+  if (base != NULL) {
+    ord_l = malloc(sizeof(struct BaseOrd) * (base->sb_head->bh_card_n + 1));
+    e = ord_l == NULL;
+    if (e == 0) {
+      for (ord = 0; ord < base->sb_head->bh_card_n; ord++) {
+        ord_l[ord].bo_qai = base->sb_card_l[ord].bc_qai;
+        ord_l[ord].bo_ord = ord;
+      }
+      qsort(ord_l, base->sb_head->bh_card_n, sizeof(struct BaseOrd), bo_cmp);
+      memcpy(id_d, base->sb_head->bh_id, SHA1_HASH_SIZE);
+    }
+  }
+  memcpy(id_d + SHA1_HASH_SIZE, cur->sb_head->bh_id, SHA1_HASH_SIZE);
+  if (e == 0) {
+    e = xg_write(xg, base != NULL ? DELTA_MAGIC : SNAP_MAGIC, sizeof(SNAP_MAGIC));
+  }
+  if (e == 0) {
+    e = snap_put(xg, SNAP_BASE, 0, id_d, sizeof(id_d), NULL);
+  }
+  if (e == 0) {
+    e = snap_put(xg, SNAP_DECKS, 0, ms->cat_t, sizeof(struct Deck) * ms->deck_a, NULL);
+  }
+  if (e == 0) {
+    e = snap_put(xg, SNAP_NAMES, 0, ms->deck_sa.sa_d, sa_length(&ms->deck_sa), NULL);
+  }
+  if (e == 0) {
+    e = snap_put(xg, SNAP_STYLES, 0, ms->style_sa.sa_d, sa_length(&ms->style_sa), NULL);
+  }
+  for (deck_i = 0; deck_i < ms->deck_a && e == 0; deck_i++) {
+    bd = cur->sb_deck_l + deck_i;
+    base_bd = base != NULL && deck_i < base->sb_head->bh_deck_a ? base->sb_deck_l + deck_i : NULL;
+    if (bd->bd_n >= 0 && (base_bd == NULL || base_bd->bd_n != bd->bd_n || memcmp(base_bd->bd_digest, bd->bd_digest, SHA1_HASH_SIZE) != 0 || memcmp(base->sb_card_l + base_bd->bd_ord, cur->sb_card_l + bd->bd_ord, sizeof(struct BaseCard) * bd->bd_n) != 0)) {
+      data_size = imf_get_size(&ms->imf, ms->cat_t[deck_i].cat_cli);
+      if (data_size > card_n) {
+        ptr = realloc(card_l, data_size);
+        e = ptr == NULL;
+        if (e == 0) {
+          card_l = ptr;
+          card_n = data_size;
+        }
+      }
+      if (e == 0) {
+        e = imf_get_digest(&ms->imf, ms->cat_t[deck_i].cat_cli, card_l, digest);
+      }
+      card_a = data_size / sizeof(struct Card);
+      list_digest = digest;
+      if (base != NULL) {
+        for (card_i = 0; card_i < card_a && e == 0; card_i++) {
+          bc = cur->sb_card_l + bd->bd_ord + card_i;
+          bo = bsearch(&bc->bc_qai, ord_l, base->sb_head->bh_card_n, sizeof(struct BaseOrd), bo_cmp);
+          if (bo != NULL && memcmp(base->sb_card_l[bo->bo_ord].bc_digest, bc->bc_digest, SHA1_HASH_SIZE) == 0) {
+            card_l[card_i].card_qai = bo->bo_ord;
+          } else {
+            card_l[card_i].card_qai = -1; // followed by its Q/A
+          }
+        }
+        list_digest = NULL;
+      }
+      if (e == 0) {
+        e = snap_put(xg, SNAP_CARDS, deck_i, card_l, data_size, list_digest);
+      }
+      for (card_i = 0; card_i < card_a && e == 0; card_i++) {
+        if (base == NULL || card_l[card_i].card_qai == -1) {
+          qai = cur->sb_card_l[bd->bd_ord + card_i].bc_qai;
+          data_size = imf_get_size(&ms->imf, qai);
+          if (data_size > data_n) {
+            ptr = realloc(data, data_size);
+            e = ptr == NULL;
+            if (e == 0) {
+              data = ptr;
+              data_n = data_size;
+            }
+          }
+          if (e == 0) {
+            e = imf_get_digest(&ms->imf, qai, data, digest);
+            if (e == 0) {
+              e = snap_put(xg, SNAP_QA, card_i, data, data_size, digest);
+            }
+          }
+        }
+      }
+    }
+  }
+  if (e == 0) {
+    e = snap_put(xg, SNAP_END, 0, NULL, 0, NULL);
+  }
+  free(card_l);
+  free(data);
+  free(ord_l);
+  return e;
+}
+
+static const struct Timeout timeouts[5] = {
+  { 60, 10 }, // 10m
+  { 60, 60 }, // 1h
+  { 60, 360 }, // 6h
+  { 120, 360 }, //12h
+  { 240, 360 } // 24h
+};
+
+static time_t lvl_s[21] = { // level strength
+  60, // 1m (0)
+  120, // 2m (1)
+  300, // 5m (2)
+  900, // 15m (3)
+  1800, // 30m (4)
+  3600, // 1h (5)
+  14400, // 4h (6)
+  43200, // 12h (7)
+  86400, // 1D (8)
+  172800, // 2D (9)
+  345600, // 4D (10)
+  604800, // 7D (11)
+  1209600, // 14D (12)
+  2592000, // 1M (13)
+  7776000,  // 3M (14)
+  15552000, // 6M (15)
+  31536000, // 1Y (16)
+  63072000, // 2Y (17)
+  157680000, // 5Y (18)
+  315360000, // 10Y (19)
+  630720000 // 20Y (20)
+};
+
+static void print_hex(char *str, uint8_t *data, size_t count)
+{
+  int i;
+  int nibble[2];
+  char ch;
+  str[count * 2] = '\0';
+  while (count--) {
+    nibble[1] = data[count] & 0xf;
+    nibble[0] = data[count] >> 4;
+    i = 2;
+    while (i--) {
+      ch = nibble[i];
+      if (ch >= 10) {
+        ch += 'a' - 10;
+      } else {
+        ch += '0';
+      }
+      str[count * 2 + i] = ch;
+    }
+  }
+}
+
+static int gen_html(struct WebMemorySurfer *wms)
+{
+  int e;
+  int rv;
+  int i;
+  int j;
+  int k;
+  int lvl; // level
+  int lvl_sel; // select
+  char *q_str;
+  char *a_str;
+  time_t time_diff;
+  char time_diff_str[32];
+  int x;
+  int y;
+  char *str;
+  char *esc_str;
+  const char *dis_str; // disabled
+  const char *attr_str; // attribute
+  const char *header_str;
+  const char *notice_str;
+  const char *submit_str;
+  char *text_str;
+  char *ext_str;
+  char *ce_str; // Content-Encoding
+  char *dup_str;
+  char title_str[64];
+  char digest_str[41];
+  struct XmlGenerator xg;
+  struct SnapBase sb_l[2]; // the base of a delta and the state taken
+  struct Sha1Context sha1;
+  uint8_t message_digest[SHA1_HASH_SIZE];
+  char *sw_info_str;
+  char mtime_str[17];
+  struct stat file_stat;
+  int n;
+  int dx; // delta
+  int dy;
+  int vby; // viewbox
+  char fc_path[168]; // "M1 61", 30 times "V61h3", "V61z"
+  int fc_n; // forecast total
+  static const char *TIMEOUTS[] = { "10 m", "1 h", "6 h", "12 h", "24 h" };
+  size_t size;
+  size_t len;
+  enum Block bl;
+  static const char *state_str[] = { "Alarm", "Scheduled", "New", "Suspended" };
+  static const char *event_str[] = { "Edit", "Learn", "Search" };
+  char el_str[5]; // "100%"
+  int bl_i; // block index
+  enum SelType sel_type;
+  e = 0;
+  mtime_str[0] = '\0';
+  if (wms->ms.imf_filename != NULL) {
+    size = sizeof(struct stat);
+    memset(&file_stat, 0, size);
+    e = stat(wms->ms.imf_filename, &file_stat);
+    if (e == 0) {
+      assert(file_stat.st_mtim.tv_sec >= 0 && file_stat.st_mtim.tv_nsec >= 0);
+      size = sizeof(mtime_str);
+      rv = snprintf(mtime_str, size, "%08x%08x", (uint32_t) file_stat.st_mtim.tv_sec, (uint32_t) file_stat.st_mtim.tv_nsec);
+      e = rv != 16;
+    }
+  }
+  if (e == 0) {
+    size = sizeof(title_str);
+    rv = snprintf(title_str, size, "MemorySurfer - Welcome");
+    e = rv < 0 || rv >= size;
+    if (wms->file_title_str != NULL && e == 0) {
+      e = xml_escape(&wms->html_lp, &wms->html_n, wms->file_title_str, ESC_AMP | ESC_LT, &esc_str);
+      if (e == 0) {
+        rv = snprintf(title_str, size, "MemorySurfer – %s", esc_str);
+        e = rv < 0;
+      }
+    }
+  }
+  if (e == 0) {
+    e = sw_stop(wms->sw_i, &wms->ms.imf.sw);
+    if (e == 0)
+      e = sw_info(&sw_info_str, &wms->ms.imf.sw);
+  }
+  assert(wms->tok_str[0] == '\0' || wms->tok_str[40] == '\0');
+  if (e == 0) {
+    bl_i = 0;
+    while ((bl = block_seq[wms->page][bl_i++]) != B_END && e == 0) {
+      switch (bl) {
+      case B_START_HTML:
+        rv = printf("Content-Type: text/html; charset=utf-8\r\n\r\n"
+                    "<!DOCTYPE html>\n"
+                    "<html lang=\"en\">\n"
+                    "\t<head>\n"
+                    "\t\t<meta charset=\"utf-8\">\n"
+                    "\t\t<title>%s</title>\n"
+                    "\t\t<meta name=\"viewport\" content=\"width=device-width\">\n"
+                    "\t\t<meta name=\"description\" content=\"Open source software to efficiently memorize flashcards.\">\n"
+                    "\t\t<link rel=\"shortcut icon\" href=\"/favicon.ico\">\n"
+                    "\t\t<link rel=\"stylesheet\" type=\"text/css\" href=\"/ms.css\">\n",
+            title_str);
+        e = rv < 0;
+        if ((wms->page == P_PREVIEW || wms->page == P_LEARN) && e == 0) {
+          rv = printf("\t\t<script src=\"/ms.js\" defer></script>\n");
+          e = rv < 0;
+        }
+        if (e == 0 && (wms->page == P_LEARN || wms->page == P_PREVIEW)) {
+          assert(wms->ms.passwd.style_sai < 0 || wms->ms.style_sa.sa_n > 0);
+          str = sa_get(&wms->ms.style_sa, wms->ms.deck_i);
+          if (str != NULL && str[0] != '\0') {
+            rv = printf("\t\t<style>%s</style>\n", str);
+            e = rv < 0;
+          }
+        }
+        if (e == 0) {
+          rv = printf("\t\t<link rel=\"license\" href=\"https://www.gnu.org/licenses/old-licenses/gpl-2.0.html\">\n"
+                      "\t</head>\n"
+                      "\t<body id=\"msf\">\n");
+          e = rv < 0;
+        }
+        break;
+      case B_FORM_URLENCODED:
+        rv = printf("\t\t<form enctype=\"application/x-www-form-urlencoded\" method=\"post\" action=\"memorysurfer.cgi\">\n");
+        e = rv < 0;
+        break;
+      case B_FORM_MULTIPART:
+        rv = printf("\t\t<form enctype=\"multipart/form-data\" method=\"post\" action=\"memorysurfer.cgi\">\n");
+        e = rv < 0;
+        break;
+      case B_OPEN_DIV:
+        rv = printf("\t\t\t<div>\n"
+                    "\t\t\t\t<input type=\"hidden\" name=\"page\" value=\"%d\">\n",
+            wms->page);
+        e = rv < 0;
+        if (e == 0 && wms->mode >= M_DEFAULT && wms->mode < M_END) {
+          rv = printf("\t\t\t\t<input type=\"hidden\" name=\"mode\" value=\"%d\">\n", wms->mode);
+          e = rv < 0;
+        }
+        if (e == 0 && wms->file_title_str != NULL) {
+          e = xml_escape(&wms->html_lp, &wms->html_n, wms->file_title_str, ESC_AMP | ESC_QUOT, &esc_str);
+          if (e == 0) {
+            rv = printf("\t\t\t\t<input type=\"hidden\" name=\"file-title\" value=\"%s\">\n", esc_str);
+            e = rv < 0;
+          }
+        }
+        if (e == 0 && strlen(wms->tok_str) == 40) {
+          rv = printf("\t\t\t\t<input type=\"hidden\" name=\"token\" value=\"%s\">\n", wms->tok_str);
+          e = rv < 0;
+        }
+        if (e == 0 && wms->ms.card_i >= 0 && ((wms->page == P_SELECT_ARRANGE && wms->mode == M_CARD) || (wms->page == P_SELECT_DEST_DECK && wms->mode == M_SEND) || (wms->page == P_SELECT_DEST_DECK && wms->mode == M_PROCEED_SEND) || wms->page == P_EDIT || wms->page == P_PREVIEW || wms->page == P_SEARCH || wms->page == P_LEARN || wms->page == P_MSG || wms->page == P_HISTOGRAM || wms->page == P_TABLE || wms->page == P_STYLE || wms->page == P_SEARCH_LIST)) {
+          rv = printf("\t\t\t\t<input type=\"hidden\" name=\"card\" value=\"%d\">\n", wms->ms.card_i);
+          e = rv < 0;
+        }
+        if (e == 0) {
+          rv = printf("\t\t\t\t<input type=\"hidden\" name=\"mctr\" value=\"%u\">\n", wms->ms.passwd.mctr);
+          e = rv < 0;
+        }
+        if (e == 0 && strlen(mtime_str) == 16) {
+          rv = printf("\t\t\t\t<input type=\"hidden\" name=\"mtime\" value=\"%s\">\n", mtime_str);
+          e = rv < 0;
+        }
+        if (e == 0 && wms->reveal_pos >= 0) {
+          rv = printf("\t\t\t\t<input type=\"hidden\" name=\"reveal-pos\" value=\"%d\">\n", wms->reveal_pos);
+          e = rv < 0;
+        }
+        if (e == 0 && wms->ms.match_case > 0 && wms->page != P_SEARCH) {
+          rv = printf("\t\t\t\t<input type=\"hidden\" name=\"match-case\" value=\"on\">\n");
+          e = rv < 0;
+        }
+        if (e == 0 && wms->ms.scope >= C_CURRENT && wms->page != P_SEARCH) {
+          rv = printf("\t\t\t\t<input type=\"hidden\" name=\"scope\" value=\"%d\">\n", wms->ms.scope);
+          e = rv < 0;
+        }
+        if (e == 0 && wms->ms.search_mode > SM_LITERAL && wms->page != P_SEARCH) {
+          rv = printf("\t\t\t\t<input type=\"hidden\" name=\"search-mode\" value=\"%d\">\n", wms->ms.search_mode);
+          e = rv < 0;
+        }
+        if (e == 0 && wms->ms.search_dist > 0 && wms->page != P_SEARCH) {
+          rv = printf("\t\t\t\t<input type=\"hidden\" name=\"search-dist\" value=\"%d\">\n", wms->ms.search_dist);
+          e = rv < 0;
+        }
+        if (e == 0 && wms->ms.mov_deck_i >= 0 && (wms->page == P_SELECT_DEST_DECK || (wms->page == P_SELECT_ARRANGE && wms->mode == M_MOVE_DECK))) {
+          rv = printf("\t\t\t\t<input type=\"hidden\" name=\"mov-deck\" value=\"%d\">\n", wms->ms.mov_deck_i);
+          e = rv < 0;
+        }
+        break;
+      case B_HIDDEN_CAT:
+        if (wms->ms.deck_i >= 0) {
+          rv = printf("\t\t\t\t<input type=\"hidden\" name=\"deck\" value=\"%d\">\n", wms->ms.deck_i);
+          e = rv < 0;
+        }
+        break;
+      case B_HIDDEN_ARRANGE:
+        if (wms->ms.arrange >= 0) {
+          rv = printf("\t\t\t\t<input type=\"hidden\" name=\"arrange\" value=\"%d\">\n", wms->ms.arrange);
+          e = rv < 0;
+        }
+        break;
+      case B_HIDDEN_CAT_NAME:
+        if (wms->ms.deck_name_str != NULL) {
+          e = xml_escape(&wms->html_lp, &wms->html_n, wms->ms.deck_name_str, ESC_AMP | ESC_QUOT, &esc_str);
+          if (e == 0) {
+            rv = printf("\t\t\t\t<input type=\"hidden\" name=\"deck-name\" value=\"%s\">\n", esc_str);
+            e = rv < 0;
+          }
+        }
+        break;
+      case B_HIDDEN_SEARCH_TXT:
+        if (wms->ms.search_txt != NULL && strlen(wms->ms.search_txt) > 0) {
+          e = xml_escape(&wms->html_lp, &wms->html_n, wms->ms.search_txt, ESC_AMP | ESC_QUOT, &esc_str);
+          if (e == 0) {
+            rv = printf("\t\t\t\t<input type=\"hidden\" name=\"search-txt\" value=\"%s\">\n", esc_str);
+            e = rv < 0;
+          }
+        }
+        break;
+      case B_HIDDEN_MOV_CARD:
+        if (wms->ms.mov_card_i >= 0) {
+          rv = printf("\t\t\t\t<input type=\"hidden\" name=\"mov-card\" value=\"%d\">\n", wms->ms.mov_card_i);
+          e = rv < 0;
+        }
+        break;
+      case B_CLOSE_DIV:
+        if ((wms->page == P_PREVIEW || (wms->page == P_LEARN && wms->mode == M_RATE)) && e == 0) {
+          rv = printf("\t\t\t\t<input type=\"hidden\" name=\"q\" value=\"\">\n"
+                      "\t\t\t\t<input type=\"hidden\" name=\"a\" value=\"\">\n");
+          e = rv < 0;
+        }
+        if (e == 0) {
+          rv = printf("\t\t\t</div>\n");
+          e = rv < 0;
+        }
+        break;
+      case B_START:
+        dis_str = wms->file_title_str != NULL ? "" : " disabled";
+        attr_str = wms->ms.n_first != -1 ? "" : " disabled";
+        rv = printf("\t\t\t<h1 class=\"msf\">Start</h1>\n"
+                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"File\">File</button></div>\n"
+                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Decks\"%s>Decks</button></div>\n"
+                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Edit\"%s>Edit</button></div>\n"
+                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Learn\"%s>Learn</button></div>\n"
+                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Search\"%s>Search</button></div>\n"
+                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Preferences\"%s>Preferences</button></div>\n"
+                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"About\">About</button></div>\n"
+                    "\t\t</form>\n"
+                    "\t\t<code class=\"msf\">%s</code>\n"
+                    "\t</body>\n"
+                    "</html>\n",
+            dis_str,
+            attr_str,
+            attr_str,
+            attr_str,
+            dis_str,
+            sw_info_str);
+        e = rv < 0;
+        break;
+      case B_FILE:
+        if (wms->file_title_str != NULL) {
+          dis_str = "";
+        } else {
+          dis_str = " disabled";
+        }
+        n = 0; // checked decks, for the Share
+        for (i = 0; wms->file_title_str != NULL && i < wms->ms.deck_a; i++) {
+          n += wms->ms.cat_t[i].deck_slot_used != 0 && wms->ms.cat_t[i].deck_on != 0;
+        }
+        rv = printf("\t\t\t<h1 class=\"msf\">File</h1>\n"
+                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"New\"%s>New</button></div>\n"
+                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Open\"%s>Open</button></div>\n"
+                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Password\"%s>Password</button></div>\n"
+                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Import\"%s>Import</button></div>\n"
+                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Export\"%s>Export</button></div>\n"
+                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Share\"%s>Share</button></div>\n"
+                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Snapshot\"%s>Snapshot</button></div>\n"
+                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Delta\"%s>Delta</button></div>\n"
+                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Base\"%s>Base</button></div>\n"
+                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Update\"%s>Update</button></div>\n"
+                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Remove\"%s>Remove</button></div>\n"
+                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Erase\"%s>Erase</button></div>\n"
+                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Close\"%s>Close</button></div>\n"
+                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Cancel\">Cancel</button></div>\n"
+                    "\t\t</form>\n"
+                    "\t\t<code class=\"msf\" >%s</code>\n"
+                    "\t</body>\n"
+                    "</html>\n",
+            wms->file_title_str == NULL ? "" : " disabled",
+            wms->file_title_str == NULL && wms->fl_c > 0 ? "" : " disabled",
+            dis_str,
+            dis_str,
+            wms->file_title_str != NULL && wms->ms.n_first != -1 ? "" : " disabled",
+            n > 0 ? "" : " disabled",
+            wms->file_title_str != NULL && wms->ms.n_first != -1 ? "" : " disabled",
+            wms->file_title_str != NULL && wms->ms.passwd.base_i >= 0 ? "" : " disabled",
+            wms->file_title_str != NULL && wms->ms.n_first != -1 ? "" : " disabled",
+            wms->file_title_str != NULL && wms->ms.passwd.base_i >= 0 ? "" : " disabled",
+            dis_str,
+            wms->file_title_str != NULL && wms->ms.n_first != -1 ? "" : " disabled",
+            dis_str,
+            sw_info_str);
+        e = rv < 0;
+        break;
+      case B_PASSWORD:
+        assert(wms->ms.passwd.pw_flag >= 0);
+        header_str = NULL;
+        notice_str = NULL;
+        x = 0;
+        y = 0;
+        if (wms->ms.passwd.pw_flag > 0) {
+          x = 1;
+          if (wms->mode != M_CHANGE_PASSWD) {
+            header_str = "Enter the password to login";
+            submit_str = "Login";
+          } else {
+            assert(wms->seq == S_GO_CHANGE);
+            header_str = "Change password";
+            notice_str = "Enter the current password";
+            submit_str = "Change";
+            y = 1;
+          }
+        } else {
+          assert(wms->ms.passwd.pw_flag == 0);
+          header_str = "Define password";
+          notice_str = "Define a (initial) password (for this file) (may be empty)";
+          submit_str = "Enter";
+          y = 1;
+        }
+        assert(wms->mode != M_NONE && header_str != NULL);
+        printf("\t\t\t<h1 class=\"msf\">%s</h1>\n", header_str);
+        if (notice_str != NULL) printf("\t\t\t<p class=\"msf\">%s</p>\n", notice_str);
+        if (x != 0) printf("\t\t\t<div class=\"msf-btns\"><input type=\"text\" name=\"password\" value=\"\" size=25></div>\n");
+        if (wms->mode == M_CHANGE_PASSWD && e == 0) {
+          rv = printf("\t\t\t<p class=\"msf\">Enter a new password</p>\n");
+          e = rv < 0;
+        }
+        if (y != 0) printf("\t\t\t<div class=\"msf-btns\"><input type=\"text\" name=\"new-password\" value=\"\" size=25></div>\n");
+        if (e == 0) {
+          rv = printf("\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"%s\">%s</button>\n"
+                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Stop\">Stop</button></div>\n"
+                      "\t\t</form>\n"
+                      "\t</body>\n"
+                      "</html>\n",
+              submit_str,
+              submit_str);
+          e = rv < 0;
+        }
+        break;
+      case B_NEW:
+        assert(wms->seq == S_NEW);
+        size = 14; // 'new-9999.imsf\0'
+        str = malloc(size);
+        e = str == NULL;
+        if (e == 0) {
+          i = 0;
+          do {
+            if (i > 0) {
+              rv = snprintf(str, size, "new-%d.imsf", i);
+            } else
+              rv = snprintf(str, size, "new.imsf");
+            e = rv < 0 || rv >= size;
+            if (e == 0) {
+              x = 0;
+              for (j = 0; x == 0 && j < wms->fl_c; j++)
+                x = strcmp(wms->fl_v[j], str) == 0;
+              i++;
+              e = i > 9999;
+            }
+          } while (e == 0 && x == 1);
+          if (e == 0) {
+            ext_str = rindex(str, '.');
+            assert(ext_str != NULL);
+            *ext_str = '\0';
+            rv = printf("\t\t\t<h1 class=\"msf\">Create a New file</h1>\n"
+                        "\t\t\t<div class=\"msf-btns\"><input type=\"text\" name=\"file-title\" value=\"%s\" size=25>.imsf</div>\n"
+                        "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Create\">Create</button>\n"
+                        "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Stop\">Stop</button></div>\n"
+                        "\t\t</form>\n"
+                        "\t\t<code class=\"msf\">%s</code>\n"
+                        "\t</body>\n"
+                        "</html>\n",
+                str,
+                sw_info_str);
+            e = rv < 0;
+          }
+          free(str);
+        }
+        break;
+      case B_OPEN:
+        rv = printf("\t\t\t<h1 class=\"msf\">Open file</h1>\n"
+                    "\t\t\t<ul class=\"msf\">\n");
+        e = rv < 0;
+        for (i = 0; e == 0 && i < wms->fl_c; i++) {
+          e = xml_escape(&wms->html_lp, &wms->html_n, wms->fl_v[i], ESC_AMP | ESC_QUOT, &esc_str);
+          if (e == 0) {
+            rv = printf("\t\t\t\t<li><label class=\"msf-td\"><input type=\"radio\" name=\"file-title\" value=\"%s\">", esc_str);
+            e = rv < 0;
+            if (e == 0) {
+              e = xml_escape(&wms->html_lp, &wms->html_n, wms->fl_v[i], ESC_AMP | ESC_LT, &esc_str);
+              rv = printf("%s</label></li>\n", esc_str);
+              e = rv < 0;
+            }
+          }
+        }
+        rv = printf("\t\t\t</ul>\n"
+                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Open\"%s>Open</button>\n"
+                    "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Cancel\">Cancel</button></div>\n"
+                    "\t\t</form>\n"
+                    "\t\t<code class=\"msf\">%s</code>\n"
+                    "\t</body>\n"
+                    "</html>\n",
+            wms->fl_c > 0 ? "" : " disabled",
+            sw_info_str);
+        e = rv < 0;
+        break;
+      case B_UPLOAD:
+        assert(wms->file_title_str != NULL && strlen(wms->tok_str) == 40);
+        if (wms->seq == S_MERGE) {
+          str = "Choose a (previously exported .XML, plain or .gz compressed) File to merge into the selected deck (cards which already exist are skipped)";
+          submit_str = "Merge";
+        } else {
+          str = "Choose a (previously exported .XML or .MSFS snapshot, plain or .gz compressed) File to upload (which will be used for the Import, or a delta for the Update)";
+          submit_str = "Upload";
+        }
+        rv = printf("\t\t\t<h1 class=\"msf\">Upload</h1>\n"
+                    "\t\t\t<p class=\"msf\">%s</p>\n"
+                    "\t\t\t<div class=\"msf-btns\"><input type=\"file\" name=\"upload\"></div>\n"
+                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"%s\">%s</button>\n"
+                    "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Stop\">Stop</button></div>\n"
+                    "\t\t</form>\n"
+                    "\t</body>\n"
+                    "</html>\n",
+            str,
+            submit_str,
+            submit_str);
+        e = rv < 0;
+        break;
+      case B_UPLOAD_REPORT:
+        str = wms->seq == S_MERGE_REPORT ? "merged" : "imported";
+        rv = printf("\t\t\t<h1 class=\"msf\">XML File %s</h1>\n"
+                    "\t\t\t<p class=\"msf\">%d card(s) in %d deck(s) %s</p>\n",
+            str,
+            wms->card_n,
+            wms->deck_n,
+            str);
+        e = rv < 0;
+        if (e == 0) {
+          if (wms->posted_message_digest != NULL) {
+            print_hex(digest_str, wms->posted_message_digest, SHA1_HASH_SIZE);
+            rv = printf("\t\t\t<p class=\"msf\">sha1 = %s</p>\n", digest_str);
+            e = rv < 0;
+          }
+          if (e == 0) {
+            rv = printf("\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"OK\">OK</button></div>\n"
+                        "\t\t</form>\n"
+                        "\t\t<code class=\"msf\">%s; chunks=%d, swaps=%d, avg=%d</code>\n"
+                        "\t</body>\n"
+                        "</html>\n",
+                sw_info_str,
+                wms->ms.imf.chunk_count,
+                wms->ms.imf.stat_swap,
+                wms->ms.imf.stat_swap / wms->ms.imf.chunk_count);
+            e = rv < 0;
+          }
+        }
+        break;
+      case B_EXPORT:
+        e = wms->file_title_str == NULL;
+        if (e == 0) {
+          dup_str = strdup(wms->file_title_str);
+          e = dup_str == NULL;
+          if (e == 0) {
+            len = strlen(dup_str);
+            e = len <= 5;
+            if (e == 0) {
+              ext_str = strrchr(dup_str, '.');
+              e = ext_str == NULL || ext_str - dup_str != len - 5 || strcmp(ext_str, ".imsf") != 0;
+              if (e == 0) {
+                *ext_str = '\0';
+                xg.w_lineptr = NULL;
+                xg.w_n = 0;
+                xg.w_fmt = NULL;
+                xg.w_fmt_n = 0;
+                xg.w_z = NULL;
+                xg.w_zbuf = NULL;
+                if (accept_gzip(getenv("HTTP_ACCEPT_ENCODING"))) {
+                  e = xg_gzip(&xg);
+                }
+                ce_str = xg.w_z != NULL ? "Content-Encoding: gzip\r\n" : "";
+                if (e == 0) {
+                  if (wms->seq == S_SNAPSHOT || wms->seq == S_DELTA) { // its sections carry their digests, sent in one pass
+                    sb_l[0].sb_d = NULL;
+                    sb_l[1].sb_d = NULL;
+                    if (wms->seq == S_DELTA) {
+                      e = ms_load_base(&wms->ms, sb_l + 0);
+                    }
+                    if (e == 0) {
+                      e = ms_build_base(&wms->ms, sb_l + 1);
+                    }
+                    if (e == 0) {
+                      rv = printf("Content-Disposition: attachment; filename=\"%s%s.msfs\"\r\n"
+                                  "Content-Type: application/octet-stream\r\n"
+                                  "%s\r\n",
+                          dup_str,
+                          wms->seq == S_DELTA ? "#delta" : "",
+                          ce_str);
+                      e = rv < 0;
+                    }
+                    if (e == 0) {
+                      xg.w_stream = stdout;
+                      xg.w_sha1 = NULL;
+                      e = gen_snapshot(&xg, &wms->ms, wms->seq == S_DELTA ? sb_l + 0 : NULL, sb_l + 1);
+                      if (e == 0 && xg.w_z != NULL) {
+                        e = xg_deflate(&xg, NULL, 0, Z_FINISH);
+                      }
+                    }
+                    base_free(sb_l + 0);
+                    base_free(sb_l + 1);
+                  } else {
+                    e = sha1_reset(&sha1);
+                    if (e == 0) {
+                      xg.w_stream = NULL; // the digest for the file name first, the XML is generated again to be sent
+                      xg.w_sha1 = &sha1;
+                      e = gen_xml(&xg, &wms->ms, wms->inds, wms->seq == S_SHARE);
+                      if (e == 0) {
+                        e = sha1_result(&sha1, message_digest);
+                      }
+                    }
+                    if (e == 0) {
+                      print_hex(digest_str, message_digest, SHA1_HASH_SIZE);
+                      rv = printf("Content-Disposition: attachment; filename=\"%s%s#sha1-%s.xml\"\r\n"
+                                  "Content-Type: application/xml; charset=utf-8\r\n"
+                                  "%s\r\n",
+                          dup_str, wms->seq == S_SHARE ? "-checked" : "", digest_str, ce_str);
+                      e = rv < 0;
+                      if (e == 0) {
+                        xg.w_stream = stdout;
+                        xg.w_sha1 = NULL;
+                        e = gen_xml(&xg, &wms->ms, wms->inds, wms->seq == S_SHARE);
+                        if (e == 0 && xg.w_z != NULL) {
+                          e = xg_deflate(&xg, NULL, 0, Z_FINISH);
+                        }
+                      }
+                    }
+                  }
+                }
+                free(xg.w_lineptr);
+                free(xg.w_fmt);
+                if (xg.w_z != NULL) {
+                  deflateEnd(xg.w_z);
+                  free(xg.w_z);
+                }
+                free(xg.w_zbuf);
+              }
+            }
+            free(dup_str);
+          }
+        }
+        break;
+      case B_SELECT_ARRANGE:
+        assert(wms->file_title_str != NULL && strlen(wms->tok_str) == 40);
+        if (wms->seq == S_DECKS_CREATE) {
+          submit_str = "Select";
+          text_str = "the deck to create";
+        } else if (wms->seq == S_SELECT_MOVE_ARRANGE) {
+          assert(wms->ms.mov_deck_i >= 0);
+          submit_str = "Move";
+          text_str = "the deck to move";
+        } else {
+          assert(wms->seq == S_CARD_ARRANGE);
+          submit_str = "Move";
+          text_str = "the card to move";
+        }
+        rv = printf("\t\t\t<h1 class=\"msf\">Select how to arrange %s</h1>\n"
+                    "\t\t\t<div class=\"msf-btns\">\n",
+            text_str);
+        e = rv < 0;
+        if (e == 0) {
+          for (i = 0; i < 3 && e == 0; i++)
+            if (wms->mode != M_CARD || i != 1) {
+              rv = printf("\t\t\t\t<label class=\"msf-div\"><input type=\"radio\" name=\"arrange\" value=\"%d\"%s>%s</label>\n",
+                  i,
+                  i == wms->ms.arrange ? " checked" : "",
+                  ARRANGE[i]);
+              e = rv < 0;
+            }
+          if (e == 0) {
+            rv = printf("\t\t\t</div>\n"
+                        "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"%s\">%s</button>\n"
+                        "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Stop\">Stop</button></div>\n"
+                        "\t\t</form>\n"
+                        "\t\t<code class=\"msf\">%s</code>\n"
+                        "\t</body>\n"
+                        "</html>\n",
+                submit_str,
+                submit_str,
+                sw_info_str);
+            e = rv < 0;
+          }
+        }
+        break;
+      case B_DECK_NAME:
+        assert(wms->file_title_str != NULL && strlen(wms->tok_str) == 40);
+        if (wms->seq == S_DECK_NAME || wms->seq == S_DECKS_CREATE) {
+          header_str = "Enter the name of the deck to create.";
+          text_str = wms->ms.deck_name_str != NULL ? wms->ms.deck_name_str : "";
+          submit_str = "Create";
+        } else {
+          assert(wms->seq == S_DECKS_RENAME && wms->ms.deck_i >= 0 && wms->ms.deck_i < wms->ms.deck_a);
+          header_str = "Enter the name to rename the deck to.";
+          text_str = sa_get(&wms->ms.deck_sa, wms->ms.deck_i);
+          e = text_str == NULL;
+          submit_str = "Rename";
+        }
+        if (e == 0) {
+          e = xml_escape(&wms->html_lp, &wms->html_n, text_str, ESC_AMP | ESC_QUOT, &esc_str);
+          if (e == 0) {
+            rv = printf("\t\t\t<h1 class=\"msf\">%s</h1>\n"
+                        "\t\t\t<div class=\"msf-btns\"><input type=\"text\" name=\"deck-name\" value=\"%s\" size=25 placeholder=\"Enter deck name here...\"></div>\n"
+                        "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"%s\">%s</button>\n"
+                        "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Stop\">Stop</button></div>\n"
+                        "\t\t</form>\n"
+                        "\t\t<code class=\"msf\">%s</code>\n"
+                        "\t</body>\n"
+                        "</html>\n",
+                header_str,
+                esc_str,
+                submit_str,
+                submit_str,
+                sw_info_str);
+            e = rv < 0;
+          }
+        }
+        break;
+      case B_STYLE:
+        str = sa_get(&wms->ms.style_sa, wms->ms.deck_i);
+        e = xml_escape(&wms->html_lp, &wms->html_n, str, ESC_AMP | ESC_LT, &esc_str);
+        if (e == 0) {
+          rv = printf("\t\t\t<h1 class=\"msf\">Style</h1>\n"
+                      "\t\t\t<p class=\"msf\">Define the (inline) &lt;style&gt; for this deck (and it's cards).</p>\n"
+                      "\t\t\t<div class=\"msf-txtarea\"><textarea class=\"msf\" name=\"style-txt\" rows=\"10\" placeholder=\"div.qa-txt { font-family: serif; }\ndiv.qa-html { background-color: #ffe; }\ndiv#a-html { text-align: center; }\ndiv#q-txt { color: #888; }\n/* ... */\">%s</textarea></div>\n"
+                      "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Apply\">Apply</button>\n"
+                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Stop\">Stop</button></div>\n"
+                      "\t\t</form>\n"
+                      "\t\t<code class=\"msf\">%s</code>\n"
+                      "\t</body>\n"
+                      "</html>\n",
+              esc_str,
+              sw_info_str);
+          e = rv < 0;
+        }
+        break;
+      case B_SELECT_DEST_DECK:
+        assert(wms->file_title_str != NULL && strlen(wms->tok_str) == 40);
+        assert(wms->seq == S_EDITING_SEND || wms->seq == S_SELECT_DEST_CAT || wms->seq == S_SELECT_PROCEED_SEND);
+        assert(wms->ms.mov_deck_i >= 0);
+        switch (wms->mode) {
+        case M_SEND:
+          header_str = "Sending";
+          notice_str = "to move the card to";
+          submit_str = "Send";
+          break;
+        case M_PROCEED_SEND:
+          header_str = "Proceed &amp; Send";
+          notice_str = "to move the rated card to";
+          submit_str = "Send";
+          break;
+        case M_MOVE:
+          header_str = "Moving";
+          notice_str = "where to move";
+          submit_str = "Select";
+          break;
+        default:
+          e = E_GHTML_1; // unexpected mode B_SELECT_DEST_DECK
+          break;
+        }
+        if (e == 0) {
+          assert(strlen(mtime_str) == 16);
+          rv = printf("\t\t\t<h1 class=\"msf\">%s</h1>\n", header_str);
+          e = rv < 0;
+          if (e == 0) {
+            rv = printf("\t\t\t<p class=\"msf\">Select the deck %s</p>\n", notice_str);
+            e = rv < 0;
+          }
+          if (e == 0) {
+            e = inds_set(wms->inds, 3, 0);
+            if (e == 0) {
+              e = gen_html_deck(wms->ms.n_first, H_CHILD, wms, Y_RADIO);
+              if (e == 0) {
+                rv = printf("\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"%s\">%s</button>\n"
+                            "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Stop\">Stop</button></div>\n"
+                            "\t\t</form>\n"
+                            "\t\t<code class=\"msf\">%s</code>\n"
+                            "\t</body>\n"
+                            "</html>\n",
+                    submit_str,
+                    submit_str,
+                    sw_info_str);
+                e = rv < 0;
+              }
+            }
+          }
+        }
+        break;
+      case B_SELECT_DECK:
+        sel_type = Y_RADIO;
+        e = wms->file_title_str == NULL || strlen(wms->tok_str) != 40;
+        if (e == 0) {
+          j = 0;
+          switch (wms->mode) {
+          case M_EDIT:
+            header_str = "Select a category to edit";
+            break;
+          case M_LEARN:
+            header_str = "Select a category to learn";
+            j = 1;
+            sel_type = Y_CHECKBOX;
+            break;
+          case M_SEARCH:
+            header_str = "Select a category to search";
+            j = 2;
+            break;
+          case M_START:
+            header_str = "Select a deck (if possible) and / or a action";
+            break;
+          default:
+            e = E_GHTML_2; // unexpected mode B_SELECT_DECK
+            break;
+          }
+          if (e == 0) {
+            rv = printf("\t\t\t<h1 class=\"msf\">%s</h1>\n", header_str);
+            e = rv < 0;
+            if (e == 0) {
+              dis_str = wms->ms.n_first >= 0 ? "" : " disabled";
+              if (wms->mode == M_START) {
+                rv = printf("\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Create\">Create</button>\n"
+                            "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Rename\"%s>Rename</button>\n"
+                            "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Move\"%s>Move</button>\n"
+                            "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Delete\"%s>Delete</button>\n"
+                            "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Toggle\"%s>Toggle</button>\n"
+                            "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Merge\"%s>Merge</button></div>\n",
+                    dis_str,
+                    dis_str,
+                    dis_str,
+                    dis_str,
+                    dis_str);
+                e = rv < 0;
+              }
+              if (e == 0) {
+                e = inds_set(wms->inds, 3, 0);
+                if (e == 0) {
+                  e = gen_html_deck(wms->ms.n_first, H_CHILD, wms, sel_type);
+                }
+              }
+              if (e == 0) {
+                rv = printf("\t\t\t<div class=\"msf-btns\">");
+                e = rv < 0;
+                for (i = 0; i < 3 && e == 0; i++) {
+                  k = (i + j) % 3;
+                  rv = printf("%s<button class=\"msf\" type=\"submit\" name=\"event\" value=\"%s\"%s>%s</button>\n",
+                      i > 0 ? "\t\t\t\t" : "",
+                      event_str[k],
+                      dis_str,
+                      event_str[k]);
+                  e = rv < 0;
+                }
+                if (e == 0) {
+                  rv = printf("\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Cancel\">Cancel</button></div>\n"
+                              "\t\t</form>\n"
+                              "\t\t<code class=\"msf\">%s</code>\n"
+                              "\t</body>\n"
+                              "</html>\n",
+                      sw_info_str);
+                  e = rv < 0;
+                }
+              }
+            }
+          }
+        }
+        break;
+      case B_EDIT:
+        q_str = sa_get(&wms->ms.card_sa, 0);
+        a_str = sa_get(&wms->ms.card_sa, 1);
+        e = xml_escape(&wms->html_lp, &wms->html_n, q_str, ESC_AMP | ESC_LT, &esc_str);
+        if (e == 0) {
+          n = 0;
+          assert(wms->ms.deck_a > 0);
+          for (i = 0; i < wms->ms.deck_a && n < 2; i++) {
+            n += wms->ms.cat_t[i].deck_slot_used != 0;
+          }
+          assert(strlen(mtime_str) == 16 && wms->file_title_str != NULL && strlen(wms->tok_str) == 40);
+          rv = printf("\t\t\t<h1 class=\"msf\">Editing</h1>\n"
+                      "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Insert\"%s>Insert</button>\n"
+                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Append\">Append</button>\n"
+                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Delete\"%s>Delete</button>\n"
+                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Previous\"%s>Previous</button>\n"
+                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Next\"%s>Next</button></div>\n"
+                      "\t\t\t<div class=\"msf-txtarea\"><textarea class=\"msf\" name=\"q\" rows=\"10\"%s%s>%s</textarea></div>\n"
+                      "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Schedule\"%s>Schedule</button>\n"
+                      "\t\t\t\t<span class=\"msf-space\"></span>\n"
+                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Set\"%s>Set</button>\n"
+                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Move\"%s>Move</button>\n"
+                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Send\"%s>Send</button></div>\n",
+              wms->ms.card_a > 0 ? "" : " disabled",
+              wms->ms.card_a > 0 ? "" : " disabled",
+              wms->ms.card_a > 0 && wms->ms.card_i > 0 ? "" : " disabled",
+              wms->ms.card_a > 0 && wms->ms.card_i + 1 < wms->ms.card_a ? "" : " disabled",
+              q_str != NULL && q_str[0] == '\0' ? " placeholder=\"Type question here...\"" : "",
+              q_str != NULL ? "" : " disabled",
+              esc_str,
+              wms->ms.card_i >= 0 && wms->ms.card_a > 0 && wms->ms.card_i < wms->ms.card_a && (wms->ms.card_l[wms->ms.card_i].card_state & 0x07) >= STATE_NEW ? "" : " disabled",
+              wms->ms.card_i != wms->ms.mov_card_i ? "" : " disabled",
+              wms->ms.mov_card_i != -1 && wms->ms.card_i != wms->ms.mov_card_i ? "" : " disabled",
+              wms->ms.card_i != -1 && n > 1 ? "" : " disabled");
+          e = rv < 0;
+          if (e == 0) {
+            e = xml_escape(&wms->html_lp, &wms->html_n, a_str, ESC_AMP | ESC_LT, &esc_str);
+            if (e == 0) {
+              rv = printf("\t\t\t<div class=\"msf-txtarea\"><textarea class=\"msf\" name=\"a\" rows=\"10\"%s%s>%s</textarea></div>\n"
+                          "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Learn\"%s>Learn</button>\n"
+                          "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Search\"%s>Search</button>\n"
+                          "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Preview\"%s>Preview</button>\n"
+                          "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Stop\">Stop</button>\n"
+                          "\t\t\t\t<label class=\"msf-div\"><input type=\"checkbox\" name=\"is-html\"%s>HTML</label></div>\n",
+                  a_str != NULL && a_str[0] == '\0' ? " placeholder=\"Type answer here...\"" : "",
+                  a_str != NULL ? "" : " disabled",
+                  esc_str,
+                  wms->ms.card_a > 0 ? "" : " disabled",
+                  wms->ms.card_a > 0 ? "" : " disabled",
+                  wms->ms.card_a > 0 ? "" : " disabled",
+                  wms->ms.card_i >= 0 && wms->ms.card_a > 0 && wms->ms.card_i < wms->ms.card_a && (wms->ms.card_l[wms->ms.card_i].card_state & 0x08) != 0 ? " checked" : "");
+              e = rv < 0;
+              if (e == 0) {
+                imf_info_swaps(&wms->ms.imf);
+                rv = printf("\t\t</form>\n"
+                            "\t\t<code class=\"msf\">%s; chunks=%d, swaps=%d, avg=%d</code>\n"
+                            "\t</body>\n"
+                            "</html>\n",
+                    sw_info_str,
+                    wms->ms.imf.chunk_count,
+                    wms->ms.imf.stat_swap,
+                    wms->ms.imf.stat_swap / wms->ms.imf.chunk_count);
+                e = rv < 0;
+              }
+            }
+          }
+        }
+        break;
+      case B_PREVIEW:
+        q_str = sa_get(&wms->ms.card_sa, 0);
+        a_str = sa_get(&wms->ms.card_sa, 1);
+        e = q_str == NULL || a_str == NULL || strlen(mtime_str) != 16 || wms->file_title_str == NULL || strlen(wms->tok_str) != 40;
+        if (e == 0) {
+          e = xml_escape(&wms->html_lp, &wms->html_n, q_str, (wms->ms.card_l[wms->ms.card_i].card_state & 0x08) != 0 ? 0 : ESC_AMP | ESC_LT, &esc_str);
+          if (e == 0) {
+            rv = printf("\t\t\t<h1 class=\"msf\">Preview</h1>\n"
+                        "\t\t\t<div class=\"msf-btns msf-anchor\"><input id=\"msf-unlock\" type=\"checkbox\" name=\"is-unlocked\"%s>\n"
+                        "\t\t\t<label class=\"msf-div\" for=\"msf-unlock\">Unlock</label>\n"
+                        "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Style\">Style</button>\n"
+                        "\t\t\t\t<button id=\"msf-surround\" class=\"msf\" type=\"button\" disabled>Surround</button>\n"
+                        "\t\t\t\t<button id=\"msf-unformat-btn\" class=\"msf\" type=\"button\" disabled>Unformat</button>\n"
+                        "\t\t\t\t<button id=\"msf-br\" class=\"msf\" type=\"button\" disabled>&lt;br&gt;</button>\n"
+                        "\t\t\t\t<div id=\"msf-inl-dlg\" class=\"msf-dlg\">\n"
+                        "\t\t\t\t\t<h1 class=\"msf\">Surround Node</h1>\n"
+                        "\t\t\t\t\t<select id=\"msf-format-inline\">\n"
+                        "\t\t\t\t\t\t<option value=\"DIV\">&lt;div&gt;</option>\n"
+                        "\t\t\t\t\t\t<option value=\"P\">&lt;p&gt;</option>\n"
+                        "\t\t\t\t\t\t<option value=\"PRE\">&lt;pre&gt;</option>\n"
+                        "\t\t\t\t\t\t<option value=\"BLOCKQUOTE\">&lt;blockquote&gt;</option>\n"
+                        "\t\t\t\t\t\t<option value=\"SPAN\">&lt;span&gt;</option>\n"
+                        "\t\t\t\t\t\t<option value=\"CODE\">&lt;code&gt;</option>\n"
+                        "\t\t\t\t\t\t<option value=\"EM\">&lt;em&gt;</option>\n"
+                        "\t\t\t\t\t\t<option value=\"MARK\">&lt;mark&gt;</option>\n"
+                        "\t\t\t\t\t\t<option value=\"STRONG\">&lt;strong&gt;</option>\n"
+                        "\t\t\t\t\t\t<option value=\"CITE\">&lt;cite&gt;</option>\n"
+                        "\t\t\t\t\t\t<option value=\"I\">&lt;i&gt;</option>\n"
+                        "\t\t\t\t\t\t<option value=\"B\">&lt;b&gt;</option>\n"
+                        "\t\t\t\t\t\t<option value=\"U\">&lt;u&gt;</option>\n"
+                        "\t\t\t\t\t</select>\n"
+                        "\t\t\t\t\t<div class=\"msf-btns\"><button id=\"msf-inl-apply\" class=\"msf\" type=\"button\">Apply</button>\n"
+                        "\t\t\t\t\t\t<button id=\"msf-inl-cancel\" class=\"msf\" type=\"button\">Cancel</button></div>\n"
+                        "\t\t\t\t</div>\n"
+                        "\t\t\t</div>\n"
+                        "\t\t\t<div id=\"%s\" class=\"%s\">%s</div>\n",
+                wms->ms.card_i >= 0 && wms->ms.card_a > 0 && wms->ms.card_i < wms->ms.card_a && (wms->ms.card_l[wms->ms.card_i].card_state & 0x08) != 0 ? "" : " disabled",
+                (wms->ms.card_l[wms->ms.card_i].card_state & 0x08) != 0 ? "q-html" : "q-txt",
+                (wms->ms.card_l[wms->ms.card_i].card_state & 0x08) != 0 ? "qa-html" : "qa-txt",
+                esc_str);
+            e = rv < 0;
+          }
+        }
+        if (e == 0) {
+          e = xml_escape(&wms->html_lp, &wms->html_n, a_str, (wms->ms.card_l[wms->ms.card_i].card_state & 0x08) != 0 ? 0 : ESC_AMP | ESC_LT, &esc_str);
+          if (e == 0) {
+            rv = printf("\t\t\t<div id=\"%s\" class=\"%s\">%s</div>\n",
+                (wms->ms.card_l[wms->ms.card_i].card_state & 0x08) != 0 ? "a-html" : "a-txt",
+                (wms->ms.card_l[wms->ms.card_i].card_state & 0x08) != 0 ? "qa-html" : "qa-txt",
+                esc_str);
+            e = rv < 0;
+          }
+        }
+        if (e == 0) {
+          rv = printf("\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Edit\">Edit</button>\n"
+                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Learn\">Learn</button>\n"
+                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Search\">Search</button>\n"
+                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Stop\">Stop</button></div>\n");
+          e = rv < 0;
+        }
+        if (e == 0) {
+          rv = printf("\t\t</form>\n"
+                      "\t\t<code class=\"msf\">%s; neli: %d</code>\n"
+                      "\t</body>\n"
+                      "</html>\n",
+              sw_info_str,
+              wms->ms.cards_nel);
+          e = rv < 0 ? E_GHTML_3 : 0;
+        }
+        break;
+      case B_SEARCH:
+        e = xml_escape(&wms->html_lp, &wms->html_n, wms->ms.search_txt, ESC_AMP | ESC_QUOT, &esc_str);
+        if (e == 0) {
+          assert(wms->file_title_str != NULL && strlen(wms->tok_str) == 40);
+          assert(wms->ms.match_case == -1 || wms->ms.match_case == 1);
+          rv = printf("\t\t\t<h1 class=\"msf\">Searching</h1>\n"
+                      "\t\t\t<div class=\"msf-btns\"><input class=\"msf\" type=\"text\" name=\"search-txt\" value=\"%s\" size=25>\n"
+                      "\t\t\t\t<label class=\"msf-div\"><input type=\"checkbox\" name=\"match-case\"%s>Match&nbsp;Case</label>\n",
+              esc_str,
+              wms->ms.match_case > 0 ? " checked" : "");
+          e = rv < 0;
+          j = wms->ms.search_mode > SM_LITERAL && wms->ms.search_mode <= SM_FUZZY ? wms->ms.search_mode : SM_LITERAL;
+          for (i = SM_LITERAL; i <= SM_FUZZY && e == 0; i++) {
+            rv = printf("\t\t\t\t<input id=\"msf-mode-%d\" type=\"radio\" name=\"search-mode\" value=\"%d\"%s>\n"
+                        "\t\t\t\t<label class=\"msf-div\" for=\"msf-mode-%d\">%s</label>\n",
+                i, i,
+                i == j ? " checked" : "",
+                i, SEARCH_MODE[i]);
+            e = rv < 0;
+          }
+          if (e == 0) {
+            rv = printf("\t\t\t\t<select class=\"msf\" name=\"search-dist\" title=\"Edits a fuzzy match may need\">\n");
+            e = rv < 0;
+          }
+          j = wms->ms.search_dist > 0 ? wms->ms.search_dist : 1;
+          for (i = 1; i <= FZ_DIST_MAX && e == 0; i++) {
+            rv = printf("\t\t\t\t\t<option value=\"%d\"%s>%d&nbsp;edit%s</option>\n",
+                i,
+                i == j ? " selected" : "",
+                i, i > 1 ? "s" : "");
+            e = rv < 0;
+          }
+          if (e == 0) {
+            rv = printf("\t\t\t\t</select></div>\n");
+            e = rv < 0;
+          }
+          if (e == 0 && wms->search_err != NULL) {
+            rv = printf("\t\t\t<p class=\"msf\">%s</p>\n", wms->search_err);
+            e = rv < 0;
+          }
+          if (e == 0) {
+            q_str = sa_get(&wms->ms.card_sa, 0);
+            a_str = sa_get(&wms->ms.card_sa, 1);
+            e = print_search_field(q_str, wms->span_l[0], wms->span_n[0], wms->found_str != NULL);
+            if (e == 0) {
+              rv = printf("\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Reverse\"%s>Reverse</button>\n"
+                          "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Forward\"%s>Forward</button>\n"
+                          "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"List\"%s>List</button>\n"
+                          "\t\t\t\t<span class=\"msf-space\"></span>\n",
+                  wms->ms.card_a > 0 || wms->ms.scope == C_ALL ? "" : " disabled",
+                  wms->ms.card_a > 0 || wms->ms.scope == C_ALL ? "" : " disabled",
+                  wms->ms.card_a > 0 || wms->ms.scope == C_ALL ? "" : " disabled");
+              e = rv < 0;
+              j = wms->ms.scope >= C_CURRENT && wms->ms.scope <= C_ALL ? wms->ms.scope : 0;
+              for (i = C_CURRENT; i <= C_ALL && e == 0; i++) {
+                if (i != C_CHECKED) {
+                  rv = printf("\t\t\t\t<input id=\"msf-scope-%d\" type=\"radio\" name=\"scope\" value=\"%d\"%s%s>\n"
+                              "\t\t\t\t<label class=\"msf-div\" for=\"msf-scope-%d\">%s</label>\n",
+                      i, i,
+                      i == j ? " checked" : "",
+                      i == 1 ? " disabled" : "",
+                      i, SCOPE[i]);
+                  e = rv < 0;
+                }
+              }
+              if (e == 0) {
+                rv = printf("\t\t\t</div>\n");
+                e = rv < 0;
+              }
+              if (e == 0) {
+                e = print_search_field(a_str, wms->span_l[1], wms->span_n[1], wms->found_str != NULL);
+                if (e == 0) {
+                  rv = printf("\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Edit\">Edit</button>\n"
+                              "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Learn\"%s>Learn</button>\n"
+                              "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Stop\">Stop</button></div>\n"
+                              "\t\t</form>\n"
+                              "\t\t<code class=\"msf\">%s</code>\n"
+                              "\t</body>\n"
+                              "</html>\n",
+                      wms->ms.card_a > 0 ? "" : " disabled",
+                      sw_info_str);
+                  e = rv < 0;
+                }
+              }
+            }
+          }
+        }
+        break;
+      case B_PREFERENCES:
+        assert(wms->file_title_str != NULL && strlen(wms->tok_str) == 40);
+        rv = printf("\t\t\t<h1 class=\"msf\">Preferences</h1>\n"
+                    "\t\t\t<p class=\"msf\">Timeout</p>\n"
+                    "\t\t\t<div>\n");
+        e = rv < 0;
+        if (e == 0) {
+          j = -1;
+          for (i = 0; i < 5 && j == -1; i++) {
+            if (timeouts[i].to_sec * timeouts[i].to_count >= wms->ms.passwd.timeout.to_count * wms->ms.passwd.timeout.to_sec) {
+              j = i;
+            }
+          }
+          if (j == -1) {
+            j = 1;
+          }
+          for (i = 0; i < 5 && e == 0; i++) {
+            attr_str = i == j ? " checked" : "";
+            rv = printf("\t\t\t\t<label class=\"msf-td\"><input type=\"radio\" name=\"timeout\" value=\"%d\"%s>%s</label>\n",
+                i,
+                attr_str,
+                TIMEOUTS[i]);
+            e = rv < 0;
+          }
+          if (e == 0) {
+            rv = printf("\t\t\t</div>\n"
+                        "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Apply\">Apply</button>\n"
+                        "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Cancel\">Cancel</button></div>\n"
+                        "\t\t</form>\n"
+                        "\t\t<code class=\"msf\">%s</code>\n"
+                        "\t</body>\n"
+                        "</html>\n",
+                sw_info_str);
+            e = rv < 0;
+          }
+        }
+        break;
+      case B_ABOUT:
+        rv = printf("\t\t\t<h1 class=\"msf\">About <a href=\"https://www.lorenz-pullwitt.de/MemorySurfer/\">MemorySurfer</a> v%08x</h1>\n"
+                    "\t\t\t<p class=\"msf\">Author: Lorenz Pullwitt</p>\n"
+                    "\t\t\t<p class=\"msf\">Copyright 2016-2024</p>\n"
+                    "\t\t\t<p class=\"msf\">Send bugs and suggestions to\n"
+                    "<a href=\"mailto:memorysurfer@lorenz-pullwitt.de\">memorysurfer@lorenz-pullwitt.de</a></p>\n"
+                    "\t\t\t<cite class=\"msf\">MemorySurfer is free software; you can redistribute it and/or\n"
+                    "modify it under the terms of the GNU\302\240General\302\240Public\302\240License\n"
+                    "as published by the Free\302\240Software\302\240Foundation; either version 2\n"
+                    "of the License, or (at your option) any later version.</cite>\n"
+                    "\t\t\t<cite class=\"msf\">This program is distributed in the hope that it will be useful,\n"
+                    "but WITHOUT ANY WARRANTY; without even the implied warranty of\n"
+                    "MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the\n"
+                    "<a href=\"https://www.gnu.org/licenses/\">GNU\302\240General\302\240Public\302\240License</a> for more details.</cite>\n"
+                    "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"OK\">OK</button></div>\n"
+                    "\t\t</form>\n"
+                    "\t\t<code class=\"msf\">%s, PATH_MAX=%u</code>\n"
+                    "\t</body>\n"
+                    "</html>\n",
+            MSF_VERSION,
+            sw_info_str,
+            PATH_MAX);
+        e = rv < 0;
+        break;
+      case B_LEARN:
+        q_str = sa_get(&wms->ms.card_sa, 0);
+        a_str = sa_get(&wms->ms.card_sa, 1);
+        e = q_str == NULL || a_str == NULL || strlen(mtime_str) != 16 || wms->file_title_str == NULL || strlen(wms->tok_str) != 40 || wms->ms.deck_path == NULL ? E_GHTML_4 : 0;
+        if (e == 0) {
+          if (wms->mode == M_ASK) {
+            header_str = "Asking";
+          } else {
+            e = wms->mode != M_RATE ? E_GHTML_5 : 0;
+            if (e == 0) {
+              header_str = "Rating";
+            }
+          }
+          if (e == 0) {
+            rv = printf("\t\t\t<h1 class=\"msf\">%s</h1>\n"
+                        "\t\t\t<div class=\"msf-btns msf-anchor\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Proceed\"%s>Proceed</button>\n"
+                        "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Show\"%s>Show</button>\n"
+                        "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Reveal\"%s>Reveal</button>\n"
+                        "\t\t\t\t<span class=\"msf-space\"></span>\n"
+                        "\t\t\t\t<input id=\"msf-unlock\" type=\"checkbox\" name=\"is-unlocked\"%s>\n"
+                        "\t\t\t\t<label class=\"msf-div\" for=\"msf-unlock\">Unlock</label>\n"
+                        "\t\t\t\t<button id=\"msf-menu\" class=\"msf\" type=\"button\">☰</button>\n"
+                        "\t\t\t\t<div id=\"msf-data\" class=\"msf-dlg\">\n"
+                        "\t\t\t\t\t<h1 class=\"msf\">Data Views</h1>\n"
+                        "\t\t\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Histogram\">Histogram</button>\n"
+                        "\t\t\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Table\">Table</button>\n"
+                        "\t\t\t\t\t\t<span class=\"msf-space\"></span>\n"
+                        "\t\t\t\t\t\t<input id=\"msf-tools-cbox\" type=\"checkbox\"%s>\n"
+                        "\t\t\t\t\t\t<label class=\"msf-div\" for=\"msf-tools-cbox\">Tools</label></div>\n"
+                        "\t\t\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"ProceedSend\" style=\"max-width:min-content;\"%s>Proceed&amp;Send</button>\n"
+                        "\t\t\t\t\t\t<span class=\"msf-space\"></span>\n"
+                        "\t\t\t\t\t\t<button id=\"msf-data-close\" class=\"msf\" type=\"button\">Close</button></div>\n"
+                        "\t\t\t\t</div>\n"
+                        "\t\t\t</div>\n"
+                        "\t\t\t<div id=\"msf-tools\" class=\"msf-btns msf-anchor\" style=\"display: none;\"><button id=\"msf-surround\" class=\"msf\" type=\"button\" disabled>Surround</button>\n"
+                        "\t\t\t\t<button id=\"msf-unformat-btn\" class=\"msf\" type=\"button\" disabled>Unformat</button>\n"
+                        "\t\t\t\t<button id=\"msf-br\" class=\"msf\" type=\"button\" disabled>&lt;br&gt;</button>\n"
+                        "\t\t\t\t<div id=\"msf-inl-dlg\" class=\"msf-dlg\">\n"
+                        "\t\t\t\t\t<h1 class=\"msf\">Surround Node</h1>\n"
+                        "\t\t\t\t\t<select id=\"msf-format-inline\">\n"
+                        "\t\t\t\t\t\t<option value=\"DIV\">&lt;div&gt;</option>\n"
+                        "\t\t\t\t\t\t<option value=\"P\">&lt;p&gt;</option>\n"
+                        "\t\t\t\t\t\t<option value=\"PRE\">&lt;pre&gt;</option>\n"
+                        "\t\t\t\t\t\t<option value=\"BLOCKQUOTE\">&lt;blockquote&gt;</option>\n"
+                        "\t\t\t\t\t\t<option value=\"SPAN\">&lt;span&gt;</option>\n"
+                        "\t\t\t\t\t\t<option value=\"CODE\">&lt;code&gt;</option>\n"
+                        "\t\t\t\t\t\t<option value=\"EM\">&lt;em&gt;</option>\n"
+                        "\t\t\t\t\t\t<option value=\"MARK\">&lt;mark&gt;</option>\n"
+                        "\t\t\t\t\t\t<option value=\"STRONG\">&lt;strong&gt;</option>\n"
+                        "\t\t\t\t\t\t<option value=\"CITE\">&lt;cite&gt;</option>\n"
+                        "\t\t\t\t\t\t<option value=\"I\">&lt;i&gt;</option>\n"
+                        "\t\t\t\t\t\t<option value=\"B\">&lt;b&gt;</option>\n"
+                        "\t\t\t\t\t\t<option value=\"U\">&lt;u&gt;</option>\n"
+                        "\t\t\t\t\t</select>\n"
+                        "\t\t\t\t\t<div class=\"msf-btns\"><button id=\"msf-inl-apply\" class=\"msf\" type=\"button\">Apply</button>\n"
+                        "\t\t\t\t\t\t<button id=\"msf-inl-cancel\" class=\"msf\" type=\"button\">Cancel</button></div>\n"
+                        "\t\t\t\t</div>\n"
+                        "\t\t\t</div>\n",
+                header_str,
+                wms->mode != M_RATE ? " disabled" : "",
+                wms->mode != M_ASK ? " disabled" : "",
+                wms->mode != M_ASK ? " disabled" : "",
+                wms->ms.card_i >= 0 && wms->ms.card_a > 0 && wms->ms.card_i < wms->ms.card_a && (wms->ms.card_l[wms->ms.card_i].card_state & 0x08) != 0 && wms->mode == M_RATE ? "" : " disabled",
+                wms->mode != M_RATE ? " disabled" : "",
+                wms->mode != M_RATE ? " disabled" : "");
+            e = rv < 0 ? E_GHTML_6 : 0;
+          }
+          if (e == 0) {
+            e = xml_escape(&wms->html_lp, &wms->html_n, q_str, (wms->ms.card_l[wms->ms.card_i].card_state & 0x08) != 0 ? 0 : ESC_AMP | ESC_LT, &esc_str) ? E_GENLRN_1 : 0;
+            if (e == 0) {
+              rv = printf("\t\t\t<div id=\"%s\" class=\"%s\">%s</div>\n"
+                          "\t\t\t<table>\n",
+                  (wms->ms.card_l[wms->ms.card_i].card_state & 0x08) != 0 ? "q-html" : "q-txt",
+                  (wms->ms.card_l[wms->ms.card_i].card_state & 0x08) != 0 ? "qa-html" : "qa-txt",
+                  esc_str);
+              e = rv < 0 ? E_GENLRN_2 : 0;
+            }
+          }
+          if (e == 0) {
+            if (wms->mode == M_ASK) {
+              for (y = 0; y < 3 && e == 0; y++) {
+                rv = printf ("\t\t\t\t<tr>\n");
+                e = rv < 0 ? E_GENLRN_3 : 0;
+                for (x = 0; x < 2 && e == 0; x++) {
+                  rv = printf("\t\t\t\t\t<td class=\"msf-lvl\"><label class=\"msf-td\"><input type=\"radio\" disabled>Level</label></td>\n");
+                  e = rv < 0 ? E_GENLRN_4 : 0;
+                }
+                if (e == 0) {
+                  rv = printf("\t\t\t\t</tr>\n");
+                  e = rv < 0 ? E_GENLRN_5 : 0;
+                }
+              }
+            } else {
+              assert(wms->ms.card_i != -1);
+              if ((wms->ms.card_l[wms->ms.card_i].card_state & 0x07) == STATE_NEW) {
+                time_diff = lvl_s[1];
+                lvl = 0;
+              } else {
+                time_diff = wms->ms.timestamp - wms->ms.card_l[wms->ms.card_i].card_time;
+                for (i = 0; i < 21; i++) {
+                  if (lvl_s[i] >= wms->ms.card_l[wms->ms.card_i].card_strength)
+                    break;
+                }
+                lvl = i;
+              }
+              j = lvl - 2;
+              if (j < 0) {
+                j = 0;
+              }
+              for (i = 0; i < 21; i++) {
+                if (lvl_s[i] >= time_diff)
+                  break;
+              }
+              lvl_sel = i;
+              if (lvl_sel > j + 5) {
+                lvl_sel = j + 5;
+              }
+              for (y = 0; y < 3 && e == 0; y++) {
+                rv = printf("\t\t\t\t<tr>\n");
+                e = rv < 0 ? E_GENLRN_6 : 0;
+                assert(wms->html_n >= 19); // 8 + 10 + 1 " checked autofocus"
+                for (x = 0; x < 2 && e == 0; x++) {
+                  i = j + x + y * 2;
+                  wms->html_lp[0] = '\0';
+                  if (i == lvl) {
+                    strcat(wms->html_lp, " checked");
+                  }
+                  if (i == lvl_sel) {
+                    strcat(wms->html_lp, " autofocus");
+                  }
+                  set_time_str(time_diff_str, lvl_s[i]);
+                  rv = printf("\t\t\t\t\t<td class=\"msf-lvl\"><label class=\"msf-td\"><input type=\"radio\" name=\"lvl\" value=\"%d\"%s>Level %d (%s)</label></td>\n",
+                      i, wms->html_lp,
+                      i, time_diff_str);
+                  e = rv < 0 ? E_GENLRN_7 : 0;
+                }
+                if (e == 0) {
+                  rv = printf("\t\t\t\t</tr>\n");
+                  e = rv < 0 ? E_GENLRN_8 : 0;
+                }
+              }
+            }
+          }
+          if (e == 0) {
+            assert(wms->mode == M_ASK && wms->reveal_pos == -1 ? wms->ms.cards_nel >= 0 : 1);
+            e = xml_escape(&wms->html_lp, &wms->html_n, a_str, (wms->ms.card_l[wms->ms.card_i].card_state & 0x08) != 0 ? 0 : ESC_AMP | ESC_LT, &esc_str) ? E_GENLRN_9 : 0;
+            if (e == 0) {
+              rv = printf("\t\t\t</table>\n"
+                          "\t\t\t<div id=\"%s\" class=\"%s\"%s>%s</div>\n",
+                  (wms->ms.card_l[wms->ms.card_i].card_state & 0x08) != 0 ? "a-html" : "a-txt",
+                  (wms->ms.card_l[wms->ms.card_i].card_state & 0x08) != 0 ? "qa-html" : "qa-txt",
+                  wms->mode == M_RATE || wms->reveal_pos > 0 ? "" : " style=\"background-color: #eee;\"",
+                  wms->mode == M_RATE || wms->reveal_pos > 0 ? esc_str : "");
+              e = rv < 0 ? E_GHTML_7 : 0;
+            }
+          }
+          if (e == 0) {
+            time_diff = wms->ms.timestamp - wms->ms.card_l[wms->ms.card_i].card_time;
+            set_time_str(time_diff_str, time_diff);
+            rv = printf("\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Suspend\">Suspend</button>\n"
+                        "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Resume\"%s>Resume</button>\n"
+                        "\t\t\t\t<span class=\"msf-space\"></span>\n"
+                        "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Edit\">Edit</button>\n"
+                        "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Search\">Search</button>\n"
+                        "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Stop\">Stop</button></div>\n"
+                        "\t\t</form>\n"
+                        "\t\t<code class=\"msf\">path: %s; %s; neli: %d; mctr: %u; time_diff: %s</code>\n"
+                        "\t</body>\n"
+                        "</html>\n",
+                wms->ms.can_resume != 0 ? "" : " disabled",
+                wms->ms.deck_path,
+                sw_info_str,
+                wms->ms.cards_nel,
+                wms->ms.passwd.mctr,
+                time_diff_str);
+            e = rv < 0 ? E_GHTML_8 : 0;
+          }
+        }
+        break;
+      case B_MSG:
+        assert(wms->msg_header != NULL && wms->msg_btn_main != NULL);
+        if (wms->mode == M_NONE) {
+          assert(wms->todo_main >= S_FILE && wms->todo_main <= S_END);
+          rv = printf("\t\t\t\t<input type=\"hidden\" name=\"todo_main\" value=\"%d\">\n", wms->todo_main);
+          e = rv < 0;
+        }
+        if (e == 0) {
+          rv = printf("\t\t\t</div>\n"
+                      "\t\t\t<h1 class=\"msf\">%s</h1>\n",
+              wms->msg_header);
+          e = rv < 0;
+          if (wms->msg_static != NULL && e == 0) {
+            rv = printf("\t\t\t<p class=\"msf\">%s</p>\n", wms->msg_static);
+            e = rv < 0;
+          }
+          if (e == 0) {
+            rv = printf("\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"%s\">%s</button>\n",
+                wms->msg_btn_main,
+                wms->msg_btn_main);
+            e = rv < 0;
+          }
+        }
+        if (e == 0 && wms->msg_btn_alt != NULL) {
+          rv = printf("\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"%s\">%s</button>\n",
+              wms->msg_btn_alt,
+              wms->msg_btn_alt);
+          e = rv < 0;
+        }
+        if (e == 0) {
+          rv = printf("\t\t\t</div>\n"
+                      "\t\t</form>\n"
+                      "\t\t<code class=\"msf\">%s</code>\n"
+                      "\t</body>\n"
+                      "</html>\n",
+              sw_info_str);
+          e = rv < 0;
+        }
+        break;
+      case B_HISTOGRAM:
+        vby = wms->hist_max;
+        if (vby < 61)
+          vby = 61;
+        else if (vby > 121)
+          vby = 121;
+        wms->html_lp[0] = '\0';
+        rv = snprintf(wms->html_lp, wms->html_n, "M1 %d", vby);
+        e = rv < 0 || rv >= wms->html_n;
+        if (e == 0) {
+          n = rv;
+          y = 0;
+          dx = 0;
+          for (i = 0; i < 100 && e == 0; i++) {
+            dy = y - wms->hist_bucket[i];
+            if (dy != 0) {
+              if (dx > 0) {
+                size = wms->html_n - n;
+                rv = snprintf(wms->html_lp + n, size, "h%d", dx);
+                e = rv < 0 || rv >= size;
+                n += rv;
+                dx = 0;
+              }
+              if (e == 0) {
+                size = wms->html_n - n;
+                rv = snprintf(wms->html_lp + n, size, "v%d", dy);
+                e = rv < 0 || rv >= size;
+                n += rv;
+                y -= dy;
+              }
+            }
+            dx++;
+          }
+          if (e == 0) {
+            size = wms->html_n - n;
+            rv = snprintf(wms->html_lp + n, size, "h%d", dx);
+            e = rv < 0 || rv >= size;
+            n += rv;
+            if (e == 0) {
+              if (y > 0) {
+                size = wms->html_n - n;
+                rv = snprintf(wms->html_lp + n, size, "v%d", y);
+                e = rv < 0 || rv >= size;
+                n += rv;
+              }
+              if (e == 0) {
+                size = wms->html_n - n;
+                rv = snprintf(wms->html_lp + n, size, "z");
+                e = rv < 0 || rv >= size;
+                n += rv;
+              }
+            }
+          }
+          if (e == 0) {
+            strcpy(fc_path, "M1 61");
+            len = 5;
+            fc_n = 0;
+            for (i = 0; i < 30; i++) {
+              y = wms->fc_max > 0 ? 61 - wms->fc_bucket[i] * 60 / wms->fc_max : 61;
+              len += sprintf(fc_path + len, "V%dh3", y);
+              fc_n += wms->fc_bucket[i];
+            }
+            strcpy(fc_path + len, "V61z");
+            e = imf_info_gaps(&wms->ms.imf);
+            if (e == 0) {
+              rv = printf("\t\t\t<h1 class=\"msf\">Histogram</h1>\n"
+                          "\t\t\t<p class=\"msf\">Retention</p>\n"
+                          "\t\t\t<svg class=\"msf\" viewbox=\"0 0 101 %d\">\n"
+                          "\t\t\t\t<path d=\"%s\" />\n"
+                          "\t\t\t</svg>\n"
+                          "\t\t\t<p class=\"msf\">Forecast (checked decks, next 30 days): %d card(s) due, %d today, at most %d a day</p>\n"
+                          "\t\t\t<svg class=\"msf\" viewbox=\"0 0 92 62\">\n"
+                          "\t\t\t\t<path d=\"%s\" />\n"
+                          "\t\t\t</svg>\n"
+                          "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Edit\">Edit</button>\n"
+                          "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Learn\">Learn</button>\n"
+                          "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Search\">Search</button>\n"
+                          "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Refresh\">Refresh</button>\n"
+                          "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Done\">Done</button></div>\n"
+                          "\t\t</form>\n"
+                          "\t\t<code class=\"msf\">%s; gaps=%d, gaps_size=%d, Details: %s, n=%d</code>\n"
+                          "\t</body>\n"
+                          "</html>\n",
+                  vby + 1,
+                  wms->html_lp,
+                  fc_n,
+                  wms->fc_bucket[0],
+                  wms->fc_max,
+                  fc_path,
+                  sw_info_str,
+                  wms->ms.imf.stats_gaps,
+                  wms->ms.imf.stats_gaps_space,
+                  wms->ms.imf.stats_gaps_str,
+                  n);
+              e = rv < 0;
+            }
+          }
+        }
+        break;
+      case B_TABLE:
+        rv = printf("\t\t\t<h1 class=\"msf\">Table</h1>\n"
+                    "\t\t\t<p class=\"msf\">%d deck(s) checked (for learning).</p>\n"
+                    "\t\t\t<table>\n"
+                    "\t\t\t\t<thead>\n"
+                    "\t\t\t\t\t<tr><td>Level</td><td>Strength</td><td>Cards</td><td>Eligible</td><td>Threshold</td></tr>\n"
+                    "\t\t\t\t</thead>\n"
+                    "\t\t\t\t<tbody>\n",
+            wms->checked_decks);
+        e = rv < 0;
+        size = sizeof(el_str);
+        for (i = 0; i < 21 && e == 0; i++) {
+          set_time_str(time_diff_str, lvl_s[i]);
+          if (wms->lvl_bucket[0][i] > 0) {
+            j = 100 * wms->lvl_bucket[1][i] / wms->lvl_bucket[0][i];
+            rv = snprintf(el_str, size, "%d%%", j);
+            e = rv < 0 || rv >= size;
+          } else
+            strcpy(el_str, "n/a");
+          if (!e) {
+            rv = printf("\t\t\t\t\t<tr>"
+                        "<td class=\"msf-str\"><label for=\"%d\">%d</label></td>"
+                        "<td class=\"msf-str\"><label for=\"%d\"><code class=\"msf\">(%s)</code></label></td>"
+                        "<td class=\"msf-str\"><label for=\"%d\">%d</label></td>"
+                        "<td class=\"msf-str\"><label for=\"%d\">%s</label></td>"
+                        "<td class=\"msf-str\"><input id=\"%d\" type=\"radio\" name=\"rank\" value=\"%d\"%s></td></tr>\n",
+                i, i,
+                i, time_diff_str,
+                i, wms->lvl_bucket[0][i],
+                i, el_str,
+                i, i, i == wms->ms.passwd.rank ? " checked" : "");
+            e = rv < 0;
+          }
+        }
+        if (e == 0) {
+          rv = printf("\t\t\t\t</tbody>\n"
+                      "\t\t\t</table>\n"
+                      "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Edit\">Edit</button>\n"
+                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Learn\">Learn</button>\n"
+                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Search\">Search</button>\n"
+                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Refresh\">Refresh</button>\n"
+                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Done\">Done</button></div>\n"
+                      "\t\t</form>\n"
+                      "\t\t<code class=\"msf\">%s; ",
+              sw_info_str);
+          e = rv < 0;
+          if (e == 0) {
+            for (i = 0; i < 4 && e == 0; i++) {
+              rv = printf("%s: %d%s", state_str[i], wms->count_bucket[i], i < 3 ? ", " : "");
+              e = rv < 0;
+            }
+            if (e == 0) {
+              rv = printf("</code>\n"
+                          "\t</body>\n"
+                          "</html>\n");
+              e = rv < 0;
+            }
+          }
+        }
+        break;
+      case B_SEARCH_LIST:
+        e = xml_escape(&wms->html_lp, &wms->html_n, wms->ms.search_txt, ESC_AMP | ESC_LT, &esc_str);
+        if (e == 0) {
+          j = wms->list_pos + SH_PAGE < wms->hit_n ? wms->list_pos + SH_PAGE : wms->hit_n;
+          rv = printf("\t\t\t<h1 class=\"msf\">Search Results</h1>\n"
+                      "\t\t\t<p class=\"msf\">%d card(s) contain <code class=\"msf\">%s</code>%s%s.</p>\n",
+              wms->hit_n,
+              esc_str,
+              wms->ms.search_mode == SM_FUZZY ? " or a close match, the closest first" : "",
+              wms->ms.scope == C_ALL ? "" : " (current deck)");
+          e = rv < 0;
+        }
+        if (e == 0 && wms->search_err != NULL) {
+          rv = printf("\t\t\t<p class=\"msf\">%s</p>\n", wms->search_err);
+          e = rv < 0;
+        }
+        if (e == 0) {
+          rv = printf("\t\t\t<table>\n"
+                      "\t\t\t\t<thead>\n"
+                      "\t\t\t\t\t<tr><td></td><td>Deck</td><td>Card</td><td>Match</td>%s</tr>\n"
+                      "\t\t\t\t</thead>\n"
+                      "\t\t\t\t<tbody>\n",
+              wms->ms.search_mode == SM_FUZZY ? "<td>Edits</td>" : "");
+          e = rv < 0;
+        }
+        for (i = wms->list_pos; i < j && e == 0; i++) {
+          assert(wms->hit_l[i].sh_path != NULL && wms->hit_l[i].sh_text != NULL);
+          e = xml_escape(&wms->html_lp, &wms->html_n, wms->hit_l[i].sh_path, ESC_AMP | ESC_LT, &esc_str);
+          if (e == 0) {
+            rv = printf("\t\t\t\t\t<tr>"
+                        "<td class=\"msf-str\"><input id=\"msf-hit-%d\" type=\"radio\" name=\"hit\" value=\"%d.%d\"%s></td>"
+                        "<td class=\"msf-str\"><label for=\"msf-hit-%d\">%s</label></td>"
+                        "<td class=\"msf-str\"><label for=\"msf-hit-%d\">%d</label></td>"
+                        "<td><label for=\"msf-hit-%d\">",
+                i, wms->hit_l[i].sh_deck_i, wms->hit_l[i].sh_card_i,
+                wms->hit_l[i].sh_deck_i == wms->ms.deck_i && wms->hit_l[i].sh_card_i == wms->ms.card_i ? " checked" : "",
+                i, esc_str,
+                i, wms->hit_l[i].sh_card_i + 1,
+                i);
+            e = rv < 0;
+          }
+          str = wms->hit_l[i].sh_text;
+          for (k = 0; k < 3 && e == 0; k++) {
+            e = xml_escape(&wms->html_lp, &wms->html_n, str, ESC_AMP | ESC_LT, &esc_str);
+            if (e == 0) {
+              rv = printf(k == 1 ? "<mark>%s</mark>" : "%s", esc_str);
+              e = rv < 0;
+              str += strlen(str) + 1;
+            }
+          }
+          if (e == 0) {
+            rv = printf("</label></td>");
+            e = rv < 0;
+          }
+          if (e == 0 && wms->ms.search_mode == SM_FUZZY) {
+            rv = printf("<td>%d</td>", wms->hit_l[i].sh_dist);
+            e = rv < 0;
+          }
+          if (e == 0) {
+            rv = printf("</tr>\n");
+            e = rv < 0;
+          }
+        }
+        if (e == 0) {
+          rv = printf("\t\t\t\t</tbody>\n"
+                      "\t\t\t</table>\n"
+                      "\t\t\t<input type=\"hidden\" name=\"hits\" value=\"%d", wms->ms.passwd.mctr);
+          e = rv < 0;
+        }
+        for (i = 0; i < wms->hit_n && e == 0; i++) { // posted back, Previous and Next only match the listed hits again
+          rv = printf("-%d.%d.%d.%d.%d.%d", wms->hit_l[i].sh_deck_i, wms->hit_l[i].sh_card_i, wms->hit_l[i].sh_field, wms->hit_l[i].sh_off, wms->hit_l[i].sh_len, wms->hit_l[i].sh_dist);
+          e = rv < 0;
+        }
+        if (e == 0) {
+          rv = printf("\">\n"
+                      "\t\t\t<div class=\"msf-btns\"><input type=\"hidden\" name=\"list-pos\" value=\"%d\">\n"
+                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Previous\"%s>Previous</button>\n"
+                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Next\"%s>Next</button>\n"
+                      "\t\t\t\t<span class=\"msf-space\"></span>\n"
+                      "\t\t\t\t<code class=\"msf\">%d - %d</code></div>\n"
+                      "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Search\">Search</button>\n"
+                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Edit\">Edit</button>\n"
+                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Learn\">Learn</button>\n"
+                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Stop\">Stop</button></div>\n"
+                      "\t\t</form>\n"
+                      "\t\t<code class=\"msf\">%s</code>\n"
+                      "\t</body>\n"
+                      "</html>\n",
+              wms->list_pos,
+              wms->list_pos > 0 ? "" : " disabled",
+              j < wms->hit_n ? "" : " disabled",
+              wms->hit_n > 0 ? wms->list_pos + 1 : 0, j,
+              sw_info_str);
+          e = rv < 0;
+        }
+        break;
+      default:
+        e = E_GHTML_9;
+        break;
+      }
+    }
+    free(sw_info_str);
+  }
+  return e;
+}
+
+static int ms_init(struct MemorySurfer *ms)
+{
+  int e;
+  int i;
+  size_t size;
+  imf_init(&ms->imf);
+  ms->imf_filename = NULL;
+  sa_init(&ms->deck_sa);
+  sa_init(&ms->style_sa);
+  assert(sizeof(struct Deck) == 12);
+  ms->cat_t = NULL;
+  ms->deck_a = 0;
+  ms->n_first = -1;
+  ms->topo_l = NULL;
+  ms->topo_h = -1;
+  ms->deck_path_z = 0;
+  ms->deck_path = NULL;
+  ms->deck_i = -1;
+  ms->mov_deck_i = -1;
+  ms->arrange = -1;
+  ms->deck_name_str = NULL;
+  ms->style_txt = NULL;
+  ms->card_l = NULL;
+  ms->card_a = 0;
+  ms->card_i = -1;
+  ms->mov_card_i = -1;
+  ms->cards_nel = -1;
+  sa_init(&ms->card_sa);
+  ms->timestamp = time(NULL);
+  e = ms->timestamp == -1;
+  if (e == 0) {
+    ms->lvl = -1;
+    ms->rank = -1;
+    ms->search_txt = NULL;
+    ms->match_case = -1;
+    ms->is_html = -1;
+    ms->is_unlocked = -1;
+    ms->search_dir = 0;
+    ms->scope = C_UNDEF;
+    ms->search_mode = SM_UNDEF;
+    ms->search_dist = -1;
+    ms->can_resume = 0;
+    ms->password = NULL;
+    ms->new_password = NULL;
+    size = sizeof(ms->passwd.pw_msg_digest);
+    memset(&ms->passwd.pw_msg_digest, -1, size);
+    ms->passwd.pw_flag = -1;
+    ms->passwd.timeout.to_sec = 0;
+    ms->passwd.timeout.to_count = 0;
+    ms->passwd.version = 0;
+    ms->passwd.style_sai = -1;
+    ms->passwd.mctr = 0;
+    ms->passwd.rank = 4;
+    ms->passwd.dsum_i = -1;
+    ms->passwd.queue_i = -1;
+    ms->passwd.sidx_i = -1;
+    ms->passwd.base_i = -1;
+    ms->deck_flags = NULL;
+    ms->deck_flags_n = 0;
+    ms->dsum_l = NULL;
+    ms->dsum_a = -1;
+    ms->dsum_mod = 0;
+    ms->sq.sq_n = -1;
+    ms->sq_mod = 0;
+    ms->sq_fill = 0;
+    ms->sidx_state = -1;
+    for (i = 0; i < SI_BUCKETS; i++) {
+      ms->sidx.si_bucket[i] = -1;
+    }
+    ms->sidx.si_vis_i = -1;
+    ms->sidx.si_pend_i = -1;
+    ms->tb_l = NULL;
+    ms->vt_l = NULL;
+    ms->vt_n = -1;
+    ms->vt_a = 0;
+    ms->vt_mod = 0;
+    ms->pend_d = NULL;
+    ms->pend_n = -1;
+    ms->pend_a = 0;
+    ms->pend_mod = 0;
+  }
+  return e;
+}
+
+static void inds_init(struct IndentStr *inds)
+{
+  inds->str = NULL;
+  inds->size = 0;
+  inds->indent_n = -1;
+}
+
+static int wms_init(struct WebMemorySurfer *wms)
+{
+  int e;
+  size_t size;
+  e = ms_init(&wms->ms);
+  if (e == 0) {
+    assert(A_END == 0);
+    wms->seq = S_END;
+    wms->page = P_START;
+    wms->from_page = P_UNDEF;
+    wms->mode = M_NONE;
+    wms->saved_mode = M_NONE;
+    wms->timeout = -1;
+    wms->dbg_n = 720;
+    wms->dbg_lp = malloc(wms->dbg_n);
+    e = wms->dbg_lp == NULL ? E_MALLOC_1 : 0;
+    if (e == 0) {
+      wms->dbg_lp[0] = '\0';
+      wms->dbg_wp = 0;
+      wms->file_title_str = NULL;
+      wms->fl_v = NULL;
+      wms->fl_c = 0;
+      sa_init(&wms->qa_sa);
+      sa_init(&wms->vis_sa);
+      wms->reveal_pos = -1;
+      wms->saved_reveal_pos = -1;
+      wms->sw_i = -1;
+      wms->msg_header = NULL;
+      wms->msg_static = NULL;
+      wms->msg_btn_main = NULL;
+      wms->msg_btn_alt = NULL;
+      wms->dyn_msg = NULL;
+      wms->todo_main = -1;
+      wms->html_n = 500;
+      wms->html_lp = malloc(wms->html_n);
+      e = wms->html_lp == NULL ? E_MALLOC_2 : 0;
+      if (e == 0) {
+        memset(wms->mtime, -1, sizeof(wms->mtime));
+        memset(wms->tok_digest, -1, sizeof(wms->tok_digest));
+        wms->tok_str[0] = '\0';
+        size = sizeof(struct IndentStr);
+        wms->inds = malloc(size);
+        e = wms->inds == NULL ? E_MALLOC_3 : 0;
+        if (e == 0) {
+          inds_init(wms->inds);
+          wms->upload_d = NULL;
+          wms->upload_n = 0;
+          wms->posted_message_digest = NULL;
+          wms->hit_l = NULL;
+          wms->hit_n = 0;
+          wms->list_pos = -1;
+          wms->hit_posted = 0;
+          wms->hit_mctr = -1;
+          wms->found_str = NULL;
+          memset(wms->span_l, 0, sizeof(wms->span_l));
+          memset(wms->span_n, 0, sizeof(wms->span_n));
+          wms->search_err = NULL;
+        }
+      }
+    }
+  }
+  return e;
+}
+
+static void ms_free(struct MemorySurfer *ms)
+{
+  free(ms->deck_flags);
+  ms->deck_flags = NULL;
+  ms->deck_flags_n = 0;
+  free(ms->dsum_l);
+  ms->dsum_l = NULL;
+  ms->dsum_a = -1;
+  ms_free_index(ms);
+  free(ms->imf_filename);
+  sa_free(&ms->style_sa);
+  sa_free(&ms->deck_sa);
+  free(ms->cat_t);
+  ms->cat_t = NULL;
+  ms->deck_a = 0;
+  free(ms->topo_l);
+  ms->topo_l = NULL;
+  free(ms->deck_path);
+  ms->deck_path = NULL;
+  ms->deck_path_z = 0;
+  free(ms->style_txt);
+  ms->style_txt = NULL;
+  free(ms->deck_name_str);
+  ms->deck_name_str = NULL;
+  free(ms->card_l);
+  ms->card_l = NULL;
+  ms->card_a = 0;
+  ms->card_i = -1;
+  sa_free(&ms->card_sa);
+  free(ms->search_txt);
+  free(ms->password);
+  free(ms->new_password);
+  char b;
+  b = imf_is_open(&ms->imf);
+  if (b) {
+    imf_close(&ms->imf);
+  }
+  sw_free(&ms->imf.sw);
+}
+
+static void inds_free(struct IndentStr *inds)
+{
+  free(inds->str);
+  inds->str = NULL;
+  inds->size = 0;
+  inds->indent_n = -1;
+}
+
+static void wms_free(struct WebMemorySurfer *wms)
+{
+  int i;
+  for (i = 0; i < wms->hit_n; i++) {
+    free(wms->hit_l[i].sh_path);
+    free(wms->hit_l[i].sh_text);
+  }
+  free(wms->hit_l);
+  wms->hit_l = NULL;
+  wms->hit_n = 0;
+  for (i = 0; i < 2; i++) {
+    free(wms->span_l[i]);
+    wms->span_l[i] = NULL;
+    wms->span_n[i] = 0;
+  }
+  free(wms->posted_message_digest);
+  wms->posted_message_digest = NULL;
+  free(wms->upload_d);
+  wms->upload_d = NULL;
+  wms->upload_n = 0;
+  inds_free(wms->inds);
+  free(wms->inds);
+  wms->inds = NULL;
+  free(wms->dyn_msg);
+  wms->dyn_msg = NULL;
+  free(wms->html_lp);
+  for (i = 0; i < wms->fl_c; i++) {
+    assert(wms->fl_v[i] != NULL);
+    free(wms->fl_v[i]);
+  }
+  free(wms->fl_v);
+  sa_free(&wms->qa_sa);
+  sa_free(&wms->vis_sa);
+  free(wms->dbg_lp);
+  free(wms->file_title_str);
+  ms_free(&wms->ms);
+}
+
+static int ms_create(struct MemorySurfer *ms, int flags_mask)
+{
+  int e;
+  size_t size;
+  assert(ms->imf_filename != NULL);
+  e = imf_create(&ms->imf, ms->imf_filename, flags_mask);
+  if (e == 0) {
+    e = imf_put(&ms->imf, SA_INDEX, "", 0);
+    if (e == 0) {
+      e = imf_put(&ms->imf, C_INDEX, "", 0);
+      if (e == 0) {
+        if (ms->passwd.pw_flag < 0) {
+          ms->passwd.pw_flag = 0;
+          assert(ms->passwd.timeout.to_sec == 0);
+          ms->passwd.timeout.to_sec = timeouts[1].to_sec;
+          assert(ms->passwd.timeout.to_count == 0);
+          ms->passwd.timeout.to_count = timeouts[1].to_count;
+        } else {
+          assert(ms->passwd.pw_flag == 1);
+        }
+        size = sizeof(struct Password);
+        e = imf_put(&ms->imf, PW_INDEX, &ms->passwd, size);
+        if (e == 0) {
+          e = imf_sync(&ms->imf);
+        }
+      }
+    }
+  }
+  return e;
+}
+
+static int ms_get_card_sa(struct MemorySurfer *ms)
+{
+  int e;
+  e = ms->card_a > 0 && ms->card_l == NULL ? E_ARG_1 : 0;
+  if (e == 0 && ms->card_i != -1) {
+    e = ms->card_i >= 0 && ms->card_i < ms->card_a ? 0 : E_ASSRT_2;
+    if (e == 0) {
+      e = sa_load(&ms->card_sa, &ms->imf, ms->card_l[ms->card_i].card_qai);
+    }
+  }
+  return e;
+}
+
+// a deck is idle when its summary proves that it holds no new, no suspended and no due card
+static int ms_deck_is_idle(struct MemorySurfer *ms, int deck_i)
+{
+  int is_idle;
+  is_idle = 0;
+  if (deck_i < ms->dsum_a) {
+    if ((ms->dsum_l[deck_i].ds_mask & (1 << STATE_NEW | 1 << STATE_SUSPENDED)) == 0) {
+      is_idle = ms->timestamp < ms->dsum_l[deck_i].ds_due - 1; // retention still above 1/e
+    }
+  }
+  return is_idle;
+}
+
+// fills the session queue with the cards ms_determine_card would return one after another when each
+// returned card is proceeded at ms->timestamp: one pass over the checked decks, the picks are done in memory.
+// A full queue is refilled only once a card gets eligible which would be picked before its cards: a new or
+// suspended card or a low one. A card of higher strength gets eligible at a retention above the queued ones of its
+// class, it waits for the queue to run out
+static int ms_fill_queue(struct MemorySurfer *ms)
+{
+  int e;
+  int deck_i;
+  int32_t data_size;
+  time_t time_diff;
+  int64_t due;
+  int64_t low_due; // the first of the cards which are picked before the queued ones when eligible
+  double retent;
+  enum CardState card_state;
+  int card_i;
+  int h;
+  int i;
+  int qc_n;
+  int qc_a;
+  struct QueueCandidate *qc_l;
+  struct QueueCandidate *qc_ptr;
+  int8_t qc_class;
+  int best[4];
+  int stop;
+  int nel;
+  int sel;
+  size_t size;
+  e = 0;
+  qc_l = NULL;
+  qc_n = 0;
+  qc_a = 0;
+  assert(ms->timestamp >= 0);
+  ms->sq.sq_n = 0;
+  ms->sq.sq_due = INT64_MAX;
+  low_due = INT64_MAX;
+  for (h = 0; h <= ms->topo_h && e == 0; h++) {
+    for (deck_i = 0; deck_i < ms->deck_a && e == 0; deck_i++) {
+      if (ms->cat_t[deck_i].deck_slot_used == 1 && ms->cat_t[deck_i].deck_on != 0 && ms->topo_l[deck_i].dt_height == h) {
+        if (ms_deck_is_idle(ms, deck_i) != 0) {
+          if (ms->dsum_l[deck_i].ds_due - 1 < ms->sq.sq_due) {
+            ms->sq.sq_due = ms->dsum_l[deck_i].ds_due - 1;
+          }
+          if (ms->dsum_l[deck_i].ds_due - 1 < low_due) { // its cards aren't known
+            low_due = ms->dsum_l[deck_i].ds_due - 1;
+          }
+        } else {
+          data_size = imf_get_size(&ms->imf, ms->cat_t[deck_i].cat_cli);
+          if (data_size > 0) {
+            ms->card_l = realloc(ms->card_l, data_size);
+            e = ms->card_l == NULL;
+            if (e == 0) {
+              e = imf_get(&ms->imf, ms->cat_t[deck_i].cat_cli, ms->card_l);
+              if (e == 0) {
+                ms->card_a = data_size / sizeof(struct Card);
+                assert(ms->card_a > 0);
+                for (card_i = 0; card_i < ms->card_a && e == 0; card_i++) {
+                  time_diff = ms->timestamp - ms->card_l[card_i].card_time;
+                  retent = exp(-(double)time_diff / ms->card_l[card_i].card_strength);
+                  card_state = ms->card_l[card_i].card_state & 0x07;
+                  qc_class = -1;
+                  due = INT64_MAX;
+                  switch (card_state) {
+                  case STATE_SCHEDULED:
+                    if (retent <= 1 / M_E) {
+                      if (ms->card_l[card_i].card_strength <= lvl_s[ms->passwd.rank]) {
+                        qc_class = 0;
+                      } else if (ms->card_l[card_i].card_strength <= lvl_s[20]) {
+                        qc_class = 2;
+                      } else {
+                        qc_class = 4;
+                      }
+                    } else {
+                      due = ms->card_l[card_i].card_time + ms->card_l[card_i].card_strength - 1;
+                    }
+                    break;
+                  case STATE_NEW:
+                  case STATE_SUSPENDED:
+                    if (retent < 1.0) {
+                      qc_class = card_state == STATE_NEW ? 1 : 3;
+                    } else {
+                      due = ms->card_l[card_i].card_time + 1;
+                    }
+                    break;
+                  case STATE_ALARM:
+                    break;
+                  default:
+                    e = E_DETECA;
+                  }
+                  if (due < ms->sq.sq_due) {
+                    ms->sq.sq_due = due;
+                  }
+                  if (due < low_due && (card_state != STATE_SCHEDULED || ms->card_l[card_i].card_strength <= lvl_s[ms->passwd.rank])) {
+                    low_due = due;
+                  }
+                  if (qc_class != -1 && e == 0) {
+                    if (qc_n == qc_a) {
+                      qc_a = qc_a == 0 ? 256 : qc_a * 2;
+                      size = sizeof(struct QueueCandidate) * qc_a;
+                      qc_ptr = realloc(qc_l, size);
+                      e = qc_ptr == NULL;
+                      if (e == 0) {
+                        qc_l = qc_ptr;
+                      }
+                    }
+                    if (e == 0) {
+                      qc_ptr = qc_l + qc_n++;
+                      qc_ptr->qc_retent = retent;
+                      qc_ptr->qc_time_diff = time_diff;
+                      qc_ptr->qc_card = card_i;
+                      qc_ptr->qc_deck = deck_i;
+                      qc_ptr->qc_height = h;
+                      qc_ptr->qc_class = qc_class;
+                    }
+                  }
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  sel = 0;
+  while (e == 0 && sel != -1 && ms->sq.sq_n < sizeof(ms->sq.sq_l) / sizeof(struct QueueEntry)) {
+    stop = ms->topo_h; // the scan of the heights ends with the first one holding a low, a new or a suspended card
+    for (i = 0; i < qc_n && qc_l[i].qc_height < stop; i++) {
+      qc_class = qc_l[i].qc_class;
+      if (qc_class == 0 || qc_class == 1 || qc_class == 3) {
+        stop = qc_l[i].qc_height;
+      }
+    }
+    for (i = 0; i < 4; i++) {
+      best[i] = -1;
+    }
+    nel = 0;
+    for (i = 0; i < qc_n && qc_l[i].qc_height <= stop; i++) {
+      qc_ptr = qc_l + i;
+      qc_class = qc_ptr->qc_class;
+      if (qc_class == 0 || qc_class == 2 || qc_class == 4) {
+        nel++;
+      }
+      if (qc_class >= 0 && qc_class <= 3) {
+        sel = best[qc_class];
+        if (sel == -1 || qc_ptr->qc_retent < qc_l[sel].qc_retent || ((qc_class == 0 || qc_class == 2) && qc_ptr->qc_retent == qc_l[sel].qc_retent && qc_ptr->qc_time_diff > qc_l[sel].qc_time_diff)) {
+          best[qc_class] = i;
+        }
+      }
+    }
+    sel = -1;
+    for (i = 0; i < 4 && sel == -1; i++) {
+      sel = best[i];
+    }
+    if (sel != -1) {
+      ms->sq.sq_l[ms->sq.sq_n].qe_deck = qc_l[sel].qc_deck;
+      ms->sq.sq_l[ms->sq.sq_n].qe_card = qc_l[sel].qc_card;
+      ms->sq.sq_l[ms->sq.sq_n].qe_nel = nel;
+      ms->sq.sq_n++;
+      qc_l[sel].qc_class = -1;
+    }
+  }
+  free(qc_l);
+  if (e == 0) {
+    if (ms->sq.sq_n == sizeof(ms->sq.sq_l) / sizeof(struct QueueEntry)) {
+      ms->sq.sq_due = low_due;
+    }
+    ms->sq_mod = 1;
+    ms->sq_fill = 1;
+  } else {
+    ms->sq.sq_n = -1;
+  }
+  return e;
+}
+
+static int ms_determine_card(struct MemorySurfer *ms)
+{
+  int e;
+  e = 0;
+  if (ms->sq.sq_n < 0 || (ms->sq_fill == 0 && (ms->sq.sq_n == 0 || ms->timestamp >= ms->sq.sq_due))) { // not again when found empty
+    e = ms_fill_queue(ms);
+  }
+  if (e == 0) {
+    if (ms->sq.sq_n > 0) {
+      ms->deck_i = ms->sq.sq_l[0].qe_deck;
+      ms->card_i = ms->sq.sq_l[0].qe_card;
+      ms->cards_nel = ms->sq.sq_l[0].qe_nel;
+    } else {
+      e = -1;
+    }
+  }
+  return e;
+}
+
+// removes the proceeded card from the head of the session queue, any other card invalidates the queue
+static void ms_pop_queue(struct MemorySurfer *ms, int64_t due)
+{
+  size_t size;
+  if (ms->sq.sq_n > 0 && ms->sq.sq_l[0].qe_deck == ms->deck_i && ms->sq.sq_l[0].qe_card == ms->card_i) {
+    ms->sq.sq_n--;
+    size = sizeof(struct QueueEntry) * ms->sq.sq_n;
+    memmove(ms->sq.sq_l, ms->sq.sq_l + 1, size);
+    if (due < ms->sq.sq_due) {
+      ms->sq.sq_due = due;
+    }
+    ms->sq_mod = 1;
+  } else {
+    ms->sq.sq_n = -1;
+    ms->sq_mod = 0;
+  }
+}
+
+static int sa_cmp(struct StringArray *sa_ls, struct StringArray *sa_rs)
+{
+  int is_equal;
+  int i;
+  int j;
+  int n;
+  char ch_ls; // left side
+  char ch_rs; // right
+  n = sa_ls->sa_c;
+  is_equal = n == sa_rs->sa_c ? 1 : -1;
+  if (is_equal == 1) {
+    i = 0;
+    j = 0;
+    while (i < n && is_equal == 1) {
+      do {
+        ch_ls = sa_ls->sa_d[j];
+        ch_rs = sa_rs->sa_d[j];
+        is_equal = ch_ls == ch_rs;
+        j++;
+      } while (is_equal == 1 && ch_ls != '\0');
+      i++;
+    }
+  }
+  return is_equal;
+}
+
+static void sa_move(struct StringArray *sa_dest, struct StringArray *sa_src)
+{
+  free (sa_dest->sa_d);
+  sa_dest->sa_d = sa_src->sa_d;
+  sa_src->sa_d = NULL;
+  sa_dest->sa_c = sa_src->sa_c;
+  sa_src->sa_c = 0;
+  sa_dest->sa_n = sa_src->sa_n;
+  sa_src->sa_n = 0;
+}
+
+static int ms_modify_qa(struct StringArray *sa, struct MemorySurfer *ms, int *need_sync)
+{
+  int e;
+  int is_equal;
+  int is_html;
+  int32_t data_size;
+  e = need_sync == NULL ? E_ARG_2 : 0;
+  if (e == 0) {
+    is_equal = sa_cmp(sa, &ms->card_sa);
+    if (is_equal == 0) {
+      is_html = (ms->card_l[ms->card_i].card_state & 0x08) != 0;
+      e = ms_index_card(ms, ms->card_l[ms->card_i].card_qai, ms->card_sa.sa_d, sa_length(&ms->card_sa), is_html, sa->sa_d, sa_length(sa), is_html);
+    }
+    if (e == 0 && is_equal == 0) {
+      sa_move(&ms->card_sa, sa);
+      data_size = sa_length(&ms->card_sa);
+      e = imf_put(&ms->imf, ms->card_l[ms->card_i].card_qai, ms->card_sa.sa_d, data_size);
+      *need_sync = 1;
+    }
+  }
+  return e;
+}
+
+static int ms_load_card_list(struct MemorySurfer *ms)
+{
+  int e;
+  int32_t data_size;
+  assert(ms->deck_i >= 0 && ms->deck_i < ms->deck_a && ms->cat_t[ms->deck_i].deck_slot_used != 0);
+  assert((ms->card_a == 0 && ms->card_l == NULL) || (ms->card_a > 0 && ms->card_l != NULL));
+  data_size = imf_get_size(&ms->imf, ms->cat_t[ms->deck_i].cat_cli);
+  e = data_size < 0;
+  if (e == 0) {
+    if (data_size > 0) {
+      ms->card_l = realloc(ms->card_l, data_size);
+      e = ms->card_l == NULL;
+      if (e == 0) {
+        e = imf_get(&ms->imf, ms->cat_t[ms->deck_i].cat_cli, ms->card_l);
+      }
+    } else {
+      free(ms->card_l);
+      ms->card_l = NULL;
+    }
+  }
+  if (e == 0) {
+    ms->card_a = data_size / sizeof(struct Card);
+  }
+  return e;
+}
+
+static int ms_load_summary(struct MemorySurfer *ms)
+{
+  int e;
+  int32_t data_size;
+  assert(ms->dsum_l == NULL && ms->dsum_a == -1);
+  e = 0;
+  if (ms->passwd.dsum_i >= 0) {
+    data_size = imf_get_size(&ms->imf, ms->passwd.dsum_i);
+    if (data_size == sizeof(struct DeckSummary) * ms->deck_a) {
+      if (data_size > 0) {
+        ms->dsum_l = malloc(data_size);
+        e = ms->dsum_l == NULL;
+        if (e == 0) {
+          e = imf_get(&ms->imf, ms->passwd.dsum_i, ms->dsum_l);
+        }
+      }
+      if (e == 0) {
+        ms->dsum_a = ms->deck_a;
+      }
+    }
+  } else if (ms->n_first == -1) {
+    ms->dsum_a = 0; // no cards, the summary starts empty
+  }
+  return e;
+}
+
+// summarizes a deck from its stored card list, *card_lp is a scratch buffer of the caller
+static int ms_resummarize(struct MemorySurfer *ms, int deck_i, struct Card **card_lp)
+{
+  int e;
+  int32_t data_size;
+  struct Card *card_l;
+  e = 0;
+  data_size = imf_get_size(&ms->imf, ms->cat_t[deck_i].cat_cli);
+  if (data_size > 0) {
+    card_l = realloc(*card_lp, data_size);
+    e = card_l == NULL;
+    if (e == 0) {
+      *card_lp = card_l;
+      e = imf_get(&ms->imf, ms->cat_t[deck_i].cat_cli, card_l);
+    }
+  }
+  if (e == 0) {
+    e = ms_summarize(ms, deck_i, *card_lp, data_size / sizeof(struct Card));
+  }
+  return e;
+}
+
+static int ms_rebuild_summary(struct MemorySurfer *ms)
+{
+  int e;
+  int deck_i;
+  struct Card *card_l;
+  e = 0;
+  card_l = NULL;
+  ms->dsum_a = 0;
+  for (deck_i = 0; deck_i < ms->deck_a && e == 0; deck_i++) {
+    if (ms->cat_t[deck_i].deck_slot_used != 0) {
+      e = ms_resummarize(ms, deck_i, &card_l);
+    }
+  }
+  free(card_l);
+  ms->dsum_mod = 1;
+  return e;
+}
+
+static int ms_put_summary(struct MemorySurfer *ms)
+{
+  int e;
+  int32_t data_size;
+  e = 0;
+  if (ms->dsum_a < 0) {
+    e = ms_rebuild_summary(ms);
+  }
+  if (e == 0 && ms->dsum_mod != 0 && ms->dsum_a > 0) {
+    if (ms->passwd.dsum_i < 0) {
+      e = imf_seek_unused(&ms->imf, &ms->passwd.dsum_i);
+    }
+    if (e == 0) {
+      data_size = sizeof(struct DeckSummary) * ms->dsum_a;
+      e = imf_put(&ms->imf, ms->passwd.dsum_i, ms->dsum_l, data_size);
+      if (e == 0) {
+        ms->dsum_mod = 0;
+      }
+    }
+  }
+  return e;
+}
+
+static int ms_load_queue(struct MemorySurfer *ms)
+{
+  int e;
+  e = 0;
+  ms->sq.sq_n = -1;
+  if (ms->passwd.queue_i >= 0) {
+    if (imf_get_size(&ms->imf, ms->passwd.queue_i) == sizeof(struct SessionQueue)) {
+      e = imf_get(&ms->imf, ms->passwd.queue_i, &ms->sq);
+      if (e == 0 && ms->sq.sq_mctr != ms->passwd.mctr) {
+        ms->sq.sq_n = -1; // written before a later modification
+      }
+    }
+  }
+  return e;
+}
+
+// the queue is stamped with the mctr it is synced with, so a sync which doesn't write it invalidates it
+static int ms_put_queue(struct MemorySurfer *ms)
+{
+  int e;
+  int32_t data_size;
+  e = 0;
+  if (ms->sq_mod != 0 && ms->sq.sq_n >= 0) {
+    if (ms->passwd.queue_i < 0) {
+      e = imf_seek_unused(&ms->imf, &ms->passwd.queue_i);
+    }
+    if (e == 0) {
+      ms->sq.sq_mctr = ms->passwd.mctr;
+      data_size = sizeof(struct SessionQueue);
+      e = imf_put(&ms->imf, ms->passwd.queue_i, &ms->sq, data_size);
+      if (e == 0) {
+        ms->sq_mod = 0;
+      }
+    }
+  }
+  return e;
+}
+
+static int ms_load_index(struct MemorySurfer *ms)
+{
+  int e;
+  int b;
+  int32_t data_size;
+  e = 0;
+  ms->sidx_state = -1;
+  for (b = 0; b < SI_BUCKETS; b++) {
+    ms->sidx.si_bucket[b] = -1;
+  }
+  ms->sidx.si_grams = 0;
+  ms->sidx.si_vis_i = -1;
+  ms->sidx.si_vis = 0;
+  ms->sidx.si_fold = 0;
+  ms->sidx.si_pend_i = -1;
+  if (ms->passwd.sidx_i >= 0) {
+    data_size = imf_get_size(&ms->imf, ms->passwd.sidx_i);
+    if (data_size == sizeof(struct SearchIndex) || data_size == sizeof(struct SearchIndex) - 4 || data_size == sizeof(struct SearchIndex) - 5 || data_size == sizeof(struct SearchIndex) - 10 || data_size == sizeof(struct SearchIndex) - 11) { // without si_pend_i, si_fold, si_vis_i and si_vis, si_grams
+      e = imf_get(&ms->imf, ms->passwd.sidx_i, &ms->sidx);
+      if (e == 0 && ms->sidx.si_mctr == ms->passwd.mctr && ms->sidx.si_grams == 1 && ms->sidx.si_vis == 1 && ms->sidx.si_fold == 1) {
+        ms->sidx_state = 0;
+      }
+    }
+  }
+  return e;
+}
+
+// like the queue the index is stamped with the mctr it is synced with, a valid index is restamped at each sync
+static int ms_put_index(struct MemorySurfer *ms)
+{
+  int e;
+  int b;
+  int32_t data_size;
+  char *data;
+  struct TermBucket *tb;
+  int8_t fold_l[SI_BUCKETS];
+  int32_t pos;
+  int32_t start;
+  int32_t n;
+  int32_t qai;
+  char term[SI_TERM_MAX + 1];
+  e = 0;
+  if (ms->sidx_state > 0 || (ms->sidx_state == 0 && ms->sidx.si_mctr != ms->passwd.mctr)) {
+    if (ms->pend_n > SI_PEND_MAX) { // folded: the buckets with pending postings are loaded, which replays them, and stored
+      memset(fold_l, 0, sizeof(fold_l));
+      pos = 0;
+      while (pos < ms->pend_n && e == 0) {
+        e = pend_next(ms, &pos, term, &qai);
+        if (e == 0) {
+          fold_l[si_hash(term)] = 1;
+        }
+      }
+      for (b = 0; b < SI_BUCKETS && e == 0; b++) {
+        if (fold_l[b] != 0) {
+          e = ms_get_bucket(ms, b, &tb);
+          if (e == 0) {
+            tb->tb_state = 1;
+          }
+        }
+      }
+    }
+    if (ms->pend_n > 0 && ms->tb_l != NULL) { // the pending postings of the buckets stored below are dropped
+      pos = 0;
+      n = 0;
+      while (pos < ms->pend_n && e == 0) {
+        start = pos;
+        e = pend_next(ms, &pos, term, &qai);
+        if (e == 0 && ms->tb_l[si_hash(term)].tb_state <= 0) {
+          memmove(ms->pend_d + n, ms->pend_d + start, pos - start);
+          n += pos - start;
+        }
+      }
+      if (e == 0 && n < ms->pend_n) {
+        ms->pend_n = n;
+        ms->pend_mod = 1;
+      }
+    }
+    for (b = 0; b < SI_BUCKETS && e == 0 && ms->tb_l != NULL; b++) {
+      tb = ms->tb_l + b;
+      if (tb->tb_state > 0) {
+        if (tb->tr_n == 0) {
+          if (ms->sidx.si_bucket[b] >= 0) {
+            e = imf_delete(&ms->imf, ms->sidx.si_bucket[b]);
+            ms->sidx.si_bucket[b] = -1;
+          }
+        } else {
+          e = tb_store(tb, &data, &data_size);
+          if (e == 0) {
+            if (ms->sidx.si_bucket[b] < 0) {
+              e = imf_seek_unused(&ms->imf, ms->sidx.si_bucket + b);
             }
+            if (e == 0) {
+              e = imf_put(&ms->imf, ms->sidx.si_bucket[b], data, data_size);
+            }
+            free(data);
           }
-          if (e == 0) {
-            if (wms->mode == M_ASK) {
-              for (y = 0; y < 3 && e == 0; y++) {
-                rv = printf ("\t\t\t\t<tr>\n");
-                e = rv < 0 ? E_GENLRN_3 : 0;
-                for (x = 0; x < 2 && e == 0; x++) {
-                  rv = printf("\t\t\t\t\t<td class=\"msf-lvl\"><label class=\"msf-td\"><input type=\"radio\" disabled>Level</label></td>\n");
-                  e = rv < 0 ? E_GENLRN_4 : 0;
-                }
-                if (e == 0) {
-                  rv = printf("\t\t\t\t</tr>\n");
-                  e = rv < 0 ? E_GENLRN_5 : 0;
-                }
+        }
+        if (e == 0) {
+          tb->tb_state = 0;
+        }
+      }
+    }
+    if (e == 0 && ms->vt_mod != 0) {
+      if (ms->vt_n == 0) {
+        if (ms->sidx.si_vis_i >= 0) {
+          e = imf_delete(&ms->imf, ms->sidx.si_vis_i);
+          ms->sidx.si_vis_i = -1;
+        }
+      } else {
+        if (ms->sidx.si_vis_i < 0) {
+          e = imf_seek_unused(&ms->imf, &ms->sidx.si_vis_i);
+        }
+        if (e == 0) {
+          e = imf_put(&ms->imf, ms->sidx.si_vis_i, ms->vt_l, sizeof(struct VisibleText) * ms->vt_n);
+        }
+      }
+      if (e == 0) {
+        ms->vt_mod = 0;
+      }
+    }
+    if (e == 0 && ms->pend_mod != 0) {
+      if (ms->pend_n == 0) {
+        if (ms->sidx.si_pend_i >= 0) {
+          e = imf_delete(&ms->imf, ms->sidx.si_pend_i);
+          ms->sidx.si_pend_i = -1;
+        }
+      } else {
+        if (ms->sidx.si_pend_i < 0) {
+          e = imf_seek_unused(&ms->imf, &ms->sidx.si_pend_i);
+        }
+        if (e == 0) {
+          e = imf_put(&ms->imf, ms->sidx.si_pend_i, ms->pend_d, ms->pend_n);
+        }
+      }
+      if (e == 0) {
+        ms->pend_mod = 0;
+      }
+    }
+    if (e == 0 && ms->passwd.sidx_i < 0) {
+      e = imf_seek_unused(&ms->imf, &ms->passwd.sidx_i);
+    }
+    if (e == 0) {
+      ms->sidx.si_mctr = ms->passwd.mctr;
+      ms->sidx.si_grams = 1;
+      ms->sidx.si_vis = 1;
+      ms->sidx.si_fold = 1;
+      data_size = sizeof(struct SearchIndex);
+      e = imf_put(&ms->imf, ms->passwd.sidx_i, &ms->sidx, data_size);
+      if (e == 0) {
+        ms->sidx_state = 0;
+      }
+    }
+  }
+  return e;
+}
+
+static int qai_cmp(const void *ls, const void *rs)
+{
+  return *(const int32_t *)ls < *(const int32_t *)rs ? -1 : *(const int32_t *)ls > *(const int32_t *)rs;
+}
+
+// intersects the postings of the trigrams of a search text of 3 or more bytes
+static int ms_gram_candidates(struct MemorySurfer *ms, const char *search_txt, int len, int32_t **cand_lp, int *cand_np)
+{
+  int e;
+  int i;
+  int32_t pos;
+  int32_t rec_n;
+  int32_t rec_i;
+  int32_t post;
+  int32_t cand_i;
+  int cand_n;
+  int32_t *cand_l;
+  int32_t *rec_d;
+  int found;
+  struct TermSet ts;
+  struct TermBucket *tb;
+  e = 0;
+  cand_l = NULL;
+  cand_n = -1;
+  if (ms->sidx_state < 0) {
+    e = ms_build_index(ms);
+  }
+  if (e == 0) {
+    e = ts_split(&ts, search_txt, len);
+    for (i = 0; i < ts.ts_n && cand_n != 0 && e == 0; i++) {
+      if (ts.ts_l[i][0] == SI_GRAM) {
+        e = ms_get_bucket(ms, si_hash(ts.ts_l[i]), &tb);
+        if (e == 0) {
+          rec_n = 0;
+          rec_d = NULL;
+          pos = tb_find(tb, ts.ts_l[i], &found);
+          if (found != 0) {
+            rec_n = tb->tr_l[pos].tr_n;
+            rec_d = tb->tr_l[pos].tr_post;
+          }
+          if (cand_n < 0) {
+            cand_l = malloc(sizeof(int32_t) * (rec_n > 0 ? rec_n : 1));
+            e = cand_l == NULL;
+            if (e == 0) {
+              if (rec_n > 0) {
+                memcpy(cand_l, rec_d, sizeof(int32_t) * rec_n);
               }
-            } else {
-              assert(wms->ms.card_i != -1);
-              if ((wms->ms.card_l[wms->ms.card_i].card_state & 0x07) == STATE_NEW) {
-                time_diff = lvl_s[1];
-                lvl = 0;
-              } else {
-                time_diff = wms->ms.timestamp - wms->ms.card_l[wms->ms.card_i].card_time;
-                for (i = 0; i < 21; i++) {
-                  if (lvl_s[i] >= wms->ms.card_l[wms->ms.card_i].card_strength)
-                    break;
+              cand_n = rec_n;
+            }
+          } else {
+            rec_i = 0;
+            pos = 0;
+            for (cand_i = 0; cand_i < cand_n; cand_i++) {
+              post = -1;
+              while (rec_i < rec_n && post < cand_l[cand_i]) {
+                post = rec_d[rec_i];
+                if (post < cand_l[cand_i]) {
+                  rec_i++;
                 }
-                lvl = i;
-              }
-              j = lvl - 2;
-              if (j < 0) {
-                j = 0;
-              }
-              for (i = 0; i < 21; i++) {
-                if (lvl_s[i] >= time_diff)
-                  break;
-              }
-              lvl_sel = i;
-              if (lvl_sel > j + 5) {
-                lvl_sel = j + 5;
               }
-              for (y = 0; y < 3 && e == 0; y++) {
-                rv = printf("\t\t\t\t<tr>\n");
-                e = rv < 0 ? E_GENLRN_6 : 0;
-                assert(wms->html_n >= 19); // 8 + 10 + 1 " checked autofocus"
-                for (x = 0; x < 2 && e == 0; x++) {
-                  i = j + x + y * 2;
-                  wms->html_lp[0] = '\0';
-                  if (i == lvl) {
-                    strcat(wms->html_lp, " checked");
-                  }
-                  if (i == lvl_sel) {
-                    strcat(wms->html_lp, " autofocus");
-                  }
-                  set_time_str(time_diff_str, lvl_s[i]);
-                  rv = printf("\t\t\t\t\t<td class=\"msf-lvl\"><label class=\"msf-td\"><input type=\"radio\" name=\"lvl\" value=\"%d\"%s>Level %d (%s)</label></td>\n",
-                      i, wms->html_lp,
-                      i, time_diff_str);
-                  e = rv < 0 ? E_GENLRN_7 : 0;
-                }
-                if (e == 0) {
-                  rv = printf("\t\t\t\t</tr>\n");
-                  e = rv < 0 ? E_GENLRN_8 : 0;
-                }
+              if (post == cand_l[cand_i]) {
+                cand_l[pos++] = post;
               }
             }
+            cand_n = pos;
           }
-          if (e == 0) {
-            assert(wms->mode == M_ASK && wms->reveal_pos == -1 ? wms->ms.cards_nel >= 0 : 1);
-            e = xml_escape(&wms->html_lp, &wms->html_n, a_str, (wms->ms.card_l[wms->ms.card_i].card_state & 0x08) != 0 ? 0 : ESC_AMP | ESC_LT) ? E_GENLRN_9 : 0;
-            if (e == 0) {
-              rv = printf("\t\t\t</table>\n"
-                          "\t\t\t<div id=\"%s\" class=\"%s\"%s>%s</div>\n",
-                  (wms->ms.card_l[wms->ms.card_i].card_state & 0x08) != 0 ? "a-html" : "a-txt",
-                  (wms->ms.card_l[wms->ms.card_i].card_state & 0x08) != 0 ? "qa-html" : "qa-txt",
-                  wms->mode == M_RATE || wms->reveal_pos > 0 ? "" : " style=\"background-color: #eee;\"",
-                  wms->mode == M_RATE || wms->reveal_pos > 0 ? wms->html_lp : "");
-              e = rv < 0 ? E_GHTML_7 : 0;
+        }
+      }
+    }
+    ts_free(&ts);
+  }
+  if (e == 0) {
+    *cand_lp = cand_l;
+    *cand_np = cand_n;
+  } else {
+    free(cand_l);
+  }
+  return e;
+}
+
+// the cards (by card_qai, sorted) which can contain the search text, *cand_np = -1 if the index can't narrow the search:
+// a card has to contain each trigram of the search text; a shorter search text scans the terms instead: a term at the
+// beginning of the search text has to be the end of a term of the card, a term at its end the beginning of one, a
+// search text of a single term a part of one
+static int ms_search_candidates(struct MemorySurfer *ms, const char *search_txt, int32_t **cand_lp, int *cand_np)
+{
+  int e;
+  int len;
+  int i;
+  int start;
+  int sel_start;
+  int sel_len;
+  int sel_kind;
+  int kind; // 1 = beginning of a term, 2 = end of a term, 3 = part of a term
+  int b;
+  int32_t tr_i;
+  int32_t post_n;
+  int32_t post_a;
+  int32_t *post_l;
+  int term_len;
+  int j;
+  int is_match;
+  char term[SI_TERM_MAX + 1];
+  struct TermBucket *tb;
+  struct TermRecord *tr;
+  e = 0;
+  *cand_lp = NULL;
+  *cand_np = -1;
+  len = strlen(search_txt);
+  sel_start = -1;
+  sel_len = 0;
+  sel_kind = 4;
+  start = -1;
+  for (i = 0; i <= len; i++) {
+    if (i < len && si_is_term_char(search_txt[i]) != 0) {
+      if (start < 0) {
+        start = i;
+      }
+    } else if (start >= 0) {
+      kind = (start == 0) << 1 | (i == len);
+      if (kind < sel_kind || (kind == sel_kind && i - start > sel_len)) {
+        sel_start = start;
+        sel_len = i - start;
+        sel_kind = kind;
+      }
+      start = -1;
+    }
+  }
+  if (len >= 3) {
+    e = ms_gram_candidates(ms, search_txt, len, cand_lp, cand_np);
+  } else if (sel_start >= 0) {
+    if (ms->sidx_state < 0) {
+      e = ms_build_index(ms);
+    }
+    term_len = sel_len < SI_TERM_MAX ? sel_len : SI_TERM_MAX;
+    memcpy(term, search_txt + sel_start, term_len);
+    term[term_len] = '\0';
+    utf8_fold(term, term_len);
+    post_l = NULL;
+    post_n = 0;
+    post_a = 0;
+    for (b = 0; b < SI_BUCKETS && e == 0; b++) {
+      e = ms_get_bucket(ms, b, &tb);
+      for (tr_i = 0; e == 0 && tr_i < tb->tr_n; tr_i++) {
+        tr = tb->tr_l + tr_i;
+        i = strlen(tr->tr_term);
+        switch (sel_kind) {
+        case 1:
+          is_match = i >= term_len && memcmp(tr->tr_term, term, term_len) == 0;
+          break;
+        case 2:
+          is_match = tr->tr_term[0] != SI_GRAM && (i == SI_TERM_MAX || (i >= term_len && memcmp(tr->tr_term + i - term_len, term, term_len) == 0));
+          break;
+        default:
+          is_match = i == SI_TERM_MAX;
+          if (tr->tr_term[0] != SI_GRAM) {
+            for (j = 0; j + term_len <= i && is_match == 0; j++) {
+              is_match = memcmp(tr->tr_term + j, term, term_len) == 0;
             }
           }
+          break;
+        }
+        if (is_match != 0) {
+          if (post_n + tr->tr_n > post_a) {
+            post_a = (post_n + tr->tr_n) * 2;
+            post_l = realloc(post_l, sizeof(int32_t) * post_a);
+            e = post_l == NULL;
+          }
           if (e == 0) {
-            time_diff = wms->ms.timestamp - wms->ms.card_l[wms->ms.card_i].card_time;
-            set_time_str(time_diff_str, time_diff);
-            rv = printf("\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Suspend\">Suspend</button>\n"
-                        "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Resume\"%s>Resume</button>\n"
-                        "\t\t\t\t<span class=\"msf-space\"></span>\n"
-                        "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Edit\">Edit</button>\n"
-                        "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Search\">Search</button>\n"
-                        "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Stop\">Stop</button></div>\n"
-                        "\t\t</form>\n"
-                        "\t\t<code class=\"msf\">path: %s; %s; neli: %d; mctr: %u; time_diff: %s</code>\n"
-                        "\t</body>\n"
-                        "</html>\n",
-                wms->ms.can_resume != 0 ? "" : " disabled",
-                wms->ms.deck_path,
-                sw_info_str,
-                wms->ms.cards_nel,
-                wms->ms.passwd.mctr,
-                time_diff_str);
-            e = rv < 0 ? E_GHTML_8 : 0;
+            memcpy(post_l + post_n, tr->tr_post, sizeof(int32_t) * tr->tr_n);
+            post_n += tr->tr_n;
+          }
+        }
+      }
+    }
+    if (e == 0) {
+      if (post_n > 0) {
+        qsort(post_l, post_n, sizeof(int32_t), qai_cmp);
+        i = 1;
+        for (j = 1; j < post_n; j++) {
+          if (post_l[j] != post_l[i - 1]) {
+            post_l[i++] = post_l[j];
+          }
+        }
+        post_n = i;
+      }
+      *cand_lp = post_l;
+      *cand_np = post_n;
+    } else {
+      free(post_l);
+    }
+  }
+  return e;
+}
+
+static int ms_is_candidate(int32_t *cand_l, int cand_n, int32_t qai)
+{
+  return cand_n < 0 || (cand_n > 0 && bsearch(&qai, cand_l, cand_n, sizeof(int32_t), qai_cmp) != NULL);
+}
+
+// the password chunk of an opened file, the fields of older versions defaulted, with the summary, the session queue
+// and the search index it refers to (A_READ_PASSWD); E_PASSWD for a chunk of no known size
+static int ms_read_passwd(struct MemorySurfer *ms)
+{
+  int e;
+  int32_t data_size;
+  assert(ms->passwd.pw_flag == -1 && ms->passwd.version == 0 && ms->passwd.style_sai == -1);
+  data_size = imf_get_size(&ms->imf, PW_INDEX);
+  e = data_size != 23 && data_size != 32 && data_size != 36 && data_size != 37 && data_size != 41 && data_size != 45 && data_size != 49 && data_size != sizeof(struct Password) ? E_PASSWD : 0;
+  if (e == 0) {
+    e = imf_get(&ms->imf, PW_INDEX, &ms->passwd);
+    if (e == 0) {
+      if (data_size == 23 || data_size == 32 || data_size == 36) {
+        ms->passwd.version = 0x01000000;
+        ms->passwd.mctr = 0;
+        ms->passwd.rank = 4;
+      }
+      if (data_size < 41) {
+        ms->passwd.dsum_i = -1;
+      }
+      if (data_size < 45) {
+        ms->passwd.queue_i = -1;
+      }
+      if (data_size < 49) {
+        ms->passwd.sidx_i = -1;
+      }
+      if (data_size < sizeof(struct Password)) {
+        ms->passwd.base_i = -1;
+      }
+      e = ms_load_summary(ms);
+      if (e == 0) {
+        e = ms_load_queue(ms);
+        if (e == 0) {
+          e = ms_load_index(ms);
+        }
+      }
+    }
+  }
+  return e;
+}
+
+// writes the derived chunks and the password chunk as a modification, mctr is incremented (A_SYNC)
+static int ms_sync(struct MemorySurfer *ms)
+{
+  int e;
+  int32_t data_size;
+  e = ms_put_summary(ms);
+  if (e == 0) {
+    ms->passwd.mctr++;
+    e = ms_put_queue(ms);
+    if (e == 0) {
+      e = ms_put_index(ms);
+    }
+  }
+  if (e == 0) {
+    data_size = sizeof(struct Password);
+    e = imf_put(&ms->imf, PW_INDEX, &ms->passwd, data_size);
+    if (e == 0) {
+      e = imf_sync(&ms->imf);
+    }
+  }
+  return e;
+}
+
+// rates the current card at ms->lvl (A_PROCEED), its card list is loaded. The card is popped from the session queue,
+// which is refilled when it runs out: before ms_sync, which writes it, so the next card is taken from it
+static int ms_proceed(struct MemorySurfer *ms)
+{
+  int e;
+  int32_t data_size;
+  struct Card *card_ptr;
+  assert(ms->deck_i >= 0 && ms->deck_i < ms->deck_a && ms->cat_t[ms->deck_i].deck_slot_used != 0);
+  assert(ms->timestamp >= 0);
+  e = ms->lvl < 0 || ms->lvl > 20 ? E_LVL_1 : 0;
+  if (e == 0 && (ms->sq.sq_n <= 0 || ms->timestamp >= ms->sq.sq_due)) { // not kept by the asking request
+    e = ms_fill_queue(ms);
+    if (e == 0) {
+      e = ms_load_card_list(ms); // its buffer was used by the fill
+    }
+  }
+  if (e == 0) {
+    card_ptr = ms->card_l + ms->card_i;
+    if ((card_ptr->card_state & 0x07) == STATE_NEW || (card_ptr->card_state & 0x07) == STATE_SUSPENDED) {
+      card_ptr->card_state = (card_ptr->card_state & 0x08) | STATE_SCHEDULED;
+    }
+    card_ptr->card_strength = lvl_s[ms->lvl]; // S = -t / log(R)
+    card_ptr->card_time = ms->timestamp;
+    assert((card_ptr->card_state & 0x07) == STATE_SCHEDULED);
+    data_size = ms->card_a * sizeof(struct Card);
+    e = imf_put(&ms->imf, ms->cat_t[ms->deck_i].cat_cli, ms->card_l, data_size);
+    if (e == 0) {
+      e = ms_summarize(ms, ms->deck_i, ms->card_l, ms->card_a);
+    }
+    ms_pop_queue(ms, card_ptr->card_time + card_ptr->card_strength - 1);
+  }
+  if (e == 0 && (ms->sq.sq_n <= 0 || ms->timestamp >= ms->sq.sq_due)) {
+    e = ms_fill_queue(ms);
+    if (e == 0) {
+      e = ms_load_card_list(ms);
+    }
+  }
+  return e;
+}
+
+// the next card to learn with its card list and Q/A (A_DETERMINE_CARD), -1 for no card eligible
+static int ms_ask_card(struct MemorySurfer *ms)
+{
+  int e;
+  e = ms_determine_card(ms); // a refilled queue is only written with a rating (ms_proceed, ms_sync)
+  if (e == 0) {
+    assert(ms->deck_i >= 0 && ms->card_i >= 0);
+    e = ms_load_card_list(ms);
+    if (e == 0) {
+      e = ms_get_card_sa(ms);
+    }
+  }
+  return e;
+}
+
+
+// writes the derived chunks (summary, queue, search index) without counting a modification: like ms_mark_base mctr
+// isn't incremented and the mtime is restored, so a search doesn't invalidate the pages of A_SYNC_OLD
+static int ms_sync_aux(struct MemorySurfer *ms)
+{
+  int e;
+  int32_t data_size;
+  struct stat file_stat;
+  struct timespec times[2];
+  e = fstat(ms->imf.filedesc, &file_stat);
+  if (e == 0) {
+    e = ms_put_summary(ms);
+  }
+  if (e == 0) {
+    e = ms_put_queue(ms);
+    if (e == 0) {
+      e = ms_put_index(ms);
+    }
+    if (e == 0) {
+      data_size = sizeof(struct Password);
+      e = imf_put(&ms->imf, PW_INDEX, &ms->passwd, data_size);
+      if (e == 0) {
+        e = imf_sync(&ms->imf);
+        if (e == 0) {
+          times[0] = file_stat.st_atim;
+          times[1] = file_stat.st_mtim;
+          e = futimens(ms->imf.filedesc, times);
+        }
+      }
+    }
+  }
+  return e;
+}
+
+// counts the scheduled cards of the checked decks by the day (of the next 30) they come due, overdue cards in day 0;
+// the wheel of a deck is re-anchored from its card list once the window reaches cards of the 32 day spans
+static int ms_forecast(struct MemorySurfer *ms, int *due_l)
+{
+  int e;
+  int deck_i;
+  int i;
+  int j;
+  int32_t end;
+  int32_t off;
+  int stale;
+  struct Card *card_l;
+  struct DeckSummary *dsum_ptr;
+  e = 0;
+  assert(ms->timestamp >= 0);
+  for (i = 0; i < 30; i++) {
+    due_l[i] = 0;
+  }
+  if (ms->dsum_a < 0) {
+    e = ms_rebuild_summary(ms);
+  }
+  card_l = NULL;
+  for (deck_i = 0; deck_i < ms->dsum_a && e == 0; deck_i++) {
+    if (ms->cat_t[deck_i].deck_slot_used == 1 && ms->cat_t[deck_i].deck_on != 0) {
+      dsum_ptr = ms->dsum_l + deck_i;
+      off = ms->timestamp / 86400 - dsum_ptr->ds_day;
+      end = off + 29; // last day of the window, relative to ds_day
+      if (end > 31) {
+        stale = dsum_ptr->ds_later > 0 && end >= 32 + 16 * 32;
+        for (i = 0; i < 16 && 32 + i * 32 <= end; i++) {
+          if (dsum_ptr->ds_wheel1[i] != 0) {
+            stale = 1;
           }
         }
-        break;
-      case B_MSG:
-        assert(wms->msg_header != NULL && wms->msg_btn_main != NULL);
-        if (wms->mode == M_NONE) {
-          assert(wms->todo_main >= S_FILE && wms->todo_main <= S_END);
-          rv = printf("\t\t\t\t<input type=\"hidden\" name=\"todo_main\" value=\"%d\">\n", wms->todo_main);
-          e = rv < 0;
+        if (stale != 0) {
+          e = ms_resummarize(ms, deck_i, &card_l);
+          off = 0;
         }
-        if (e == 0) {
-          rv = printf("\t\t\t</div>\n"
-                      "\t\t\t<h1 class=\"msf\">%s</h1>\n",
-              wms->msg_header);
-          e = rv < 0;
-          if (wms->msg_static != NULL && e == 0) {
-            rv = printf("\t\t\t<p class=\"msf\">%s</p>\n", wms->msg_static);
-            e = rv < 0;
+      }
+      if (e == 0) {
+        for (i = 0; i < 32; i++) {
+          j = i - off;
+          if (j < 0) {
+            j = 0;
           }
-          if (e == 0) {
-            rv = printf("\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"%s\">%s</button>\n",
-                wms->msg_btn_main,
-                wms->msg_btn_main);
-            e = rv < 0;
+          if (j < 30) {
+            due_l[j] += dsum_ptr->ds_wheel0[i];
           }
         }
-        if (e == 0 && wms->msg_btn_alt != NULL) {
-          rv = printf("\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"%s\">%s</button>\n",
-              wms->msg_btn_alt,
-              wms->msg_btn_alt);
-          e = rv < 0;
-        }
-        if (e == 0) {
-          rv = printf("\t\t\t</div>\n"
-                      "\t\t</form>\n"
-                      "\t\t<code class=\"msf\">%s</code>\n"
-                      "\t</body>\n"
-                      "</html>\n",
-              sw_info_str);
-          e = rv < 0;
-        }
-        break;
-      case B_HISTOGRAM:
-        vby = wms->hist_max;
-        if (vby < 61)
-          vby = 61;
-        else if (vby > 121)
-          vby = 121;
-        wms->html_lp[0] = '\0';
-        rv = snprintf(wms->html_lp, wms->html_n, "M1 %d", vby);
-        e = rv < 0 || rv >= wms->html_n;
-        if (e == 0) {
-          n = rv;
-          y = 0;
-          dx = 0;
-          for (i = 0; i < 100 && e == 0; i++) {
-            dy = y - wms->hist_bucket[i];
-            if (dy != 0) {
-              if (dx > 0) {
-                size = wms->html_n - n;
-                rv = snprintf(wms->html_lp + n, size, "h%d", dx);
-                e = rv < 0 || rv >= size;
-                n += rv;
-                dx = 0;
-              }
-              if (e == 0) {
-                size = wms->html_n - n;
-                rv = snprintf(wms->html_lp + n, size, "v%d", dy);
-                e = rv < 0 || rv >= size;
-                n += rv;
-                y -= dy;
-              }
+      }
+    }
+  }
+  free(card_l);
+  return e;
+}
+
+static void str_tolower(char *str)
+{
+  assert (str != NULL);
+  utf8_fold(str, strlen(str));
+}
+
+// returns the first occurrence of the needle in the text (without modifying it), with fold != 0 the needle is expected
+// folded (str_tolower) and the text is folded as it is compared; a word of 8 positions is skipped at once when none
+// of them holds the first byte of the needle, the last byte is compared before the bytes in between; a needle of
+// ASCII bytes only is compared by bytes (nothing else folds into ASCII)
+static char *str_match(const char *str, const char *needle, int fold)
+{
+  size_t n;
+  size_t m;
+  size_t i;
+  size_t j;
+  size_t k;
+  uint64_t word;
+  uint64_t first;
+  uint64_t mask;
+  uint64_t x;
+  uint8_t ch0;
+  uint8_t chl;
+  int is_cand;
+  int is_wide;
+  int len;
+  char fold_d[4];
+  const char *found;
+  found = NULL;
+  m = strlen(needle);
+  n = strlen(str);
+  is_wide = 0;
+  for (k = 0; k < m && fold != 0; k++) {
+    is_wide |= (uint8_t)needle[k] >= 0x80;
+  }
+  if (m == 0) {
+    found = str;
+  } else if (m <= n) {
+    ch0 = needle[0];
+    chl = needle[m - 1];
+    first = 0x0101010101010101ull * ch0;
+    mask = fold != 0 && ch0 >= 'a' && ch0 <= 'z' ? 0x2020202020202020ull : 0; // 'A' | 0x20 == 'a'
+    i = 0;
+    while (found == NULL && i <= n - m) {
+      is_cand = 1;
+      if (i + sizeof(word) <= n && (is_wide == 0 || ch0 < 0x80)) { // 'Σ' and 'σ' start with different bytes
+        memcpy(&word, str + i, sizeof(word));
+        x = (word | mask) ^ first;
+        is_cand = ((x - 0x0101010101010101ull) & ~x & 0x8080808080808080ull) != 0; // x has a zero byte
+      }
+      if (is_cand == 0) {
+        i += sizeof(word);
+      } else {
+        j = i + sizeof(word) < n - m + 1 ? i + sizeof(word) : n - m + 1;
+        while (found == NULL && i < j) {
+          if (is_wide != 0) {
+            is_cand = 1;
+            for (k = 0; k < m && is_cand != 0; k += len) {
+              len = utf8_fold_char(str + i + k, fold_d);
+              is_cand = k + len <= m && memcmp(fold_d, needle + k, len) == 0;
             }
-            dx++;
-          }
-          if (e == 0) {
-            size = wms->html_n - n;
-            rv = snprintf(wms->html_lp + n, size, "h%d", dx);
-            e = rv < 0 || rv >= size;
-            n += rv;
-            if (e == 0) {
-              if (y > 0) {
-                size = wms->html_n - n;
-                rv = snprintf(wms->html_lp + n, size, "v%d", y);
-                e = rv < 0 || rv >= size;
-                n += rv;
-              }
-              if (e == 0) {
-                size = wms->html_n - n;
-                rv = snprintf(wms->html_lp + n, size, "z");
-                e = rv < 0 || rv >= size;
-                n += rv;
-              }
+          } else if (fold != 0) {
+            is_cand = lower_map[(uint8_t)str[i]] == ch0 && lower_map[(uint8_t)str[i + m - 1]] == chl;
+            for (k = 1; k + 1 < m && is_cand != 0; k++) {
+              is_cand = lower_map[(uint8_t)str[i + k]] == (uint8_t)needle[k];
             }
+          } else {
+            is_cand = (uint8_t)str[i] == ch0 && (uint8_t)str[i + m - 1] == chl && memcmp(str + i + 1, needle + 1, m - 1) == 0;
           }
-          if (e == 0) {
-            e = imf_info_gaps(&wms->ms.imf);
-            if (e == 0) {
-              rv = printf("\t\t\t<h1 class=\"msf\">Histogram</h1>\n"
-                          "\t\t\t<p class=\"msf\">Retention</p>\n"
-                          "\t\t\t<svg class=\"msf\" viewbox=\"0 0 101 %d\">\n"
-                          "\t\t\t\t<path d=\"%s\" />\n"
-                          "\t\t\t</svg>\n"
-                          "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Edit\">Edit</button>\n"
-                          "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Learn\">Learn</button>\n"
-                          "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Search\">Search</button>\n"
-                          "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Refresh\">Refresh</button>\n"
-                          "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Done\">Done</button></div>\n"
-                          "\t\t</form>\n"
-                          "\t\t<code class=\"msf\">%s; gaps=%d, gaps_size=%d, Details: %s, n=%d</code>\n"
-                          "\t</body>\n"
-                          "</html>\n",
-                  vby + 1,
-                  wms->html_lp,
-                  sw_info_str,
-                  wms->ms.imf.stats_gaps,
-                  wms->ms.imf.stats_gaps_space,
-                  wms->ms.imf.stats_gaps_str,
-                  n);
-              e = rv < 0;
-            }
+          if (is_cand != 0) {
+            found = str + i;
+          } else {
+            i++;
           }
         }
-        break;
-      case B_TABLE:
-        rv = printf("\t\t\t<h1 class=\"msf\">Table</h1>\n"
-                    "\t\t\t<p class=\"msf\">%d deck(s) checked (for learning).</p>\n"
-                    "\t\t\t<table>\n"
-                    "\t\t\t\t<thead>\n"
-                    "\t\t\t\t\t<tr><td>Level</td><td>Strength</td><td>Cards</td><td>Eligible</td><td>Threshold</td></tr>\n"
-                    "\t\t\t\t</thead>\n"
-                    "\t\t\t\t<tbody>\n",
-            wms->checked_decks);
-        e = rv < 0;
-        size = sizeof(el_str);
-        for (i = 0; i < 21 && e == 0; i++) {
-          set_time_str(time_diff_str, lvl_s[i]);
-          if (wms->lvl_bucket[0][i] > 0) {
-            j = 100 * wms->lvl_bucket[1][i] / wms->lvl_bucket[0][i];
-            rv = snprintf(el_str, size, "%d%%", j);
-            e = rv < 0 || rv >= size;
-          } else
-            strcpy(el_str, "n/a");
-          if (!e) {
-            rv = printf("\t\t\t\t\t<tr>"
-                        "<td class=\"msf-str\"><label for=\"%d\">%d</label></td>"
-                        "<td class=\"msf-str\"><label for=\"%d\"><code class=\"msf\">(%s)</code></label></td>"
-                        "<td class=\"msf-str\"><label for=\"%d\">%d</label></td>"
-                        "<td class=\"msf-str\"><label for=\"%d\">%s</label></td>"
-                        "<td class=\"msf-str\"><input id=\"%d\" type=\"radio\" name=\"rank\" value=\"%d\"%s></td></tr>\n",
-                i, i,
-                i, time_diff_str,
-                i, wms->lvl_bucket[0][i],
-                i, el_str,
-                i, i, i == wms->ms.passwd.rank ? " checked" : "");
-            e = rv < 0;
+      }
+    }
+  }
+  return (char *)found;
+}
+
+// a new position of the pattern, matching the bytes in cls (bit c & 63 of cls[c >> 6])
+static int rx_position(struct RegexParse *rp, const uint64_t *cls, struct Glushkov *gl)
+{
+  int e;
+  int c;
+  uint64_t bit;
+  struct Regex *rx;
+  rx = rp->rp_rx;
+  e = rx->rx_n == RX_POS_MAX;
+  if (e == 0) {
+    bit = (uint64_t)1 << rx->rx_n;
+    for (c = 0; c < 256; c++) {
+      if ((cls[c >> 6] >> (c & 63) & 1) != 0) {
+        rx->rx_class[c] |= bit;
+      }
+    }
+    rx->rx_n++;
+    gl->gl_first = bit;
+    gl->gl_last = bit;
+    gl->gl_nullable = 0;
+  } else {
+    rp->rp_err = "The pattern has too many characters and classes";
+  }
+  return e;
+}
+
+// gl followed by r, the follow sets of the last positions of gl gain the first positions of r
+static void gl_concat(struct Regex *rx, struct Glushkov *gl, const struct Glushkov *r)
+{
+  int p;
+  for (p = 0; p < rx->rx_n; p++) {
+    if ((gl->gl_last >> p & 1) != 0) {
+      rx->rx_follow[p] |= r->gl_first;
+    }
+  }
+  if (gl->gl_nullable != 0) {
+    gl->gl_first |= r->gl_first;
+  }
+  gl->gl_last = r->gl_nullable != 0 ? gl->gl_last | r->gl_last : r->gl_last;
+  gl->gl_nullable = gl->gl_nullable != 0 && r->gl_nullable != 0;
+}
+
+// lets gl repeat (for '*' and '+')
+static void gl_repeat(struct Regex *rx, struct Glushkov *gl)
+{
+  int p;
+  for (p = 0; p < rx->rx_n; p++) {
+    if ((gl->gl_last >> p & 1) != 0) {
+      rx->rx_follow[p] |= gl->gl_first;
+    }
+  }
+}
+
+static void cls_add(uint64_t *cls, int c, int fold)
+{
+  cls[c >> 6] |= (uint64_t)1 << (c & 63);
+  if (fold != 0 && lower_map[c] != c) {
+    cls[lower_map[c] >> 6] |= (uint64_t)1 << (lower_map[c] & 63);
+  } else if (fold != 0 && c >= 'a' && c <= 'z') {
+    cls[(c - 0x20) >> 6] |= (uint64_t)1 << ((c - 0x20) & 63);
+  }
+}
+
+// \d, \w and \s (and the negations in upper case), returns 0 for other letters
+static int cls_escape(uint64_t *cls, int ch)
+{
+  int is_cls;
+  int c;
+  uint64_t neg[4];
+  is_cls = 1;
+  memset(neg, 0, sizeof(neg));
+  switch (ch | 0x20) {
+  case 'd':
+    for (c = '0'; c <= '9'; c++) {
+      cls_add(neg, c, 0);
+    }
+    break;
+  case 'w':
+    for (c = 0; c < 128; c++) {
+      if ((c >= '0' && c <= '9') || (lower_map[c] >= 'a' && lower_map[c] <= 'z') || c == '_') {
+        cls_add(neg, c, 0);
+      }
+    }
+    break;
+  case 's':
+    for (c = 0; c < 128; c++) {
+      if (c == ' ' || (c >= '\t' && c <= '\r')) {
+        cls_add(neg, c, 0);
+      }
+    }
+    break;
+  default:
+    is_cls = 0;
+  }
+  for (c = 0; c < 4 && is_cls != 0; c++) {
+    cls[c] |= (ch & 0x20) != 0 ? neg[c] : ~neg[c];
+  }
+  return is_cls;
+}
+
+// cls followed by any UTF-8 continuation bytes, so that '.', [^...] and \W take a character as a whole
+static int rx_char_class(struct RegexParse *rp, uint64_t *cls, struct Glushkov *gl)
+{
+  int e;
+  uint64_t cont[4] = { 0, 0, UINT64_MAX, 0 }; // 0x80 - 0xbf
+  struct Glushkov tail;
+  cls[2] = 0;
+  e = rx_position(rp, cls, gl);
+  if (e == 0) {
+    e = rx_position(rp, cont, &tail);
+    if (e == 0) {
+      gl_repeat(rp->rp_rx, &tail);
+      tail.gl_nullable = 1;
+      gl_concat(rp->rp_rx, gl, &tail);
+    }
+  }
+  return e;
+}
+
+// the bytes s[0..n) one position each, in sequence
+static int rx_bytes(struct RegexParse *rp, const char *s, int n, struct Glushkov *gl)
+{
+  int e;
+  int i;
+  uint64_t cls[4];
+  struct Glushkov byte;
+  e = 0;
+  for (i = 0; i < n && e == 0; i++) {
+    memset(cls, 0, sizeof(cls));
+    cls_add(cls, (uint8_t)s[i], rp->rp_fold);
+    e = rx_position(rp, cls, i == 0 ? gl : &byte);
+    if (e == 0 && i > 0) {
+      gl_concat(rp->rp_rx, gl, &byte);
+    }
+  }
+  return e;
+}
+
+// a literal character at rp_i (all bytes of a UTF-8 sequence), when folding other than ASCII as alternatives of
+// the characters which fold like it
+static int rx_literal(struct RegexParse *rp, struct Glushkov *gl)
+{
+  int e;
+  int n;
+  int i;
+  int var_n;
+  uint32_t cp;
+  uint32_t var_l[UC_VARIANTS];
+  char var_d[4];
+  struct Glushkov alt;
+  n = utf8_lead_len(rp->rp_s[rp->rp_i]);
+  e = rp->rp_i + n > rp->rp_end;
+  for (i = 1; i < n && e == 0; i++) {
+    e = (rp->rp_s[rp->rp_i + i] & 0xc0) != 0x80;
+  }
+  if (e == 0) {
+    if (rp->rp_fold != 0 && n > 1 && utf8_decode((const char *)rp->rp_s + rp->rp_i, &cp) == n) {
+      var_n = uc_variants(cp, var_l);
+      gl->gl_first = 0;
+      gl->gl_last = 0;
+      gl->gl_nullable = 0;
+      for (i = 0; i < var_n && e == 0; i++) {
+        e = rx_bytes(rp, var_d, utf8_encode(var_l[i], var_d), &alt);
+        gl->gl_first |= alt.gl_first;
+        gl->gl_last |= alt.gl_last;
+      }
+    } else {
+      e = rx_bytes(rp, (const char *)rp->rp_s + rp->rp_i, n, gl);
+    }
+    rp->rp_i += n;
+  } else {
+    rp->rp_err = "The pattern is not valid UTF-8";
+  }
+  return e;
+}
+
+// a bracket expression after '[': ASCII members and ranges go into one position, other characters are alternatives
+static int rx_bracket(struct RegexParse *rp, struct Glushkov *gl)
+{
+  int e;
+  int is_neg;
+  int is_first;
+  int c;
+  int c_to;
+  uint64_t cls[4];
+  struct Glushkov alt;
+  e = 0;
+  memset(cls, 0, sizeof(cls));
+  gl->gl_first = 0;
+  gl->gl_last = 0;
+  gl->gl_nullable = 0;
+  is_neg = rp->rp_i < rp->rp_end && rp->rp_s[rp->rp_i] == '^';
+  rp->rp_i += is_neg;
+  is_first = 1;
+  while (e == 0 && rp->rp_i < rp->rp_end && (rp->rp_s[rp->rp_i] != ']' || is_first != 0)) {
+    is_first = 0;
+    c = rp->rp_s[rp->rp_i];
+    if (c >= 0x80) {
+      e = is_neg;
+      if (e == 0) {
+        e = rx_literal(rp, &alt);
+        if (e == 0) {
+          gl->gl_first |= alt.gl_first;
+          gl->gl_last |= alt.gl_last;
+        }
+      } else {
+        rp->rp_err = "Non-ASCII characters in [^...] are not supported";
+      }
+    } else {
+      rp->rp_i++;
+      if (c == '\\' && rp->rp_i < rp->rp_end) {
+        c = rp->rp_s[rp->rp_i++];
+        if (cls_escape(cls, c) != 0) {
+          c = -1;
+        } else {
+          c = c == 'n' ? '\n' : c == 't' ? '\t' : c == 'r' ? '\r' : c;
+        }
+      }
+      if (c >= 0) {
+        c_to = c;
+        if (rp->rp_i + 1 < rp->rp_end && rp->rp_s[rp->rp_i] == '-' && rp->rp_s[rp->rp_i + 1] != ']') {
+          c_to = rp->rp_s[rp->rp_i + 1];
+          rp->rp_i += 2;
+          e = c_to >= 0x80 || c_to < c || c_to == '\\';
+          if (e != 0) {
+            rp->rp_err = "Invalid range in [...]";
           }
         }
+        for (; c <= c_to && e == 0; c++) {
+          cls_add(cls, c, rp->rp_fold);
+        }
+      }
+    }
+  }
+  if (e == 0) {
+    e = rp->rp_i >= rp->rp_end;
+    if (e == 0) {
+      rp->rp_i++;
+      if (is_neg != 0) {
+        for (c = 0; c < 4; c++) {
+          cls[c] = ~cls[c];
+        }
+        e = rx_char_class(rp, cls, gl);
+      } else if ((cls[0] | cls[1] | cls[2] | cls[3]) != 0) {
+        e = rx_position(rp, cls, &alt);
         if (e == 0) {
-          rv = printf("\t\t\t\t</tbody>\n"
-                      "\t\t\t</table>\n"
-                      "\t\t\t<div class=\"msf-btns\"><button class=\"msf\" type=\"submit\" name=\"event\" value=\"Edit\">Edit</button>\n"
-                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Learn\">Learn</button>\n"
-                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Search\">Search</button>\n"
-                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Refresh\">Refresh</button>\n"
-                      "\t\t\t\t<button class=\"msf\" type=\"submit\" name=\"event\" value=\"Done\">Done</button></div>\n"
-                      "\t\t</form>\n"
-                      "\t\t<code class=\"msf\">%s; ",
-              sw_info_str);
-          e = rv < 0;
+          gl->gl_first |= alt.gl_first;
+          gl->gl_last |= alt.gl_last;
+        }
+      }
+    } else {
+      rp->rp_err = "Missing ]";
+    }
+  }
+  return e;
+}
+
+// parses alternatives up to ')' or the end of the pattern (recursing into groups) and builds the
+// follow sets of the position automaton (Glushkov)
+static int rx_alt(struct RegexParse *rp, struct Glushkov *gl, int depth)
+{
+  int e;
+  int is_end;
+  uint8_t ch;
+  uint64_t cls[4];
+  struct Glushkov seq;
+  struct Glushkov atom;
+  e = depth > RX_POS_MAX;
+  if (e != 0) {
+    rp->rp_err = "The pattern is nested too deep";
+  }
+  gl->gl_first = 0;
+  gl->gl_last = 0;
+  gl->gl_nullable = 0;
+  is_end = e;
+  while (is_end == 0) {
+    seq.gl_first = 0;
+    seq.gl_last = 0;
+    seq.gl_nullable = 1;
+    while (e == 0 && rp->rp_i < rp->rp_end && rp->rp_s[rp->rp_i] != '|' && rp->rp_s[rp->rp_i] != ')') {
+      ch = rp->rp_s[rp->rp_i];
+      memset(cls, 0, sizeof(cls));
+      switch (ch) {
+      case '(':
+        rp->rp_i++;
+        e = rx_alt(rp, &atom, depth + 1);
+        if (e == 0) {
+          e = rp->rp_i >= rp->rp_end;
           if (e == 0) {
-            for (i = 0; i < 4 && e == 0; i++) {
-              rv = printf("%s: %d%s", state_str[i], wms->count_bucket[i], i < 3 ? ", " : "");
-              e = rv < 0;
-            }
-            if (e == 0) {
-              rv = printf("</code>\n"
-                          "\t</body>\n"
-                          "</html>\n");
-              e = rv < 0;
-            }
+            rp->rp_i++;
+          } else {
+            rp->rp_err = "Missing )";
           }
         }
         break;
-      default:
-        e = E_GHTML_9;
+      case '[':
+        rp->rp_i++;
+        e = rx_bracket(rp, &atom);
+        break;
+      case '.':
+        rp->rp_i++;
+        memset(cls, 0xff, sizeof(cls));
+        cls[0] &= ~((uint64_t)1 << '\n');
+        e = rx_char_class(rp, cls, &atom);
+        break;
+      case '\\':
+        rp->rp_i++;
+        e = rp->rp_i >= rp->rp_end;
+        if (e == 0) {
+          ch = rp->rp_s[rp->rp_i];
+          if (cls_escape(cls, ch) != 0) {
+            rp->rp_i++;
+            e = (ch & 0x20) == 0 ? rx_char_class(rp, cls, &atom) : rx_position(rp, cls, &atom);
+          } else if (ch == 'n' || ch == 't' || ch == 'r') {
+            rp->rp_i++;
+            cls_add(cls, ch == 'n' ? '\n' : ch == 't' ? '\t' : '\r', 0);
+            e = rx_position(rp, cls, &atom);
+          } else {
+            e = rx_literal(rp, &atom);
+          }
+        } else {
+          rp->rp_err = "The pattern ends with \\";
+        }
         break;
+      case '*':
+      case '+':
+      case '?':
+      case '{':
+        e = 1;
+        rp->rp_err = "Nothing to repeat (or {m,n}, which is not supported)";
+        break;
+      case '^':
+      case '$':
+        e = 1;
+        rp->rp_err = "^ and $ are only supported at the start and the end of the pattern";
+        break;
+      default:
+        e = rx_literal(rp, &atom);
+      }
+      while (e == 0 && rp->rp_i < rp->rp_end && (rp->rp_s[rp->rp_i] == '*' || rp->rp_s[rp->rp_i] == '+' || rp->rp_s[rp->rp_i] == '?')) {
+        if (rp->rp_s[rp->rp_i] != '?') {
+          gl_repeat(rp->rp_rx, &atom);
+        }
+        if (rp->rp_s[rp->rp_i] != '+') {
+          atom.gl_nullable = 1;
+        }
+        rp->rp_i++;
+      }
+      if (e == 0) {
+        gl_concat(rp->rp_rx, &seq, &atom);
       }
     }
-    free(sw_info_str);
+    if (e == 0) {
+      gl->gl_first |= seq.gl_first;
+      gl->gl_last |= seq.gl_last;
+      gl->gl_nullable |= seq.gl_nullable;
+    }
+    is_end = e != 0 || rp->rp_i >= rp->rp_end || rp->rp_s[rp->rp_i] == ')';
+    if (is_end == 0) {
+      rp->rp_i++; // '|'
+    }
   }
   return e;
 }
 
-static int ms_init(struct MemorySurfer *ms)
+// compiles a pattern (literal characters, '.', [...], \d \w \s, groups, '|', '*', '+', '?' and ^ and $ at
+// its ends) into a position automaton that is run bit-parallel: a state is the set of positions reached,
+// its successor is looked up byte by byte in rx_next, so a text is scanned in linear time;
+// an invalid pattern sets *err_str and *rx_ptr to NULL
+static int rx_compile(struct Regex **rx_ptr, const char *pattern, int fold, const char **err_str)
 {
   int e;
-  size_t size;
-  imf_init(&ms->imf);
-  ms->imf_filename = NULL;
-  sa_init(&ms->deck_sa);
-  sa_init(&ms->style_sa);
-  assert(sizeof(struct Deck) == 12);
-  ms->cat_t = NULL;
-  ms->deck_a = 0;
-  ms->n_first = -1;
-  ms->deck_path_z = 0;
-  ms->deck_path = NULL;
-  ms->deck_i = -1;
-  ms->mov_deck_i = -1;
-  ms->arrange = -1;
-  ms->deck_name_str = NULL;
-  ms->style_txt = NULL;
-  ms->card_l = NULL;
-  ms->card_a = 0;
-  ms->card_i = -1;
-  ms->mov_card_i = -1;
-  ms->cards_nel = -1;
-  sa_init(&ms->card_sa);
-  ms->timestamp = time(NULL);
-  e = ms->timestamp == -1;
+  int k;
+  int v;
+  int p;
+  int q;
+  int i;
+  size_t len;
+  struct Regex *rx;
+  struct RegexParse rp;
+  struct Glushkov gl;
+  uint64_t prev[RX_POS_MAX];
+  *rx_ptr = NULL;
+  rx = malloc(sizeof(struct Regex));
+  e = rx == NULL;
   if (e == 0) {
-    ms->lvl = -1;
-    ms->rank = -1;
-    ms->search_txt = NULL;
-    ms->match_case = -1;
-    ms->is_html = -1;
-    ms->is_unlocked = -1;
-    ms->search_dir = 0;
-    ms->scope = C_UNDEF;
-    ms->can_resume = 0;
-    ms->password = NULL;
-    ms->new_password = NULL;
-    size = sizeof(ms->passwd.pw_msg_digest);
-    memset(&ms->passwd.pw_msg_digest, -1, size);
-    ms->passwd.pw_flag = -1;
-    ms->passwd.timeout.to_sec = 0;
-    ms->passwd.timeout.to_count = 0;
-    ms->passwd.version = 0;
-    ms->passwd.style_sai = -1;
-    ms->passwd.mctr = 0;
-    ms->passwd.rank = 4;
-    ms->deck_flags = NULL;
-    ms->deck_flags_n = 0;
+    memset(rx, 0, sizeof(struct Regex));
+    len = strlen(pattern);
+    rp.rp_rx = rx;
+    rp.rp_s = (const uint8_t *)pattern;
+    rp.rp_i = 0;
+    rp.rp_end = len < INT_MAX ? len : INT_MAX;
+    rp.rp_fold = fold;
+    rp.rp_err = NULL;
+    if (rp.rp_end > 0 && pattern[0] == '^') {
+      rx->rx_bol = 1;
+      rp.rp_i = 1;
+    }
+    if (rp.rp_end > rp.rp_i && pattern[rp.rp_end - 1] == '$') {
+      i = rp.rp_end - 1;
+      while (i > rp.rp_i && pattern[i - 1] == '\\') {
+        i--;
+      }
+      if ((rp.rp_end - 1 - i) % 2 == 0) {
+        rx->rx_eol = 1;
+        rp.rp_end--;
+      }
+    }
+    if (rx_alt(&rp, &gl, 0) == 0 && rp.rp_i < rp.rp_end) {
+      rp.rp_err = "Unmatched )";
+    }
+    if (rp.rp_err == NULL) {
+      rx->rx_first = gl.gl_first;
+      rx->rx_last = gl.gl_last;
+      rx->rx_nullable = gl.gl_nullable;
+      rx->rx_w = (rx->rx_n + 7) / 8;
+      memset(prev, 0, sizeof(prev));
+      for (p = 0; p < rx->rx_n; p++) {
+        for (q = 0; q < rx->rx_n; q++) {
+          if ((rx->rx_follow[p] >> q & 1) != 0) {
+            prev[q] |= (uint64_t)1 << p;
+          }
+        }
+      }
+      for (k = 0; k < rx->rx_w; k++) {
+        for (v = 1; v < 256; v++) {
+          p = 0;
+          while ((v >> p & 1) == 0) {
+            p++;
+          }
+          p += k * 8;
+          rx->rx_next[k][v] = rx->rx_next[k][v & (v - 1)] | (p < rx->rx_n ? rx->rx_follow[p] : 0);
+          rx->rx_prev[k][v] = rx->rx_prev[k][v & (v - 1)] | (p < rx->rx_n ? prev[p] : 0);
+        }
+      }
+      *rx_ptr = rx;
+    } else {
+      *err_str = rp.rp_err;
+      free(rx);
+    }
   }
   return e;
 }
 
-static void inds_init(struct IndentStr *inds)
+static uint64_t rx_step(uint64_t (*table)[256], int w, uint64_t state)
 {
-  inds->str = NULL;
-  inds->size = 0;
-  inds->indent_n = -1;
+  uint64_t next;
+  int k;
+  next = 0;
+  for (k = 0; k < w; k++) {
+    next |= table[k][state >> (k * 8) & 0xff];
+  }
+  return next;
 }
 
-static int wms_init(struct WebMemorySurfer *wms)
+// the leftmost start of the matches that end first, extended to the longest match from there: three linear scans
+static char *rx_find(struct Regex *rx, const char *str, int *len)
 {
-  int e;
-  size_t size;
-  e = ms_init(&wms->ms);
-  if (e == 0) {
-    assert(A_END == 0);
-    wms->seq = S_END;
-    wms->page = P_START;
-    wms->from_page = P_UNDEF;
-    wms->mode = M_NONE;
-    wms->saved_mode = M_NONE;
-    wms->timeout = -1;
-    wms->dbg_n = 720;
-    wms->dbg_lp = malloc(wms->dbg_n);
-    e = wms->dbg_lp == NULL ? E_MALLOC_1 : 0;
-    if (e == 0) {
-      wms->dbg_lp[0] = '\0';
-      wms->dbg_wp = 0;
-      wms->file_title_str = NULL;
-      wms->fl_v = NULL;
-      wms->fl_c = 0;
-      sa_init(&wms->qa_sa);
-      wms->reveal_pos = -1;
-      wms->saved_reveal_pos = -1;
-      wms->sw_i = -1;
-      wms->msg_header = NULL;
-      wms->msg_static = NULL;
-      wms->msg_btn_main = NULL;
-      wms->msg_btn_alt = NULL;
-      wms->dyn_msg = NULL;
-      wms->todo_main = -1;
-      wms->html_n = 500;
-      wms->html_lp = malloc(wms->html_n);
-      e = wms->html_lp == NULL ? E_MALLOC_2 : 0;
-      if (e == 0) {
-        memset(wms->mtime, -1, sizeof(wms->mtime));
-        memset(wms->tok_digest, -1, sizeof(wms->tok_digest));
-        wms->tok_str[0] = '\0';
-        size = sizeof(struct IndentStr);
-        wms->inds = malloc(size);
-        e = wms->inds == NULL ? E_MALLOC_3 : 0;
-        if (e == 0) {
-          inds_init(wms->inds);
-          wms->temp_filename = NULL;
-          wms->posted_message_digest = NULL;
-        }
+  const uint8_t *s;
+  size_t n;
+  size_t i;
+  size_t start;
+  size_t end;
+  uint64_t d;
+  int found;
+  s = (const uint8_t *)str;
+  n = strlen(str);
+  found = rx->rx_nullable != 0 && (rx->rx_eol == 0 || n == 0);
+  end = 0;
+  d = 0;
+  i = 0;
+  while (found == 0 && i < n && (d != 0 || i == 0 || rx->rx_bol == 0)) {
+    d = (rx_step(rx->rx_next, rx->rx_w, d) | (i == 0 || rx->rx_bol == 0 ? rx->rx_first : 0)) & rx->rx_class[s[i]];
+    i++;
+    if ((d & rx->rx_last) != 0 && (rx->rx_eol == 0 || i == n)) {
+      found = 1;
+      end = i;
+    }
+  }
+  if (found == 0 && rx->rx_nullable != 0 && (rx->rx_bol == 0 || n == 0)) {
+    found = 1; // empty match at the end
+    end = n;
+  }
+  start = end;
+  if (found != 0) {
+    d = 0;
+    i = end;
+    while (i > 0 && (d != 0 || i == end)) {
+      i--;
+      d = (rx_step(rx->rx_prev, rx->rx_w, d) | (i == end - 1 ? rx->rx_last : 0)) & rx->rx_class[s[i]];
+      if ((d & rx->rx_first) != 0 && (rx->rx_bol == 0 || i == 0)) {
+        start = i;
       }
     }
+    d = 0;
+    i = start;
+    while (i < n && (d != 0 || i == start)) {
+      d = (rx_step(rx->rx_next, rx->rx_w, d) | (i == start ? rx->rx_first : 0)) & rx->rx_class[s[i]];
+      i++;
+      if ((d & rx->rx_last) != 0 && (rx->rx_eol == 0 || i == n)) {
+        end = i;
+      }
+    }
+    *len = end - start;
   }
-  return e;
+  return found != 0 ? (char *)str + start : NULL;
 }
 
-static void ms_free(struct MemorySurfer *ms)
+// a character of the text or the pattern: its UTF-8 bytes (folded with fold != 0, but for ASCII, which fz_peq
+// holds in either case) packed into *key, returns the number of bytes it takes of s
+static int fz_char(const uint8_t *s, int fold, uint32_t *key)
 {
-  free(ms->deck_flags);
-  ms->deck_flags = NULL;
-  ms->deck_flags_n = 0;
-  free(ms->imf_filename);
-  sa_free(&ms->style_sa);
-  sa_free(&ms->deck_sa);
-  free(ms->cat_t);
-  ms->cat_t = NULL;
-  ms->deck_a = 0;
-  free(ms->deck_path);
-  ms->deck_path = NULL;
-  ms->deck_path_z = 0;
-  free(ms->style_txt);
-  ms->style_txt = NULL;
-  free(ms->deck_name_str);
-  ms->deck_name_str = NULL;
-  free(ms->card_l);
-  ms->card_l = NULL;
-  ms->card_a = 0;
-  ms->card_i = -1;
-  sa_free(&ms->card_sa);
-  free(ms->search_txt);
-  free(ms->password);
-  free(ms->new_password);
-  char b;
-  b = imf_is_open(&ms->imf);
-  if (b) {
-    imf_close(&ms->imf);
+  int n;
+  int i;
+  uint32_t cp;
+  char fold_d[4];
+  if (s[0] < 0x80) {
+    n = 1;
+    *key = s[0];
+  } else {
+    if (fold != 0) {
+      n = utf8_fold_char((const char *)s, fold_d);
+    } else {
+      n = utf8_decode((const char *)s, &cp);
+      memcpy(fold_d, s, n);
+    }
+    *key = 0;
+    for (i = 0; i < n; i++) {
+      *key = *key << 8 | (uint8_t)fold_d[i];
+    }
+  }
+  return n;
+}
+
+// the character which ends at s[end]
+static int fz_char_back(const uint8_t *s, int end, int fold, uint32_t *key)
+{
+  int i;
+  i = end - 1;
+  while (i > 0 && end - i < 4 && (s[i] & 0xc0) == 0x80) {
+    i--;
+  }
+  if (fz_char(s + i, fold, key) != end - i) {
+    i = end - 1;
+    *key = s[i]; // a stray continuation byte
+  }
+  return end - i;
+}
+
+// the pattern positions (forward, dir 0, or reversed, dir 1) which hold the character key
+static uint64_t fz_eq(const struct Fuzzy *fz, int dir, uint32_t key)
+{
+  uint64_t eq;
+  int i;
+  eq = 0;
+  if (key < 128) {
+    eq = fz->fz_peq[dir][key];
+  } else {
+    for (i = 0; i < fz->fz_cp_n && eq == 0; i++) {
+      if (fz->fz_cp[i] == key) {
+        eq = fz->fz_cp_peq[dir][i];
+      }
+    }
+  }
+  return eq;
+}
+
+// one column of the edit distance matrix in Myers' bit-vector form: *pv and *mv are the vertical +1 and -1 deltas,
+// returns the change of the last row; carry is the delta of the first row (0 to search, 1 for a fixed start)
+static int fz_step(uint64_t eq, uint64_t *pv, uint64_t *mv, uint64_t hb, uint64_t carry)
+{
+  uint64_t xv;
+  uint64_t xh;
+  uint64_t ph;
+  uint64_t mh;
+  int delta;
+  xv = eq | *mv;
+  xh = (((eq & *pv) + *pv) ^ *pv) | eq;
+  ph = *mv | ~(xh | *pv);
+  mh = *pv & xh;
+  delta = (ph & hb) != 0 ? 1 : (mh & hb) != 0 ? -1 : 0;
+  ph = ph << 1 | carry;
+  mh <<= 1;
+  *pv = mh | ~(xv | ph);
+  *mv = ph & xv;
+  return delta;
+}
+
+// compiles the (lower case when folding) search text for approximate matching with up to k edits;
+// an empty text or one longer than FZ_POS_MAX characters leaves *fz_ptr NULL
+static int fz_compile(struct Fuzzy **fz_ptr, const char *txt, int k, int fold, const char **err_str)
+{
+  int e;
+  int i;
+  int m;
+  int c;
+  int n;
+  uint32_t key;
+  const uint8_t *s;
+  struct Fuzzy *fz;
+  *fz_ptr = NULL;
+  s = (const uint8_t *)txt;
+  m = 0;
+  for (i = 0; s[i] != '\0'; i += fz_char(s + i, 0, &key)) {
+    m++;
   }
-  sw_free(&ms->imf.sw);
+  e = 0;
+  if (m > FZ_POS_MAX) {
+    *err_str = "The search text is too long for a fuzzy search (64 characters at most)";
+  } else if (m > 0) {
+    fz = malloc(sizeof(struct Fuzzy));
+    e = fz == NULL;
+    if (e == 0) {
+      memset(fz, 0, sizeof(struct Fuzzy));
+      fz->fz_m = m;
+      fz->fz_k = k < m ? k : m - 1;
+      fz->fz_fold = fold;
+      i = 0;
+      for (c = 0; c < m; c++) {
+        n = fz_char(s + i, 0, &key);
+        i += n;
+        if (key < 128) {
+          fz->fz_peq[0][key] |= (uint64_t)1 << c;
+          fz->fz_peq[1][key] |= (uint64_t)1 << (m - 1 - c);
+          if (fold != 0 && key >= 'a' && key <= 'z') {
+            fz->fz_peq[0][key - 0x20] |= (uint64_t)1 << c;
+            fz->fz_peq[1][key - 0x20] |= (uint64_t)1 << (m - 1 - c);
+          }
+        } else {
+          n = 0;
+          while (n < fz->fz_cp_n && fz->fz_cp[n] != key) {
+            n++;
+          }
+          fz->fz_cp[n] = key;
+          fz->fz_cp_n += n == fz->fz_cp_n;
+          fz->fz_cp_peq[0][n] |= (uint64_t)1 << c;
+          fz->fz_cp_peq[1][n] |= (uint64_t)1 << (m - 1 - c);
+        }
+      }
+      *fz_ptr = fz;
+    }
+  }
+  return e;
 }
 
-static void inds_free(struct IndentStr *inds)
+// the substring of str with the fewest edits (at most fz_k, by characters) from the pattern: the first end of the
+// closest matches in one forward scan, then its start in a backward scan anchored at that end
+static char *fz_find(const struct Fuzzy *fz, const char *str, int *len, int *dist)
 {
-  free(inds->str);
-  inds->str = NULL;
-  inds->size = 0;
-  inds->indent_n = -1;
+  const uint8_t *s;
+  uint64_t hb;
+  uint64_t mask;
+  uint64_t pv;
+  uint64_t mv;
+  uint32_t key;
+  int i;
+  int n;
+  int t;
+  int score;
+  int best;
+  int start;
+  int end;
+  s = (const uint8_t *)str;
+  hb = (uint64_t)1 << (fz->fz_m - 1);
+  mask = hb | (hb - 1);
+  pv = mask;
+  mv = 0;
+  score = fz->fz_m;
+  best = fz->fz_k + 1;
+  end = -1;
+  i = 0;
+  while (s[i] != '\0' && best > 0) {
+    n = fz_char(s + i, fz->fz_fold, &key);
+    i += n;
+    score += fz_step(fz_eq(fz, 0, key), &pv, &mv, hb, 0);
+    if (score < best) {
+      best = score;
+      end = i;
+    }
+  }
+  start = end;
+  if (end >= 0) {
+    pv = mask;
+    mv = 0;
+    score = fz->fz_m;
+    i = end;
+    t = 0;
+    while (i > 0 && t < fz->fz_m + best) {
+      i -= fz_char_back(s, i, fz->fz_fold, &key);
+      t++;
+      score += fz_step(fz_eq(fz, 1, key), &pv, &mv, hb, 1);
+      if (score <= best) {
+        start = i;
+      }
+    }
+    *len = end - start;
+    *dist = best;
+  }
+  return end >= 0 ? (char *)str + start : NULL;
 }
 
-static void wms_free(struct WebMemorySurfer *wms)
+// the first match in str, *dist is the number of edits it needs (0 but for SM_FUZZY)
+static char *mt_find(const struct Matcher *mt, const char *str, int *len, int *dist)
 {
-  int i;
-  free(wms->posted_message_digest);
-  wms->posted_message_digest = NULL;
-  free(wms->temp_filename);
-  wms->temp_filename = NULL;
-  inds_free(wms->inds);
-  free(wms->inds);
-  wms->inds = NULL;
-  free(wms->dyn_msg);
-  wms->dyn_msg = NULL;
-  free(wms->html_lp);
-  for (i = 0; i < wms->fl_c; i++) {
-    assert(wms->fl_v[i] != NULL);
-    free(wms->fl_v[i]);
+  char *found;
+  *dist = 0;
+  if (mt->mt_rx != NULL) {
+    found = rx_find(mt->mt_rx, str, len);
+  } else if (mt->mt_fz != NULL) {
+    found = fz_find(mt->mt_fz, str, len, dist);
+  } else {
+    found = str_match(str, mt->mt_txt, mt->mt_fold);
+    *len = mt->mt_len;
   }
-  free(wms->fl_v);
-  sa_free(&wms->qa_sa);
-  free(wms->dbg_lp);
-  free(wms->file_title_str);
-  ms_free(&wms->ms);
+  return found;
 }
 
-static int ms_create(struct MemorySurfer *ms, int flags_mask)
+// all matches in str in *span_lp (grown as needed), each searched after the end of the previous one, an empty one
+// a character further; a pattern anchored by ^ matches once at most
+static int mt_find_all(const struct Matcher *mt, const char *str, struct MatchSpan **span_lp, int *span_np)
 {
   int e;
-  size_t size;
-  assert(ms->imf_filename != NULL);
-  e = imf_create(&ms->imf, ms->imf_filename, flags_mask);
-  if (e == 0) {
-    e = imf_put(&ms->imf, SA_INDEX, "", 0);
-    if (e == 0) {
-      e = imf_put(&ms->imf, C_INDEX, "", 0);
-      if (e == 0) {
-        if (ms->passwd.pw_flag < 0) {
-          ms->passwd.pw_flag = 0;
-          assert(ms->passwd.timeout.to_sec == 0);
-          ms->passwd.timeout.to_sec = timeouts[1].to_sec;
-          assert(ms->passwd.timeout.to_count == 0);
-          ms->passwd.timeout.to_count = timeouts[1].to_count;
-        } else {
-          assert(ms->passwd.pw_flag == 1);
-        }
-        size = sizeof(struct Password);
-        e = imf_put(&ms->imf, PW_INDEX, &ms->passwd, size);
+  int len;
+  int dist;
+  int32_t off;
+  char *found;
+  struct MatchSpan *span_l;
+  e = 0;
+  *span_np = 0;
+  off = 0;
+  do {
+    found = mt_find(mt, str + off, &len, &dist);
+    if (found != NULL) {
+      if ((*span_np & (*span_np - 1)) == 0) { // 0, 1, 2, 4, ...
+        span_l = realloc(*span_lp, sizeof(struct MatchSpan) * (*span_np > 0 ? *span_np * 2 : 1));
+        e = span_l == NULL;
         if (e == 0) {
-          e = imf_sync(&ms->imf);
+          *span_lp = span_l;
         }
       }
+      if (e == 0) {
+        (*span_lp)[*span_np].span_off = found - str;
+        (*span_lp)[*span_np].span_len = len;
+        (*span_np)++;
+        off = found - str + (len > 0 ? len : utf8_char_len(found));
+      }
     }
-  }
+  } while (found != NULL && str[off] != '\0' && (mt->mt_rx == NULL || mt->mt_rx->rx_bol == 0) && e == 0);
   return e;
 }
 
-static int ms_get_card_sa(struct MemorySurfer *ms)
+static void mt_free(struct Matcher *mt)
+{
+  free(mt->mt_txt);
+  mt->mt_txt = NULL;
+  free(mt->mt_rx);
+  mt->mt_rx = NULL;
+  free(mt->mt_fz);
+  mt->mt_fz = NULL;
+}
+
+// the candidates of a fuzzy search: of fz_k + 1 pieces of the search text one at least is part of a match
+// unchanged, so a card has to be a candidate for one of the pieces
+static int ms_fuzzy_candidates(struct MemorySurfer *ms, const struct Fuzzy *fz, const char *txt, int32_t **cand_lp, int *cand_np)
 {
   int e;
-  e = ms->card_a > 0 && ms->card_l == NULL ? E_ARG_1 : 0;
-  if (e == 0 && ms->card_i != -1) {
-    e = ms->card_i >= 0 && ms->card_i < ms->card_a ? 0 : E_ASSRT_2;
+  int p;
+  int c;
+  int i;
+  int start;
+  int piece_n;
+  int32_t *piece_l;
+  int32_t *cand_l;
+  int cand_n;
+  int32_t *union_l;
+  int union_n;
+  int a;
+  int b;
+  uint32_t key;
+  char *piece;
+  cand_l = NULL;
+  cand_n = 0;
+  piece = malloc(strlen(txt) + 1);
+  e = piece == NULL;
+  i = 0;
+  c = 0;
+  for (p = 0; p <= fz->fz_k && cand_n >= 0 && e == 0; p++) {
+    start = i;
+    while (c < fz->fz_m * (p + 1) / (fz->fz_k + 1)) {
+      i += fz_char((const uint8_t *)txt + i, 0, &key);
+      c++;
+    }
+    memcpy(piece, txt + start, i - start);
+    piece[i - start] = '\0';
+    e = ms_search_candidates(ms, piece, &piece_l, &piece_n);
     if (e == 0) {
-      e = sa_load(&ms->card_sa, &ms->imf, ms->card_l[ms->card_i].card_qai);
+      if (piece_n < 0) {
+        free(cand_l);
+        cand_l = NULL;
+        cand_n = -1;
+      } else {
+        union_l = malloc(sizeof(int32_t) * (cand_n + piece_n + 1));
+        e = union_l == NULL;
+        if (e == 0) {
+          union_n = 0;
+          a = 0;
+          b = 0;
+          while (a < cand_n || b < piece_n) {
+            if (b == piece_n || (a < cand_n && cand_l[a] < piece_l[b])) {
+              union_l[union_n++] = cand_l[a++];
+            } else {
+              if (a < cand_n && cand_l[a] == piece_l[b]) {
+                a++;
+              }
+              union_l[union_n++] = piece_l[b++];
+            }
+          }
+          free(cand_l);
+          cand_l = union_l;
+          cand_n = union_n;
+        }
+      }
+      free(piece_l);
     }
   }
+  free(piece);
+  if (e == 0) {
+    *cand_lp = cand_l;
+    *cand_np = cand_n;
+  } else {
+    free(cand_l);
+  }
   return e;
 }
 
-static int ms_determine_heights(struct MemorySurfer *ms, int16_t *heights, int deck_i)
+// prepares the matcher for ms->search_txt and takes the candidates from the search index (*cand_np == -1 for all
+// cards, always so for regular expressions); an invalid pattern sets *err_str; the index is built if need be, as
+// search reads the visible text of HTML cards from it
+static int ms_prepare_search(struct MemorySurfer *ms, struct Matcher *mt, int32_t **cand_lp, int *cand_np, const char **err_str)
 {
-  int h_max;
-  int h_tmp;
-  h_max = 0;
-  if (ms->cat_t[deck_i].n_child != -1) {
-    h_tmp = ms_determine_heights(ms, heights, ms->cat_t[deck_i].n_child);
-    if (h_max < h_tmp + 1) {
-      h_max = h_tmp + 1;
+  int e;
+  size_t size;
+  mt->mt_txt = NULL;
+  mt->mt_rx = NULL;
+  mt->mt_fz = NULL;
+  mt->mt_fold = ms->match_case < 0;
+  *cand_lp = NULL;
+  *cand_np = -1;
+  e = 0;
+  if (ms->sidx_state < 0) {
+    e = ms_build_index(ms); // the visible text of the HTML cards with it
+  }
+  if (e == 0 && ms->search_txt == NULL) {
+    ms->search_txt = malloc(1);
+    e = ms->search_txt == NULL;
+    if (e == 0) {
+      ms->search_txt[0] = '\0';
     }
   }
-  heights[deck_i] = h_max;
-  if (ms->cat_t[deck_i].n_sibling != -1) {
-    h_tmp = ms_determine_heights(ms, heights, ms->cat_t[deck_i].n_sibling);
-    if (h_max < h_tmp) {
-      h_max = h_tmp;
+  if (e == 0) {
+    size = strlen(ms->search_txt) + 1;
+    mt->mt_txt = malloc(size);
+    e = mt->mt_txt == NULL;
+    if (e == 0) {
+      strcpy(mt->mt_txt, ms->search_txt);
+      mt->mt_len = size - 1;
+      if (ms->search_mode == SM_REGEX) {
+        e = rx_compile(&mt->mt_rx, ms->search_txt, mt->mt_fold, err_str);
+      } else {
+        if (mt->mt_fold != 0) {
+          str_tolower(mt->mt_txt);
+        }
+        if (ms->search_mode == SM_FUZZY) {
+          e = fz_compile(&mt->mt_fz, mt->mt_txt, ms->search_dist > 0 ? ms->search_dist : 1, mt->mt_fold, err_str);
+        }
+        if (e == 0 && *err_str == NULL) {
+          if (mt->mt_fz != NULL) {
+            e = ms_fuzzy_candidates(ms, mt->mt_fz, mt->mt_txt, cand_lp, cand_np);
+          } else {
+            e = ms_search_candidates(ms, mt->mt_txt, cand_lp, cand_np);
+          }
+        }
+      }
     }
   }
-  return h_max;
+  return e;
 }
 
-static int ms_determine_card(struct MemorySurfer *ms)
+// writes "/root/.../deck" to *path_lp, which is grown as needed
+static int ms_deck_path(struct MemorySurfer *ms, int deck_i, char **path_lp, size_t *path_z)
 {
   int e;
-  int deck_i;
-  int32_t data_size;
-  time_t time_diff;
-  int32_t card_strength_thr; // threshold
-  double retent; // retention
-  double reten_state[4];
-  time_t state_time_diff[4];
-  int sel_card[4]; // selected
-  int sel_deck[4];
-  enum CardState card_state;
-  int card_i;
-  int16_t *heights;
-  int h_max;
-  int h;
+  int j;
+  int rv;
+  size_t len;
   size_t size;
+  int16_t *n_path;
+  char *str;
   size = sizeof(int16_t) * ms->deck_a;
-  heights = malloc(size);
-  e = heights == NULL;
+  n_path = malloc(size);
+  e = n_path == NULL;
   if (e == 0) {
-    h_max = ms_determine_heights(ms, heights, ms->n_first);
-    assert(ms->timestamp >= 0);
-    card_strength_thr = lvl_s[20];
-    ms->cards_nel = 0;
-    for (card_state = 0; card_state <= STATE_SUSPENDED; card_state++) {
-      reten_state[card_state] = 1.0;
-      state_time_diff[card_state] = INT32_MAX;
-      sel_card[card_state] = -1;
-      sel_deck[card_state] = -1;
-    }
-    for (h = 0; h <= h_max && (sel_card[STATE_SCHEDULED] == -1 || (sel_card[STATE_SCHEDULED] != -1 && card_strength_thr > lvl_s[ms->passwd.rank])) && sel_card[STATE_NEW] == -1 && sel_card[STATE_SUSPENDED] == -1; h++) {
-      for (deck_i = 0; deck_i < ms->deck_a && e == 0; deck_i++) {
-        if (ms->cat_t[deck_i].deck_slot_used == 1 && ms->cat_t[deck_i].deck_on != 0 && heights[deck_i] == h) {
-          data_size = imf_get_size(&ms->imf, ms->cat_t[deck_i].cat_cli);
-          if (data_size > 0) {
-            ms->card_l = realloc(ms->card_l, data_size);
-            e = ms->card_l == NULL;
+    j = 0;
+    while (deck_i != -1) {
+      n_path[j] = deck_i;
+      deck_i = ms->topo_l[deck_i].dt_parent;
+      j++;
+    }
+    len = 0;
+    while (j-- > 0 && e == 0) {
+      str = sa_get(&ms->deck_sa, n_path[j]);
+      do {
+        size = 0;
+        rv = snprintf(*path_lp + len, *path_z - len, "/%s", str);
+        e = rv < 0;
+        if (e == 0) {
+          if (rv >= *path_z - len) {
+            size = len + rv + 1;
+            *path_lp = realloc(*path_lp, size);
+            e = *path_lp == NULL;
             if (e == 0) {
-              e = imf_get(&ms->imf, ms->cat_t[deck_i].cat_cli, ms->card_l);
-              if (e == 0) {
-                ms->card_a = data_size / sizeof(struct Card);
-                assert(ms->card_a > 0);
-                for (card_i = 0; card_i < ms->card_a && e == 0; card_i++) {
-                  time_diff = ms->timestamp - ms->card_l[card_i].card_time;
-                  retent = exp(-(double)time_diff / ms->card_l[card_i].card_strength);
-                  card_state = ms->card_l[card_i].card_state & 0x07;
-                  switch (card_state) {
-                  case STATE_SCHEDULED:
-                    if (retent <= 1 / M_E) {
-                      ms->cards_nel++;
-                      if (ms->card_l[card_i].card_strength <= card_strength_thr) {
-                        if (card_strength_thr > lvl_s[ms->passwd.rank]) {
-                          if (ms->card_l[card_i].card_strength <= lvl_s[ms->passwd.rank]) {
-                            card_strength_thr = lvl_s[ms->passwd.rank];
-                            reten_state[STATE_SCHEDULED] = 1.0;
-                          }
-                        }
-                        if (retent < reten_state[STATE_SCHEDULED] || (retent == reten_state[STATE_SCHEDULED] && time_diff > state_time_diff[STATE_SCHEDULED])) {
-                          reten_state[STATE_SCHEDULED] = retent;
-                          state_time_diff[STATE_SCHEDULED] = time_diff;
-                          sel_card[STATE_SCHEDULED] = card_i;
-                          sel_deck[card_state] = deck_i;
-                        }
-                      }
-                    }
-                    break;
-                  case STATE_ALARM:
-                  case STATE_NEW:
-                  case STATE_SUSPENDED:
-                    if (retent < reten_state[card_state]) {
-                      reten_state[card_state] = retent;
-                      sel_card[card_state] = card_i;
-                      sel_deck[card_state] = deck_i;
-                    }
-                    break;
-                  default:
-                    e = E_DETECA;
-                  }
-                }
-              }
+              *path_z = size;
             }
+          } else {
+            len += rv;
           }
         }
-      }
-    }
-    if (e == 0) {
-      if (sel_card[STATE_SCHEDULED] != -1 && card_strength_thr == lvl_s[ms->passwd.rank]) {
-        ms->card_i = sel_card[STATE_SCHEDULED];
-        ms->deck_i = sel_deck[STATE_SCHEDULED];
-      } else if (sel_card[STATE_NEW] != -1) {
-        ms->card_i = sel_card[STATE_NEW];
-        ms->deck_i = sel_deck[STATE_NEW];
-      } else if (sel_card[STATE_SCHEDULED] != -1) {
-        ms->card_i = sel_card[STATE_SCHEDULED];
-        ms->deck_i = sel_deck[STATE_SCHEDULED];
-      } else if (sel_card[STATE_SUSPENDED] != -1) {
-        ms->card_i = sel_card[STATE_SUSPENDED];
-        ms->deck_i = sel_deck[STATE_SUSPENDED];
-      } else {
-        e = -1;
-      }
+      } while (e == 0 && size != 0);
     }
+    free(n_path);
   }
   return e;
 }
 
-static int sa_cmp(struct StringArray *sa_ls, struct StringArray *sa_rs)
+static int hit_pos_cmp(const void *ls, const void *rs)
 {
-  int is_equal;
-  int i;
-  int j;
-  int n;
-  char ch_ls; // left side
-  char ch_rs; // right
-  n = sa_ls->sa_c;
-  is_equal = n == sa_rs->sa_c ? 1 : -1;
-  if (is_equal == 1) {
-    i = 0;
-    j = 0;
-    while (i < n && is_equal == 1) {
-      do {
-        ch_ls = sa_ls->sa_d[j];
-        ch_rs = sa_rs->sa_d[j];
-        is_equal = ch_ls == ch_rs;
-        j++;
-      } while (is_equal == 1 && ch_ls != '\0');
-      i++;
-    }
+  const struct SearchHit *hit_ls = ls;
+  const struct SearchHit *hit_rs = rs;
+  return hit_ls->sh_pos < hit_rs->sh_pos ? -1 : hit_ls->sh_pos > hit_rs->sh_pos;
+}
+
+static int hit_rank_cmp(const void *ls, const void *rs)
+{
+  const struct SearchHit *hit_ls = ls;
+  const struct SearchHit *hit_rs = rs;
+  int cmp;
+  cmp = hit_ls->sh_dist - hit_rs->sh_dist;
+  if (cmp == 0) {
+    cmp = hit_ls->sh_rank - hit_rs->sh_rank;
   }
-  return is_equal;
+  if (cmp == 0) {
+    cmp = hit_ls->sh_card_i - hit_rs->sh_card_i;
+  }
+  return cmp;
 }
 
-static void sa_move(struct StringArray *sa_dest, struct StringArray *sa_src)
+// matches a range of candidates, sets sh_field and sh_off of the cards that contain the search text (the closer
+// field for a fuzzy search)
+static void *match_hits(void *arg)
 {
-  free (sa_dest->sa_d);
-  sa_dest->sa_d = sa_src->sa_d;
-  sa_src->sa_d = NULL;
-  sa_dest->sa_c = sa_src->sa_c;
-  sa_src->sa_c = 0;
-  sa_dest->sa_n = sa_src->sa_n;
-  sa_src->sa_n = 0;
+  struct SearchWork *work;
+  struct StringArray sa;
+  struct SearchHit *hit;
+  int i;
+  int k;
+  int len;
+  int dist;
+  char *str;
+  char *found;
+  work = arg;
+  sa_init(&sa);
+  work->e = 0;
+  for (i = 0; i < work->hit_n && work->e == 0; i++) {
+    hit = work->hit_l + i;
+    work->e = sa_fetch(&sa, work->imf, hit->sh_qai, 1);
+    for (k = 0; k < 2 && (hit->sh_field < 0 || hit->sh_dist > 0) && work->e == 0; k++) {
+      str = sa_get(&sa, k);
+      work->e = str == NULL;
+      if (work->e == 0) {
+        found = mt_find(work->mt, str, &len, &dist);
+        if (found != NULL && (hit->sh_field < 0 || dist < hit->sh_dist)) {
+          hit->sh_field = k;
+          hit->sh_off = found - str;
+          hit->sh_len = len;
+          hit->sh_dist = dist;
+        }
+      }
+    }
+  }
+  sa_free(&sa);
+  return NULL;
 }
 
-static int ms_modify_qa(struct StringArray *sa, struct MemorySurfer *ms, int *need_sync)
+// collects every card of the scope that contains the search text: the candidate cards are read once, in the order
+// of their chunk positions (split into contiguous ranges for up to SH_THREADS workers), the hits are returned by
+// edits (fuzzy search), in deck preorder and card order
+static int ms_search_list(struct MemorySurfer *ms, const struct Matcher *mt, int32_t *cand_l, int cand_n, struct SearchHit **hit_lp, int *hit_np)
 {
   int e;
-  int is_equal;
+  int deck_i;
+  int card_i;
+  int card_a;
+  int hit_n;
+  int hit_a;
+  int i;
+  int j;
+  int work_n;
+  int thread_n;
+  long cpu_n;
   int32_t data_size;
-  e = need_sync == NULL ? E_ARG_2 : 0;
-  if (e == 0) {
-    is_equal = sa_cmp(sa, &ms->card_sa);
-    if (is_equal == 0) {
-      sa_move(&ms->card_sa, sa);
-      data_size = sa_length(&ms->card_sa);
-      e = imf_put(&ms->imf, ms->card_l[ms->card_i].card_qai, ms->card_sa.sa_d, data_size);
-      *need_sync = 1;
+  struct Card *card_l;
+  struct Card *card_ptr;
+  struct SearchHit *hit_l;
+  struct SearchHit *hit_ptr;
+  struct SearchWork work_l[SH_THREADS];
+  pthread_t thread_l[SH_THREADS];
+  assert(*hit_lp == NULL && *hit_np == 0);
+  e = 0;
+  card_l = NULL;
+  hit_l = NULL;
+  hit_n = 0;
+  hit_a = 0;
+  for (deck_i = 0; deck_i < ms->deck_a && e == 0; deck_i++) {
+    if (ms->cat_t[deck_i].deck_slot_used != 0 && (ms->scope == C_ALL || deck_i == ms->deck_i)) {
+      data_size = imf_get_size(&ms->imf, ms->cat_t[deck_i].cat_cli);
+      e = data_size < 0;
+      if (e == 0 && data_size > 0) {
+        card_ptr = realloc(card_l, data_size);
+        e = card_ptr == NULL;
+        if (e == 0) {
+          card_l = card_ptr;
+          e = imf_get(&ms->imf, ms->cat_t[deck_i].cat_cli, card_l);
+        }
+        card_a = data_size / sizeof(struct Card);
+        for (card_i = 0; card_i < card_a && e == 0; card_i++) {
+          if (ms_is_candidate(cand_l, cand_n, card_l[card_i].card_qai) != 0) {
+            if (hit_n == hit_a) {
+              hit_a = hit_a * 2 + 64;
+              hit_ptr = realloc(hit_l, sizeof(struct SearchHit) * hit_a);
+              e = hit_ptr == NULL;
+              if (e == 0) {
+                hit_l = hit_ptr;
+              }
+            }
+            if (e == 0) {
+              e = ms_text_index(ms, card_l[card_i].card_qai, card_l[card_i].card_state & 0x08, &hit_l[hit_n].sh_qai);
+            }
+            if (e == 0) {
+              hit_l[hit_n].sh_pos = ms->imf.chunks[hit_l[hit_n].sh_qai].position;
+              hit_l[hit_n].sh_card_i = card_i;
+              hit_l[hit_n].sh_deck_i = deck_i;
+              hit_l[hit_n].sh_rank = ms->topo_l[deck_i].dt_rank;
+              hit_l[hit_n].sh_field = -1;
+              hit_l[hit_n].sh_off = -1;
+              hit_l[hit_n].sh_len = 0;
+              hit_l[hit_n].sh_dist = 0;
+              hit_l[hit_n].sh_path = NULL;
+              hit_l[hit_n].sh_text = NULL;
+              hit_n++;
+            }
+          }
+        }
+      }
     }
   }
+  free(card_l);
+  if (e == 0 && hit_n > 0) {
+    qsort(hit_l, hit_n, sizeof(struct SearchHit), hit_pos_cmp);
+    cpu_n = sysconf(_SC_NPROCESSORS_ONLN);
+    work_n = hit_n / SH_WORK_MIN;
+    if (work_n > cpu_n) {
+      work_n = cpu_n;
+    }
+    if (work_n > SH_THREADS) {
+      work_n = SH_THREADS;
+    }
+    if (work_n < 1) {
+      work_n = 1;
+    }
+    j = 0;
+    for (i = 0; i < work_n; i++) {
+      work_l[i].imf = &ms->imf;
+      work_l[i].mt = mt;
+      work_l[i].hit_l = hit_l + j;
+      work_l[i].hit_n = (hit_n - j) / (work_n - i);
+      work_l[i].e = -1;
+      j += work_l[i].hit_n;
+    }
+    thread_n = 1;
+    while (thread_n < work_n && pthread_create(thread_l + thread_n, NULL, match_hits, work_l + thread_n) == 0) {
+      thread_n++;
+    }
+    for (i = thread_n; i < work_n; i++) {
+      match_hits(work_l + i); // no thread
+    }
+    match_hits(work_l);
+    for (i = 1; i < thread_n; i++) {
+      pthread_join(thread_l[i], NULL);
+    }
+    for (i = 0; i < work_n && e == 0; i++) {
+      e = work_l[i].e;
+    }
+    ms->imf.stat_gets += hit_n;
+    if (e == 0) {
+      j = 0;
+      for (i = 0; i < hit_n; i++) {
+        if (hit_l[i].sh_field >= 0) {
+          hit_l[j++] = hit_l[i];
+        }
+      }
+      hit_n = j;
+      qsort(hit_l, hit_n, sizeof(struct SearchHit), hit_rank_cmp);
+    }
+  }
+  if (e == 0) {
+    *hit_lp = hit_l;
+    *hit_np = hit_n;
+  } else {
+    free(hit_l);
+  }
   return e;
 }
 
-static int ms_load_card_list(struct MemorySurfer *ms)
+// the text around a hit, cut at character boundaries, as three strings: before, match and after
+// resolves the chunk of a posted hit, E_HIT when its card is gone
+static int ms_hit_chunk(struct MemorySurfer *ms, struct SearchHit *hit)
 {
   int e;
   int32_t data_size;
-  assert(ms->deck_i >= 0 && ms->deck_i < ms->deck_a && ms->cat_t[ms->deck_i].deck_slot_used != 0);
-  assert((ms->card_a == 0 && ms->card_l == NULL) || (ms->card_a > 0 && ms->card_l != NULL));
-  data_size = imf_get_size(&ms->imf, ms->cat_t[ms->deck_i].cat_cli);
-  e = data_size < 0;
+  struct Card *card_l;
+  e = hit->sh_deck_i < ms->deck_a && ms->cat_t[hit->sh_deck_i].deck_slot_used != 0 ? 0 : E_HIT;
   if (e == 0) {
-    if (data_size > 0) {
-      ms->card_l = realloc(ms->card_l, data_size);
-      e = ms->card_l == NULL;
+    data_size = imf_get_size(&ms->imf, ms->cat_t[hit->sh_deck_i].cat_cli);
+    e = data_size < 0 || hit->sh_card_i >= data_size / (int32_t)sizeof(struct Card) ? E_HIT : 0;
+  }
+  if (e == 0) {
+    card_l = malloc(data_size);
+    e = card_l == NULL;
+    if (e == 0) {
+      e = imf_get(&ms->imf, ms->cat_t[hit->sh_deck_i].cat_cli, card_l);
       if (e == 0) {
-        e = imf_get(&ms->imf, ms->cat_t[ms->deck_i].cat_cli, ms->card_l);
+        e = ms_text_index(ms, card_l[hit->sh_card_i].card_qai, card_l[hit->sh_card_i].card_state & 0x08, &hit->sh_qai);
       }
-    } else {
-      free(ms->card_l);
-      ms->card_l = NULL;
+      free(card_l);
     }
   }
-  if (e == 0) {
-    ms->card_a = data_size / sizeof(struct Card);
-  }
   return e;
 }
 
-static void str_tolower(char *str)
+static int ms_hit_snippet(struct MemorySurfer *ms, struct SearchHit *hit)
 {
-  int i;
-  char ch;
-  static uint8_t map[256] = {
-    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
-    0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f,
-    0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f,
-    0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0x3e, 0x3f,
-    0x40, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x6b, 0x6c, 0x6d, 0x6e, 0x6f, // A - O
-    0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x5b, 0x5c, 0x5d, 0x5e, 0x5f, // P - Z
-    0x60, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x6b, 0x6c, 0x6d, 0x6e, 0x6f,
-    0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x7b, 0x7c, 0x7d, 0x7e, 0x7f,
-    0x80, 0x81, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x8b, 0x8c, 0x8d, 0x8e, 0x8f,
-    0x90, 0x91, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0x9b, 0x9c, 0x9d, 0x9e, 0x9f,
-    0xa0, 0xa1, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xab, 0xac, 0xad, 0xae, 0xaf,
-    0xb0, 0xb1, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xbb, 0xbc, 0xbd, 0xbe, 0xbf,
-    0xc0, 0xc1, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xcb, 0xcc, 0xcd, 0xce, 0xcf,
-    0xd0, 0xd1, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xdb, 0xdc, 0xdd, 0xde, 0xdf,
-    0xe0, 0xe1, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xeb, 0xec, 0xed, 0xee, 0xef,
-    0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff };
-  assert (str != NULL);
-  i = 0;
-  while (ch = str[i], ch != '\0')
-  {
-    str[i++] = map[(uint8_t)ch];
+  int e;
+  struct StringArray sa;
+  char *str;
+  size_t len;
+  size_t start;
+  size_t end;
+  size_t stop;
+  size_t match_len;
+  assert(hit->sh_field >= 0 && hit->sh_text == NULL);
+  match_len = hit->sh_len;
+  sa_init(&sa);
+  e = sa_load(&sa, &ms->imf, hit->sh_qai);
+  if (e == 0) {
+    str = sa_get(&sa, hit->sh_field);
+    e = str == NULL;
+    if (e == 0) {
+      len = strlen(str);
+      end = hit->sh_off + match_len;
+      e = end > len ? E_ASSRT_5 : 0;
+      if (e == 0) {
+        start = hit->sh_off > SH_CONTEXT ? hit->sh_off - SH_CONTEXT : 0;
+        while (start > 0 && ((uint8_t)str[start] & 0xc0) == 0x80) {
+          start--;
+        }
+        stop = end + SH_CONTEXT < len ? end + SH_CONTEXT : len;
+        while (stop < len && ((uint8_t)str[stop] & 0xc0) == 0x80) {
+          stop++;
+        }
+        hit->sh_text = malloc(stop - start + 3);
+        e = hit->sh_text == NULL;
+        if (e == 0) {
+          len = hit->sh_off - start;
+          memcpy(hit->sh_text, str + start, len);
+          hit->sh_text[len] = '\0';
+          memcpy(hit->sh_text + len + 1, str + hit->sh_off, match_len);
+          hit->sh_text[len + 1 + match_len] = '\0';
+          memcpy(hit->sh_text + len + 2 + match_len, str + end, stop - end);
+          hit->sh_text[stop - start + 2] = '\0';
+        }
+      }
+    }
   }
+  sa_free(&sa);
+  return e;
 }
 
 static int ms_close(struct MemorySurfer *ms)
@@ -4687,6 +9962,17 @@ static int ms_close(struct MemorySurfer *ms)
     ms->cat_t = NULL;
     ms->deck_a = 0;
     ms->n_first = -1;
+    free(ms->topo_l);
+    ms->topo_l = NULL;
+    ms->topo_h = -1;
+    free(ms->dsum_l);
+    ms->dsum_l = NULL;
+    ms->dsum_a = -1;
+    ms->dsum_mod = 0;
+    ms->sq.sq_n = -1;
+    ms->sq_mod = 0;
+    ms->sq_fill = 0;
+    ms_free_index(ms);
   }
   return e;
 }
@@ -4728,59 +10014,6 @@ static void e2str(int e, char *e_str)
   }
 }
 
-static size_t utf8_char_len(const char *s)
-{
-  size_t len;
-  const uint8_t *b;
-  b = (const uint8_t *)s;
-  if ((*b & 0x80) == 0)
-    len = 1;
-  else if ((*b & 0xE0) == 0xC0)
-    len = 2;
-  else if ((*b & 0xF0) == 0xE0)
-    len = 3;
-  else if ((*b & 0xF8) == 0xF0)
-    len = 4;
-  else
-    len = 0;
-  return len;
-}
-
-static int utf8_strcspn(const char *s, const char *reject, size_t *n)
-{
-  int e;
-  size_t len;
-  int i;
-  int j;
-  int found;
-  e = s == NULL || reject == NULL || n == NULL;
-  if (e == 0) {
-    *n = 0;
-    do {
-      i = 0;
-      do {
-        len = utf8_char_len(reject + i);
-        e = len == 0;
-        if (e == 0) {
-          j = 0;
-          found = 1;
-          while (s[*n + j] != '\0' && j < len && found == 1) {
-            found = s[*n + j] == reject[i + j];
-            j++;
-          }
-          if (reject[i] != '\0')
-            i += len;
-          else
-            found = -1;
-        }
-      } while (found == 0 && e == 0);
-      if (found <= 0)
-        ++*n;
-    } while (found <= 0 && e == 0);
-  }
-  return e;
-}
-
 int main(int argc, char *argv[])
 {
   int e; // error
@@ -4798,7 +10031,10 @@ int main(int argc, char *argv[])
   char *a_str;
   int search_deck_i;
   int search_card_i;
-  char *lwr_search_txt; // lower case
+  struct Matcher mt;
+  struct StringArray *sa_ptr;
+  int32_t *cand_l; // search candidates
+  int cand_n;
   struct stat file_stat;
   int mtime_test;
   int act_i; // action index
@@ -4817,11 +10053,13 @@ int main(int argc, char *argv[])
   char *str;
   struct Sha1Context sha1;
   uint8_t message_digest[SHA1_HASH_SIZE];
+  struct SnapBase sb_l[2]; // the base recorded and the state of the file
   uint32_t mod_time;
   int deck_a;
   int16_t n_parent;
   int16_t n_prev;
-  int16_t *n_path;
+  struct DeckTopology *dt_ptr;
+  int16_t rank;
   struct Card card;
   int32_t index;
   struct Card *mov_card_l;
@@ -4833,7 +10071,6 @@ int main(int argc, char *argv[])
   char e_str[11]; // E_AAAAAA-1 + '\0'
   struct tm bd_time; // broken-down
   int need_sync;
-  FILE *temp_stream;
   struct XML *xml;
   do {
     e = MACRO_TO_CALL_FCGI_ACCEPT < 0;
@@ -5032,19 +10269,8 @@ int main(int argc, char *argv[])
                 break;
               case A_READ_PASSWD:
                 if (wms->ms.imf_filename != NULL) {
-                  assert(wms->ms.passwd.pw_flag == -1 && wms->ms.passwd.version == 0 && wms->ms.passwd.style_sai == -1);
-                  data_size = imf_get_size(&wms->ms.imf, PW_INDEX);
-                  e = data_size != 23 && data_size != 32 && data_size != 36 && data_size != sizeof(struct Password);
-                  if (e == 0) {
-                    e = imf_get(&wms->ms.imf, PW_INDEX, &wms->ms.passwd);
-                    if (e == 0) {
-                      if (data_size == 23 || data_size == 32 || data_size == 36) {
-                        wms->ms.passwd.version = 0x01000000;
-                        wms->ms.passwd.mctr = 0;
-                        wms->ms.passwd.rank = 4;
-                      }
-                    }
-                  } else {
+                  e = ms_read_passwd(&wms->ms);
+                  if (e == E_PASSWD) {
                     free(wms->file_title_str);
                     wms->file_title_str = NULL;
                     wms->msg_header = "Read of password hash failed";
@@ -5276,6 +10502,8 @@ int main(int argc, char *argv[])
                         wms->msg_static = "Please select a deck to search";
                       } else if (wms->seq == S_DECKS_RENAME) {
                         wms->msg_static = "Please select a deck to rename";
+                      } else if (wms->seq == S_MERGE) {
+                        wms->msg_static = "Please select a deck to merge into";
                       } else {
                         e = E_DECK_4;
                       }
@@ -5387,60 +10615,124 @@ int main(int argc, char *argv[])
                 wms->page = P_UPLOAD;
                 break;
               case A_UPLOAD_REPORT:
-                if (wms->posted_message_digest != NULL) {
-                  e = sha1_reset(&sha1);
-                  if (e == 0) {
-                    temp_stream = fopen(wms->temp_filename, "r");
-                    e = temp_stream == NULL;
-                    if (e == 0) {
-                      do {
-                        len = fread(wms->html_lp, 1, wms->html_n, temp_stream);
-                        e = len == 0 && ferror(temp_stream) != 0;
-                        if (len > 0 && e == 0) {
-                          e = sha1_input(&sha1, (uint8_t*)wms->html_lp, len);
-                        }
-                      } while (feof(temp_stream) == 0 && e == 0);
-                      if (e == 0) {
-                        e = sha1_result(&sha1, message_digest);
-                        if (e == 0) {
-                          e = memcmp(wms->posted_message_digest, message_digest, 20) != 0 ? E_MISMA : 0;
-                        }
-                      }
-                      rv = fclose(temp_stream);
-                      if (e == 0) {
-                        e = rv != 0 ? E_SHA : 0;
-                      }
-                    }
-                  }
+                e = wms->upload_d == NULL;
+                if (e == 0 && wms->posted_message_digest != NULL) {
+                  e = memcmp(wms->posted_message_digest, wms->upload_digest, SHA1_HASH_SIZE) != 0 ? E_MISMA : 0;
                 }
                 if (e == 0) {
-                  e = wms->ms.n_first == -1 ? 0 : E_UPLOAD_1; // file not empty
+                  if (wms->seq == S_MERGE_REPORT) {
+                    e = snap_kind(wms->upload_d, wms->upload_n) != 0 ? E_UPLOAD_2 : 0; // only XML is merged
+                  } else {
+                    e = wms->ms.n_first == -1 || snap_kind(wms->upload_d, wms->upload_n) == 2 ? 0 : E_UPLOAD_1; // file not empty (a delta applies to its base)
+                  }
                   if (e == 0) {
                     size = sizeof(struct XML);
                     xml = malloc(size);
                     e = xml == NULL;
                     if (e == 0) {
-                      xml->n = 0;
                       xml->p_lineptr = NULL;
+                      xml->xml_buf = wms->upload_d;
+                      xml->xml_len = wms->upload_n;
+                      xml->xml_pos = 0;
+                      xml->xml_held = -1;
                       xml->cardlist_l = NULL;
+                      xml->cardlist_a = 0;
+                      xml_stage_init(xml);
                       xml->prev_cat_i = -1;
-                      xml->xml_stream = fopen(wms->temp_filename, "r");
-                      e = xml->xml_stream == NULL;
+                      xml->base = NULL;
+                      xml->old_cat_t = NULL;
+                      xml->old_deck_a = 0;
+                      xml->ref_l = NULL;
+                      xml->snap_idf = 0;
+                      xml->dup = NULL;
+                      xml->dup_n = 0;
+                      xml->fold_n = 0;
+                      sb_l[0].sb_d = NULL;
+                      sb_l[1].sb_d = NULL;
+                      wms->card_n = 0;
+                      wms->deck_n = 0;
+                      if (snap_kind(wms->upload_d, wms->upload_n) == 2) {
+                        e = ms_load_base(&wms->ms, sb_l + 0);
+                        if (e == 0) {
+                          e = ms_build_base(&wms->ms, sb_l + 1);
+                        }
+                        if (e == 0) { // the file must not have been modified since its base was recorded
+                          e = sb_l[0].sb_n != sb_l[1].sb_n || memcmp(sb_l[0].sb_d + SHA1_HASH_SIZE, sb_l[1].sb_d + SHA1_HASH_SIZE, sb_l[0].sb_n - SHA1_HASH_SIZE) != 0 ? E_BASE : 0;
+                        }
+                        base_free(sb_l + 1);
+                        if (e == 0) {
+                          xml->base = sb_l + 0;
+                          xml->ref_l = calloc(sb_l[0].sb_head->bh_card_n + 1, sizeof(int8_t));
+                          e = xml->ref_l == NULL;
+                        }
+                        if (e == 0) {
+                          wms->ms.sidx_state = -1; // rebuilt by the next search
+                          e = snap_load(xml, wms);
+                        }
+                      } else if (wms->seq == S_MERGE_REPORT) { // under the selected deck, the cards of the file skipped
+                        e = ms_build_base(&wms->ms, sb_l + 1);
+                        if (e == 0) {
+                          qsort(sb_l[1].sb_card_l, sb_l[1].sb_head->bh_card_n, sizeof(struct BaseCard), bc_cmp);
+                          xml->dup = sb_l + 1;
+                          xml->cardlist_l = calloc(wms->ms.deck_a, sizeof(struct CardList));
+                          e = xml->cardlist_l == NULL;
+                        }
+                        if (e == 0) {
+                          xml->cardlist_a = wms->ms.deck_a;
+                          size = sizeof(struct Deck) * wms->ms.deck_a;
+                          xml->old_cat_t = malloc(size);
+                          e = xml->old_cat_t == NULL;
+                        }
+                        if (e == 0) {
+                          memcpy(xml->old_cat_t, wms->ms.cat_t, size);
+                          xml->old_deck_a = wms->ms.deck_a;
+                          deck_i = wms->ms.cat_t[wms->ms.deck_i].n_child;
+                          while (deck_i != -1) {
+                            xml->prev_cat_i = deck_i;
+                            deck_i = wms->ms.cat_t[deck_i].n_sibling;
+                          }
+                          e = parse_xml(xml, wms, TAG_ROOT, wms->ms.deck_i);
+                        }
+                        if (e == 0) {
+                          e = merge_fold(xml, &wms->ms, wms->ms.deck_i);
+                        }
+                      } else {
+                        e = ms_clear_index(&wms->ms); // the cards are indexed as they are imported
+                        if (e == 0) {
+                          if (snap_kind(wms->upload_d, wms->upload_n) == 1) {
+                            e = snap_load(xml, wms);
+                          } else {
+                            e = parse_xml(xml, wms, TAG_ROOT, -1);
+                          }
+                        }
+                      }
                       if (e == 0) {
-                        wms->card_n = 0;
-                        wms->deck_n = 0;
-                        e = parse_xml(xml, wms, TAG_ROOT, -1);
-                        rv = fclose(xml->xml_stream);
+                        e = xml_store(xml, &wms->ms);
+                        wms->card_n -= xml->dup_n;
+                        wms->deck_n -= xml->fold_n;
+                      }
+                      if (e == 0 && (xml->base != NULL || xml->dup != NULL)) {
+                        e = snap_prune(xml, &wms->ms);
+                      }
+                      if (e == 0 && xml->snap_idf != 0) { // the imported state is the base of the next delta
+                        e = ms_build_base(&wms->ms, sb_l + 1);
                         if (e == 0) {
-                          e = rv;
+                          memcpy(sb_l[1].sb_head->bh_id, xml->snap_id, SHA1_HASH_SIZE);
+                          e = ms_store_base(&wms->ms, sb_l + 1);
                         }
-                        xml->xml_stream = NULL;
+                      }
+                      base_free(sb_l + 0);
+                      base_free(sb_l + 1);
+                      free(xml->old_cat_t);
+                      free(xml->ref_l);
+                      for (i = 0; i < xml->cardlist_a; i++) {
+                        free(xml->cardlist_l[i].card_l);
                       }
                       free(xml->cardlist_l);
                       xml->cardlist_l = NULL;
-                      free(xml->p_lineptr);
+                      xml_stage_free(xml);
+                      xml->xml_buf = NULL; // wms->upload_d
                       xml->p_lineptr = NULL;
-                      xml->n = 0;
                       free(xml);
                       xml = NULL;
                     }
@@ -5453,10 +10745,14 @@ int main(int argc, char *argv[])
                     data_size = sizeof(struct Deck) * wms->ms.deck_a;
                     e = imf_put(&wms->ms.imf, C_INDEX, wms->ms.cat_t, data_size);
                     if (e == 0) {
-                      assert(wms->ms.passwd.style_sai == -1);
+                      e = ms_build_topology(&wms->ms);
+                    }
+                    if (e == 0) {
                       data_size = sa_length(&wms->ms.style_sa);
-                      if (data_size > 0) {
-                        e = imf_seek_unused(&wms->ms.imf, &wms->ms.passwd.style_sai);
+                      if (data_size > 0 || wms->ms.passwd.style_sai >= 0) { // set, or replaced by a delta
+                        if (wms->ms.passwd.style_sai < 0) {
+                          e = imf_seek_unused(&wms->ms.imf, &wms->ms.passwd.style_sai);
+                        }
                         if (e == 0) {
                           e = imf_put(&wms->ms.imf, wms->ms.passwd.style_sai, wms->ms.style_sa.sa_d, data_size);
                         }
@@ -5512,54 +10808,7 @@ int main(int argc, char *argv[])
                 }
                 break;
               case A_DECK_PATH:
-                size = sizeof(int16_t) * wms->ms.deck_a;
-                n_path = malloc(size);
-                e = n_path == NULL;
-                if (e == 0) {
-                  deck_i = wms->ms.deck_i;
-                  j = 0;
-                  while (deck_i != -1) {
-                    n_path[j] = deck_i;
-                    n_prev = -1;
-                    n_parent = -1;
-                    do {
-                      for (i = 0; i < wms->ms.deck_a && n_parent == -1; i++) {
-                        if (wms->ms.cat_t[i].deck_slot_used != 0) {
-                          if ((n_prev == -1 && wms->ms.cat_t[i].n_sibling == deck_i) || (n_prev != -1 && wms->ms.cat_t[i].n_sibling == n_prev)) {
-                            n_prev = i;
-                          }
-                          if (wms->ms.cat_t[i].n_child == deck_i || (n_prev != -1 && wms->ms.cat_t[i].n_child == n_prev)) {
-                            n_parent = i;
-                          }
-                        }
-                      }
-                    } while (n_parent == -1 && (wms->ms.n_first != n_prev && n_prev != -1));
-                    deck_i = n_parent;
-                    j++;
-                  }
-                  len = 0;
-                  while (j-- > 0 && e == 0) {
-                    str = sa_get(&wms->ms.deck_sa, n_path[j]);
-                    do {
-                      size = 0;
-                      rv = snprintf(wms->ms.deck_path + len, wms->ms.deck_path_z - len, "/%s", str);
-                      e = rv < 0;
-                      if (e == 0) {
-                        if (rv >= wms->ms.deck_path_z - len) {
-                          size = len + rv + 1;
-                          wms->ms.deck_path = realloc(wms->ms.deck_path, size);
-                          e = wms->ms.deck_path == NULL;
-                          if (e == 0) {
-                            wms->ms.deck_path_z = size;
-                          }
-                        } else {
-                          len += rv;
-                        }
-                      }
-                    } while (e == 0 && size != 0);
-                  }
-                  free(n_path);
-                }
+                e = ms_deck_path(&wms->ms, wms->ms.deck_i, &wms->ms.deck_path, &wms->ms.deck_path_z);
                 break;
               case A_ASK_REMOVE:
                 wms->msg_header = "Remove file from the file system?";
@@ -5580,6 +10829,20 @@ int main(int argc, char *argv[])
                   }
                 }
                 break;
+              case A_ASK_BASE:
+                wms->msg_header = "Mark the current state as the base of the next delta?";
+                wms->msg_btn_main = "Mark";
+                wms->msg_btn_alt = "Cancel";
+                wms->page = P_MSG;
+                wms->mode = M_MSG_FILE;
+                break;
+              case A_MARK_BASE:
+                e = ms_build_base(&wms->ms, sb_l + 0);
+                if (e == 0) {
+                  e = ms_mark_base(&wms->ms, sb_l + 0);
+                }
+                base_free(sb_l + 0);
+                break;
               case A_ASK_ERASE:
                 wms->msg_header = "Erase all decks & cards?";
                 wms->msg_btn_main = "Erase";
@@ -5591,6 +10854,10 @@ int main(int argc, char *argv[])
                 e = ms_close(&wms->ms);
                 if (e == 0) {
                   wms->ms.passwd.style_sai = -1;
+                  wms->ms.passwd.dsum_i = -1;
+                  wms->ms.passwd.queue_i = -1;
+                  wms->ms.passwd.sidx_i = -1;
+                  wms->ms.passwd.base_i = -1;
                   e = ms_create(&wms->ms, O_TRUNC);
                   if (e == 0) {
                     wms->ms.deck_i = -1;
@@ -5683,23 +10950,16 @@ int main(int argc, char *argv[])
                       e = imf_put(&wms->ms.imf, index, "", 0);
                       if (e == 0) {
                         wms->ms.cat_t[deck_i].cat_cli = index;
+                        e = ms_summarize(&wms->ms, deck_i, NULL, 0);
+                      }
+                      if (e == 0) {
                         e = sa_set(&wms->ms.deck_sa, deck_i, wms->ms.deck_name_str);
                         if (e == 0) {
                           wms->ms.cat_t[deck_i].deck_x = 1;
                           switch (wms->ms.arrange) {
                           case 0: // Before
-                            n_prev = -1;
-                            n_parent = -1;
-                            for (i = 0; i < wms->ms.deck_a && n_prev == -1 && n_parent == -1; i++) {
-                              if (wms->ms.cat_t[i].deck_slot_used != 0) {
-                                if (wms->ms.cat_t[i].n_sibling == wms->ms.deck_i) {
-                                  n_prev = i;
-                                }
-                                if (wms->ms.cat_t[i].n_child == wms->ms.deck_i) {
-                                  n_parent = i;
-                                }
-                              }
-                            }
+                            n_prev = wms->ms.topo_l[wms->ms.deck_i].dt_prev;
+                            n_parent = wms->ms.topo_l[wms->ms.deck_i].dt_parent;
                             if (n_prev != -1) {
                               assert(wms->ms.cat_t[n_prev].n_sibling == wms->ms.deck_i);
                               wms->ms.cat_t[n_prev].n_sibling = deck_i;
@@ -5744,6 +11004,9 @@ int main(int argc, char *argv[])
                             if (e == 0) {
                               data_size = sizeof(struct Deck) * wms->ms.deck_a;
                               e = imf_put(&wms->ms.imf, C_INDEX, wms->ms.cat_t, data_size);
+                              if (e == 0) {
+                                e = ms_build_topology(&wms->ms);
+                              }
                               if (e == 0) {
                                 need_sync = 1;
                                 wms->ms.deck_i = deck_i;
@@ -5826,20 +11089,8 @@ int main(int argc, char *argv[])
                 break;
               case A_DELETE_DECK:
                 assert(wms->ms.cat_t[wms->ms.deck_i].deck_slot_used != 0);
-                n_prev = -1;
-                n_parent = -1;
-                i = 0;
-                do {
-                  if (wms->ms.cat_t[i].deck_slot_used != 0) {
-                    if (wms->ms.cat_t[i].n_sibling == wms->ms.deck_i) {
-                      n_prev = i;
-                    }
-                    if (wms->ms.cat_t[i].n_child == wms->ms.deck_i) {
-                      n_parent = i;
-                    }
-                  }
-                  i++;
-                } while (i < wms->ms.deck_a && n_prev == -1 && n_parent == -1);
+                n_prev = wms->ms.topo_l[wms->ms.deck_i].dt_prev;
+                n_parent = n_prev == -1 ? wms->ms.topo_l[wms->ms.deck_i].dt_parent : -1;
                 if (n_prev != -1) {
                   wms->ms.cat_t[n_prev].n_sibling = wms->ms.cat_t[wms->ms.deck_i].n_sibling;
                 } else if (n_parent != -1) {
@@ -5855,7 +11106,10 @@ int main(int argc, char *argv[])
                   if (e == 0) {
                     card_i = 0;
                     while (card_i < wms->ms.card_a && e == 0) {
-                      e = imf_delete(&wms->ms.imf, wms->ms.card_l[card_i].card_qai);
+                      e = ms_index_chunk(&wms->ms, wms->ms.card_l[card_i].card_qai, 0, wms->ms.card_l[card_i].card_state & 0x08);
+                      if (e == 0) {
+                        e = imf_delete(&wms->ms.imf, wms->ms.card_l[card_i].card_qai);
+                      }
                       card_i++;
                     }
                     if (e == 0) {
@@ -5867,6 +11121,9 @@ int main(int argc, char *argv[])
                   wms->ms.cat_t[wms->ms.deck_i].deck_slot_used = 0;
                   data_size = sizeof(struct Deck) * wms->ms.deck_a;
                   e = imf_put(&wms->ms.imf, C_INDEX, wms->ms.cat_t, data_size);
+                  if (e == 0) {
+                    e = ms_build_topology(&wms->ms);
+                  }
                   if (e == 0) {
                     need_sync = 1;
                     wms->ms.deck_i = -1;
@@ -5890,45 +11147,14 @@ int main(int argc, char *argv[])
                 assert(wms->ms.cat_t[wms->ms.deck_i].deck_slot_used != 0);
                 e = wms->ms.mov_deck_i < 0 || wms->ms.mov_deck_i >= wms->ms.deck_a || wms->ms.cat_t[wms->ms.mov_deck_i].deck_slot_used == 0 ? E_MOVED : 0;
                 if (e == 0) {
-                  n_prev = -1;
-                  n_parent = wms->ms.deck_i;
-                  do {
-                    if (n_prev != -1) {
-                      deck_i = n_prev;
-                    }
-                    if (n_parent != -1) {
-                      deck_i = n_parent;
-                    }
-                    e = wms->ms.mov_deck_i == n_parent ? E_TOPOL : 0;
-                    if (e == 0) {
-                      n_prev = -1;
-                      n_parent = -1;
-                      for (i = 0; i < wms->ms.deck_a && n_parent == -1 && n_prev == -1; i++) {
-                        if (wms->ms.cat_t[i].deck_slot_used != 0) {
-                          if (wms->ms.cat_t[i].n_sibling == deck_i) {
-                            n_prev = i;
-                          }
-                          if (wms->ms.cat_t[i].n_child == deck_i) {
-                            n_parent = i;
-                          }
-                        }
-                      }
-                    }
-                  } while ((n_parent != -1 || n_prev != -1) && e == 0);
+                  dt_ptr = wms->ms.topo_l + wms->ms.mov_deck_i;
+                  rank = wms->ms.topo_l[wms->ms.deck_i].dt_rank;
+                  e = rank >= dt_ptr->dt_rank && rank < dt_ptr->dt_rank + dt_ptr->dt_size ? E_TOPOL : 0; // the target lies within the moved subtree
                   if (e == 0) {
                     if (wms->ms.arrange != 0 || wms->ms.cat_t[wms->ms.mov_deck_i].n_sibling != wms->ms.deck_i) {
                       if (wms->ms.n_first != wms->ms.mov_deck_i) {
-                        n_prev = -1;
-                        n_parent = -1;
-                        for (i = 0; i < wms->ms.deck_a && n_prev == -1 && n_parent == -1; i++)
-                          if (wms->ms.cat_t[i].deck_slot_used != 0) {
-                            if (wms->ms.cat_t[i].n_sibling == wms->ms.mov_deck_i) {
-                              n_prev = i;
-                            }
-                            if (wms->ms.cat_t[i].n_child == wms->ms.mov_deck_i) {
-                              n_parent = i;
-                            }
-                          }
+                        n_prev = dt_ptr->dt_prev;
+                        n_parent = n_prev == -1 ? dt_ptr->dt_parent : -1;
                         if (n_prev != -1) {
                           wms->ms.cat_t[n_prev].n_sibling = wms->ms.cat_t[wms->ms.mov_deck_i].n_sibling;
                         }
@@ -5940,20 +11166,8 @@ int main(int argc, char *argv[])
                       }
                       switch (wms->ms.arrange) {
                       case 0: // Before
-                        i = 0;
-                        n_prev = -1;
-                        n_parent = -1;
-                        do {
-                          if (wms->ms.cat_t[i].deck_slot_used != 0) {
-                            if (wms->ms.cat_t[i].n_sibling == wms->ms.deck_i) {
-                              n_prev = i;
-                            }
-                            if (wms->ms.cat_t[i].n_child == wms->ms.deck_i) {
-                              n_parent = i;
-                            }
-                          }
-                          i++;
-                        } while (i < wms->ms.deck_a && n_prev == -1 && n_parent == -1);
+                        n_prev = wms->ms.topo_l[wms->ms.deck_i].dt_prev; // not the moved deck, so unaffected by its unlinking
+                        n_parent = wms->ms.topo_l[wms->ms.deck_i].dt_parent;
                         if (n_prev != -1) {
                           assert(wms->ms.cat_t[n_prev].n_sibling == wms->ms.deck_i);
                           wms->ms.cat_t[n_prev].n_sibling = wms->ms.mov_deck_i;
@@ -5982,6 +11196,9 @@ int main(int argc, char *argv[])
                       if (e == 0) {
                         data_size = sizeof(struct Deck) * wms->ms.deck_a;
                         e = imf_put(&wms->ms.imf, C_INDEX, wms->ms.cat_t, data_size);
+                        if (e == 0) {
+                          e = ms_build_topology(&wms->ms);
+                        }
                         if (e == 0) {
                           need_sync = 1;
                           wms->ms.deck_i = wms->ms.mov_deck_i;
@@ -6035,11 +11252,15 @@ int main(int argc, char *argv[])
                 break;
               case A_UPDATE_HTML:
                 if (wms->ms.card_i >= 0 && (((wms->ms.card_l[wms->ms.card_i].card_state & 0x08) != 0) != (wms->ms.is_html > 0))) {
-                  wms->ms.card_l[wms->ms.card_i].card_state = (wms->ms.card_l[wms->ms.card_i].card_state & 0x07) | (wms->ms.is_html > 0) << 3;
-                  data_size = wms->ms.card_a * sizeof(struct Card);
-                  index = wms->ms.cat_t[wms->ms.deck_i].cat_cli;
-                  e = imf_put(&wms->ms.imf, index, wms->ms.card_l, data_size);
-                  need_sync = 1;
+                  data_size = sa_length(&wms->ms.card_sa);
+                  e = ms_index_card(&wms->ms, wms->ms.card_l[wms->ms.card_i].card_qai, wms->ms.card_sa.sa_d, data_size, wms->ms.is_html <= 0, wms->ms.card_sa.sa_d, data_size, wms->ms.is_html > 0);
+                  if (e == 0) {
+                    wms->ms.card_l[wms->ms.card_i].card_state = (wms->ms.card_l[wms->ms.card_i].card_state & 0x07) | (wms->ms.is_html > 0) << 3;
+                    data_size = wms->ms.card_a * sizeof(struct Card);
+                    index = wms->ms.cat_t[wms->ms.deck_i].cat_cli;
+                    e = imf_put(&wms->ms.imf, index, wms->ms.card_l, data_size);
+                    need_sync = 1;
+                  }
                 }
                 break;
               case A_UPDATE_DECK_FLAGS:
@@ -6065,12 +11286,7 @@ int main(int argc, char *argv[])
                 if (need_sync == 1) {
                   e = wms->mctr != wms->ms.passwd.mctr ? E_MCTR : 0;
                   if (e == 0) {
-                    wms->ms.passwd.mctr++;
-                    data_size = sizeof(struct Password);
-                    e = imf_put(&wms->ms.imf, PW_INDEX, &wms->ms.passwd, data_size);
-                    if (e == 0) {
-                      e = imf_sync(&wms->ms.imf);
-                    }
+                    e = ms_sync(&wms->ms);
                   }
                 }
                 break;
@@ -6079,12 +11295,7 @@ int main(int argc, char *argv[])
                   assert(mtime_test != -1);
                   e = mtime_test != 1;
                   if (e == 0) {
-                    wms->ms.passwd.mctr++;
-                    data_size = sizeof(struct Password);
-                    e = imf_put(&wms->ms.imf, PW_INDEX, &wms->ms.passwd, data_size);
-                    if (e == 0) {
-                      e = imf_sync(&wms->ms.imf);
-                    }
+                    e = ms_sync(&wms->ms);
                   } else {
                     wms->msg_header = "Error: Invalid mtime value";
                     wms->msg_btn_main = "OK";
@@ -6123,6 +11334,7 @@ int main(int argc, char *argv[])
                             wms->ms.card_l[wms->ms.card_i].card_state = STATE_NEW | STATE_HTML;
                             e = imf_put(&wms->ms.imf, wms->ms.cat_t[wms->ms.deck_i].cat_cli, wms->ms.card_l, data_size);
                             if (e == 0) {
+                              e = ms_summarize(&wms->ms, wms->ms.deck_i, wms->ms.card_l, wms->ms.card_a);
                               need_sync = 1;
                               wms->page = P_EDIT;
                             }
@@ -6158,6 +11370,9 @@ int main(int argc, char *argv[])
                             wms->ms.card_l[wms->ms.card_i].card_state = STATE_NEW | STATE_HTML;
                             cat_ptr = wms->ms.cat_t + wms->ms.deck_i;
                             e = imf_put(&wms->ms.imf, cat_ptr->cat_cli, wms->ms.card_l, data_size);
+                            if (e == 0) {
+                              e = ms_summarize(&wms->ms, wms->ms.deck_i, wms->ms.card_l, wms->ms.card_a);
+                            }
                             need_sync = 1;
                             wms->page = P_EDIT;
                           }
@@ -6177,7 +11392,10 @@ int main(int argc, char *argv[])
               case A_DELETE_CARD:
                 if (wms->ms.card_a > 0 && wms->ms.card_i >= 0 && wms->ms.card_i < wms->ms.card_a) {
                   card_ptr = wms->ms.card_l + wms->ms.card_i;
-                  e = imf_delete(&wms->ms.imf, card_ptr->card_qai);
+                  e = ms_index_chunk(&wms->ms, card_ptr->card_qai, 0, card_ptr->card_state & 0x08);
+                  if (e == 0) {
+                    e = imf_delete(&wms->ms.imf, card_ptr->card_qai);
+                  }
                   if (e == 0) {
                     wms->ms.card_a--;
                     dest = wms->ms.card_l + wms->ms.card_i;
@@ -6195,6 +11413,9 @@ int main(int argc, char *argv[])
                     e = imf_put(&wms->ms.imf, cat_ptr->cat_cli, wms->ms.card_l, data_size);
                     if (e == 0) {
                       need_sync = 1;
+                      e = ms_summarize(&wms->ms, wms->ms.deck_i, wms->ms.card_l, wms->ms.card_a);
+                    }
+                    if (e == 0) {
                       e = ms_get_card_sa(&wms->ms);
                       if (e == 0) {
                         wms->page = P_EDIT;
@@ -6240,6 +11461,9 @@ int main(int argc, char *argv[])
                   data_size = wms->ms.card_a * sizeof(struct Card);
                   index = wms->ms.cat_t[wms->ms.deck_i].cat_cli;
                   e = imf_put(&wms->ms.imf, index, wms->ms.card_l, data_size);
+                  if (e == 0) {
+                    e = ms_summarize(&wms->ms, wms->ms.deck_i, wms->ms.card_l, wms->ms.card_a);
+                  }
                   need_sync = 1;
                   wms->page = P_EDIT;
                 }
@@ -6329,6 +11553,9 @@ int main(int argc, char *argv[])
                             }
                             data_size = mov_card_a * sizeof(struct Card);
                             e = imf_put(&wms->ms.imf, index, mov_card_l, data_size);
+                            if (e == 0) {
+                              e = ms_summarize(&wms->ms, wms->ms.mov_deck_i, mov_card_l, mov_card_a);
+                            }
                             if (e == 0) {
                               wms->ms.card_i = wms->ms.card_a;
                               wms->ms.card_a++;
@@ -6342,6 +11569,9 @@ int main(int argc, char *argv[])
                                 memcpy(dest, src, size);
                                 index = wms->ms.cat_t[wms->ms.deck_i].cat_cli;
                                 e = imf_put(&wms->ms.imf, index, wms->ms.card_l, data_size);
+                                if (e == 0) {
+                                  e = ms_summarize(&wms->ms, wms->ms.deck_i, wms->ms.card_l, wms->ms.card_a);
+                                }
                               }
                             }
                             if (e == 0) {
@@ -6401,23 +11631,11 @@ int main(int argc, char *argv[])
                 wms->page = P_START;
                 break;
               case A_SEARCH:
-                if (wms->ms.search_txt == NULL) {
-                  wms->ms.search_txt = malloc(1);
-                  e = wms->ms.search_txt == NULL;
-                  if (e == 0) {
-                    wms->ms.search_txt[0] = '\0';
-                  }
-                }
+                wms->found_str = NULL;
+                sa_ptr = &wms->ms.card_sa;
+                e = ms_prepare_search(&wms->ms, &mt, &cand_l, &cand_n, &wms->search_err);
                 if (e == 0) {
-                  size = strlen(wms->ms.search_txt) + 1;
-                  lwr_search_txt = malloc(size);
-                  e = lwr_search_txt == NULL;
-                  if (e == 0) {
-                    strcpy(lwr_search_txt, wms->ms.search_txt);
-                    if (wms->ms.match_case < 0) {
-                      str_tolower(lwr_search_txt);
-                    }
-                    wms->found_str = NULL;
+                  if (wms->search_err == NULL) {
                     search_deck_i = wms->ms.deck_i;
                     assert(wms->ms.card_i >= -1);
                     if (wms->ms.card_a > 0 && wms->ms.card_i == -1) {
@@ -6461,23 +11679,33 @@ int main(int argc, char *argv[])
                         assert(wms->ms.card_i >= -1);
                         if (wms->ms.card_a > 0) {
                           assert(wms->ms.card_i >= 0 && wms->ms.card_i < wms->ms.card_a);
-                          e = ms_get_card_sa(&wms->ms);
-                          if (e == 0) {
-                            q_str = sa_get(&wms->ms.card_sa, 0);
-                            e = q_str == NULL;
+                          if (ms_is_candidate(cand_l, cand_n, wms->ms.card_l[wms->ms.card_i].card_qai) != 0) {
+                            e = ms_text_index(&wms->ms, wms->ms.card_l[wms->ms.card_i].card_qai, wms->ms.card_l[wms->ms.card_i].card_state & 0x08, &index);
                             if (e == 0) {
-                              if (wms->ms.match_case < 0) {
-                                str_tolower(q_str);
+                              if (index == wms->ms.card_l[wms->ms.card_i].card_qai) {
+                                e = ms_get_card_sa(&wms->ms);
+                                sa_ptr = &wms->ms.card_sa;
+                              } else {
+                                e = sa_load(&wms->vis_sa, &wms->ms.imf, index);
+                                sa_ptr = &wms->vis_sa;
                               }
-                              wms->found_str = strstr(q_str, lwr_search_txt);
-                              if (wms->found_str == NULL) {
-                                a_str = sa_get(&wms->ms.card_sa, 1);
-                                e = a_str == NULL;
-                                if (e == 0) {
-                                  if (wms->ms.match_case < 0) {
-                                    str_tolower(a_str);
+                            }
+                            if (e == 0) {
+                              q_str = sa_get(sa_ptr, 0);
+                              e = q_str == NULL;
+                              if (e == 0) {
+                                e = mt_find_all(&mt, q_str, &wms->span_l[0], &wms->span_n[0]);
+                                if (e == 0 && wms->span_n[0] > 0) {
+                                  wms->found_str = q_str + wms->span_l[0][0].span_off;
+                                } else if (e == 0) {
+                                  a_str = sa_get(sa_ptr, 1);
+                                  e = a_str == NULL;
+                                  if (e == 0) {
+                                    e = mt_find_all(&mt, a_str, &wms->span_l[1], &wms->span_n[1]);
+                                    if (e == 0 && wms->span_n[1] > 0) {
+                                      wms->found_str = a_str + wms->span_l[1][0].span_off;
+                                    }
                                   }
-                                  wms->found_str = strstr(a_str, lwr_search_txt);
                                 }
                               }
                             }
@@ -6485,12 +11713,73 @@ int main(int argc, char *argv[])
                         }
                       }
                     } while (wms->found_str == NULL && !(wms->ms.scope == C_ALL ? wms->ms.card_i == search_card_i && wms->ms.deck_i == search_deck_i : wms->ms.card_i == search_card_i) && e == 0);
-                    e = ms_get_card_sa(&wms->ms);
-                    free(lwr_search_txt);
+                  }
+                  if (e == 0 && wms->found_str != NULL && sa_ptr == &wms->ms.card_sa && wms->span_n[0] > 0) {
+                    a_str = sa_get(sa_ptr, 1);
+                    e = a_str == NULL;
+                    if (e == 0) {
+                      e = mt_find_all(&mt, a_str, &wms->span_l[1], &wms->span_n[1]);
+                    }
+                  }
+                  if (e == 0 && (wms->found_str == NULL || sa_ptr != &wms->ms.card_sa)) {
+                    wms->span_n[0] = 0; // offsets into the visible text, the markup is shown
+                    wms->span_n[1] = 0;
+                    e = ms_get_card_sa(&wms->ms); // the card the search started at, or found by its visible text
+                  }
+                  if (e == 0 && wms->ms.sidx_state > 0 && (wms->mctr == wms->ms.passwd.mctr || need_sync == 1)) {
+                    e = ms_sync_aux(&wms->ms); // built by this search of the state the page shows (or synced)
                   }
                 }
+                free(cand_l);
+                mt_free(&mt);
                 wms->page = P_SEARCH;
                 break;
+              case A_SEARCH_LIST:
+                if (wms->hit_posted != 0 && (wms->ms.search_dir == 0 || wms->hit_mctr != wms->ms.passwd.mctr || wms->ms.sidx_state < 0)) { // not a page turn in the unchanged file
+                  free(wms->hit_l);
+                  wms->hit_l = NULL;
+                  wms->hit_n = 0;
+                  wms->hit_posted = 0;
+                }
+                if (wms->hit_posted == 0) {
+                  e = ms_prepare_search(&wms->ms, &mt, &cand_l, &cand_n, &wms->search_err);
+                  if (e == 0) {
+                    if (wms->search_err == NULL) {
+                      e = ms_search_list(&wms->ms, &mt, cand_l, cand_n, &wms->hit_l, &wms->hit_n);
+                    }
+                    if (e == 0 && wms->ms.sidx_state > 0 && wms->mctr == wms->ms.passwd.mctr) {
+                      e = ms_sync_aux(&wms->ms); // built by this search of the state the page shows
+                    }
+                  }
+                  free(cand_l);
+                  mt_free(&mt);
+                }
+                if (e == 0) {
+                  if (wms->list_pos < 0) {
+                    wms->list_pos = 0;
+                  }
+                  wms->list_pos += wms->ms.search_dir * SH_PAGE;
+                  if (wms->list_pos >= wms->hit_n) {
+                    wms->list_pos = wms->hit_n > 0 ? (wms->hit_n - 1) / SH_PAGE * SH_PAGE : 0;
+                  }
+                  if (wms->list_pos < 0) {
+                    wms->list_pos = 0;
+                  }
+                  for (i = wms->list_pos; i < wms->hit_n && i < wms->list_pos + SH_PAGE && e == 0; i++) {
+                    if (wms->hit_posted != 0) {
+                      e = ms_hit_chunk(&wms->ms, wms->hit_l + i);
+                    }
+                    if (e == 0) {
+                      e = ms_hit_snippet(&wms->ms, wms->hit_l + i);
+                    }
+                    if (e == 0) {
+                      size = 0;
+                      e = ms_deck_path(&wms->ms, wms->hit_l[i].sh_deck_i, &wms->hit_l[i].sh_path, &size);
+                    }
+                  }
+                }
+                wms->page = P_SEARCH_LIST;
+                break;
               case A_PREVIEW:
                 wms->page = P_PREVIEW;
                 break;
@@ -6505,17 +11794,10 @@ int main(int argc, char *argv[])
                 }
                 break;
               case A_DETERMINE_CARD:
-                e = ms_determine_card(&wms->ms);
+                e = ms_ask_card(&wms->ms);
                 if (e == 0) {
-                  assert(wms->ms.deck_i >= 0 && wms->ms.card_i >= 0);
-                  e = ms_load_card_list(&wms->ms);
-                  if (e == 0) {
-                    e = ms_get_card_sa(&wms->ms);
-                    if (e == 0) {
-                      wms->page = P_LEARN;
-                      wms->mode = M_ASK;
-                    }
-                  }
+                  wms->page = P_LEARN;
+                  wms->mode = M_ASK;
                 } else if (e == -1) {
                   wms->msg_header = "Notification";
                   wms->msg_static = "No card eligible for repetition.";
@@ -6577,19 +11859,8 @@ int main(int argc, char *argv[])
                 }
                 break;
               case A_PROCEED:
-                assert(wms->ms.deck_i >= 0 && wms->ms.deck_i < wms->ms.deck_a && wms->ms.cat_t[wms->ms.deck_i].deck_slot_used != 0);
-                assert(wms->ms.timestamp >= 0);
-                e = wms->ms.lvl < 0 || wms->ms.lvl > 20 ? E_LVL_1 : 0;
+                e = ms_proceed(&wms->ms);
                 if (e == 0) {
-                  card_ptr = wms->ms.card_l + wms->ms.card_i;
-                  if ((card_ptr->card_state & 0x07) == STATE_NEW || (card_ptr->card_state & 0x07) == STATE_SUSPENDED) {
-                    card_ptr->card_state = (card_ptr->card_state & 0x08) | STATE_SCHEDULED;
-                  }
-                  card_ptr->card_strength = lvl_s[wms->ms.lvl]; // S = -t / log(R)
-                  card_ptr->card_time = wms->ms.timestamp;
-                  assert((card_ptr->card_state & 0x07) == STATE_SCHEDULED);
-                  data_size = wms->ms.card_a * sizeof(struct Card);
-                  e = imf_put(&wms->ms.imf, wms->ms.cat_t[wms->ms.deck_i].cat_cli, wms->ms.card_l, data_size);
                   need_sync = 1;
                 }
                 break;
@@ -6610,6 +11881,9 @@ int main(int argc, char *argv[])
                 data_size = wms->ms.card_a * sizeof(struct Card);
                 index = wms->ms.cat_t[wms->ms.deck_i].cat_cli;
                 e = imf_put(&wms->ms.imf, index, wms->ms.card_l, data_size);
+                if (e == 0) {
+                  e = ms_summarize(&wms->ms, wms->ms.deck_i, wms->ms.card_l, wms->ms.card_a);
+                }
                 need_sync = 1;
                 break;
               case A_ASK_RESUME:
@@ -6635,6 +11909,9 @@ int main(int argc, char *argv[])
                     data_size = wms->ms.card_a * sizeof(struct Card);
                     index = wms->ms.cat_t[wms->ms.deck_i].cat_cli;
                     e = imf_put(&wms->ms.imf, index, wms->ms.card_l, data_size);
+                    if (e == 0) {
+                      e = ms_summarize(&wms->ms, wms->ms.deck_i, wms->ms.card_l, wms->ms.card_a);
+                    }
                     need_sync = 1;
                   }
                 }
@@ -6670,7 +11947,14 @@ int main(int argc, char *argv[])
                   for (i = 0; i < 100; i++)
                     if (wms->hist_bucket[i] > wms->hist_max)
                       wms->hist_max = wms->hist_bucket[i];
-                  wms->page = P_HISTOGRAM;
+                  e = ms_forecast(&wms->ms, wms->fc_bucket); // stale wheels are re-anchored in memory, the file isn't written
+                  if (e == 0) {
+                    wms->fc_max = 0;
+                    for (i = 0; i < 30; i++)
+                      if (wms->fc_bucket[i] > wms->fc_max)
+                        wms->fc_max = wms->fc_bucket[i];
+                    wms->page = P_HISTOGRAM;
+                  }
                 }
                 break;
               case A_TABLE: